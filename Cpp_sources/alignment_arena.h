@@ -0,0 +1,119 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef ALIGNMENT_ARENA_H
+#define ALIGNMENT_ARENA_H
+
+#include <cstdint>
+#include <vector>
+#include "alignment_io.h"
+
+/// <summary>
+/// Consecutive alignments of a single read stored in an arena (or any other array); filters can only reorder and drop them.
+/// </summary>
+class AlignmentSpan {
+private:
+  Alignment* first;
+  size_t length;
+
+public:
+  AlignmentSpan(Alignment* first, const size_t length) : first(first), length(length) {}
+
+  inline size_t size() const { return length; }
+  inline bool empty() const { return length == 0; }
+  inline Alignment& operator[](const size_t i) { return first[i]; }
+  inline const Alignment& operator[](const size_t i) const { return first[i]; }
+  inline Alignment* begin() { return first; }
+  inline Alignment* end() { return first + length; }
+  inline const Alignment* begin() const { return first; }
+  inline const Alignment* end() const { return first + length; }
+
+  /// <summary>
+  /// Drops alignments from the end of the span; records stay in the arena for the next reads.
+  /// </summary>
+  /// <param name="size">New size, which must not exceed the current one.</param>
+  inline void resize(const size_t size) { length = size; }
+  inline void clear() { length = 0; }
+};
+
+/// <summary>
+/// Records of alignments reused by consecutive chunks: the arena is reset instead of freed, so records keep their buffers
+/// and reading into them allocates memory only until the buffers are large enough for the longest lines (or BAM records).
+/// </summary>
+class AlignmentArena {
+private:
+  std::vector<Alignment> records;
+  size_t used = 0;
+  /// <summary>
+  /// Capacity of the buffer of the record returned by the last add(), to detect its growth.
+  /// </summary>
+  size_t capacity = 0;
+  uint64_t allocations_count = 0;
+
+  /// <summary>
+  /// Counts a growth of the buffer of the last added record.
+  /// </summary>
+  inline void check_last() {
+    if (used > 0 && records[used - 1].capacity() > capacity) {
+      ++allocations_count;
+    }
+  }
+
+public:
+  /// <summary>
+  /// Makes all records free; their buffers are preserved.
+  /// </summary>
+  void reset() {
+    check_last();
+    used = 0;
+    capacity = 0;
+  }
+
+  /// <summary>
+  /// Returns a free record to be filled (e.g. by AlignmentReader::next), it is valid until the arena grows by the next add().
+  /// </summary>
+  Alignment& add() {
+    check_last();
+    if (used == records.size()) {
+      // A new record and possibly a reallocation of the array of records
+      allocations_count += records.size() == records.capacity() ? 2 : 1;
+      records.emplace_back();
+    }
+    Alignment& record = records[used++];
+    capacity = record.capacity();
+    return record;
+  }
+
+  /// <summary>
+  /// Returns the last added record to the free ones (e.g. if it was not filled).
+  /// </summary>
+  void pop() {
+    check_last();
+    --used;
+    capacity = 0;
+  }
+
+  /// <summary>
+  /// Number of used records.
+  /// </summary>
+  inline size_t size() const { return used; }
+
+  /// <summary>
+  /// Used records [from; from + length).
+  /// </summary>
+  inline AlignmentSpan span(const size_t from, const size_t length) { return AlignmentSpan(records.data() + from, length); }
+
+  /// <summary>
+  /// Returns the number of heap allocations made by the arena (new records, reallocations of the array and growths of buffers of records) since the last call.
+  /// </summary>
+  uint64_t allocations() {
+    check_last();
+    capacity = used > 0 ? records[used - 1].capacity() : 0;
+    uint64_t result = allocations_count;
+    allocations_count = 0;
+    return result;
+  }
+};
+
+#endif
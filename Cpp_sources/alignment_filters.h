@@ -0,0 +1,549 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef ALIGNMENT_FILTERS_H
+#define ALIGNMENT_FILTERS_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include "alignment_arena.h"
+#include "alignment_grouping.h"
+#include "alignment_io.h"
+#include "annotation_index.h"
+#include "id_dictionary.h"
+#include "parallel.h"
+#include "result_cache.h"
+#include "run_stats.h"
+
+/// <summary>
+/// A stage of the filtering pipeline; it gets all preserved alignments of a single read (grouped by NH:i:Nmap) at once.
+/// Stages do not modify NH:i:Nmap, HI:i:I, MAPQ nor the primary alignment flag, these are fixed once after the last stage.
+/// </summary>
+class AlignmentStage {
+public:
+  virtual ~AlignmentStage() {}
+
+  /// <summary>
+  /// Removes references from the output header, which cannot occur in the filtered alignments.
+  /// </summary>
+  /// <param name="header">Output header after the previous stages.</param>
+  /// <returns>Mapping from reference ids of the given header to the new reference ids (-1 for removed references); empty if nothing was removed.</returns>
+  virtual std::vector<int32_t> filter_header(AlignmentHeader& /*header*/) const {
+    return std::vector<int32_t>();
+  }
+
+  /// <summary>
+  /// Removes alignments from the group.
+  /// </summary>
+  /// <param name="group">Preserved alignments of a single read (in the input order).</param>
+  /// <param name="header">Header of the input file.</param>
+  /// <returns>0 if no error occured; otherwise the error code to be returned from the program.</returns>
+  virtual int filter(AlignmentSpan& group, const AlignmentHeader& header) const = 0;
+};
+
+/// <summary>
+/// Filters out all alignments mapped to the reverse strand.
+/// </summary>
+class ReverseStrandFilter : public AlignmentStage {
+public:
+  int filter(AlignmentSpan& group, const AlignmentHeader& /*header*/) const override {
+    size_t preserved = 0;
+    for (size_t i = 0; i < group.size(); ++i) {
+      if (!(group[i].flag() & 16)) { // SEQ is not reverse complemented
+        if (preserved != i) {
+          std::swap(group[preserved], group[i]);
+        }
+        ++preserved;
+      }
+    }
+    group.resize(preserved);
+    return 0;
+  }
+};
+
+/// <summary>
+/// Filters out reads mapped into multiple transcripts from different genes (multiple transcripts from the same gene are allowed).
+/// </summary>
+class AmbiguousGeneFilter : public AlignmentStage {
+private:
+  /// <summary>
+  /// Mapping saying, what gene_id corresponds to a given transcript_id.
+  /// </summary>
+  const TranscriptGenes& transcript_gene;
+  /// <summary>
+  /// Name of the annotation file for error messages.
+  /// </summary>
+  std::string annotations;
+  /// <summary>
+  /// Counters of removed reads and of transcript_ids missing in the annotations (see RunStats).
+  /// </summary>
+  std::atomic<uint64_t>& ambiguous_reads;
+  std::atomic<uint64_t>& unknown_transcripts;
+
+public:
+  AmbiguousGeneFilter(const TranscriptGenes& transcript_gene, const std::string& annotations) : transcript_gene(transcript_gene), annotations(annotations),
+    ambiguous_reads(RunStats::global().counter("ambiguous_reads")), unknown_transcripts(RunStats::global().counter("unknown_transcript_ids")) {}
+
+  int filter(AlignmentSpan& group, const AlignmentHeader& header) const override {
+    if (group.size() <= 1) { // If there is just a single read, there is nothing to check
+      return 0;
+    }
+    // Whether all alignments correspond to the same gene
+    bool unambiguous = true;
+    uint32_t first_gene = IdDictionary::NONE;
+    for (size_t i = 0; i < group.size(); ++i) {
+      std::string_view transcript_id = group[i].reference(header);
+      uint32_t gene = transcript_gene.gene(transcript_id);
+      if (gene == IdDictionary::NONE) {
+        ++unknown_transcripts;
+        std::cerr << "Unknown gene_id: a transcript_id '" << transcript_id << "' did not occure in the annotations file '" << annotations << "': '" << group[i].text(header) << "'" << std::endl;
+        return i == 0 ? 6 : 7;
+      }
+      if (i == 0) {
+        first_gene = gene;
+      } else if (first_gene != gene) {
+        unambiguous = false;
+      }
+    }
+    if (!unambiguous) {
+      ++ambiguous_reads;
+      group.clear();
+    }
+    return 0;
+  }
+
+  /// <summary>
+  /// Loads transcript_id => gene_id mapping from annotations in GTF format, or from their index (compile_annotations).
+  /// </summary>
+  /// <param name="filename">Annotations file in GTF format or annotation index.</param>
+  /// <param name="transcript_gene">Mapping saying, what gene_id corresponds to a given transcript_id (output).</param>
+  /// <returns>0 if no error occured; otherwise the error code to be returned from the program.</returns>
+  static int load(const std::string& filename, TranscriptGenes& transcript_gene) {
+    if (AnnotationIndex::is_annotation_index(filename)) {
+      AnnotationIndex index;
+      if (!index.open(filename)) {
+        return 9;
+      }
+      load_transcript_genes(index, transcript_gene);
+      return 0;
+    }
+    std::string line;
+    InputFile input;
+    if (!input.open(filename)) {
+      return 9;
+    }
+    while (input.getline(line)) {
+      if (!line.empty() && line[0] != '#') {
+        size_t transcript_from = line.find(" transcript_id \"");
+        if (transcript_from != line.npos) {
+          transcript_from += 16;
+          size_t transcript_to = line.find("\";", transcript_from);
+          if (transcript_to == line.npos) {
+            std::cerr << "Unexpected line format: incomplete 'transcript_id' tag: '" << line << "'" << std::endl;
+            return 2;
+          }
+          size_t gene_from = line.find("\tgene_id \"");
+          if (gene_from == line.npos) {
+            std::cerr << "Unexpected line format: missing 'gene_id' tag: '" << line << "'" << std::endl;
+            return 2;
+          }
+          gene_from += 10;
+          size_t gene_to = line.find("\";", gene_from);
+          if (gene_to == line.npos) {
+            std::cerr << "Unexpected line format: incomplete 'gene_id' tag: '" << line << "'" << std::endl;
+            return 2;
+          }
+          std::string_view view(line);
+          transcript_gene.add(view.substr(transcript_from, transcript_to - transcript_from), view.substr(gene_from, gene_to - gene_from));
+        }
+      }
+    }
+    if (input.failed()) {
+      return 10;
+    }
+    return 0;
+  }
+};
+
+/// <summary>
+/// Filters out all alignments to transcripts that are not selected; '@SQ' lines of such transcripts are removed from the header.
+/// </summary>
+class TranscriptFilter : public AlignmentStage {
+private:
+  /// <summary>
+  /// Transcript_ids that should be preserved.
+  /// </summary>
+  const IdDictionary& transcript_ids;
+
+  inline bool selected(const std::string_view transcript_id) const {
+    return transcript_ids.find(transcript_id) != IdDictionary::NONE;
+  }
+
+public:
+  TranscriptFilter(const IdDictionary& transcript_ids) : transcript_ids(transcript_ids) {}
+
+  std::vector<int32_t> filter_header(AlignmentHeader& header) const override {
+    return header.filter_references([this](const std::string& name) { return selected(name); });
+  }
+
+  int filter(AlignmentSpan& group, const AlignmentHeader& header) const override {
+    size_t preserved = 0;
+    for (size_t i = 0; i < group.size(); ++i) {
+      if (selected(group[i].reference(header))) {
+        if (preserved != i) {
+          std::swap(group[preserved], group[i]);
+        }
+        ++preserved;
+      }
+    }
+    group.resize(preserved);
+    return 0;
+  }
+
+  /// <summary>
+  /// Loads transcript_ids to be preserved.
+  /// </summary>
+  /// <param name="filename">File with one transcript_id per line.</param>
+  /// <param name="transcript_ids">Transcript_ids (output).</param>
+  static void load(const std::string& filename, IdDictionary& transcript_ids) {
+    InputFile input;
+    if (!input.open(filename)) {
+      return;
+    }
+    for (std::string line; input.getline(line); ) {
+      transcript_ids.insert(line);
+    }
+  }
+};
+
+/// <summary>
+/// Updates FLAG (by choosing a new primary alignment), MAPQ, NH:i:Nmap and HI:i:I of alignments of a single read if some of them were filtered out.
+/// </summary>
+/// <param name="group">Preserved alignments of the read.</param>
+/// <param name="count">Original number of alignments of the read.</param>
+/// <param name="header">Header of the input file.</param>
+inline void update_group(AlignmentSpan& group, const int64_t count, const AlignmentHeader& header) {
+  if (group.size() == (size_t)count) { // No alignment leaved out, so no changes in lines
+    return;
+  }
+  // Whether a preserved line is marked as a primary alignment
+  size_t primary = -1;
+  for (size_t i = 0; i < group.size(); i++) {
+    if (!(group[i].flag() & 256)) {
+      primary = i;
+    }
+  }
+  if (primary == -1) { // No preserved alignment is labeled as a primary, so one of them must be choosen
+    // For now, all alignments have the some CIGAR so it is not necessary to try to identify alignment score
+    for (size_t i = 1; i < group.size(); i++) {
+      if (group[i].cigar() != group[0].cigar()) {
+        std::cerr << "Not implemented yet '" << group[i].text(header) << "'" << std::endl;
+      }
+    }
+    primary = 0;
+  } else { // Some preserved alignment was marked as a primary, so no one flag must be changed
+    primary = -1;
+  }
+  // It is constant for all alignments
+  uint8_t mapq = (uint8_t)(group.size() <= 1 ? 255 : (-10 * std::log10(1 - 1.0 / group.size())));
+  for (size_t i = 0; i < group.size(); i++) {
+    // New primary alignment must be changed, MAPQ score must be recomputed, number of alignments was changed and index of the alignment could be changed
+    group[i].set_fields(primary == i ? group[i].flag() ^ 256 : group[i].flag(), mapq, group.size(), i + 1);
+  }
+}
+
+/// <summary>
+/// Marks references of an alignment (RNAME and RNEXT) as used.
+/// </summary>
+/// <param name="alignment">The alignment.</param>
+/// <param name="header">Header the alignment refers to.</param>
+/// <param name="used">Whether references (by reference ids of the header) are used (output).</param>
+inline void mark_references(const Alignment& alignment, const AlignmentHeader& header, std::vector<bool>& used) {
+  auto mark = [&used](const int32_t id) {
+    if (id >= 0 && (size_t)id < used.size()) {
+      used[id] = true;
+    }
+  };
+  if (alignment.is_binary()) {
+    mark(alignment.reference_id());
+    mark(alignment.next_reference_id());
+  } else { // RNEXT '=' is the same as RNAME, '*' is not a reference
+    mark(header.reference_id(alignment.reference(header)));
+    mark(header.reference_id(alignment.next_reference(header)));
+  }
+}
+
+/// <summary>
+/// Alignments of a single read (grouped by NH:i:Nmap) as a range of records of the chunk's arena.
+/// </summary>
+struct AlignmentGroup {
+  /// <summary>
+  /// Index of the first record in the arena.
+  /// </summary>
+  size_t from;
+  /// <summary>
+  /// Number of preserved alignments (in the input order).
+  /// </summary>
+  size_t size;
+  /// <summary>
+  /// Original number of alignments of the read.
+  /// </summary>
+  int64_t count;
+};
+
+/// <summary>
+/// Consecutive reads processed together by a single thread; chunks are cut only at boundaries of reads.
+/// Chunks are recycled by ordered_pipeline, so records of the arena and the array of groups are allocated only while they grow.
+/// </summary>
+struct AlignmentChunk {
+  AlignmentArena arena;
+  std::vector<AlignmentGroup> groups;
+
+  /// <summary>
+  /// Preserved alignments of a group; the span is valid until the chunk is refilled.
+  /// </summary>
+  inline AlignmentSpan alignments(const AlignmentGroup& group) { return arena.span(group.from, group.size); }
+};
+
+/// <summary>
+/// Number of alignments in a chunk (the last read is always completed).
+/// </summary>
+const size_t ALIGNMENT_CHUNK = 16384;
+
+/// <summary>
+/// Filters a single alignment file through all stages in one pass.
+/// It expectes that the input file has grouped QNAMEs (unless they are grouped by an external sort, see GroupingOptions) and that NH:i:Nmap is valid.
+/// Reads are split into chunks, which are filtered by multiple threads and written in the original order, so the output does not depend on the number of threads.
+/// </summary>
+/// <param name="stages">Stages of the pipeline in the order of application.</param>
+/// <param name="input_name">Input file in SAM or BAM format.</param>
+/// <param name="output_name">Output file (in BAM format if its name ends with '.bam', in SAM format otherwise).</param>
+/// <param name="threads">Number of threads filtering chunks (and decompressing and compressing BGZF blocks), 1 means processing in the calling thread.</param>
+/// <param name="compression">Compression of SAM output (AUTO by the extension of its name); BAM output is always in BGZF format.</param>
+/// <param name="grouping">Whether QNAMEs are grouped by an external sort and whether unused references are removed from the header.</param>
+/// <returns>0 if no error occured; otherwise the error code to be returned from the program.</returns>
+inline int filter_alignments(const std::vector<const AlignmentStage*>& stages, const std::string& input_name, const std::string& output_name, const size_t threads = 1,
+  const OutputFile::Compression compression = OutputFile::Compression::AUTO, const GroupingOptions& grouping = GroupingOptions()) {
+  AlignmentReader input;
+  AlignmentHeader input_header;
+  if (!input.open(input_name, threads) || !input.read_header(input_header)) {
+    return 9;
+  }
+  AlignmentWriter output;
+  if (!output.open(output_name, compression, threads)) {
+    return 9;
+  }
+  // Counters shared by all files filtered by the process
+  RunStats& stats = RunStats::global();
+  std::atomic<uint64_t>& input_alignments = stats.counter("input_alignments");
+  std::atomic<uint64_t>& output_alignments = stats.counter("output_alignments");
+  std::atomic<uint64_t>& input_reads = stats.counter("input_reads");
+  std::atomic<uint64_t>& removed_reads = stats.counter("removed_reads");
+  std::atomic<uint64_t>& modified_reads = stats.counter("modified_reads");
+  // Header; stages knowing in advance which references cannot occur (e.g. '@SQ' of not selected transcripts) modify it,
+  // other unused references are left out only if the output is spooled into a temporary file first (GroupingOptions::prune_references)
+  AlignmentHeader header = input_header;
+  std::vector<int32_t> mapping;
+  for (const AlignmentStage* stage : stages) {
+    std::vector<int32_t> stage_mapping = stage->filter_header(header);
+    if (stage_mapping.empty()) {
+      continue;
+    }
+    if (mapping.empty()) {
+      mapping.swap(stage_mapping);
+    } else {
+      for (int32_t& id : mapping) {
+        id = id < 0 ? -1 : stage_mapping[id];
+      }
+    }
+  }
+  // Alignments of the ungrouped input are grouped by QNAME before filtering
+  QnameGrouper grouper(grouping, input.is_binary());
+  if (grouping.ungrouped) {
+    for (Alignment alignment; input.next(alignment); ) {
+      if (!grouper.add(alignment)) {
+        return 10;
+      }
+    }
+    if (input.failed()) {
+      return 10;
+    }
+    if (!grouper.finish()) {
+      return 10;
+    }
+    stats.add("spilled_runs", grouper.runs());
+    mark_grouped(header);
+  }
+  auto next = [&](Alignment& alignment) {
+    return grouping.ungrouped ? grouper.next(alignment) : input.next(alignment);
+  };
+  // Filtered alignments waiting for the header without unused references, and the references used by them
+  AlignmentSpool spool;
+  std::vector<bool> used(header.names.size(), false);
+  if (grouping.prune_references) {
+    if (!spool.create(grouping.temp_directory, input.is_binary())) {
+      return 9;
+    }
+  } else {
+    output.write_header(header);
+  }
+
+  // Multiple lines must be processed together to correctly update NH:i tag, MAPQ score etc., so chunks contain whole reads
+  std::atomic<uint64_t>& group_allocations = stats.counter("group_allocations");
+  auto read_chunk = [&](AlignmentChunk& chunk) {
+    chunk.arena.reset();
+    const size_t groups_capacity = chunk.groups.capacity();
+    chunk.groups.clear();
+    int result = 0;
+    for (size_t lines = 0; lines < ALIGNMENT_CHUNK; ) {
+      Alignment* alignment = &chunk.arena.add();
+      if (!next(*alignment)) {
+        chunk.arena.pop();
+        break;
+      }
+      // First we need to know, how many alignments there are for the current read
+      int64_t count;
+      if (!alignment->get_tag("NH", count)) {
+        std::cerr << "Unexpected file format: missing NH:i: tag '" << alignment->text(input_header) << "'" << std::endl;
+        chunk.arena.pop();
+        continue;
+      }
+      AlignmentGroup group = { chunk.arena.size() - 1, 1, std::max<int64_t>(count, 1) };
+      for (int64_t i = 1; i < count; i++) {
+        alignment = &chunk.arena.add();
+        if (!next(*alignment)) {
+          std::cerr << "Unexpected end of file file '" << input_name << "'" << std::endl;
+          result = 17;
+          break;
+        }
+        ++group.size;
+      }
+      if (result != 0) {
+        break;
+      }
+      chunk.groups.push_back(group);
+      lines += group.count;
+    }
+    group_allocations += chunk.arena.allocations() + (chunk.groups.capacity() != groups_capacity ? 1 : 0);
+    if (result != 0) {
+      return result;
+    }
+    if (input.failed() || grouper.failed()) {
+      return 10;
+    }
+    return chunk.groups.empty() ? -1 : 0;
+  };
+  auto filter_chunk = [&](AlignmentChunk& chunk) {
+    // Counters are updated once per chunk
+    uint64_t alignments = 0, preserved = 0, removed = 0, modified = 0;
+    for (AlignmentGroup& group : chunk.groups) {
+      AlignmentSpan group_alignments = chunk.alignments(group);
+      alignments += group_alignments.size();
+      for (const AlignmentStage* stage : stages) {
+        if (group_alignments.empty()) {
+          break;
+        }
+        int error = stage->filter(group_alignments, input_header);
+        if (error != 0) { // Only the previous reads are written
+          chunk.groups.resize(&group - chunk.groups.data());
+          return error;
+        }
+      }
+      group.size = group_alignments.size();
+      preserved += group_alignments.size();
+      removed += group_alignments.empty() ? 1 : 0;
+      modified += !group_alignments.empty() && group_alignments.size() != (size_t)group.count ? 1 : 0;
+      update_group(group_alignments, group.count, input_header);
+      if (!mapping.empty()) {
+        for (Alignment& alignment : group_alignments) {
+          alignment.remap_references(mapping);
+        }
+      }
+    }
+    input_alignments += alignments;
+    output_alignments += preserved;
+    input_reads += chunk.groups.size();
+    removed_reads += removed;
+    modified_reads += modified;
+    return 0;
+  };
+  auto write_chunk = [&](AlignmentChunk& chunk) {
+    for (const AlignmentGroup& group : chunk.groups) {
+      for (const Alignment& alignment : chunk.alignments(group)) {
+        if (grouping.prune_references) {
+          mark_references(alignment, header, used);
+          spool.write(alignment);
+        } else if (!output.write(alignment, header)) {
+          return 10;
+        }
+      }
+    }
+    return 0;
+  };
+  int error = ordered_pipeline<AlignmentChunk>(threads, read_chunk, filter_chunk, write_chunk);
+  if (error != 0) {
+    return error;
+  }
+  if (grouping.prune_references) { // The header is known only now
+    IdDictionary used_names;
+    for (size_t i = 0; i < used.size(); ++i) {
+      if (used[i]) {
+        used_names.insert(header.names[i]);
+      }
+    }
+    std::vector<int32_t> pruned = header.filter_references([&used_names](const std::string& name) { return used_names.find(name) != IdDictionary::NONE; });
+    output.write_header(header);
+    if (!spool.rewind()) {
+      return 10;
+    }
+    for (Alignment alignment; spool.next(alignment); ) {
+      alignment.remap_references(pruned);
+      if (!output.write(alignment, header)) {
+        return 10;
+      }
+    }
+    if (spool.failed()) {
+      return 10;
+    }
+  }
+  // Cleaning
+  if (!output.close()) {
+    return 9;
+  }
+  return 0;
+}
+
+/// <summary>
+/// Filters pairs of alignment files through all stages; the threads are shared by files processed simultaneously and by chunks of each file.
+/// </summary>
+/// <param name="stages">Stages of the pipeline in the order of application.</param>
+/// <param name="names">Pairs of input and output filenames.</param>
+/// <param name="pairs">Number of pairs of filenames.</param>
+/// <param name="threads">Maximal number of threads.</param>
+/// <param name="compression">Compression of SAM outputs (AUTO by the extensions of their names).</param>
+/// <param name="grouping">Whether QNAMEs are grouped by an external sort and whether unused references are removed from headers.</param>
+/// <returns>0 if no error occured; otherwise the error code of the first failed pair.</returns>
+/// <remarks>With '--cache DIR' each pair is a result of its own (see ResultCache), so pairs filtered before with the same stages are only restored.</remarks>
+inline int filter_file_pairs(const std::vector<const AlignmentStage*>& stages, char* names[], const size_t pairs, const size_t threads,
+  const OutputFile::Compression compression = OutputFile::Compression::AUTO, const GroupingOptions& grouping = GroupingOptions()) {
+  // Files are processed simultaneously first, the remaining threads split files into chunks
+  size_t files = std::max<size_t>(1, std::min(threads, pairs));
+  size_t chunk_threads = std::max<size_t>(1, threads / files);
+  return parallel_for(pairs, files, [&](const size_t i) {
+    ResultCache::Result result = ResultCache::global().result({ names[2 * i] }, { names[2 * i + 1] });
+    if (result.restore()) {
+      RunStats::global().add("reused_outputs", 1);
+      return 0;
+    }
+    int error = filter_alignments(stages, names[2 * i], result.target(0), chunk_threads, compression, grouping);
+    if (error == 0 && !result.store()) {
+      error = 9;
+    }
+    return error;
+  });
+}
+
+#endif
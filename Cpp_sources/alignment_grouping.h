@@ -0,0 +1,435 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef ALIGNMENT_GROUPING_H
+#define ALIGNMENT_GROUPING_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+#include <unistd.h>
+#include "alignment_io.h"
+#include "compressed_io.h"
+
+/// <summary>
+/// How filters get alignments grouped by QNAME and which references they keep in the header.
+/// </summary>
+struct GroupingOptions {
+  /// <summary>
+  /// Whether the input is not grouped by QNAME (e.g. it is sorted by coordinates), so alignments are grouped by an external sort.
+  /// </summary>
+  bool ungrouped = false;
+  /// <summary>
+  /// Whether '@SQ' lines of references without any preserved alignment are removed; the output is spooled into a temporary file then.
+  /// </summary>
+  bool prune_references = false;
+  /// <summary>
+  /// Memory for alignments sorted at once (in bytes); larger inputs are sorted in runs on disk, which are merged.
+  /// </summary>
+  size_t memory = (size_t)512 << 20;
+  /// <summary>
+  /// Directory of temporary files; TMPDIR (or '/tmp') if empty.
+  /// </summary>
+  std::string temp_directory;
+};
+
+/// <summary>
+/// Parses an option of the grouping (--ungrouped, --prune-references, --memory MB, --temp DIR) if it is the argument at the given position.
+/// </summary>
+/// <param name="argi">Position of the examined argument; it is moved after the option if present.</param>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Arguments.</param>
+/// <param name="options">Grouping options (output); unchanged if no option is present.</param>
+/// <returns>FALSE if an option is present, but its value is invalid.</returns>
+inline bool parse_grouping(int& argi, const int argc, char* argv[], GroupingOptions& options) {
+  if (argi >= argc) {
+    return true;
+  }
+  std::string option(argv[argi]);
+  if (option == "--ungrouped") {
+    options.ungrouped = true;
+    ++argi;
+  } else if (option == "--prune-references") {
+    options.prune_references = true;
+    ++argi;
+  } else if (option == "--memory" || option == "--temp") {
+    if (argi + 1 >= argc) {
+      std::cerr << "Missing value of option '" << option << "'." << std::endl;
+      return false;
+    }
+    if (option == "--temp") {
+      options.temp_directory = argv[argi + 1];
+    } else {
+      char* end;
+      long value = std::strtol(argv[argi + 1], &end, 10);
+      if (*end != '\0' || value <= 0) {
+        std::cerr << "Invalid memory size '" << argv[argi + 1] << "'." << std::endl;
+        return false;
+      }
+      options.memory = (size_t)value << 20;
+    }
+    argi += 2;
+  }
+  return true;
+}
+
+/// <summary>
+/// Uniquely named temporary file, which is removed when the object is destroyed.
+/// </summary>
+class TemporaryFile {
+private:
+  std::string path;
+
+public:
+  TemporaryFile() {}
+
+  TemporaryFile(const TemporaryFile&) = delete;
+  TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+  ~TemporaryFile() {
+    if (!path.empty()) {
+      std::remove(path.c_str());
+    }
+  }
+
+  /// <summary>
+  /// Creates an empty file with a unique name.
+  /// </summary>
+  /// <param name="directory">Directory of the file; TMPDIR (or '/tmp') if empty.</param>
+  /// <returns>FALSE if the file could not be created.</returns>
+  bool create(const std::string& directory) {
+    std::string pattern = directory;
+    if (pattern.empty()) {
+      const char* tmpdir = std::getenv("TMPDIR");
+      pattern = tmpdir != nullptr && *tmpdir != '\0' ? tmpdir : "/tmp";
+    }
+    pattern += "/alignments.XXXXXX";
+    int descriptor = mkstemp(&pattern[0]);
+    if (descriptor < 0) {
+      std::cerr << "Unable to create a temporary file '" << pattern << "'." << std::endl;
+      return false;
+    }
+    ::close(descriptor);
+    path = pattern;
+    return true;
+  }
+
+  inline const std::string& name() const { return path; }
+};
+
+/// <summary>
+/// Alignments stored in a temporary file; each record is the stored SAM line or BAM record preceded by its size.
+/// </summary>
+class AlignmentSpool {
+private:
+  TemporaryFile file;
+  OutputFile output;
+  InputFile input;
+  bool binary;
+  bool error;
+  /// <summary>
+  /// Buffer of a read SAM line; it gets the memory of the previous line of the alignment it is assigned to.
+  /// </summary>
+  std::string line;
+
+  /// <summary>
+  /// Reports an error of the temporary file.
+  /// </summary>
+  bool failure() {
+    std::cerr << "Unable to use temporary file '" << file.name() << "'." << std::endl;
+    error = true;
+    return false;
+  }
+
+public:
+  AlignmentSpool() : binary(false), error(false) {}
+
+  /// <summary>
+  /// Creates the temporary file for writing.
+  /// </summary>
+  /// <param name="directory">Directory of the file; TMPDIR (or '/tmp') if empty.</param>
+  /// <param name="binary">Whether the alignments are BAM records.</param>
+  /// <returns>FALSE if the file could not be created.</returns>
+  bool create(const std::string& directory, const bool binary) {
+    this->binary = binary;
+    error = !file.create(directory) || !output.open(file.name());
+    return !error;
+  }
+
+  /// <summary>
+  /// Appends an alignment.
+  /// </summary>
+  inline void write(const Alignment& alignment) {
+    uint32_t size = (uint32_t)alignment.raw().size();
+    output.write((const char*)&size, sizeof(size));
+    output.write(alignment.raw());
+  }
+
+  /// <summary>
+  /// Finishes writing and opens the file for reading from its beginning.
+  /// </summary>
+  /// <returns>FALSE if writing failed or the file could not be opened.</returns>
+  bool rewind() {
+    if (!output.close() || !input.open(file.name())) {
+      return failure();
+    }
+    return true;
+  }
+
+  /// <summary>
+  /// Reads next alignment, after rewind() was called.
+  /// </summary>
+  /// <param name="alignment">The alignment (output).</param>
+  /// <returns>FALSE at the end of the file or if an error occured (see failed()).</returns>
+  bool next(Alignment& alignment) {
+    uint32_t size;
+    size_t read = input.read((char*)&size, sizeof(size));
+    if (read != sizeof(size)) {
+      return read != 0 || input.failed() ? failure() : false;
+    }
+    if (binary) {
+      return input.read(alignment.assign_binary(size), size) == size || failure();
+    }
+    line.resize(size);
+    return (input.read(&line[0], size) == size && alignment.assign_text(line)) || failure();
+  }
+
+  /// <summary>
+  /// Whether the temporary file could not be written or read.
+  /// </summary>
+  inline bool failed() const { return error; }
+};
+
+/// <summary>
+/// Groups alignments by QNAME in bounded memory: alignments are sorted by QNAME in runs, which are spilled into temporary files
+/// once they exceed the memory limit, and the runs are merged. Alignments of the same QNAME keep their input order.
+/// </summary>
+class QnameGrouper {
+private:
+  /// <summary>
+  /// Maximal number of runs merged at once; more runs are merged in several passes.
+  /// </summary>
+  static const size_t MERGED_RUNS = 64;
+
+  const GroupingOptions& options;
+  bool binary;
+  bool error;
+  /// <summary>
+  /// Alignments of the current run in the input order, their approximate memory size and their order by QNAME.
+  /// </summary>
+  std::vector<Alignment> run;
+  size_t run_memory;
+  std::vector<uint32_t> order;
+  /// <summary>
+  /// Runs spilled to disk in the input order.
+  /// </summary>
+  std::vector<std::unique_ptr<AlignmentSpool>> spools;
+  /// <summary>
+  /// Current alignment of each merged run, and the heap of runs with the smallest current QNAME (the first run on ties) on the top.
+  /// </summary>
+  std::vector<Alignment> heads;
+  std::vector<uint32_t> heap;
+  /// <summary>
+  /// Next alignment of the run kept in memory, if nothing was spilled.
+  /// </summary>
+  size_t position;
+
+  /// <summary>
+  /// Orders the current run by QNAME.
+  /// </summary>
+  void sort_run() {
+    order.resize(run.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [this](const uint32_t a, const uint32_t b) { return run[a].qname() < run[b].qname(); });
+  }
+
+  /// <summary>
+  /// Sorts the current run and writes it into a new temporary file.
+  /// </summary>
+  bool spill() {
+    sort_run();
+    spools.emplace_back(new AlignmentSpool());
+    AlignmentSpool& spool = *spools.back();
+    if (!spool.create(options.temp_directory, binary)) {
+      return false;
+    }
+    for (uint32_t i : order) {
+      spool.write(run[i]);
+    }
+    run.clear();
+    run_memory = 0;
+    return spool.rewind();
+  }
+
+  /// <summary>
+  /// Whether the merged run a should be taken after the merged run b.
+  /// </summary>
+  inline bool later(const uint32_t a, const uint32_t b) const {
+    int comparison = heads[a].qname().compare(heads[b].qname());
+    return comparison > 0 || (comparison == 0 && a > b);
+  }
+
+  /// <summary>
+  /// Starts merging the given runs.
+  /// </summary>
+  bool start_merge(const size_t count) {
+    heads.resize(count);
+    heap.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+      if (spools[i]->next(heads[i])) {
+        heap.push_back(i);
+      } else if (spools[i]->failed()) {
+        return false;
+      }
+    }
+    std::make_heap(heap.begin(), heap.end(), [this](const uint32_t a, const uint32_t b) { return later(a, b); });
+    return true;
+  }
+
+  /// <summary>
+  /// Takes next alignment of the merged runs.
+  /// </summary>
+  bool next_merged(Alignment& alignment) {
+    if (heap.empty()) {
+      return false;
+    }
+    auto compare = [this](const uint32_t a, const uint32_t b) { return later(a, b); };
+    std::pop_heap(heap.begin(), heap.end(), compare);
+    uint32_t top = heap.back();
+    std::swap(alignment, heads[top]);
+    if (spools[top]->next(heads[top])) {
+      std::push_heap(heap.begin(), heap.end(), compare);
+    } else {
+      heap.pop_back();
+      if (spools[top]->failed()) {
+        error = true;
+      }
+    }
+    return true;
+  }
+
+  /// <summary>
+  /// Merges consecutive runs into larger ones until they can be merged at once.
+  /// </summary>
+  bool reduce_runs() {
+    while (spools.size() > MERGED_RUNS) {
+      std::vector<std::unique_ptr<AlignmentSpool>> merged;
+      for (size_t from = 0; from < spools.size(); from += MERGED_RUNS) {
+        std::vector<std::unique_ptr<AlignmentSpool>> part;
+        for (size_t i = from; i < std::min(from + MERGED_RUNS, spools.size()); ++i) {
+          part.push_back(std::move(spools[i]));
+        }
+        part.swap(spools);
+        std::unique_ptr<AlignmentSpool> spool(new AlignmentSpool());
+        if (!spool->create(options.temp_directory, binary) || !start_merge(spools.size())) {
+          return false;
+        }
+        for (Alignment alignment; next_merged(alignment); ) {
+          spool->write(alignment);
+        }
+        if (error || !spool->rewind()) {
+          return false;
+        }
+        merged.push_back(std::move(spool));
+        part.swap(spools);
+      }
+      spools.swap(merged);
+    }
+    return true;
+  }
+
+public:
+  /// <param name="options">Memory limit and the directory of temporary files.</param>
+  /// <param name="binary">Whether the alignments are BAM records.</param>
+  QnameGrouper(const GroupingOptions& options, const bool binary) : options(options), binary(binary), error(false), run_memory(0), position(0) {}
+
+  /// <summary>
+  /// Adds an alignment in the input order, before finish() is called.
+  /// </summary>
+  /// <returns>FALSE if the run could not be spilled.</returns>
+  bool add(Alignment& alignment) {
+    run_memory += alignment.raw().size() + sizeof(Alignment) + sizeof(uint32_t);
+    run.push_back(std::move(alignment));
+    if (run_memory >= options.memory && !spill()) {
+      error = true;
+    }
+    return !error;
+  }
+
+  /// <summary>
+  /// Finishes adding alignments and prepares their merge.
+  /// </summary>
+  /// <returns>FALSE if the runs could not be written or read.</returns>
+  bool finish() {
+    if (spools.empty()) { // Everything fits into the memory
+      sort_run();
+      position = 0;
+      return true;
+    }
+    if ((!run.empty() && !spill()) || !reduce_runs() || !start_merge(spools.size())) {
+      error = true;
+    }
+    return !error;
+  }
+
+  /// <summary>
+  /// Takes next alignment grouped by QNAME, after finish() was called.
+  /// </summary>
+  /// <param name="alignment">The alignment (output).</param>
+  /// <returns>FALSE if there is no more alignment or an error occured (see failed()).</returns>
+  bool next(Alignment& alignment) {
+    if (spools.empty()) {
+      if (position == order.size()) {
+        return false;
+      }
+      std::swap(alignment, run[order[position++]]);
+      return true;
+    }
+    return !error && next_merged(alignment);
+  }
+
+  /// <summary>
+  /// Whether the temporary files could not be written or read.
+  /// </summary>
+  inline bool failed() const { return error; }
+
+  /// <summary>
+  /// Number of runs spilled to disk (after merging passes).
+  /// </summary>
+  inline size_t runs() const { return spools.size(); }
+};
+
+/// <summary>
+/// Marks the header as grouped by QNAME ('@HD' gets 'SO:unsorted' and 'GO:query'); other header lines are not changed.
+/// </summary>
+/// <param name="header">The header.</param>
+inline void mark_grouped(AlignmentHeader& header) {
+  if (header.text.rfind("@HD\t", 0) != 0) {
+    return;
+  }
+  size_t end = header.text.find('\n');
+  std::string line = header.text.substr(0, end);
+  std::string updated;
+  for (size_t from = 0; from <= line.size(); ) {
+    size_t to = line.find('\t', from);
+    to = to == line.npos ? line.size() : to;
+    std::string_view field(line.data() + from, to - from);
+    if (field.rfind("SO:", 0) != 0 && field.rfind("GO:", 0) != 0) {
+      updated.append(updated.empty() ? "" : "\t").append(field);
+    }
+    from = to + 1;
+  }
+  updated += "\tSO:unsorted\tGO:query";
+  header.text.replace(0, end == header.text.npos ? header.text.size() : end, updated);
+}
+
+#endif
@@ -0,0 +1,1226 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef ALIGNMENT_IO_H
+#define ALIGNMENT_IO_H
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+#include "compressed_io.h"
+#include "sam_fields.h"
+#include "id_dictionary.h"
+#include "mapped_file.h"
+
+/// <summary>
+/// Header of an alignment file in SAM or BAM format.
+/// </summary>
+struct AlignmentHeader {
+  /// <summary>
+  /// SAM header lines, each one terminated by '\n'.
+  /// </summary>
+  std::string text;
+  /// <summary>
+  /// Reference sequence names (in the order of reference ids).
+  /// </summary>
+  std::vector<std::string> names;
+  /// <summary>
+  /// Reference sequence lengths (in the order of reference ids).
+  /// </summary>
+  std::vector<uint32_t> lengths;
+  /// <summary>
+  /// Interned reference sequence names.
+  /// </summary>
+  IdDictionary ids;
+  /// <summary>
+  /// Reference ids of the interned names (the first reference if a name is repeated).
+  /// </summary>
+  std::vector<int32_t> references;
+
+  /// <summary>
+  /// Removes all lines and references.
+  /// </summary>
+  void clear() {
+    text.clear();
+    names.clear();
+    lengths.clear();
+    ids.clear();
+    references.clear();
+  }
+
+  /// <summary>
+  /// Adds a reference sequence.
+  /// </summary>
+  /// <param name="name">Name of the reference.</param>
+  /// <param name="length">Length of the reference.</param>
+  void add_reference(const std::string& name, const uint32_t length) {
+    if (ids.insert(name) == references.size()) {
+      references.push_back((int32_t)names.size());
+    }
+    names.push_back(name);
+    lengths.push_back(length);
+  }
+
+  /// <summary>
+  /// Adds a SAM header line and registers a reference sequence if it is a '@SQ' line.
+  /// </summary>
+  /// <param name="line">Header line without the trailing '\n'.</param>
+  void add_line(const std::string& line) {
+    text += line;
+    text += '\n';
+    if (line.rfind("@SQ\t", 0) == 0) {
+      std::string_view name = tag_value(line, "SN:");
+      if (name.data() == nullptr) {
+        std::cerr << "Unexpected line format: missing SN field within '@SQ' line: '" << line << "'." << std::endl;
+        return;
+      }
+      std::string_view length = tag_value(line, "LN:");
+      add_reference(std::string(name), length.data() == nullptr ? 0 : (uint32_t)std::strtoul(std::string(length).c_str(), nullptr, 10));
+    }
+  }
+
+  /// <summary>
+  /// Returns the value of a tab-separated 'XX:value' field within a header line.
+  /// </summary>
+  /// <param name="line">Header line.</param>
+  /// <param name="tag">Tag including the colon.</param>
+  /// <returns>The value, or view with nullptr data if the tag is missing.</returns>
+  static std::string_view tag_value(const std::string_view line, const std::string& tag) {
+    size_t from = line.find('\t' + tag);
+    if (from == line.npos) {
+      return std::string_view();
+    }
+    from += tag.size() + 1;
+    size_t to = line.find('\t', from);
+    return line.substr(from, to == line.npos ? line.npos : to - from);
+  }
+
+  /// <summary>
+  /// Returns the reference id of the given reference name.
+  /// </summary>
+  /// <param name="name">Reference sequence name.</param>
+  /// <returns>The reference id, or -1 if the reference is unknown.</returns>
+  int32_t reference_id(const std::string_view name) const {
+    uint32_t id = ids.find(name);
+    return id == IdDictionary::NONE ? -1 : references[id];
+  }
+
+  /// <summary>
+  /// Removes '@SQ' lines and references, which should not be preserved.
+  /// </summary>
+  /// <param name="keep">Predicate deciding by the reference name, whether the reference should be preserved.</param>
+  /// <returns>Mapping from old reference ids to new reference ids; -1 for removed references.</returns>
+  template <typename Predicate>
+  std::vector<int32_t> filter_references(Predicate keep) {
+    std::string filtered;
+    for (size_t from = 0; from < text.size(); ) {
+      size_t to = text.find('\n', from);
+      to = to == text.npos ? text.size() : to + 1;
+      std::string_view line(text.data() + from, to - from);
+      bool preserve = true;
+      if (line.rfind("@SQ\t", 0) == 0) {
+        std::string_view name = tag_value(line.substr(0, line.size() - 1), "SN:");
+        if (name.data() == nullptr) {
+          std::cerr << "Unexpected line format: missing SN field within '@SQ' line: '" << line.substr(0, line.size() - 1) << "'." << std::endl;
+          preserve = false;
+        } else {
+          preserve = keep(std::string(name));
+        }
+      }
+      if (preserve) {
+        filtered.append(line);
+      }
+      from = to;
+    }
+    text.swap(filtered);
+    std::vector<int32_t> mapping(names.size(), -1);
+    std::vector<std::string> old_names;
+    std::vector<uint32_t> old_lengths;
+    old_names.swap(names);
+    old_lengths.swap(lengths);
+    ids.clear();
+    references.clear();
+    for (size_t i = 0; i < old_names.size(); ++i) {
+      if (keep(old_names[i])) {
+        mapping[i] = (int32_t)names.size();
+        add_reference(old_names[i], old_lengths[i]);
+      }
+    }
+    return mapping;
+  }
+};
+
+/// <summary>
+/// Single alignment record, stored either as a SAM line or as a binary BAM record.
+/// Accessors work directly on the stored representation, so records are not converted unless the output format differs.
+/// </summary>
+class Alignment {
+private:
+  /// <summary>
+  /// SAM line without the trailing '\n'; or BAM record without the leading block_size.
+  /// </summary>
+  std::string data;
+  bool binary;
+  /// <summary>
+  /// Positions of columns of a SAM line.
+  /// </summary>
+  SamColumns columns;
+
+  // Offsets of fixed-length fields within a BAM record
+  static const size_t BAM_REF_ID = 0;
+  static const size_t BAM_POS = 4;
+  static const size_t BAM_L_READ_NAME = 8;
+  static const size_t BAM_MAPQ = 9;
+  static const size_t BAM_BIN = 10;
+  static const size_t BAM_N_CIGAR_OP = 12;
+  static const size_t BAM_FLAG = 14;
+  static const size_t BAM_L_SEQ = 16;
+  static const size_t BAM_NEXT_REF_ID = 20;
+  static const size_t BAM_NEXT_POS = 24;
+  static const size_t BAM_TLEN = 28;
+  static const size_t BAM_READ_NAME = 32;
+
+  template <typename T>
+  inline T get(const size_t offset) const {
+    T value;
+    std::memcpy(&value, data.data() + offset, sizeof(T));
+    return value;
+  }
+
+  template <typename T>
+  inline void set(const size_t offset, const T value) {
+    std::memcpy(&data[offset], &value, sizeof(T));
+  }
+
+  static inline void append_int(std::string& out, const int64_t value) {
+    out += std::to_string(value);
+  }
+
+  /// <summary>
+  /// Offset of CIGAR operations within a BAM record.
+  /// </summary>
+  inline size_t bam_cigar() const { return BAM_READ_NAME + get<uint8_t>(BAM_L_READ_NAME); }
+
+  /// <summary>
+  /// Offset of the optional fields within a BAM record.
+  /// </summary>
+  inline size_t bam_aux() const {
+    int32_t l_seq = get<int32_t>(BAM_L_SEQ);
+    return bam_cigar() + 4 * (size_t)get<uint16_t>(BAM_N_CIGAR_OP) + (l_seq + 1) / 2 + l_seq;
+  }
+
+  /// <summary>
+  /// Size of a value of a BAM optional field.
+  /// </summary>
+  /// <param name="type">Type of the value.</param>
+  /// <param name="offset">Offset of the value.</param>
+  /// <returns>Size in bytes, or 0 if the type is unknown or the value exceeds the record.</returns>
+  size_t bam_value_size(const char type, const size_t offset) const {
+    switch (type) {
+      case 'A': case 'c': case 'C':
+        return 1;
+      case 's': case 'S':
+        return 2;
+      case 'i': case 'I': case 'f':
+        return 4;
+      case 'Z': case 'H': {
+        const void* end = std::memchr(data.data() + offset, '\0', data.size() - offset);
+        return end == nullptr ? 0 : (const char*)end - (data.data() + offset) + 1;
+      }
+      case 'B': {
+        if (offset + 5 > data.size()) {
+          return 0;
+        }
+        size_t element = bam_value_size(data[offset], offset);
+        if (element == 0 || data[offset] == 'Z' || data[offset] == 'H' || data[offset] == 'B') {
+          return 0;
+        }
+        return 5 + element * get<uint32_t>(offset + 1);
+      }
+      default:
+        return 0;
+    }
+  }
+
+  /// <summary>
+  /// Finds an optional field within a BAM record.
+  /// </summary>
+  /// <param name="tag">Two-character tag.</param>
+  /// <returns>Offset of the tag, or npos if it is missing.</returns>
+  size_t bam_find_tag(const char* tag) const {
+    for (size_t offset = bam_aux(); offset + 3 <= data.size(); ) {
+      size_t size = bam_value_size(data[offset + 2], offset + 3);
+      if (size == 0 || offset + 3 + size > data.size()) {
+        return std::string::npos;
+      }
+      if (data[offset] == tag[0] && data[offset + 1] == tag[1]) {
+        return offset;
+      }
+      offset += 3 + size;
+    }
+    return std::string::npos;
+  }
+
+  /// <summary>
+  /// Replaces a content of a mandatory column within a SAM line.
+  /// </summary>
+  void sam_replace(const size_t index, const std::string_view value) {
+    size_t from = columns.starts[index];
+    size_t length = columns.starts[index + 1] - from - 1;
+    data.replace(from, length, value.data(), value.size());
+    columns.shift(index, (int64_t)value.size() - (int64_t)length);
+  }
+
+public:
+  Alignment() : binary(false) {}
+
+  /// <summary>
+  /// Provides an access to the stored SAM line or BAM record.
+  /// </summary>
+  inline const std::string& raw() const { return data; }
+
+  /// <summary>
+  /// Capacity of the buffer of the stored line or record (to count allocations of reused records).
+  /// </summary>
+  inline size_t capacity() const { return data.capacity(); }
+
+  /// <summary>
+  /// Whether the record is stored as a binary BAM record.
+  /// </summary>
+  inline bool is_binary() const { return binary; }
+
+  /// <summary>
+  /// Sets a SAM line as the content of the record, the line is checked to have all mandatory columns.
+  /// The line is copied if it fits into the buffer of the record (so reused records, e.g. of an AlignmentArena, keep their buffers), otherwise the buffers are swapped.
+  /// </summary>
+  /// <param name="line">SAM line without the trailing '\n'; its content is unspecified afterwards.</param>
+  /// <returns>FALSE if the line has not enough columns.</returns>
+  bool assign_text(std::string& line) {
+    if (data.capacity() >= line.size()) {
+      data.assign(line);
+    } else {
+      data.swap(line);
+    }
+    binary = false;
+    return columns.split(data);
+  }
+
+  /// <summary>
+  /// Provides a buffer to read a BAM record into and marks the record as binary.
+  /// The record is checked by validate_binary after it is filled.
+  /// </summary>
+  /// <param name="size">Size of the BAM record without block_size.</param>
+  /// <returns>Buffer of the given size.</returns>
+  char* assign_binary(const size_t size) {
+    data.resize(size);
+    binary = true;
+    return &data[0];
+  }
+
+  /// <summary>
+  /// Checks that lengths of the variable-length fields of a BAM record are consistent with its size.
+  /// </summary>
+  /// <returns>TRUE if the record is consistent.</returns>
+  bool validate_binary() const {
+    if (data.size() < BAM_READ_NAME) {
+      return false;
+    }
+    int32_t l_seq = get<int32_t>(BAM_L_SEQ);
+    return l_seq >= 0 && bam_aux() <= data.size() && get<uint8_t>(BAM_L_READ_NAME) > 0;
+  }
+
+  /// <summary>
+  /// Returns QNAME.
+  /// </summary>
+  inline std::string_view qname() const {
+    if (binary) {
+      return std::string_view(data.data() + BAM_READ_NAME, get<uint8_t>(BAM_L_READ_NAME) - 1);
+    }
+    return columns.get(data, 0);
+  }
+
+  /// <summary>
+  /// Returns FLAG.
+  /// </summary>
+  inline uint16_t flag() const {
+    if (binary) {
+      return get<uint16_t>(BAM_FLAG);
+    }
+    uint16_t flag = 0;
+    parse_integer(columns.get(data, 1), flag);
+    return flag;
+  }
+
+  /// <summary>
+  /// Sets FLAG.
+  /// </summary>
+  inline void set_flag(const uint16_t flag) {
+    if (binary) {
+      set<uint16_t>(BAM_FLAG, flag);
+    } else {
+      char text[8];
+      sam_replace(1, std::string_view(text, std::to_chars(text, text + sizeof(text), flag).ptr - text));
+    }
+  }
+
+  /// <summary>
+  /// Sets MAPQ.
+  /// </summary>
+  inline void set_mapq(const uint8_t mapq) {
+    if (binary) {
+      set<uint8_t>(BAM_MAPQ, mapq);
+    } else {
+      char text[4];
+      sam_replace(4, std::string_view(text, std::to_chars(text, text + sizeof(text), mapq).ptr - text));
+    }
+  }
+
+  /// <summary>
+  /// Returns RNAME.
+  /// </summary>
+  /// <param name="header">Header of the file the record belongs to.</param>
+  inline std::string_view reference(const AlignmentHeader& header) const {
+    if (binary) {
+      int32_t id = get<int32_t>(BAM_REF_ID);
+      return id < 0 || (size_t)id >= header.names.size() ? std::string_view("*") : std::string_view(header.names[id]);
+    }
+    return columns.get(data, 2);
+  }
+
+  /// <summary>
+  /// Returns the reference id of a BAM record (-1 if unmapped); SAM records refer references by names only.
+  /// </summary>
+  inline int32_t reference_id() const {
+    return binary ? get<int32_t>(BAM_REF_ID) : -1;
+  }
+
+  /// <summary>
+  /// Returns RNEXT; '=' is kept as it is in SAM records, BAM records return the name of the reference.
+  /// </summary>
+  /// <param name="header">Header of the file the record belongs to.</param>
+  inline std::string_view next_reference(const AlignmentHeader& header) const {
+    if (binary) {
+      int32_t id = get<int32_t>(BAM_NEXT_REF_ID);
+      return id < 0 || (size_t)id >= header.names.size() ? std::string_view("*") : std::string_view(header.names[id]);
+    }
+    return columns.get(data, 6);
+  }
+
+  /// <summary>
+  /// Returns the reference id of RNEXT of a BAM record (-1 if unavailable); SAM records refer references by names only.
+  /// </summary>
+  inline int32_t next_reference_id() const {
+    return binary ? get<int32_t>(BAM_NEXT_REF_ID) : -1;
+  }
+
+  /// <summary>
+  /// Returns 1-based POS (0 if unavailable).
+  /// </summary>
+  /// <param name="pos">The position (output).</param>
+  /// <returns>FALSE if POS of a SAM record is not a valid number.</returns>
+  inline bool position(uint64_t& pos) const {
+    if (binary) {
+      pos = (uint64_t)((int64_t)get<int32_t>(BAM_POS) + 1);
+      return true;
+    }
+    return parse_integer(columns.get(data, 3), pos);
+  }
+
+  /// <summary>
+  /// Returns CIGAR, in the textual form for SAM records and in the binary form for BAM records, so only records of the same file should be compared.
+  /// </summary>
+  inline std::string_view cigar() const {
+    if (binary) {
+      return std::string_view(data.data() + bam_cigar(), 4 * (size_t)get<uint16_t>(BAM_N_CIGAR_OP));
+    }
+    return columns.get(data, 5);
+  }
+
+  /// <summary>
+  /// Computes lengths of the read and of the aligned part of the reference from CIGAR.
+  /// </summary>
+  /// <param name="query">Length of the read including soft clips (output).</param>
+  /// <param name="reference">Length of the aligned part of the reference (output).</param>
+  /// <returns>FALSE if CIGAR is unavailable or invalid.</returns>
+  bool cigar_lengths(uint32_t& query, uint32_t& reference) const {
+    if (!binary) {
+      return parse_cigar_lengths(cigar(), query, reference);
+    }
+    query = reference = 0;
+    uint16_t n_cigar_op = get<uint16_t>(BAM_N_CIGAR_OP);
+    for (size_t i = 0, offset = bam_cigar(); i < n_cigar_op; ++i, offset += 4) {
+      uint32_t op = get<uint32_t>(offset);
+      query += cigar_consumes_query(op & 15) ? op >> 4 : 0;
+      reference += cigar_consumes_reference(op & 15) ? op >> 4 : 0;
+    }
+    return n_cigar_op > 0;
+  }
+
+  /// <summary>
+  /// Returns a value of an optional field of an integer type (e.g. NH:i:Nmap).
+  /// </summary>
+  /// <param name="tag">Two-character tag.</param>
+  /// <param name="value">The value (output).</param>
+  /// <returns>FALSE if the field is missing or it is not an integer.</returns>
+  bool get_tag(const char* tag, int64_t& value) const {
+    if (binary) {
+      size_t offset = bam_find_tag(tag);
+      if (offset == std::string::npos) {
+        return false;
+      }
+      offset += 3;
+      switch (data[offset - 1]) {
+        case 'c': value = get<int8_t>(offset); return true;
+        case 'C': value = get<uint8_t>(offset); return true;
+        case 's': value = get<int16_t>(offset); return true;
+        case 'S': value = get<uint16_t>(offset); return true;
+        case 'i': value = get<int32_t>(offset); return true;
+        case 'I': value = get<uint32_t>(offset); return true;
+        default: return false;
+      }
+    }
+    const char typed[] = { tag[0], tag[1], ':', 'i' };
+    size_t from, to;
+    return columns.find_tag(data, typed, from, to) && parse_integer(std::string_view(data.data() + from, to - from), value);
+  }
+
+  /// <summary>
+  /// Updates a value of an existing optional field of an integer type; missing fields are not added.
+  /// </summary>
+  /// <param name="tag">Two-character tag.</param>
+  /// <param name="value">The new value.</param>
+  void set_tag(const char* tag, const int64_t value) {
+    if (binary) {
+      size_t offset = bam_find_tag(tag);
+      if (offset == std::string::npos) {
+        return;
+      }
+      size_t old_size = bam_value_size(data[offset + 2], offset + 3);
+      std::string encoded;
+      char type = encode_integer(value, encoded);
+      data[offset + 2] = type;
+      if (encoded.size() == old_size) { // The record keeps its size, so the rest is not moved
+        std::memcpy(&data[offset + 3], encoded.data(), old_size);
+      } else {
+        data.replace(offset + 3, old_size, encoded);
+      }
+      return;
+    }
+    const char typed[] = { tag[0], tag[1], ':', 'i' };
+    size_t from, to;
+    if (columns.find_tag(data, typed, from, to)) {
+      char text[24];
+      data.replace(from, to - from, text, std::to_chars(text, text + sizeof(text), value).ptr - text);
+    }
+  }
+
+  /// <summary>
+  /// Sets FLAG, MAPQ and values of existing NH:i and HI:i fields at once (missing fields are not added).
+  /// A SAM line is patched in place if the values keep their lengths, otherwise it is rebuilt in a single pass.
+  /// </summary>
+  /// <param name="flag">The new FLAG.</param>
+  /// <param name="mapq">The new MAPQ.</param>
+  /// <param name="nh">The new NH:i:Nmap.</param>
+  /// <param name="hi">The new HI:i:I.</param>
+  void set_fields(const uint16_t flag, const uint8_t mapq, const int64_t nh, const int64_t hi) {
+    if (binary) {
+      set<uint16_t>(BAM_FLAG, flag);
+      set<uint8_t>(BAM_MAPQ, mapq);
+      set_tag("NH", nh);
+      set_tag("HI", hi);
+      return;
+    }
+    // Replaced range [from; to) of the line and its new text
+    struct Edit {
+      size_t from, to, size;
+      char text[24];
+    };
+    Edit edits[4];
+    size_t count = 0;
+    auto add = [&](const size_t from, const size_t to, const int64_t value) {
+      Edit& edit = edits[count++];
+      edit.from = from;
+      edit.to = to;
+      edit.size = std::to_chars(edit.text, edit.text + sizeof(edit.text), value).ptr - edit.text;
+    };
+    // FLAG is rewritten only if changed, so that it keeps its original form otherwise
+    if (flag != this->flag()) {
+      add(columns.starts[1], columns.starts[2] - 1, flag);
+    }
+    add(columns.starts[4], columns.starts[5] - 1, mapq);
+    // Differences of lengths of the mandatory columns
+    int64_t flag_difference = count == 2 ? (int64_t)edits[0].size - (int64_t)(edits[0].to - edits[0].from) : 0;
+    int64_t mapq_difference = (int64_t)edits[count - 1].size - (int64_t)(edits[count - 1].to - edits[count - 1].from);
+    size_t from, to;
+    if (columns.find_tag(data, "NH:i", from, to)) {
+      add(from, to, nh);
+    }
+    if (columns.find_tag(data, "HI:i", from, to)) {
+      add(from, to, hi);
+    }
+    if (count == 4 && edits[3].from < edits[2].from) {
+      std::swap(edits[2], edits[3]);
+    }
+    bool same = true;
+    for (size_t i = 0; i < count; ++i) {
+      same = same && edits[i].size == edits[i].to - edits[i].from;
+    }
+    if (same) {
+      for (size_t i = 0; i < count; ++i) {
+        std::memcpy(&data[edits[i].from], edits[i].text, edits[i].size);
+      }
+      return;
+    }
+    std::string patched;
+    patched.reserve(data.size() + 4 * sizeof(Edit::text));
+    size_t copied = 0;
+    for (size_t i = 0; i < count; ++i) {
+      patched.append(data, copied, edits[i].from - copied);
+      patched.append(edits[i].text, edits[i].size);
+      copied = edits[i].to;
+    }
+    patched.append(data, copied, std::string::npos);
+    data.swap(patched);
+    columns.shift(1, flag_difference);
+    columns.shift(4, mapq_difference);
+  }
+
+  /// <summary>
+  /// Updates reference ids after removal of references from the header; does nothing for SAM records as they refer references by names.
+  /// </summary>
+  /// <param name="mapping">Mapping from old reference ids to new reference ids, as returned by AlignmentHeader::filter_references.</param>
+  void remap_references(const std::vector<int32_t>& mapping) {
+    if (!binary) {
+      return;
+    }
+    for (size_t offset : { BAM_REF_ID, BAM_NEXT_REF_ID }) {
+      int32_t id = get<int32_t>(offset);
+      if (id >= 0) {
+        set<int32_t>(offset, (size_t)id < mapping.size() ? mapping[id] : -1);
+      }
+    }
+  }
+
+  /// <summary>
+  /// Encodes an integer into the smallest BAM integer type.
+  /// </summary>
+  /// <param name="value">The encoded value.</param>
+  /// <param name="out">Where to append the encoded value.</param>
+  /// <returns>The BAM type of the value.</returns>
+  static char encode_integer(const int64_t value, std::string& out) {
+    if (value >= 0) {
+      if (value <= UINT8_MAX) { append_binary<uint8_t>(out, (uint8_t)value); return 'C'; }
+      if (value <= UINT16_MAX) { append_binary<uint16_t>(out, (uint16_t)value); return 'S'; }
+      append_binary<uint32_t>(out, (uint32_t)value);
+      return 'I';
+    }
+    if (value >= INT8_MIN) { append_binary<int8_t>(out, (int8_t)value); return 'c'; }
+    if (value >= INT16_MIN) { append_binary<int16_t>(out, (int16_t)value); return 's'; }
+    append_binary<int32_t>(out, (int32_t)value);
+    return 'i';
+  }
+
+  /// <summary>
+  /// Computes BAM bin for a 0-based region [from; to), as defined in the SAM specification.
+  /// </summary>
+  static uint16_t reg2bin(const int64_t from, int64_t to) {
+    --to;
+    if (from >> 14 == to >> 14) return (uint16_t)(((1 << 15) - 1) / 7 + (from >> 14));
+    if (from >> 17 == to >> 17) return (uint16_t)(((1 << 12) - 1) / 7 + (from >> 17));
+    if (from >> 20 == to >> 20) return (uint16_t)(((1 << 9) - 1) / 7 + (from >> 20));
+    if (from >> 23 == to >> 23) return (uint16_t)(((1 << 6) - 1) / 7 + (from >> 23));
+    if (from >> 26 == to >> 26) return (uint16_t)(((1 << 3) - 1) / 7 + (from >> 26));
+    return 0;
+  }
+
+  /// <summary>
+  /// Converts a SAM record into a binary BAM record.
+  /// </summary>
+  /// <param name="header">Header providing reference ids.</param>
+  /// <param name="out">The BAM record without block_size (output).</param>
+  /// <returns>FALSE if the record could not be converted.</returns>
+  bool encode_binary(const AlignmentHeader& header, std::string& out) const {
+    std::string_view columns[SamColumns::MANDATORY];
+    for (size_t i = 0; i < SamColumns::MANDATORY; ++i) {
+      columns[i] = this->columns.get(data, i);
+    }
+    auto number = [](const std::string_view text) { int64_t value = 0; parse_integer(text, value); return value; };
+    int32_t ref_id = columns[2] == "*" ? -1 : header.reference_id(columns[2]);
+    if (ref_id == -1 && columns[2] != "*") {
+      std::cerr << "Unknown reference sequence '" << columns[2] << "' missing in the header: '" << data << "'" << std::endl;
+      return false;
+    }
+    int32_t next_ref_id = columns[6] == "*" ? -1 : columns[6] == "=" ? ref_id : header.reference_id(columns[6]);
+    int32_t pos = (int32_t)number(columns[3]) - 1;
+    // CIGAR operations and length of the alignment within the reference
+    std::string cigar;
+    uint32_t n_cigar_op = 0;
+    int64_t reference_length = 0;
+    if (columns[5] != "*") {
+      static const char OPERATIONS[] = "MIDNSHP=X";
+      for (size_t i = 0; i < columns[5].size(); ) {
+        size_t j = i;
+        while (j < columns[5].size() && columns[5][j] >= '0' && columns[5][j] <= '9') {
+          ++j;
+        }
+        const char* op = j < columns[5].size() ? std::strchr(OPERATIONS, columns[5][j]) : nullptr;
+        if (j == i || op == nullptr || *op == '\0') {
+          std::cerr << "Unexpected CIGAR format: '" << data << "'" << std::endl;
+          return false;
+        }
+        uint32_t length = (uint32_t)number(columns[5].substr(i, j - i));
+        append_binary<uint32_t>(cigar, length << 4 | (uint32_t)(op - OPERATIONS));
+        if (*op == 'M' || *op == 'D' || *op == 'N' || *op == '=' || *op == 'X') {
+          reference_length += length;
+        }
+        ++n_cigar_op;
+        i = j + 1;
+      }
+    }
+    if (n_cigar_op > UINT16_MAX) {
+      std::cerr << "Not implemented yet: too many CIGAR operations '" << data << "'" << std::endl;
+      return false;
+    }
+    std::string_view seq = columns[9] == "*" ? std::string_view() : columns[9];
+    if (columns[10] != "*" && columns[10].size() != seq.size()) {
+      std::cerr << "Unexpected file format: different length of SEQ and QUAL '" << data << "'" << std::endl;
+      return false;
+    }
+
+    out.clear();
+    append_binary<int32_t>(out, ref_id);
+    append_binary<int32_t>(out, pos);
+    append_binary<uint8_t>(out, (uint8_t)(columns[0].size() + 1));
+    append_binary<uint8_t>(out, (uint8_t)number(columns[4]));
+    append_binary<uint16_t>(out, reg2bin(pos, pos + (reference_length == 0 ? 1 : reference_length)));
+    append_binary<uint16_t>(out, (uint16_t)n_cigar_op);
+    append_binary<uint16_t>(out, (uint16_t)number(columns[1]));
+    append_binary<int32_t>(out, (int32_t)seq.size());
+    append_binary<int32_t>(out, next_ref_id);
+    append_binary<int32_t>(out, (int32_t)number(columns[7]) - 1);
+    append_binary<int32_t>(out, (int32_t)number(columns[8]));
+    out.append(columns[0]);
+    out += '\0';
+    out += cigar;
+    static const char BASES[] = "=ACMGRSVTWYHKDBN";
+    for (size_t i = 0; i < seq.size(); i += 2) {
+      const char* high = std::strchr(BASES, std::toupper(seq[i]));
+      const char* low = i + 1 < seq.size() ? std::strchr(BASES, std::toupper(seq[i + 1])) : BASES;
+      out += (char)(((high == nullptr || *high == '\0' ? 15 : high - BASES) << 4) | (low == nullptr || *low == '\0' ? 15 : low - BASES));
+    }
+    if (columns[10] == "*") {
+      out.append(seq.size(), '\xff');
+    } else {
+      for (char q : columns[10]) {
+        out += (char)(q - 33);
+      }
+    }
+    // Optional fields
+    std::string_view optional = this->columns.optional(data);
+    for (size_t from = 0; from < optional.size(); ) {
+      size_t to = optional.find('\t', from);
+      if (to == optional.npos) {
+        to = optional.size();
+      }
+      std::string_view field = optional.substr(from, to - from);
+      from = to + 1;
+      if (field.size() < 5 || field[2] != ':' || field[4] != ':') {
+        std::cerr << "Unexpected format of an optional field '" << field << "': '" << data << "'" << std::endl;
+        return false;
+      }
+      std::string_view value = field.substr(5);
+      out.append(field.substr(0, 2));
+      switch (field[3]) {
+        case 'A':
+          out += 'A';
+          out += value.empty() ? ' ' : value[0];
+          break;
+        case 'i': {
+          size_t type = out.size();
+          out += ' ';
+          out[type] = encode_integer(number(value), out);
+          break;
+        }
+        case 'f':
+          out += 'f';
+          append_binary<float>(out, std::strtof(std::string(value).c_str(), nullptr));
+          break;
+        case 'Z':
+        case 'H':
+          out += field[3];
+          out.append(value);
+          out += '\0';
+          break;
+        case 'B': {
+          if (value.empty()) {
+            std::cerr << "Unexpected format of an optional field '" << field << "': '" << data << "'" << std::endl;
+            return false;
+          }
+          out += 'B';
+          out += value[0];
+          size_t count_offset = out.size();
+          append_binary<uint32_t>(out, 0);
+          uint32_t count = 0;
+          for (size_t from = value.find(','); from != value.npos; ++count) {
+            size_t to = value.find(',', from + 1);
+            std::string element(value.substr(from + 1, to == value.npos ? value.npos : to - from - 1));
+            switch (value[0]) {
+              case 'c': append_binary<int8_t>(out, (int8_t)std::strtol(element.c_str(), nullptr, 10)); break;
+              case 'C': append_binary<uint8_t>(out, (uint8_t)std::strtoul(element.c_str(), nullptr, 10)); break;
+              case 's': append_binary<int16_t>(out, (int16_t)std::strtol(element.c_str(), nullptr, 10)); break;
+              case 'S': append_binary<uint16_t>(out, (uint16_t)std::strtoul(element.c_str(), nullptr, 10)); break;
+              case 'i': append_binary<int32_t>(out, (int32_t)std::strtol(element.c_str(), nullptr, 10)); break;
+              case 'I': append_binary<uint32_t>(out, (uint32_t)std::strtoul(element.c_str(), nullptr, 10)); break;
+              case 'f': append_binary<float>(out, std::strtof(element.c_str(), nullptr)); break;
+              default:
+                std::cerr << "Unexpected array type of an optional field '" << field << "': '" << data << "'" << std::endl;
+                return false;
+            }
+            from = to;
+          }
+          std::memcpy(&out[count_offset], &count, sizeof(count));
+          break;
+        }
+        default:
+          std::cerr << "Unexpected type of an optional field '" << field << "': '" << data << "'" << std::endl;
+          return false;
+      }
+    }
+    return true;
+  }
+
+  /// <summary>
+  /// Converts a BAM record into a SAM line.
+  /// </summary>
+  /// <param name="header">Header providing reference names.</param>
+  /// <param name="out">The SAM line without the trailing '\n' (output).</param>
+  void format_text(const AlignmentHeader& header, std::string& out) const {
+    out.clear();
+    auto reference_name = [&header](const int32_t id) -> std::string_view {
+      return id < 0 || (size_t)id >= header.names.size() ? std::string_view("*") : std::string_view(header.names[id]);
+    };
+    int32_t ref_id = get<int32_t>(BAM_REF_ID);
+    int32_t next_ref_id = get<int32_t>(BAM_NEXT_REF_ID);
+    out.append(qname());
+    out += '\t';
+    append_int(out, get<uint16_t>(BAM_FLAG));
+    out += '\t';
+    out.append(reference_name(ref_id));
+    out += '\t';
+    append_int(out, (int64_t)get<int32_t>(BAM_POS) + 1);
+    out += '\t';
+    append_int(out, get<uint8_t>(BAM_MAPQ));
+    out += '\t';
+    size_t offset = bam_cigar();
+    uint16_t n_cigar_op = get<uint16_t>(BAM_N_CIGAR_OP);
+    if (n_cigar_op == 0) {
+      out += '*';
+    }
+    for (size_t i = 0; i < n_cigar_op; ++i, offset += 4) {
+      uint32_t op = get<uint32_t>(offset);
+      append_int(out, op >> 4);
+      out += "MIDNSHP=X"[(op & 15) < 9 ? op & 15 : 0];
+    }
+    out += '\t';
+    if (next_ref_id < 0) {
+      out += '*';
+    } else if (next_ref_id == ref_id) {
+      out += '=';
+    } else {
+      out.append(reference_name(next_ref_id));
+    }
+    out += '\t';
+    append_int(out, (int64_t)get<int32_t>(BAM_NEXT_POS) + 1);
+    out += '\t';
+    append_int(out, get<int32_t>(BAM_TLEN));
+    out += '\t';
+    int32_t l_seq = get<int32_t>(BAM_L_SEQ);
+    if (l_seq == 0) {
+      out += "*\t*";
+    } else {
+      for (int32_t i = 0; i < l_seq; ++i) {
+        uint8_t bases = get<uint8_t>(offset + i / 2);
+        out += "=ACMGRSVTWYHKDBN"[i % 2 == 0 ? bases >> 4 : bases & 15];
+      }
+      offset += (l_seq + 1) / 2;
+      out += '\t';
+      if ((uint8_t)data[offset] == 0xff) {
+        out += '*';
+      } else {
+        for (int32_t i = 0; i < l_seq; ++i) {
+          out += (char)(data[offset + i] + 33);
+        }
+      }
+    }
+    // Optional fields
+    for (offset = bam_aux(); offset + 3 <= data.size(); ) {
+      char type = data[offset + 2];
+      size_t size = bam_value_size(type, offset + 3);
+      if (size == 0 || offset + 3 + size > data.size()) {
+        break;
+      }
+      out += '\t';
+      out.append(data, offset, 2);
+      offset += 3;
+      switch (type) {
+        case 'A': out += ":A:"; out += data[offset]; break;
+        case 'c': out += ":i:"; append_int(out, get<int8_t>(offset)); break;
+        case 'C': out += ":i:"; append_int(out, get<uint8_t>(offset)); break;
+        case 's': out += ":i:"; append_int(out, get<int16_t>(offset)); break;
+        case 'S': out += ":i:"; append_int(out, get<uint16_t>(offset)); break;
+        case 'i': out += ":i:"; append_int(out, get<int32_t>(offset)); break;
+        case 'I': out += ":i:"; append_int(out, get<uint32_t>(offset)); break;
+        case 'f': {
+          char number[32];
+          std::snprintf(number, sizeof(number), "%.9g", get<float>(offset));
+          out += ":f:";
+          out += number;
+          break;
+        }
+        case 'Z': case 'H':
+          out += ':';
+          out += type;
+          out += ':';
+          out.append(data, offset, size - 1);
+          break;
+        case 'B': {
+          char subtype = data[offset];
+          out += ":B:";
+          out += subtype;
+          size_t element = bam_value_size(subtype, offset);
+          uint32_t count = get<uint32_t>(offset + 1);
+          for (size_t i = 0, position = offset + 5; i < count; ++i, position += element) {
+            out += ',';
+            switch (subtype) {
+              case 'c': append_int(out, get<int8_t>(position)); break;
+              case 'C': append_int(out, get<uint8_t>(position)); break;
+              case 's': append_int(out, get<int16_t>(position)); break;
+              case 'S': append_int(out, get<uint16_t>(position)); break;
+              case 'i': append_int(out, get<int32_t>(position)); break;
+              case 'I': append_int(out, get<uint32_t>(position)); break;
+              case 'f': {
+                char number[32];
+                std::snprintf(number, sizeof(number), "%.9g", get<float>(position));
+                out += number;
+                break;
+              }
+            }
+          }
+          break;
+        }
+      }
+      offset += size;
+    }
+  }
+
+  /// <summary>
+  /// Returns the record as a SAM line, e.g. for error messages.
+  /// </summary>
+  /// <param name="header">Header of the file the record belongs to.</param>
+  std::string text(const AlignmentHeader& header) const {
+    if (!binary) {
+      return data;
+    }
+    std::string line;
+    format_text(header, line);
+    return line;
+  }
+};
+
+/// <summary>
+/// Sequential reader of alignments in SAM format (plain or gzip-compressed) or BAM format; the format is detected from the content.
+/// </summary>
+class AlignmentReader {
+private:
+  InputFile input;
+  std::string path;
+  bool binary;
+  bool error;
+  /// <summary>
+  /// The first alignment line of a SAM file, which was read together with the header.
+  /// </summary>
+  std::string pending;
+  bool has_pending;
+
+  /// <summary>
+  /// Reads a little-endian 32-bit integer.
+  /// </summary>
+  bool read_int(int32_t& value) {
+    return input.read((char*)&value, sizeof(value)) == sizeof(value);
+  }
+
+  /// <summary>
+  /// Reports an unexpected end of the file.
+  /// </summary>
+  bool truncated() {
+    std::cerr << "Unexpected end of file file '" << path << "'" << std::endl;
+    error = true;
+    return false;
+  }
+
+public:
+  AlignmentReader() : binary(false), error(false), has_pending(false) {}
+
+  /// <summary>
+  /// Opens an alignment file.
+  /// </summary>
+  /// <param name="filename">Path to the file; '-' stands for the standard input.</param>
+  /// <param name="threads">Number of threads decompressing BGZF blocks.</param>
+  /// <returns>TRUE if the file was opened and the format is supported.</returns>
+  bool open(const std::string& filename, const size_t threads = 1) {
+    path = filename;
+    error = false;
+    has_pending = false;
+    input.set_threads(threads);
+    if (!input.open(filename)) {
+      error = true;
+      return false;
+    }
+    std::string magic = input.peek(4);
+    binary = input.is_compressed() && magic == std::string("BAM\1", 4);
+    if (!input.is_compressed() && magic == "CRAM") {
+      std::cerr << "CRAM format is not supported, file '" << filename << "' should be converted to BAM format (e.g. by 'samtools view -b')." << std::endl;
+      error = true;
+      return false;
+    }
+    return true;
+  }
+
+  /// <summary>
+  /// Whether the opened file is in BAM format.
+  /// </summary>
+  inline bool is_binary() const { return binary; }
+
+  /// <summary>
+  /// Whether an error occured during reading.
+  /// </summary>
+  inline bool failed() const { return error || input.failed(); }
+
+  /// <summary>
+  /// Reads the header, it must be called before the first alignment is read.
+  /// </summary>
+  /// <param name="header">The header (output).</param>
+  /// <returns>FALSE if an error occured.</returns>
+  bool read_header(AlignmentHeader& header) {
+    header.clear();
+    if (!binary) {
+      while (input.getline(pending)) {
+        if (pending.empty()) {
+          std::cerr << "Unexpected empty line in file '" << path << "'" << std::endl;
+        } else if (pending[0] == '@') {
+          header.add_line(pending);
+        } else {
+          has_pending = true;
+          break;
+        }
+      }
+      return !input.failed();
+    }
+    char magic[4];
+    int32_t l_text, n_ref;
+    if (input.read(magic, 4) != 4 || !read_int(l_text) || l_text < 0) return truncated();
+    header.text.resize(l_text);
+    if (input.read(&header.text[0], l_text) != (size_t)l_text) return truncated();
+    // Text may be padded by NULs
+    header.text.resize(std::strlen(header.text.c_str()));
+    if (!header.text.empty() && header.text.back() != '\n') {
+      header.text += '\n';
+    }
+    if (!read_int(n_ref) || n_ref < 0) return truncated();
+    for (int32_t i = 0; i < n_ref; ++i) {
+      int32_t l_name, l_ref;
+      if (!read_int(l_name) || l_name <= 0) return truncated();
+      std::string name(l_name, '\0');
+      if (input.read(&name[0], l_name) != (size_t)l_name || !read_int(l_ref)) return truncated();
+      name.resize(l_name - 1);
+      header.add_reference(name, (uint32_t)l_ref);
+    }
+    return true;
+  }
+
+  /// <summary>
+  /// Reads next alignment; invalid SAM lines are reported and skipped.
+  /// </summary>
+  /// <param name="alignment">The alignment (output).</param>
+  /// <returns>FALSE at the end of the file or if an error occured (see failed()).</returns>
+  bool next(Alignment& alignment) {
+    if (error) {
+      return false;
+    }
+    if (binary) {
+      int32_t block_size;
+      size_t size = input.read((char*)&block_size, sizeof(block_size));
+      if (size == 0) {
+        return false;
+      }
+      if (size != sizeof(block_size) || block_size < 0) return truncated();
+      if (input.read(alignment.assign_binary(block_size), block_size) != (size_t)block_size) return truncated();
+      if (!alignment.validate_binary()) {
+        std::cerr << "Unexpected file format: inconsistent BAM record in file '" << path << "'" << std::endl;
+        error = true;
+        return false;
+      }
+      return true;
+    }
+    while (has_pending || input.getline(pending)) {
+      has_pending = false;
+      if (pending.empty()) {
+        std::cerr << "Unexpected empty line in file '" << path << "'" << std::endl;
+      } else if (pending[0] == '@') {
+        std::cerr << "Unexpected header line among alignments in file '" << path << "': '" << pending << "'" << std::endl;
+      } else if (alignment.assign_text(pending)) {
+        return true;
+      } else {
+        std::cerr << "Unexpected file format: not enough columns '" << alignment.raw() << "'" << std::endl;
+      }
+    }
+    return false;
+  }
+
+  /// <summary>
+  /// Reads raw lines of a SAM file (after the header) in blocks; lines are neither checked nor split.
+  /// </summary>
+  /// <param name="lines">Whole lines terminated by '\n' (output).</param>
+  /// <param name="size">Approximate size of the block in bytes.</param>
+  /// <returns>FALSE at the end of the file or if an error occured (see failed()).</returns>
+  bool read_lines(std::string& lines, const size_t size) {
+    lines.clear();
+    if (error || binary) {
+      return false;
+    }
+    if (has_pending) {
+      has_pending = false;
+      lines.append(pending);
+      lines += '\n';
+    }
+    size_t from = lines.size();
+    lines.resize(from + size);
+    lines.resize(from + input.read(&lines[from], size));
+    if (!lines.empty() && lines.back() != '\n') {
+      if (input.getline(pending)) {
+        lines.append(pending);
+      }
+      lines += '\n';
+    }
+    return !lines.empty();
+  }
+};
+
+/// <summary>
+/// Writer of alignments in SAM or BAM format, records are converted only if the output format differs from the input one.
+/// </summary>
+class AlignmentWriter {
+private:
+  OutputFile output;
+  bool binary;
+  std::string record;
+
+public:
+  AlignmentWriter() : binary(false) {}
+
+  /// <summary>
+  /// Whether a file name denotes a BAM file.
+  /// </summary>
+  static bool is_bam_name(const std::string& filename) {
+    return filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".bam") == 0;
+  }
+
+  /// <summary>
+  /// Creates an output file, BAM format is used if its name ends with '.bam', SAM format otherwise.
+  /// The file is written by a background thread.
+  /// </summary>
+  /// <param name="filename">Path to the file; '-' stands for the standard output.</param>
+  /// <param name="compression">Compression of SAM format (AUTO by the extension, e.g. '.sam.gz'); BAM format is always in BGZF.</param>
+  /// <param name="threads">Number of threads compressing the output.</param>
+  /// <returns>TRUE if the file was created.</returns>
+  bool open(const std::string& filename, const OutputFile::Compression compression = OutputFile::Compression::AUTO, const size_t threads = 1) {
+    binary = is_bam_name(filename);
+    output.set_threads(threads);
+    // Filters produce records faster than they are compressed and written, so both overlap
+    output.set_write_behind(true);
+    return output.open(filename, binary ? OutputFile::Compression::BGZF : compression);
+  }
+
+  /// <summary>
+  /// Whether the output is in BAM format.
+  /// </summary>
+  inline bool is_binary() const { return binary; }
+
+  /// <summary>
+  /// Writes the header.
+  /// </summary>
+  void write_header(const AlignmentHeader& header) {
+    std::string text = header.text;
+    if (text.find("@SQ\t") != 0 && text.find("\n@SQ\t") == text.npos && !header.names.empty()) { // BAM header may list references only in the binary form
+      std::string references;
+      for (size_t i = 0; i < header.names.size(); ++i) {
+        references += "@SQ\tSN:" + header.names[i] + "\tLN:" + std::to_string(header.lengths[i]) + '\n';
+      }
+      size_t position = text.rfind("@HD\t", 0) == 0 ? text.find('\n') + 1 : 0;
+      text.insert(position, references);
+    }
+    if (!binary) {
+      output.write(text);
+      return;
+    }
+    output.write("BAM\1", 4);
+    int32_t value = (int32_t)text.size();
+    output.write((const char*)&value, sizeof(value));
+    output.write(text);
+    value = (int32_t)header.names.size();
+    output.write((const char*)&value, sizeof(value));
+    for (size_t i = 0; i < header.names.size(); ++i) {
+      value = (int32_t)header.names[i].size() + 1;
+      output.write((const char*)&value, sizeof(value));
+      output.write(header.names[i].c_str(), value);
+      output.write((const char*)&header.lengths[i], sizeof(uint32_t));
+    }
+  }
+
+  /// <summary>
+  /// Writes an alignment.
+  /// </summary>
+  /// <param name="alignment">The alignment.</param>
+  /// <param name="header">Header providing reference ids for the alignment (and for the output).</param>
+  /// <returns>FALSE if the alignment could not be converted into the output format.</returns>
+  bool write(const Alignment& alignment, const AlignmentHeader& header) {
+    const std::string* data = &alignment.raw();
+    if (alignment.is_binary() != binary) {
+      if (binary) {
+        if (!alignment.encode_binary(header, record)) {
+          return false;
+        }
+      } else {
+        alignment.format_text(header, record);
+      }
+      data = &record;
+    }
+    if (binary) {
+      int32_t block_size = (int32_t)data->size();
+      output.write((const char*)&block_size, sizeof(block_size));
+      output.write(*data);
+    } else {
+      output.write(*data);
+      output.put('\n');
+    }
+    return true;
+  }
+
+  /// <summary>
+  /// Writes all buffered data and closes the file.
+  /// </summary>
+  /// <returns>TRUE if no error occured.</returns>
+  bool close() {
+    return output.close();
+  }
+};
+
+#endif
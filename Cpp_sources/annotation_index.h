@@ -0,0 +1,379 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef ANNOTATION_INDEX_H
+#define ANNOTATION_INDEX_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+#include "id_dictionary.h"
+#include "mapped_file.h"
+#include "sam_fields.h"
+
+/// <summary>
+/// Finds a value of an attribute in the ninth column of a GTF line, e.g. 'gene_id' in 'gene_id "ENSG..."; gene_version "1";'.
+/// </summary>
+/// <param name="attributes">The ninth column.</param>
+/// <param name="key">Name of the attribute.</param>
+/// <param name="value">Value of the attribute without quotes (output).</param>
+/// <returns>0 if the attribute was found, 1 if it is missing, 2 if its value is not enclosed by quotes.</returns>
+inline int gtf_attribute(const std::string_view attributes, const std::string_view key, std::string_view& value) {
+  for (size_t from = attributes.find(key); from != attributes.npos; from = attributes.find(key, from + 1)) {
+    size_t quote = from + key.size();
+    if ((from > 0 && attributes[from - 1] != ' ' && attributes[from - 1] != ';') || attributes.substr(quote, 2) != " \"") {
+      continue;
+    }
+    size_t end = attributes.find('"', quote + 2);
+    if (end == attributes.npos) {
+      return 2;
+    }
+    value = attributes.substr(quote + 2, end - quote - 2);
+    return 0;
+  }
+  return 1;
+}
+
+/// <summary>
+/// A line of annotations in GTF format; views point either into the line, or into a mapped annotation index.
+/// </summary>
+struct GtfRecord {
+  std::string_view seqname, source, feature, score, attributes;
+  /// <summary>
+  /// 1-based boundaries [start; end].
+  /// </summary>
+  uint64_t start, end;
+  /// <summary>
+  /// '+', '-' or '.'.
+  /// </summary>
+  char strand;
+  /// <summary>
+  /// '0', '1', '2' or '.'.
+  /// </summary>
+  char phase;
+  /// <summary>
+  /// Values of 'gene_id' and 'transcript_id' attributes, empty if missing.
+  /// </summary>
+  std::string_view gene_id, transcript_id;
+
+  /// <summary>
+  /// Parses a (non-comment) line of a GTF file.
+  /// </summary>
+  /// <param name="line">The line, it has to outlive the record.</param>
+  /// <returns>0 if no error occured, otherwise the error code (5 for a wrong number of columns, 6 for wrong values, 13 for unenclosed ids).</returns>
+  int parse(const std::string_view line) {
+    std::string_view columns[9];
+    size_t from = 0;
+    for (size_t i = 0; i < 8; ++i) {
+      size_t to = line.find('\t', from);
+      if (to == line.npos) {
+        std::cerr << "Unexpected line format - not enough columns: " << line << std::endl;
+        return 5;
+      }
+      columns[i] = line.substr(from, to - from);
+      from = to + 1;
+    }
+    columns[8] = line.substr(from);
+    if (columns[8].find('\t') != columns[8].npos) {
+      std::cerr << "Unexpected line format - too many columns: " << line << std::endl;
+      return 5;
+    }
+    seqname = columns[0];
+    source = columns[1];
+    feature = columns[2];
+    score = columns[5];
+    attributes = columns[8];
+    if (!parse_integer(columns[3], start) || !parse_integer(columns[4], end) || columns[6].size() != 1 || columns[7].size() != 1
+      || std::string_view("+-.").find(columns[6][0]) == std::string_view::npos || std::string_view("012.").find(columns[7][0]) == std::string_view::npos) {
+      std::cerr << "Unexpected line format - invalid position, strand or phase: " << line << std::endl;
+      return 6;
+    }
+    strand = columns[6][0];
+    phase = columns[7][0];
+    gene_id = transcript_id = std::string_view();
+    if (gtf_attribute(attributes, "gene_id", gene_id) == 2 || gtf_attribute(attributes, "transcript_id", transcript_id) == 2) {
+      std::cerr << "Unexpected line format - unenclosed 'gene_id' or 'transcript_id' attribute: " << line << std::endl;
+      return 13;
+    }
+    return 0;
+  }
+
+  /// <summary>
+  /// Formats the record as a line of a GTF file (without the line break).
+  /// </summary>
+  std::string to_line() const {
+    std::string line;
+    for (std::string_view column : { seqname, source, feature }) {
+      line.append(column);
+      line += '\t';
+    }
+    line += std::to_string(start) + '\t' + std::to_string(end) + '\t';
+    line.append(score);
+    line += '\t';
+    line += strand;
+    line += '\t';
+    line += phase;
+    line += '\t';
+    line.append(attributes);
+    return line;
+  }
+};
+
+/// <summary>
+/// Binary annotation index (written by compile_annotations), all numbers are little-endian and sections are aligned to 8 bytes:
+/// - magic "RPANNOT1";
+/// - texts of attributes and comment lines;
+/// - dictionaries of interned seqnames, sources, features, scores, gene_ids and transcript_ids: names concatenated
+///   and uint64 offsets of their starts (one more than the number of names, the last one is the end);
+/// - columns of records (in the order of lines): uint32 ids of seqname, source, feature, score, uint64 start, end,
+///   uint8 strand, phase (characters), uint32 ids of gene_id and transcript_id (UINT32_MAX if missing), uint64 offset and length of attributes;
+/// - comments: uint64 number of preceding records, uint64 offset and length of the line;
+/// - trailer: uint64 offset and number of items of each section (see annotation_format::Section), uint64 number of sections.
+/// </summary>
+namespace annotation_format {
+  const char MAGIC[] = "RPANNOT1";
+  const size_t HEADER_SIZE = 8;
+
+  enum Section {
+    SEQNAMES, SOURCES, FEATURES, SCORES, GENES, TRANSCRIPTS, // Dictionaries (offset of starts, number of names)
+    SEQNAME, SOURCE, FEATURE, SCORE, START, END, STRAND, PHASE, GENE, TRANSCRIPT, ATTRIBUTES, ATTRIBUTES_LENGTH, // Columns
+    COMMENTS,
+    SECTIONS
+  };
+  const size_t DICTIONARIES = 6;
+  const size_t TRAILER_SIZE = 16 * SECTIONS + 8;
+
+  /// <summary>
+  /// Size of an item of a section.
+  /// </summary>
+  inline size_t item_size(const size_t section) {
+    switch (section) {
+      case STRAND: case PHASE: return 1;
+      case SEQNAME: case SOURCE: case FEATURE: case SCORE: case GENE: case TRANSCRIPT: return 4;
+      case COMMENTS: return 24;
+      default: return 8; // Starts of names in dictionaries, positions and attributes
+    }
+  }
+}
+
+/// <summary>
+/// Annotations in the binary index format mapped into memory.
+/// </summary>
+class AnnotationIndex {
+public:
+  static constexpr uint32_t NONE = UINT32_MAX;
+
+private:
+  MappedFile file;
+  const unsigned char* data = nullptr;
+  /// <summary>
+  /// Offsets and numbers of items of sections.
+  /// </summary>
+  uint64_t offsets[annotation_format::SECTIONS] = { 0 };
+  uint64_t counts[annotation_format::SECTIONS] = { 0 };
+
+  template <typename T>
+  inline const T* column(const size_t section) const { return (const T*)(data + offsets[section]); }
+
+  inline std::string_view text(const uint64_t offset, const uint64_t length) const {
+    return std::string_view((const char*)data + offset, length);
+  }
+
+  bool invalid(const std::string& filename) {
+    std::cerr << "Unexpected file format: corrupted annotation index '" << filename << "'" << std::endl;
+    close();
+    return false;
+  }
+
+public:
+  AnnotationIndex() {}
+  AnnotationIndex(const AnnotationIndex&) = delete;
+  AnnotationIndex& operator=(const AnnotationIndex&) = delete;
+  ~AnnotationIndex() { close(); }
+
+  /// <summary>
+  /// Whether a file is an annotation index (judged by its magic).
+  /// </summary>
+  static bool is_annotation_index(const std::string& filename) {
+    return MappedFile::has_magic(filename, annotation_format::MAGIC);
+  }
+
+  /// <summary>
+  /// Maps an annotation index into memory and checks its sections.
+  /// </summary>
+  /// <param name="filename">Path to the file.</param>
+  /// <returns>TRUE if the file was opened.</returns>
+  bool open(const std::string& filename) {
+    close();
+    if (!file.open(filename)) {
+      return false;
+    }
+    data = file.data();
+    if (!file.starts_with(annotation_format::MAGIC, annotation_format::HEADER_SIZE + annotation_format::TRAILER_SIZE)
+      || file.get<uint64_t>(file.size() - 8) != annotation_format::SECTIONS) {
+      return invalid(filename);
+    }
+    const size_t trailer = file.size() - annotation_format::TRAILER_SIZE;
+    for (size_t i = 0; i < annotation_format::SECTIONS; ++i) {
+      offsets[i] = file.get<uint64_t>(trailer + 16 * i);
+      counts[i] = file.get<uint64_t>(trailer + 16 * i + 8);
+      uint64_t items = counts[i] + (i < annotation_format::DICTIONARIES ? 1 : 0);
+      if (offsets[i] % 8 != 0 || offsets[i] > trailer || items > (trailer - offsets[i]) / annotation_format::item_size(i)) {
+        return invalid(filename);
+      }
+      if (i >= annotation_format::SEQNAME && i < annotation_format::COMMENTS && counts[i] != records()) {
+        return invalid(filename);
+      }
+    }
+    // Texts have to lie within the file and ids have to be valid
+    for (size_t i = 0; i < annotation_format::DICTIONARIES; ++i) {
+      const uint64_t* starts = column<uint64_t>(i);
+      for (uint64_t j = 0; j < counts[i]; ++j) {
+        if (starts[j] > starts[j + 1] || starts[j + 1] > trailer) {
+          return invalid(filename);
+        }
+      }
+    }
+    const size_t columns[] = { annotation_format::SEQNAMES, annotation_format::SOURCES, annotation_format::FEATURES, annotation_format::SCORES };
+    for (uint64_t r = 0; r < records(); ++r) {
+      for (size_t i = 0; i < 4; ++i) {
+        if (column<uint32_t>(annotation_format::SEQNAME + i)[r] >= counts[columns[i]]) {
+          return invalid(filename);
+        }
+      }
+      uint32_t gene = column<uint32_t>(annotation_format::GENE)[r], transcript = column<uint32_t>(annotation_format::TRANSCRIPT)[r];
+      uint64_t attributes = column<uint64_t>(annotation_format::ATTRIBUTES)[r];
+      if ((gene != NONE && gene >= counts[annotation_format::GENES]) || (transcript != NONE && transcript >= counts[annotation_format::TRANSCRIPTS])
+        || attributes > trailer || column<uint64_t>(annotation_format::ATTRIBUTES_LENGTH)[r] > trailer - attributes) {
+        return invalid(filename);
+      }
+    }
+    const uint64_t* comments = column<uint64_t>(annotation_format::COMMENTS);
+    for (uint64_t c = 0; c < counts[annotation_format::COMMENTS]; ++c) {
+      if (comments[3 * c] > records() || (c > 0 && comments[3 * c] < comments[3 * c - 3]) || comments[3 * c + 1] > trailer || comments[3 * c + 2] > trailer - comments[3 * c + 1]) {
+        return invalid(filename);
+      }
+    }
+    return true;
+  }
+
+  /// <summary>
+  /// Unmaps the file.
+  /// </summary>
+  void close() {
+    file.close();
+    data = nullptr;
+    std::memset(offsets, 0, sizeof(offsets));
+    std::memset(counts, 0, sizeof(counts));
+  }
+
+  /// <summary>
+  /// Number of records (non-comment lines).
+  /// </summary>
+  inline uint64_t records() const { return counts[annotation_format::SEQNAME]; }
+
+  /// <summary>
+  /// Number of interned names in a dictionary (e.g. annotation_format::GENES).
+  /// </summary>
+  inline uint64_t names(const size_t dictionary) const { return counts[dictionary]; }
+
+  /// <summary>
+  /// Name of an id within a dictionary (e.g. annotation_format::GENES).
+  /// </summary>
+  inline std::string_view name(const size_t dictionary, const uint32_t id) const {
+    const uint64_t* starts = column<uint64_t>(dictionary);
+    return text(starts[id], starts[id + 1] - starts[id]);
+  }
+
+  inline uint32_t seqname(const uint64_t record) const { return column<uint32_t>(annotation_format::SEQNAME)[record]; }
+  inline uint32_t feature(const uint64_t record) const { return column<uint32_t>(annotation_format::FEATURE)[record]; }
+  inline uint64_t start(const uint64_t record) const { return column<uint64_t>(annotation_format::START)[record]; }
+  inline uint64_t end(const uint64_t record) const { return column<uint64_t>(annotation_format::END)[record]; }
+  inline char strand(const uint64_t record) const { return (char)column<uint8_t>(annotation_format::STRAND)[record]; }
+  inline char phase(const uint64_t record) const { return (char)column<uint8_t>(annotation_format::PHASE)[record]; }
+  /// <summary>
+  /// Id of gene_id of a record, NONE if it is missing.
+  /// </summary>
+  inline uint32_t gene(const uint64_t record) const { return column<uint32_t>(annotation_format::GENE)[record]; }
+  /// <summary>
+  /// Id of transcript_id of a record, NONE if it is missing.
+  /// </summary>
+  inline uint32_t transcript(const uint64_t record) const { return column<uint32_t>(annotation_format::TRANSCRIPT)[record]; }
+
+  /// <summary>
+  /// Fills all columns of a record.
+  /// </summary>
+  void record(const uint64_t record, GtfRecord& result) const {
+    result.seqname = name(annotation_format::SEQNAMES, seqname(record));
+    result.source = name(annotation_format::SOURCES, column<uint32_t>(annotation_format::SOURCE)[record]);
+    result.feature = name(annotation_format::FEATURES, feature(record));
+    result.score = name(annotation_format::SCORES, column<uint32_t>(annotation_format::SCORE)[record]);
+    result.start = start(record);
+    result.end = end(record);
+    result.strand = strand(record);
+    result.phase = phase(record);
+    result.attributes = text(column<uint64_t>(annotation_format::ATTRIBUTES)[record], column<uint64_t>(annotation_format::ATTRIBUTES_LENGTH)[record]);
+    result.gene_id = gene(record) == NONE ? std::string_view() : name(annotation_format::GENES, gene(record));
+    result.transcript_id = transcript(record) == NONE ? std::string_view() : name(annotation_format::TRANSCRIPTS, transcript(record));
+  }
+
+  /// <summary>
+  /// Number of comment lines.
+  /// </summary>
+  inline uint64_t comments() const { return counts[annotation_format::COMMENTS]; }
+
+  /// <summary>
+  /// Comment line and the number of records preceding it.
+  /// </summary>
+  inline std::string_view comment(const uint64_t comment, uint64_t& position) const {
+    const uint64_t* item = column<uint64_t>(annotation_format::COMMENTS) + 3 * comment;
+    position = item[0];
+    return text(item[1], item[2]);
+  }
+
+  /// <summary>
+  /// Reads records (and comments) in the order of the original lines.
+  /// </summary>
+  /// <param name="on_record">Function taking a record number and the record, it returns 0, or an error code to stop.</param>
+  /// <param name="on_comment">Function taking a comment line, it returns 0, or an error code to stop.</param>
+  /// <returns>0 if no error occured; otherwise the error code.</returns>
+  template <typename OnRecord, typename OnComment>
+  int read(OnRecord on_record, OnComment on_comment) const {
+    GtfRecord current;
+    uint64_t c = 0, position = 0;
+    for (uint64_t r = 0; r <= records(); ++r) {
+      for (; c < comments() && (comment(c, position), position == r); ++c) {
+        int error = on_comment(comment(c, position));
+        if (error != 0) {
+          return error;
+        }
+      }
+      if (r < records()) {
+        record(r, current);
+        int error = on_record(r, current);
+        if (error != 0) {
+          return error;
+        }
+      }
+    }
+    return 0;
+  }
+};
+
+/// <summary>
+/// Builds a mapping transcript_id => gene_id from all records of an annotation index.
+/// </summary>
+inline void load_transcript_genes(const AnnotationIndex& index, TranscriptGenes& transcript_gene) {
+  for (uint64_t r = 0; r < index.records(); ++r) {
+    uint32_t transcript = index.transcript(r), gene = index.gene(r);
+    if (transcript != AnnotationIndex::NONE && gene != AnnotationIndex::NONE) {
+      transcript_gene.add(index.name(annotation_format::TRANSCRIPTS, transcript), index.name(annotation_format::GENES, gene));
+    }
+  }
+}
+
+#endif
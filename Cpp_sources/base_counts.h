@@ -0,0 +1,263 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef BASE_COUNTS_H
+#define BASE_COUNTS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <string_view>
+#include "strand.h"
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define BASE_COUNTS_AVX2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BASE_COUNTS_NEON
+#endif
+
+/// <summary>
+/// Numbers of (upper-case) A, C, G, T, U and N bases within a part of a sequence.
+/// </summary>
+struct BaseCounts {
+  /// <summary>
+  /// Counted characters in the order of counts.
+  /// </summary>
+  static constexpr char BASES[] = "ACGTUN";
+  static constexpr size_t SIZE = 6;
+
+  /// <summary>
+  /// Counts of A, C, G, T, U and N.
+  /// </summary>
+  uint64_t counts[SIZE] = { 0 };
+  /// <summary>
+  /// Number of all characters including other ones (e.g. IUPAC codes or soft-masked bases).
+  /// </summary>
+  uint64_t length = 0;
+
+  inline uint64_t a() const { return counts[0]; }
+  inline uint64_t c() const { return counts[1]; }
+  inline uint64_t g() const { return counts[2]; }
+  inline uint64_t t() const { return counts[3]; }
+  inline uint64_t u() const { return counts[4]; }
+  inline uint64_t n() const { return counts[5]; }
+
+  /// <summary>
+  /// Number of characters other than A, C, G, T, U and N.
+  /// </summary>
+  inline uint64_t others() const {
+    uint64_t known = 0;
+    for (uint64_t count : counts) {
+      known += count;
+    }
+    return length - known;
+  }
+
+  /// <summary>
+  /// Returns counts of the complementary strand (A <=> T, C <=> G, U => A, N remains); other characters are not complemented.
+  /// </summary>
+  BaseCounts complement() const {
+    BaseCounts result;
+    result.counts[0] = t() + u();
+    result.counts[1] = g();
+    result.counts[2] = c();
+    result.counts[3] = a();
+    result.counts[5] = n();
+    result.length = length;
+    return result;
+  }
+
+  /// <summary>
+  /// Adds counts of another part.
+  /// </summary>
+  BaseCounts& operator+=(const BaseCounts& other) {
+    for (size_t i = 0; i < SIZE; ++i) {
+      counts[i] += other.counts[i];
+    }
+    length += other.length;
+    return *this;
+  }
+};
+
+namespace base_counting {
+  /// <summary>
+  /// Counts bases one by one.
+  /// </summary>
+  inline void count_scalar(const char* data, const size_t size, uint64_t* counts) {
+    // Index of a character in BaseCounts::BASES, or SIZE for other characters
+    static const struct Table {
+      unsigned char index[256];
+      Table() {
+        std::fill(index, index + 256, (unsigned char)BaseCounts::SIZE);
+        for (size_t i = 0; i < BaseCounts::SIZE; ++i) {
+          index[(unsigned char)BaseCounts::BASES[i]] = (unsigned char)i;
+        }
+      }
+    } table;
+    uint64_t local[BaseCounts::SIZE + 1] = { 0 };
+    for (size_t i = 0; i < size; ++i) {
+      ++local[table.index[(unsigned char)data[i]]];
+    }
+    for (size_t i = 0; i < BaseCounts::SIZE; ++i) {
+      counts[i] += local[i];
+    }
+  }
+
+#ifdef BASE_COUNTS_AVX2
+  /// <summary>
+  /// Counts bases by 32 at once; byte counters are summed before they can overflow (every 255 iterations).
+  /// </summary>
+  /// <returns>Number of counted characters (a multiple of 32), the rest has to be counted otherwise.</returns>
+  __attribute__((target("avx2")))
+  inline size_t count_avx2(const char* data, const size_t size, uint64_t* counts) {
+    __m256i letters[BaseCounts::SIZE];
+    for (size_t k = 0; k < BaseCounts::SIZE; ++k) {
+      letters[k] = _mm256_set1_epi8(BaseCounts::BASES[k]);
+    }
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    while (i + 32 <= size) {
+      __m256i sums[BaseCounts::SIZE];
+      for (size_t k = 0; k < BaseCounts::SIZE; ++k) {
+        sums[k] = zero;
+      }
+      for (size_t end = std::min(size - size % 32, i + 255 * 32); i < end; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+        for (size_t k = 0; k < BaseCounts::SIZE; ++k) { // Equal bytes are -1
+          sums[k] = _mm256_sub_epi8(sums[k], _mm256_cmpeq_epi8(block, letters[k]));
+        }
+      }
+      for (size_t k = 0; k < BaseCounts::SIZE; ++k) {
+        __m256i total = _mm256_sad_epu8(sums[k], zero);
+        counts[k] += (uint64_t)_mm256_extract_epi64(total, 0) + (uint64_t)_mm256_extract_epi64(total, 1)
+          + (uint64_t)_mm256_extract_epi64(total, 2) + (uint64_t)_mm256_extract_epi64(total, 3);
+      }
+    }
+    return i;
+  }
+
+  inline bool has_avx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+  }
+#endif
+
+#ifdef BASE_COUNTS_NEON
+  /// <summary>
+  /// Counts bases by 16 at once; byte counters are summed before they can overflow (every 255 iterations).
+  /// </summary>
+  /// <returns>Number of counted characters (a multiple of 16), the rest has to be counted otherwise.</returns>
+  inline size_t count_neon(const char* data, const size_t size, uint64_t* counts) {
+    uint8x16_t letters[BaseCounts::SIZE];
+    for (size_t k = 0; k < BaseCounts::SIZE; ++k) {
+      letters[k] = vdupq_n_u8((uint8_t)BaseCounts::BASES[k]);
+    }
+    size_t i = 0;
+    while (i + 16 <= size) {
+      uint8x16_t sums[BaseCounts::SIZE];
+      for (size_t k = 0; k < BaseCounts::SIZE; ++k) {
+        sums[k] = vdupq_n_u8(0);
+      }
+      for (size_t end = std::min(size - size % 16, i + 255 * 16); i < end; i += 16) {
+        uint8x16_t block = vld1q_u8((const uint8_t*)(data + i));
+        for (size_t k = 0; k < BaseCounts::SIZE; ++k) { // Equal bytes are 0xFF, i.e. -1
+          sums[k] = vsubq_u8(sums[k], vceqq_u8(block, letters[k]));
+        }
+      }
+      for (size_t k = 0; k < BaseCounts::SIZE; ++k) {
+        counts[k] += vaddlvq_u8(sums[k]);
+      }
+    }
+    return i;
+  }
+#endif
+}
+
+/// <summary>
+/// Counts A, C, G, T, U and N bases within a part of a sequence (vectorized if the CPU allows it).
+/// </summary>
+/// <param name="bases">The part of the sequence.</param>
+/// <returns>The counts.</returns>
+inline BaseCounts count_bases(const std::string_view bases) {
+  BaseCounts result;
+  result.length = bases.size();
+  size_t done = 0;
+#if defined(BASE_COUNTS_AVX2)
+  if (base_counting::has_avx2()) {
+    done = base_counting::count_avx2(bases.data(), bases.size(), result.counts);
+  }
+#elif defined(BASE_COUNTS_NEON)
+  done = base_counting::count_neon(bases.data(), bases.size(), result.counts);
+#endif
+  base_counting::count_scalar(bases.data() + done, bases.size() - done, result.counts);
+  return result;
+}
+
+namespace base_counting {
+  /// <summary>
+  /// 2-bit codes of bases (A = 0, C = 1, G = 2, T and U = 3) on the forward and reverse (complemented) strand, 4 for other characters.
+  /// </summary>
+  struct KmerCodes {
+    unsigned char forward[256], reverse[256];
+
+    KmerCodes() {
+      std::fill(forward, forward + 256, 4);
+      std::fill(reverse, reverse + 256, 4);
+      const char bases[] = "ACGTU";
+      const unsigned char codes[] = { 0, 1, 2, 3, 3 };
+      for (size_t i = 0; i < 5; ++i) {
+        forward[(unsigned char)bases[i]] = codes[i];
+        reverse[(unsigned char)bases[i]] = 3 - codes[i];
+      }
+    }
+
+    static const KmerCodes& get() {
+      static const KmerCodes codes;
+      return codes;
+    }
+  };
+
+  /// <summary>
+  /// Counts k-mers read from the 5' end of a feature on the given strand (see count_kmers).
+  /// </summary>
+  template <typename S>
+  void count_kmers(const std::string_view bases, const size_t k, const size_t step, const size_t frame, uint32_t* counts) {
+    const unsigned char* codes = S::forward ? KmerCodes::get().forward : KmerCodes::get().reverse;
+    const uint32_t mask = k >= 16 ? UINT32_MAX : (1U << (2 * k)) - 1;
+    uint32_t code = 0;
+    // Number of valid bases at the end of the current k-mer
+    size_t valid = 0;
+    for (size_t i = 0; i < bases.size(); ++i) {
+      unsigned char base = codes[(unsigned char)S::base(bases, i)];
+      if (base > 3) {
+        valid = 0;
+        continue;
+      }
+      code = ((code << 2) | base) & mask;
+      // The current k-mer starts at i + 1 - k
+      if (++valid >= k && i + 1 >= k + frame && (i + 1 - k - frame) % step == 0) {
+        ++counts[code];
+      }
+    }
+  }
+}
+
+/// <summary>
+/// Counts k-mers of a part of a sequence read in the direction of its strand (the reverse strand is complemented) by a rolling 2k-bit code.
+/// K-mers with other characters than A, C, G, T and U (read as T) are skipped.
+/// </summary>
+/// <param name="bases">The part of the sequence in the forward direction.</param>
+/// <param name="strand">TRUE for the forward strand.</param>
+/// <param name="k">Length of k-mers (at most 16).</param>
+/// <param name="step">Distance of starts of counted k-mers (e.g. 3 for codons, 1 for all overlapping k-mers).</param>
+/// <param name="frame">Start of the first counted k-mer (e.g. the phase of a CDS).</param>
+/// <param name="counts">Counts of k-mers indexed by their codes (A = 0, C = 1, G = 2, T = 3; the first base in the highest bits).</param>
+inline void count_kmers(const std::string_view bases, const bool strand, const size_t k, const size_t step, const size_t frame, uint32_t* counts) {
+  with_strand(strand, [&](auto direction) {
+    base_counting::count_kmers<decltype(direction)>(bases, k, step, frame, counts);
+  });
+}
+
+#endif
@@ -0,0 +1,80 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef BENCHMARK_DATA_H
+#define BENCHMARK_DATA_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <iostream>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "synthetic_data.h"
+
+/// <summary>
+/// Synthetic input files of benchmarks in a temporary directory, which is removed with all files (including outputs of benchmarks) in the end.
+/// </summary>
+class BenchmarkData {
+private:
+  std::string directory;
+
+public:
+  BenchmarkData() {}
+
+  BenchmarkData(const BenchmarkData&) = delete;
+  BenchmarkData& operator=(const BenchmarkData&) = delete;
+
+  ~BenchmarkData() {
+    if (directory.empty()) {
+      return;
+    }
+    if (DIR* listing = opendir(directory.c_str())) {
+      for (dirent* entry = readdir(listing); entry != nullptr; entry = readdir(listing)) {
+        std::string name(entry->d_name);
+        if (name != "." && name != "..") {
+          std::remove(path(name).c_str());
+        }
+      }
+      closedir(listing);
+    }
+    rmdir(directory.c_str());
+  }
+
+  /// <summary>
+  /// Path of a file within the directory.
+  /// </summary>
+  inline std::string path(const std::string& name) const {
+    return directory + '/' + name;
+  }
+
+  /// <summary>
+  /// Size of a file within the directory in bytes (0 if it does not exist).
+  /// </summary>
+  inline uint64_t size(const std::string& name) const {
+    struct stat status;
+    return stat(path(name).c_str(), &status) == 0 ? (uint64_t)status.st_size : 0;
+  }
+
+  /// <summary>
+  /// Creates the directory in TMPDIR (or '/tmp') and writes 'genome.fa', 'annotations.gtf', 'alignments.sam', 'transcript_ids.txt' and 'ranges.tsv'.
+  /// </summary>
+  /// <returns>FALSE if the directory or a file could not be created.</returns>
+  bool create(const SyntheticOptions& options) {
+    const char* tmpdir = std::getenv("TMPDIR");
+    std::string pattern = std::string(tmpdir != nullptr && *tmpdir != '\0' ? tmpdir : "/tmp") + "/ribo_benchmark.XXXXXX";
+    if (mkdtemp(&pattern[0]) == nullptr) {
+      std::cerr << "Unable to create a temporary directory '" << pattern << "'." << std::endl;
+      return false;
+    }
+    directory = pattern;
+    SyntheticData data(options);
+    return data.write_genome(path("genome.fa")) && data.write_annotations(path("annotations.gtf")) && data.write_alignments(path("alignments.sam"))
+      && data.write_transcript_ids(path("transcript_ids.txt")) && data.write_ranges(path("ranges.tsv"));
+  }
+};
+
+#endif
@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+# Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+# Last update: 2026-10-14
+# Released under Apache License 2.0
+
+"""Compares two JSON outputs of stage_benchmarks or tool_benchmarks (--benchmark_out=FILE --benchmark_out_format=json)
+and fails if a benchmark of the contender is slower than the baseline by more than the threshold."""
+
+import argparse
+import json
+import statistics
+import sys
+
+UNITS = {"ns": 1e-9, "us": 1e-6, "ms": 1e-3, "s": 1.0}
+
+
+def load(filename):
+    """Median real time in seconds of the iterations (repetitions) of each benchmark."""
+    with open(filename) as file:
+        benchmarks = json.load(file)["benchmarks"]
+    times = {}
+    for benchmark in benchmarks:
+        if benchmark.get("run_type", "iteration") != "iteration" or benchmark.get("error_occurred"):
+            continue
+        name = benchmark.get("run_name", benchmark["name"])
+        times.setdefault(name, []).append(benchmark["real_time"] * UNITS[benchmark.get("time_unit", "ns")])
+    return {name: statistics.median(values) for name, values in times.items()}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("baseline")
+    parser.add_argument("contender")
+    parser.add_argument("--threshold", type=float, default=5.0, help="allowed slowdown in percent (default 5)")
+    arguments = parser.parse_args()
+    baseline, contender = load(arguments.baseline), load(arguments.contender)
+    regressions = 0
+    print("%-56s %12s %12s %9s" % ("benchmark", "baseline", "contender", "change"))
+    for name in sorted(baseline.keys() & contender.keys()):
+        change = 100.0 * (contender[name] / baseline[name] - 1) if baseline[name] > 0 else 0.0
+        regression = change > arguments.threshold
+        regressions += regression
+        print("%-56s %10.3fms %10.3fms %+8.1f%%%s" % (name, 1e3 * baseline[name], 1e3 * contender[name], change, "  REGRESSION" if regression else ""))
+    for name in sorted(baseline.keys() ^ contender.keys()):
+        print("%-56s only in %s" % (name, "baseline" if name in baseline else "contender"))
+    if regressions:
+        print("%d benchmark(s) slower by more than %.1f%%." % (regressions, arguments.threshold))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
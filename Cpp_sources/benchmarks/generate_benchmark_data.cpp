@@ -0,0 +1,38 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#include <string>
+#include <iostream>
+#include "synthetic_data.h"
+
+int main(int argc, char* argv[]) {
+  SyntheticOptions options;
+  int argi = 1;
+  for (int previous = 0; previous != argi; ) {
+    previous = argi;
+    if (!parse_synthetic_option(argi, argc, argv, options)) {
+      return 1;
+    }
+  }
+  if (argc != argi + 1) {
+    std::cout << "generate_benchmark_data [--reads N] [--genes N] [--multimapping RATE] [--reverse FRACTION] [--seed N] <directory>\n";
+    std::cout << "                              \t Writes a synthetic data set into an existing <directory>: 'genome.fa' (FASTA), 'annotations.gtf'\n";
+    std::cout << "                              \t (Ensembl-like GTF), 'alignments.sam' (NH-grouped alignments of reads to transcripts),\n";
+    std::cout << "                              \t 'transcript_ids.txt' (a half of transcripts) and 'ranges.tsv' (CDS ranges of transcripts).\n";
+    std::cout << "                              \t --reads N  \t number of reads (default " << options.reads << ").\n";
+    std::cout << "                              \t --genes N  \t number of genes (default " << options.genes << ").\n";
+    std::cout << "                              \t --multimapping RATE\t fraction of reads with multiple alignments (default " << options.multimapping_rate << ").\n";
+    std::cout << "                              \t --reverse FRACTION \t fraction of alignments to the reverse strand (default " << options.reverse_fraction << ").\n";
+    std::cout << "                              \t --seed N   \t seed of the pseudo-random numbers; equal options produce equal files.\n";
+    std::cout << "Created by Jan Jelínek (jan.jelinek@biomed.cas.cz); last update: 2026-10-14; license: Apache License 2.0" << std::endl;
+    return (argc == 1) ? 0 : 1;
+  }
+  const std::string directory(argv[argi]);
+  SyntheticData data(options);
+  if (!data.write_genome(directory + "/genome.fa") || !data.write_annotations(directory + "/annotations.gtf") || !data.write_alignments(directory + "/alignments.sam")
+    || !data.write_transcript_ids(directory + "/transcript_ids.txt") || !data.write_ranges(directory + "/ranges.tsv")) {
+    return 9;
+  }
+  return 0;
+}
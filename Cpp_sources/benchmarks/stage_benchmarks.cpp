@@ -0,0 +1,349 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+// Benchmarks of stages shared by the tools (parsing, filters, counting) on a synthetic data set, which is generated in a temporary directory.
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <iostream>
+#include <benchmark/benchmark.h>
+#include "../alignment_filters.h"
+#include "../annotation_index.h"
+#include "../base_counts.h"
+#include "../genome_file.h"
+#include "../position_counts.h"
+#include "../transcript_projection.h"
+#include "benchmark_data.h"
+
+namespace {
+
+BenchmarkData data;
+
+/// <summary>
+/// Alignments of the data set grouped by reads; they are loaded once and copied by benchmarks of filters (outside of the measured time).
+/// </summary>
+struct LoadedAlignments {
+  AlignmentHeader header;
+  std::vector<std::vector<Alignment>> groups;
+  uint64_t alignments = 0;
+};
+
+const LoadedAlignments& loaded_alignments() {
+  static LoadedAlignments loaded;
+  if (loaded.groups.empty()) {
+    AlignmentReader input;
+    if (!input.open(data.path("alignments.sam")) || !input.read_header(loaded.header)) {
+      return loaded;
+    }
+    for (Alignment alignment; input.next(alignment); ++loaded.alignments) {
+      if (loaded.groups.empty() || loaded.groups.back().front().qname() != alignment.qname()) {
+        loaded.groups.emplace_back();
+      }
+      loaded.groups.back().push_back(alignment);
+    }
+  }
+  return loaded;
+}
+
+/// <summary>
+/// Lines of the annotations except comments.
+/// </summary>
+const std::vector<std::string>& annotation_lines() {
+  static std::vector<std::string> lines;
+  if (lines.empty()) {
+    InputFile input;
+    if (input.open(data.path("annotations.gtf"))) {
+      for (std::string line; input.getline(line); ) {
+        if (!line.empty() && line[0] != '#') {
+          lines.push_back(line);
+        }
+      }
+    }
+  }
+  return lines;
+}
+
+/// <summary>
+/// Runs a filter over copies of all groups; only the filter (and update_group) is measured.
+/// </summary>
+void filter_groups(benchmark::State& state, const AlignmentStage& stage) {
+  const LoadedAlignments& loaded = loaded_alignments();
+  std::vector<std::vector<Alignment>> groups;
+  for (auto _ : state) {
+    state.PauseTiming();
+    groups = loaded.groups;
+    state.ResumeTiming();
+    for (std::vector<Alignment>& group : groups) {
+      AlignmentSpan span(group.data(), group.size());
+      if (stage.filter(span, loaded.header) != 0) {
+        state.SkipWithError("The filter failed.");
+        return;
+      }
+      update_group(span, (int64_t)group.size(), loaded.header);
+    }
+    benchmark::DoNotOptimize(groups.data());
+  }
+  state.SetItemsProcessed(state.iterations() * loaded.alignments);
+}
+
+void BM_SamParsing(benchmark::State& state) {
+  uint64_t alignments = 0;
+  for (auto _ : state) {
+    AlignmentReader input;
+    AlignmentHeader header;
+    if (!input.open(data.path("alignments.sam")) || !input.read_header(header)) {
+      state.SkipWithError("Unable to read alignments.");
+      return;
+    }
+    for (Alignment alignment; input.next(alignment); ) {
+      ++alignments;
+    }
+  }
+  state.SetItemsProcessed(alignments);
+  state.SetBytesProcessed(state.iterations() * data.size("alignments.sam"));
+}
+BENCHMARK(BM_SamParsing)->Unit(benchmark::kMillisecond);
+
+void BM_SamWriting(benchmark::State& state) {
+  const LoadedAlignments& loaded = loaded_alignments();
+  const std::string output_name = data.path(state.range(0) ? "written.sam.gz" : "written.sam");
+  for (auto _ : state) {
+    AlignmentWriter output;
+    if (!output.open(output_name)) {
+      state.SkipWithError("Unable to write alignments.");
+      return;
+    }
+    output.write_header(loaded.header);
+    for (const std::vector<Alignment>& group : loaded.groups) {
+      for (const Alignment& alignment : group) {
+        output.write(alignment, loaded.header);
+      }
+    }
+    if (!output.close()) {
+      state.SkipWithError("Unable to write alignments.");
+      return;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * loaded.alignments);
+}
+// The output is compressed and written by a background thread, so the real time is measured
+BENCHMARK(BM_SamWriting)->ArgName("bgzf")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_ReverseStrandFilter(benchmark::State& state) {
+  ReverseStrandFilter filter;
+  filter_groups(state, filter);
+}
+BENCHMARK(BM_ReverseStrandFilter)->Unit(benchmark::kMillisecond);
+
+void BM_AmbiguousGeneFilter(benchmark::State& state) {
+  TranscriptGenes transcript_gene;
+  if (AmbiguousGeneFilter::load(data.path("annotations.gtf"), transcript_gene) != 0) {
+    state.SkipWithError("Unable to load annotations.");
+    return;
+  }
+  AmbiguousGeneFilter filter(transcript_gene, data.path("annotations.gtf"));
+  filter_groups(state, filter);
+}
+BENCHMARK(BM_AmbiguousGeneFilter)->Unit(benchmark::kMillisecond);
+
+void BM_TranscriptFilter(benchmark::State& state) {
+  IdDictionary transcript_ids;
+  TranscriptFilter::load(data.path("transcript_ids.txt"), transcript_ids);
+  TranscriptFilter filter(transcript_ids);
+  filter_groups(state, filter);
+}
+BENCHMARK(BM_TranscriptFilter)->Unit(benchmark::kMillisecond);
+
+void BM_FilterPipeline(benchmark::State& state) {
+  TranscriptGenes transcript_gene;
+  IdDictionary transcript_ids;
+  if (AmbiguousGeneFilter::load(data.path("annotations.gtf"), transcript_gene) != 0) {
+    state.SkipWithError("Unable to load annotations.");
+    return;
+  }
+  TranscriptFilter::load(data.path("transcript_ids.txt"), transcript_ids);
+  ReverseStrandFilter reverse;
+  AmbiguousGeneFilter genes(transcript_gene, data.path("annotations.gtf"));
+  TranscriptFilter transcripts(transcript_ids);
+  const std::vector<const AlignmentStage*> stages = { &reverse, &genes, &transcripts };
+  for (auto _ : state) {
+    if (filter_alignments(stages, data.path("alignments.sam"), data.path("filtered.sam"), (size_t)state.range(0)) != 0) {
+      state.SkipWithError("Filtering failed.");
+      return;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * loaded_alignments().alignments);
+  state.SetBytesProcessed(state.iterations() * data.size("alignments.sam"));
+}
+BENCHMARK(BM_FilterPipeline)->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_TranscriptGenesLoad(benchmark::State& state) {
+  for (auto _ : state) {
+    TranscriptGenes transcript_gene;
+    if (AmbiguousGeneFilter::load(data.path("annotations.gtf"), transcript_gene) != 0) {
+      state.SkipWithError("Unable to load annotations.");
+      return;
+    }
+    benchmark::DoNotOptimize(&transcript_gene);
+  }
+  state.SetItemsProcessed(state.iterations() * annotation_lines().size());
+  state.SetBytesProcessed(state.iterations() * data.size("annotations.gtf"));
+}
+BENCHMARK(BM_TranscriptGenesLoad)->Unit(benchmark::kMillisecond);
+
+void BM_GtfRecordParsing(benchmark::State& state) {
+  const std::vector<std::string>& lines = annotation_lines();
+  GtfRecord record;
+  for (auto _ : state) {
+    for (const std::string& line : lines) {
+      if (record.parse(line) != 0) {
+        state.SkipWithError("Unable to parse annotations.");
+        return;
+      }
+      benchmark::DoNotOptimize(record.start);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * lines.size());
+}
+BENCHMARK(BM_GtfRecordParsing)->Unit(benchmark::kMillisecond);
+
+void BM_PositionCounting(benchmark::State& state) {
+  const LoadedAlignments& loaded = loaded_alignments();
+  // RNAME and POS of all alignments, so only counting is measured
+  std::vector<std::pair<std::string_view, uint64_t>> positions;
+  for (const std::vector<Alignment>& group : loaded.groups) {
+    for (const Alignment& alignment : group) {
+      uint64_t pos = 0;
+      alignment.position(pos);
+      positions.emplace_back(alignment.reference(loaded.header), pos);
+    }
+  }
+  for (auto _ : state) {
+    PositionCounts counts;
+    for (size_t i = 0; i < loaded.header.names.size(); ++i) {
+      counts.add_reference(loaded.header.names[i], loaded.header.lengths[i]);
+    }
+    for (const std::pair<std::string_view, uint64_t>& position : positions) {
+      counts.add(position.first, position.second);
+    }
+    benchmark::DoNotOptimize(&counts);
+  }
+  state.SetItemsProcessed(state.iterations() * positions.size());
+}
+BENCHMARK(BM_PositionCounting)->Unit(benchmark::kMillisecond);
+
+void BM_TranscriptomeProjection(benchmark::State& state) {
+  Transcriptome transcriptome;
+  if (transcriptome.load(data.path("annotations.gtf")) != 0) {
+    state.SkipWithError("Unable to load annotations.");
+    return;
+  }
+  // Random genomic positions within exons
+  std::vector<std::pair<uint32_t, uint64_t>> positions;
+  SyntheticRandom random(7);
+  GtfRecord record;
+  for (const std::string& line : annotation_lines()) {
+    if (record.parse(line) == 0 && record.feature == "exon") {
+      for (int i = 0; i < 4; ++i) {
+        positions.emplace_back(transcriptome.reference(record.seqname), random.between(record.start, record.end));
+      }
+    }
+  }
+  uint64_t projected = 0;
+  for (auto _ : state) {
+    for (const std::pair<uint32_t, uint64_t>& position : positions) {
+      transcriptome.project(position.first, position.second, true, [&projected](const uint32_t, const uint64_t) { ++projected; });
+      transcriptome.project(position.first, position.second, false, [&projected](const uint32_t, const uint64_t) { ++projected; });
+    }
+  }
+  benchmark::DoNotOptimize(projected);
+  state.SetItemsProcessed(state.iterations() * positions.size());
+}
+BENCHMARK(BM_TranscriptomeProjection)->Unit(benchmark::kMillisecond);
+
+void BM_GenomeLoad(benchmark::State& state) {
+  for (auto _ : state) {
+    Genome genome;
+    if (genome.load(data.path("genome.fa")) != 0) {
+      state.SkipWithError("Unable to load the genome.");
+      return;
+    }
+    benchmark::DoNotOptimize(&genome);
+  }
+  state.SetBytesProcessed(state.iterations() * data.size("genome.fa"));
+}
+BENCHMARK(BM_GenomeLoad)->Unit(benchmark::kMillisecond);
+
+void BM_BaseCounting(benchmark::State& state) {
+  Genome genome;
+  if (genome.load(data.path("genome.fa")) != 0) {
+    state.SkipWithError("Unable to load the genome.");
+    return;
+  }
+  std::string buffer;
+  uint64_t bases = 0;
+  for (auto _ : state) {
+    for (size_t i = 0; i < genome.sequence_count(); ++i) {
+      std::string_view sequence = genome.bases(i, 0, genome.length(i), buffer);
+      BaseCounts counts = count_bases(sequence);
+      benchmark::DoNotOptimize(counts);
+      bases += sequence.size();
+    }
+  }
+  state.SetBytesProcessed(bases);
+}
+BENCHMARK(BM_BaseCounting)->Unit(benchmark::kMillisecond);
+
+void BM_KmerCounting(benchmark::State& state) {
+  Genome genome;
+  if (genome.load(data.path("genome.fa")) != 0) {
+    state.SkipWithError("Unable to load the genome.");
+    return;
+  }
+  const size_t k = (size_t)state.range(0), step = (size_t)state.range(1);
+  std::vector<uint32_t> counts((size_t)1 << (2 * k));
+  std::string buffer;
+  uint64_t bases = 0;
+  for (auto _ : state) {
+    for (size_t i = 0; i < genome.sequence_count(); ++i) {
+      std::string_view sequence = genome.bases(i, 0, genome.length(i), buffer);
+      count_kmers(sequence, true, k, step, 0, counts.data());
+      bases += sequence.size();
+    }
+  }
+  benchmark::DoNotOptimize(counts.data());
+  state.SetBytesProcessed(bases);
+}
+BENCHMARK(BM_KmerCounting)->ArgNames({ "k", "step" })->Args({ 1, 1 })->Args({ 4, 1 })->Args({ 3, 3 })->Unit(benchmark::kMillisecond);
+
+}
+
+int main(int argc, char* argv[]) {
+  // Options of the synthetic data set are removed before Google Benchmark parses its own options
+  SyntheticOptions options;
+  std::vector<char*> arguments = { argv[0] };
+  for (int argi = 1; argi < argc; ) {
+    int previous = argi;
+    if (!parse_synthetic_option(argi, argc, argv, options)) {
+      return 1;
+    }
+    if (argi == previous) {
+      arguments.push_back(argv[argi++]);
+    }
+  }
+  int count = (int)arguments.size();
+  benchmark::Initialize(&count, arguments.data());
+  if (benchmark::ReportUnrecognizedArguments(count, arguments.data())) {
+    return 1;
+  }
+  if (!data.create(options)) {
+    return 9;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,475 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef SYNTHETIC_DATA_H
+#define SYNTHETIC_DATA_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <iostream>
+#include "../compressed_io.h"
+#include "../sam_fields.h"
+
+/// <summary>
+/// Parameters of a synthetic Ribo-seq data set; equal parameters (including the seed) always produce equal files.
+/// </summary>
+struct SyntheticOptions {
+  uint64_t seed = 1;
+  size_t chromosomes = 4;
+  size_t genes = 2000;
+  /// <summary>
+  /// Upper bounds of numbers of transcripts of a gene and of exons of a gene (transcripts use subsets of them).
+  /// </summary>
+  size_t max_transcripts = 4;
+  size_t max_exons = 8;
+  /// <summary>
+  /// Fraction of protein coding transcripts; the others have no CDS, start and stop codons.
+  /// </summary>
+  double coding_fraction = 0.8;
+  /// <summary>
+  /// GC content of the genome.
+  /// </summary>
+  double gc = 0.42;
+  uint64_t reads = 200000;
+  /// <summary>
+  /// Fraction of reads with multiple alignments (NH:i:2 to NH:i:max_hits).
+  /// </summary>
+  double multimapping_rate = 0.3;
+  size_t max_hits = 8;
+  /// <summary>
+  /// Fraction of additional alignments of multi-mapped reads to transcripts of other genes (the rest hit transcripts of the same gene).
+  /// </summary>
+  double cross_gene_rate = 0.3;
+  /// <summary>
+  /// Fraction of alignments to the reverse strand.
+  /// </summary>
+  double reverse_fraction = 0.1;
+  uint32_t min_read_length = 26;
+  uint32_t max_read_length = 34;
+  /// <summary>
+  /// Fraction of transcripts in the list of selected transcript_ids.
+  /// </summary>
+  double selected_fraction = 0.5;
+};
+
+/// <summary>
+/// Parses an option of synthetic data ('--reads N', '--genes N', '--multimapping RATE', '--reverse FRACTION' or '--seed N')
+/// if it is the argument at the given position.
+/// </summary>
+/// <param name="argi">Position of the examined argument; it is moved after the option if present.</param>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Arguments.</param>
+/// <param name="options">Parameters of the data set (output).</param>
+/// <returns>FALSE if the option is present, but its value is missing or invalid.</returns>
+inline bool parse_synthetic_option(int& argi, const int argc, char* argv[], SyntheticOptions& options) {
+  if (argi >= argc) {
+    return true;
+  }
+  std::string option(argv[argi]);
+  if (option != "--reads" && option != "--genes" && option != "--multimapping" && option != "--reverse" && option != "--seed") {
+    return true;
+  }
+  if (argi + 1 >= argc) {
+    std::cerr << "Missing value of option '" << option << "'." << std::endl;
+    return false;
+  }
+  std::string_view value(argv[argi + 1]);
+  bool valid;
+  if (option == "--multimapping" || option == "--reverse") {
+    char* end = nullptr;
+    double rate = std::strtod(argv[argi + 1], &end);
+    valid = !value.empty() && *end == '\0' && rate >= 0 && rate <= 1;
+    (option == "--multimapping" ? options.multimapping_rate : options.reverse_fraction) = rate;
+  } else if (option == "--reads") {
+    valid = parse_integer(value, options.reads);
+  } else if (option == "--genes") {
+    valid = parse_integer(value, options.genes) && options.genes > 0;
+  } else {
+    valid = parse_integer(value, options.seed);
+  }
+  if (!valid) {
+    std::cerr << "Invalid value '" << value << "' of option '" << option << "'." << std::endl;
+    return false;
+  }
+  argi += 2;
+  return true;
+}
+
+/// <summary>
+/// Pseudo-random numbers (SplitMix64), which are the same on all platforms unlike the distributions of the standard library.
+/// </summary>
+class SyntheticRandom {
+private:
+  uint64_t state;
+
+public:
+  explicit SyntheticRandom(const uint64_t seed) : state(seed) {}
+
+  inline uint64_t next() {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  /// <summary>
+  /// Uniform number within [0; 1).
+  /// </summary>
+  inline double real() {
+    return (next() >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  /// <summary>
+  /// Uniform integer within [from; to].
+  /// </summary>
+  inline uint64_t between(const uint64_t from, const uint64_t to) {
+    return from + next() % (to - from + 1);
+  }
+
+  inline bool chance(const double probability) {
+    return real() < probability;
+  }
+};
+
+/// <summary>
+/// A synthetic genome with Ensembl-like annotations and NH-grouped alignments of ribosome footprints to the transcriptome (as by STAR --quantMode TranscriptomeSAM).
+/// The model is created in the constructor; files are written on demand.
+/// </summary>
+class SyntheticData {
+private:
+  struct Gene {
+    std::string id;
+    size_t chromosome;
+    bool strand;
+    /// <summary>
+    /// 1-based genomic boundaries [from; to].
+    /// </summary>
+    uint64_t from, to;
+    /// <summary>
+    /// Range of indices of its transcripts.
+    /// </summary>
+    uint32_t first_transcript, transcripts;
+  };
+
+  struct Transcript {
+    std::string id;
+    uint32_t gene;
+    /// <summary>
+    /// 1-based genomic boundaries [from; to] of exons in the direction of the transcript.
+    /// </summary>
+    std::vector<std::pair<uint64_t, uint64_t>> exons;
+    uint64_t length;
+    /// <summary>
+    /// 0-based boundaries [from; to) of the CDS including the stop codon in transcript coordinates; equal for non-coding transcripts.
+    /// </summary>
+    uint64_t cds_from, cds_to;
+
+    inline bool coding() const { return cds_from < cds_to; }
+  };
+
+  SyntheticOptions options;
+  std::vector<std::string> sequences;
+  std::vector<Gene> genes;
+  std::vector<Transcript> transcripts;
+
+  /// <summary>
+  /// Genomic parts of a part [from; to) of a transcript in transcript coordinates: 1-based boundaries [start; end] and the transcript coordinate of the 5' end.
+  /// </summary>
+  static std::vector<std::pair<std::pair<uint64_t, uint64_t>, uint64_t>> project(const Transcript& transcript, const bool strand, const uint64_t from, const uint64_t to) {
+    std::vector<std::pair<std::pair<uint64_t, uint64_t>, uint64_t>> parts;
+    uint64_t offset = 0;
+    for (const std::pair<uint64_t, uint64_t>& exon : transcript.exons) {
+      uint64_t length = exon.second - exon.first + 1;
+      uint64_t part_from = std::max(from, offset), part_to = std::min(to, offset + length);
+      if (part_from < part_to) {
+        std::pair<uint64_t, uint64_t> bounds = strand ? std::pair<uint64_t, uint64_t>(exon.first + (part_from - offset), exon.first + (part_to - offset) - 1)
+          : std::pair<uint64_t, uint64_t>(exon.second - (part_to - offset) + 1, exon.second - (part_from - offset));
+        parts.emplace_back(bounds, part_from);
+      }
+      offset += length;
+    }
+    return parts;
+  }
+
+  static std::string numbered(const char* prefix, const uint64_t number) {
+    char id[32];
+    std::snprintf(id, sizeof(id), "%s%011llu", prefix, (unsigned long long)number);
+    return id;
+  }
+
+  /// <summary>
+  /// STAR-like MAPQ of a read with the given number of alignments.
+  /// </summary>
+  static unsigned mapq(const size_t hits) {
+    return hits == 1 ? 255 : hits == 2 ? 3 : hits <= 4 ? 1 : 0;
+  }
+
+public:
+  explicit SyntheticData(const SyntheticOptions& options) : options(options), sequences(std::max<size_t>(1, options.chromosomes)) {
+    SyntheticRandom random(options.seed);
+    const uint32_t max_read_length = std::max(options.min_read_length, options.max_read_length);
+    // Genes are placed one after another with intergenic gaps
+    std::vector<uint64_t> ends(sequences.size(), 0);
+    for (size_t g = 0; g < options.genes; ++g) {
+      size_t chromosome = g % sequences.size();
+      Gene gene{ numbered("ENSG", g + 1), chromosome, random.chance(0.5), 0, 0, (uint32_t)transcripts.size(), 0 };
+      // Exons of the gene in the genomic order
+      std::vector<std::pair<uint64_t, uint64_t>> exons;
+      uint64_t position = ends[chromosome] + random.between(1000, 20000);
+      size_t exon_count = (size_t)random.between(1, std::max<size_t>(1, options.max_exons));
+      for (size_t e = 0; e < exon_count; ++e) {
+        uint64_t length = random.between(std::max<uint64_t>(60, max_read_length), 400);
+        exons.emplace_back(position, position + length - 1);
+        position += length + random.between(100, 3000);
+      }
+      gene.from = exons.front().first;
+      gene.to = exons.back().second;
+      ends[chromosome] = gene.to;
+      size_t transcript_count = (size_t)random.between(1, std::max<size_t>(1, options.max_transcripts));
+      for (size_t t = 0; t < transcript_count; ++t) {
+        Transcript transcript{ numbered("ENST", transcripts.size() + 1), (uint32_t)genes.size(), {}, 0, 0, 0 };
+        // A contiguous range of exons of the gene, internal ones are skipped sometimes (alternative splicing)
+        size_t first = (size_t)random.between(0, exons.size() - 1), last = (size_t)random.between(first, exons.size() - 1);
+        for (size_t e = first; e <= last; ++e) {
+          if (e == first || e == last || !random.chance(0.2)) {
+            transcript.exons.push_back(exons[e]);
+            transcript.length += exons[e].second - exons[e].first + 1;
+          }
+        }
+        if (!gene.strand) {
+          std::reverse(transcript.exons.begin(), transcript.exons.end());
+        }
+        if (random.chance(options.coding_fraction)) {
+          uint64_t utr5 = random.between(0, std::min<uint64_t>(200, transcript.length / 4));
+          uint64_t utr3 = random.between(0, std::min<uint64_t>(300, transcript.length / 4));
+          uint64_t cds = (transcript.length - utr5 - utr3) / 3 * 3;
+          if (cds >= 9) {
+            transcript.cds_from = utr5;
+            transcript.cds_to = utr5 + cds;
+          }
+        }
+        transcripts.push_back(std::move(transcript));
+      }
+      gene.transcripts = (uint32_t)transcript_count;
+      genes.push_back(std::move(gene));
+    }
+    // Bases with the given GC content (not soft-masked as by Ensembl 'dna' files) and Ns at the start of chromosomes (before the first gene)
+    for (size_t c = 0; c < sequences.size(); ++c) {
+      std::string& sequence = sequences[c];
+      sequence.resize(ends[c] + random.between(1000, 20000));
+      for (size_t i = 0; i < sequence.size(); ++i) {
+        sequence[i] = random.chance(options.gc) ? "CG"[random.next() & 1] : "AT"[random.next() & 1];
+      }
+      std::fill_n(sequence.begin(), std::min<size_t>(500, sequence.size()), 'N');
+    }
+  }
+
+  inline size_t transcript_count() const { return transcripts.size(); }
+
+  /// <summary>
+  /// Writes the genome in FASTA format with 60 bases per line.
+  /// </summary>
+  /// <returns>FALSE if the file could not be written.</returns>
+  bool write_genome(const std::string& filename) const {
+    OutputFile output;
+    if (!output.open(filename, OutputFile::Compression::AUTO)) {
+      return false;
+    }
+    for (size_t c = 0; c < sequences.size(); ++c) {
+      output.write(">" + std::to_string(c + 1) + " dna:chromosome chromosome:GRCh38:" + std::to_string(c + 1) + ":1:" + std::to_string(sequences[c].size()) + ":1 REF\n");
+      for (size_t i = 0; i < sequences[c].size(); i += 60) {
+        output.write(sequences[c].data() + i, std::min<size_t>(60, sequences[c].size() - i));
+        output.put('\n');
+      }
+    }
+    return output.close();
+  }
+
+  /// <summary>
+  /// Writes annotations in the GTF format of Ensembl: genes, transcripts, exons, CDSs without stop codons, start and stop codons (split across exons
+  /// if needed) and UTRs.
+  /// </summary>
+  /// <returns>FALSE if the file could not be written.</returns>
+  bool write_annotations(const std::string& filename) const {
+    OutputFile output;
+    if (!output.open(filename, OutputFile::Compression::AUTO)) {
+      return false;
+    }
+    output.write("#!genome-build GRCh38.p14\n#!genome-version GRCh38\n#!genebuild-last-updated 2026-10\n");
+    std::string line;
+    auto print = [&](const Gene& gene, const char* feature, const uint64_t from, const uint64_t to, const char phase, const std::string& attributes) {
+      line.clear();
+      line += std::to_string(gene.chromosome + 1);
+      line += "\tensembl\t";
+      line += feature;
+      line += '\t';
+      line += std::to_string(from);
+      line += '\t';
+      line += std::to_string(to);
+      line += "\t.\t";
+      line += gene.strand ? '+' : '-';
+      line += '\t';
+      line += phase;
+      line += '\t';
+      line += attributes;
+      line += '\n';
+      output.write(line);
+    };
+    for (size_t g = 0; g < genes.size(); ++g) {
+      const Gene& gene = genes[g];
+      bool coding = false;
+      for (uint32_t t = gene.first_transcript; t < gene.first_transcript + gene.transcripts; ++t) {
+        coding = coding || transcripts[t].coding();
+      }
+      std::string gene_attributes = "gene_id \"" + gene.id + "\"; gene_version \"" + std::to_string(g % 9 + 1) + "\"; gene_name \"G" + std::to_string(g + 1) + "\"; gene_source \"ensembl\"; gene_biotype \"" + (coding ? "protein_coding" : "lncRNA") + "\";";
+      print(gene, "gene", gene.from, gene.to, '.', gene_attributes);
+      for (uint32_t t = gene.first_transcript; t < gene.first_transcript + gene.transcripts; ++t) {
+        const Transcript& transcript = transcripts[t];
+        std::string attributes = "gene_id \"" + gene.id + "\"; gene_version \"" + std::to_string(g % 9 + 1) + "\"; transcript_id \"" + transcript.id + "\"; transcript_version \"" + std::to_string(t % 5 + 1)
+          + "\"; gene_name \"G" + std::to_string(g + 1) + "\"; gene_source \"ensembl\"; gene_biotype \"" + (coding ? "protein_coding" : "lncRNA") + "\"; transcript_name \"G" + std::to_string(g + 1) + "-"
+          + std::to_string(201 + t - gene.first_transcript) + "\"; transcript_source \"ensembl\"; transcript_biotype \"" + (transcript.coding() ? "protein_coding" : "lncRNA") + "\";";
+        uint64_t first = transcript.exons.front().first, last = transcript.exons.back().second;
+        print(gene, "transcript", std::min(first, last), std::max(first, last), '.', attributes + " tag \"basic\";");
+        std::string protein = "; protein_id \"" + numbered("ENSP", t + 1) + "\"; protein_version \"1\";";
+        uint64_t offset = 0;
+        for (size_t e = 0; e < transcript.exons.size(); ++e) {
+          const std::pair<uint64_t, uint64_t>& exon = transcript.exons[e];
+          uint64_t length = exon.second - exon.first + 1;
+          std::string exon_attributes = attributes.substr(0, attributes.size() - 1) + "; exon_number \"" + std::to_string(e + 1) + "\"; exon_id \"" + numbered("ENSE", t * 64 + e + 1) + "\"; exon_version \"1\";";
+          print(gene, "exon", exon.first, exon.second, '.', exon_attributes);
+          if (transcript.coding()) {
+            const std::string coding_attributes = exon_attributes.substr(0, exon_attributes.size() - 1) + protein;
+            // Parts of the CDS (without the stop codon), start and stop codons within this exon
+            const std::pair<const char*, std::pair<uint64_t, uint64_t>> features[] = {
+              { "CDS", { transcript.cds_from, transcript.cds_to - 3 } }, { "start_codon", { transcript.cds_from, transcript.cds_from + 3 } }, { "stop_codon", { transcript.cds_to - 3, transcript.cds_to } }
+            };
+            for (const auto& feature : features) {
+              uint64_t from = std::max(feature.second.first, offset), to = std::min(feature.second.second, offset + length);
+              for (const auto& part : project(transcript, gene.strand, from, to)) {
+                char phase = (char)('0' + (3 - (part.second - feature.second.first) % 3) % 3);
+                print(gene, feature.first, part.first.first, part.first.second, phase, feature.first[0] == 'C' ? coding_attributes : exon_attributes);
+              }
+            }
+          }
+          offset += length;
+        }
+        if (transcript.coding()) {
+          for (const auto& part : project(transcript, gene.strand, 0, transcript.cds_from)) {
+            print(gene, "five_prime_utr", part.first.first, part.first.second, '.', attributes);
+          }
+          for (const auto& part : project(transcript, gene.strand, transcript.cds_to, transcript.length)) {
+            print(gene, "three_prime_utr", part.first.first, part.first.second, '.', attributes);
+          }
+        }
+      }
+    }
+    return output.close();
+  }
+
+  /// <summary>
+  /// Writes alignments of reads to transcripts in SAM format; all alignments of a read are adjacent, the first one is primary, and they have
+  /// STAR-like MAPQ, NH:i:Nmap, HI:i:I, AS:i and nM:i fields.
+  /// </summary>
+  /// <returns>FALSE if the file could not be written.</returns>
+  bool write_alignments(const std::string& filename) const {
+    OutputFile output;
+    if (!output.open(filename, OutputFile::Compression::AUTO)) {
+      return false;
+    }
+    SyntheticRandom random(options.seed ^ 0x5A4D);
+    std::string line = "@HD\tVN:1.4\tSO:unsorted\n";
+    for (const Transcript& transcript : transcripts) {
+      line += "@SQ\tSN:" + transcript.id + "\tLN:" + std::to_string(transcript.length) + '\n';
+    }
+    line += "@PG\tID:STAR\tPN:STAR\tVN:2.7.10b\tCL:STAR --quantMode TranscriptomeSAM --outFilterMultimapNmax " + std::to_string(options.max_hits) + '\n';
+    output.write(line);
+    // Transcripts ordered by a random expression level; reads come mostly from the first ones
+    std::vector<uint32_t> expression(transcripts.size());
+    for (uint32_t t = 0; t < expression.size(); ++t) {
+      expression[t] = t;
+    }
+    for (size_t i = expression.size(); i > 1; --i) {
+      std::swap(expression[i - 1], expression[(size_t)random.between(0, i - 1)]);
+    }
+    std::string sequence, qualities;
+    for (uint64_t read = 0; read < options.reads && !transcripts.empty(); ++read) {
+      uint32_t length = (uint32_t)random.between(options.min_read_length, std::max(options.min_read_length, options.max_read_length));
+      sequence.resize(length);
+      qualities.resize(length);
+      for (uint32_t i = 0; i < length; ++i) {
+        sequence[i] = "ACGT"[random.next() & 3];
+        qualities[i] = (char)random.between('#', 'I');
+      }
+      size_t hits = options.max_hits > 1 && random.chance(options.multimapping_rate) ? (size_t)random.between(2, options.max_hits) : 1;
+      double level = random.real();
+      uint32_t target = expression[(size_t)(level * level * expression.size())];
+      std::string name = "SRR" + std::to_string(1000000 + read % 9000000) + "." + std::to_string(read + 1);
+      for (size_t hit = 0; hit < hits; ++hit) {
+        if (hit > 0) {
+          const Gene& gene = genes[transcripts[target].gene];
+          target = random.chance(options.cross_gene_rate) ? (uint32_t)random.between(0, transcripts.size() - 1) : gene.first_transcript + (uint32_t)random.between(0, gene.transcripts - 1);
+        }
+        const Transcript& transcript = transcripts[target];
+        bool reverse = random.chance(options.reverse_fraction);
+        unsigned flag = (reverse ? 16 : 0) | (hit > 0 ? 256 : 0);
+        uint64_t position = random.between(1, transcript.length - std::min<uint64_t>(length, transcript.length) + 1);
+        unsigned mismatches = random.chance(0.15) ? 1 : 0;
+        line = name;
+        line += '\t' + std::to_string(flag) + '\t' + transcript.id + '\t' + std::to_string(position) + '\t' + std::to_string(mapq(hits)) + '\t' + std::to_string(length) + "M\t*\t0\t0\t";
+        line += sequence;
+        line += '\t';
+        line += qualities;
+        line += "\tNH:i:" + std::to_string(hits) + "\tHI:i:" + std::to_string(hit + 1) + "\tAS:i:" + std::to_string(length - 1 - 2 * mismatches) + "\tnM:i:" + std::to_string(mismatches) + '\n';
+        output.write(line);
+      }
+    }
+    return output.close();
+  }
+
+  /// <summary>
+  /// Writes a random subset of transcript_ids (one per line) for select_transcripts.
+  /// </summary>
+  /// <returns>FALSE if the file could not be written.</returns>
+  bool write_transcript_ids(const std::string& filename) const {
+    OutputFile output;
+    if (!output.open(filename, OutputFile::Compression::AUTO)) {
+      return false;
+    }
+    SyntheticRandom random(options.seed ^ 0x1D5);
+    for (const Transcript& transcript : transcripts) {
+      if (random.chance(options.selected_fraction)) {
+        output.write(transcript.id);
+        output.put('\n');
+      }
+    }
+    return output.close();
+  }
+
+  /// <summary>
+  /// Writes ranges of CDSs '[transcript_id]\t[from]\t[to]' (1-based [from; to)), or lengths of non-coding transcripts, for region_readcounts.
+  /// </summary>
+  /// <returns>FALSE if the file could not be written.</returns>
+  bool write_ranges(const std::string& filename) const {
+    OutputFile output;
+    if (!output.open(filename, OutputFile::Compression::AUTO)) {
+      return false;
+    }
+    for (const Transcript& transcript : transcripts) {
+      if (transcript.coding()) {
+        output.write(transcript.id + '\t' + std::to_string(transcript.cds_from + 1) + '\t' + std::to_string(transcript.cds_to + 1) + '\n');
+      } else {
+        output.write(transcript.id + '\t' + std::to_string(transcript.length) + '\n');
+      }
+    }
+    return output.close();
+  }
+};
+
+#endif
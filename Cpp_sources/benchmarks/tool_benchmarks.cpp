@@ -0,0 +1,177 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+// End-to-end benchmarks running the built tools (or tools from '--tools DIR', e.g. a previous release) on a synthetic data set.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include "../compressed_io.h"
+#include "benchmark_data.h"
+
+extern char** environ;
+
+namespace {
+
+BenchmarkData data;
+/// <summary>
+/// Directory with the benchmarked tools.
+/// </summary>
+std::string tools = TOOLS_DIRECTORY;
+
+/// <summary>
+/// Runs a tool with standard output redirected into a file of the data set and standard error output into 'stderr.txt'.
+/// </summary>
+/// <param name="arguments">Name of the tool and its arguments; names of files of the data set are given by '@name'.</param>
+/// <param name="output">Name of the file for the standard output.</param>
+/// <returns>Exit code of the tool, or -1 if it could not be started.</returns>
+int run(const std::vector<std::string>& arguments, const std::string& output) {
+  std::vector<std::string> expanded;
+  for (const std::string& argument : arguments) {
+    expanded.push_back(argument[0] == '@' ? data.path(argument.substr(1)) : argument);
+  }
+  expanded[0] = tools + '/' + arguments[0];
+  std::vector<char*> argv;
+  for (std::string& argument : expanded) {
+    argv.push_back(&argument[0]);
+  }
+  argv.push_back(nullptr);
+  const std::string output_name = data.path(output), errors = data.path("stderr.txt");
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, 1, output_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  posix_spawn_file_actions_addopen(&actions, 2, errors.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  pid_t pid;
+  int error = posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (error != 0) {
+    std::cerr << "Unable to run '" << argv[0] << "'." << std::endl;
+    return -1;
+  }
+  int status;
+  if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+    return -1;
+  }
+  return WEXITSTATUS(status);
+}
+
+/// <summary>
+/// Number of alignments of the data set.
+/// </summary>
+uint64_t alignments = 0;
+
+/// <summary>
+/// Registers a benchmark of a tool; alignments are reported as processed items if the tool reads them.
+/// </summary>
+/// <param name="name">Name of the benchmark.</param>
+/// <param name="arguments">Arguments of run.</param>
+/// <param name="input">Name of the main input file, whose size is reported as processed bytes.</param>
+void add(const std::string& name, const std::vector<std::string>& arguments, const std::string& input) {
+  benchmark::RegisterBenchmark(name.c_str(), [arguments, input](benchmark::State& state) {
+    for (auto _ : state) {
+      int error = run(arguments, "stdout.txt");
+      if (error != 0) {
+        state.SkipWithError(("The tool failed with code " + std::to_string(error) + ", see '" + data.path("stderr.txt") + "'.").c_str());
+        return;
+      }
+    }
+    if (input == "alignments.sam") {
+      state.SetItemsProcessed(state.iterations() * alignments);
+    }
+    state.SetBytesProcessed(state.iterations() * data.size(input));
+  })->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+
+/// <summary>
+/// Registers benchmarks of all tools, once the data set and derived inputs (counts, packed genome and annotation index) are ready.
+/// </summary>
+/// <returns>FALSE if a derived input could not be created.</returns>
+bool register_benchmarks() {
+  InputFile input;
+  if (!input.open(data.path("alignments.sam"))) {
+    return false;
+  }
+  for (std::string line; input.getline(line); ) {
+    alignments += line[0] != '@';
+  }
+  if (run({ "read_counts", "@alignments.sam" }, "counts.tsv") != 0 || run({ "read_counts", "--binary", "@alignments.sam" }, "counts.bin") != 0
+    || run({ "transcripts_startstop_positions", "@annotations.gtf" }, "positions.tsv") != 0 || run({ "pack_genome", "@genome.fa", "@genome.packed" }, "stdout.txt") != 0
+    || run({ "compile_annotations", "@annotations.gtf", "@annotations.index" }, "stdout.txt") != 0) {
+    std::cerr << "Unable to prepare inputs of benchmarks by tools in '" << tools << "', see '" << data.path("stderr.txt") << "'." << std::endl;
+    return false;
+  }
+  add("filter_reverse_reads", { "filter_reverse_reads", "@alignments.sam", "@filtered.sam" }, "alignments.sam");
+  add("filter_reverse_reads/bam", { "filter_reverse_reads", "@alignments.sam", "@filtered.bam" }, "alignments.sam");
+  add("filter_ambiguous_genes", { "filter_ambiguous_genes", "@annotations.gtf", "@alignments.sam", "@filtered.sam" }, "alignments.sam");
+  add("filter_ambiguous_genes/index", { "filter_ambiguous_genes", "@annotations.index", "@alignments.sam", "@filtered.sam" }, "alignments.sam");
+  add("select_transcripts", { "select_transcripts", "@transcript_ids.txt", "@alignments.sam", "@filtered.sam" }, "alignments.sam");
+  // The three filters in a single pass, compared to a chain of the single filters below
+  for (const char* threads : { "1", "4" }) {
+    add(std::string("filter_alignments/threads:") + threads, { "filter_alignments", "--threads", threads, "--reverse", "--genes", "@annotations.gtf",
+      "--transcripts", "@transcript_ids.txt", "@alignments.sam", "@filtered.sam" }, "alignments.sam");
+  }
+  benchmark::RegisterBenchmark("filter_chain", [](benchmark::State& state) {
+    for (auto _ : state) {
+      if (run({ "filter_reverse_reads", "@alignments.sam", "@chain1.sam" }, "stdout.txt") != 0 || run({ "filter_ambiguous_genes", "@annotations.gtf", "@chain1.sam", "@chain2.sam" }, "stdout.txt") != 0
+        || run({ "select_transcripts", "@transcript_ids.txt", "@chain2.sam", "@chain3.sam" }, "stdout.txt") != 0) {
+        state.SkipWithError("A filter failed.");
+        return;
+      }
+    }
+    state.SetItemsProcessed(state.iterations() * alignments);
+  })->Unit(benchmark::kMillisecond)->UseRealTime();
+  for (const char* threads : { "1", "4" }) {
+    add(std::string("read_counts/threads:") + threads, { "read_counts", "--threads", threads, "@alignments.sam" }, "alignments.sam");
+  }
+  add("read_counts/binary", { "read_counts", "--binary", "@alignments.sam" }, "alignments.sam");
+  add("region_readcounts", { "region_readcounts", "@ranges.tsv", "@counts.tsv" }, "counts.tsv");
+  add("region_readcounts/binary", { "region_readcounts", "@ranges.tsv", "@counts.bin" }, "counts.bin");
+  for (const char* threads : { "1", "4" }) {
+    add(std::string("gc_content/threads:") + threads, { "gc_content", "--threads", threads, "@genome.fa", "@annotations.gtf" }, "genome.fa");
+  }
+  add("gc_content/packed_index", { "gc_content", "@genome.packed", "@annotations.index" }, "genome.packed");
+  add("gc_content/codons_windows", { "gc_content", "--codons", "--windows", "@positions.tsv", "30", "@genome.fa", "@annotations.gtf" }, "genome.fa");
+  add("transcripts_startstop_positions", { "transcripts_startstop_positions", "@annotations.gtf" }, "annotations.gtf");
+  add("transcripts_startstop_positions/index", { "transcripts_startstop_positions", "@annotations.index" }, "annotations.index");
+  return true;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  // Options of the synthetic data set and '--tools DIR' are removed before Google Benchmark parses its own options
+  SyntheticOptions options;
+  std::vector<char*> arguments = { argv[0] };
+  for (int argi = 1; argi < argc; ) {
+    int previous = argi;
+    if (!parse_synthetic_option(argi, argc, argv, options)) {
+      return 1;
+    }
+    if (argi != previous) {
+      continue;
+    }
+    if (std::string(argv[argi]) == "--tools" && argi + 1 < argc) {
+      tools = argv[argi + 1];
+      argi += 2;
+    } else {
+      arguments.push_back(argv[argi++]);
+    }
+  }
+  int count = (int)arguments.size();
+  benchmark::Initialize(&count, arguments.data());
+  if (benchmark::ReportUnrecognizedArguments(count, arguments.data())) {
+    return 1;
+  }
+  if (!data.create(options) || !register_benchmarks()) {
+    return 9;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,170 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+#include "annotation_index.h"
+#include "compressed_io.h"
+#include "id_dictionary.h"
+#include "run_stats.h"
+
+/// <summary>
+/// Output of the annotation index with tracking of the current offset.
+/// </summary>
+class IndexOutput {
+private:
+  OutputFile& output;
+  uint64_t offset = 0;
+
+public:
+  IndexOutput(OutputFile& output) : output(output) {}
+
+  inline uint64_t position() const { return offset; }
+
+  inline void write(const void* data, const size_t size) {
+    output.write((const char*)data, size);
+    offset += size;
+  }
+
+  /// <summary>
+  /// Pads the output by zeros to a multiple of 8 bytes.
+  /// </summary>
+  inline void align() {
+    static const char zeros[8] = { 0 };
+    write(zeros, (8 - offset % 8) % 8);
+  }
+
+  /// <summary>
+  /// Writes an aligned section of items.
+  /// </summary>
+  /// <returns>Offset of the section.</returns>
+  template <typename T>
+  uint64_t write_section(const std::vector<T>& items) {
+    align();
+    uint64_t start = offset;
+    write(items.data(), items.size() * sizeof(T));
+    return start;
+  }
+};
+
+int main(int argc, char* argv[]) {
+  int argi = 1;
+  if (!parse_stats(argi, argc, argv)) {
+    return 1;
+  }
+  if (argc != argi + 2) {
+    std::cout << "compile_annotations [--stats | --stats-json FILE] <annotations> <index>\t Parses <annotations> in GTF format (optionally gzip-compressed) once and writes\n";
+    std::cout << "                                         \t them into <index> in a binary format with interned seqnames, features, gene_ids\n";
+    std::cout << "                                         \t and transcript_ids, and columns of records, which is mapped into memory instead of\n";
+    std::cout << "                                         \t parsing the GTF file by gc_content, filter_ambiguous_genes, filter_alignments,\n";
+    std::cout << "                                         \t transcripts_startstop_positions, mane2ensembl_gtf and read_counts.\n";
+    print_stats_usage("                                         \t ");
+    std::cout << "Created by Jan Jelínek (jan.jelinek@biomed.cas.cz); last update: 2026-10-14; license: Apache License 2.0" << std::endl;
+    return (argc == 1) ? 0 : 1;
+  }
+
+  RunStats& stats = RunStats::global();
+  stats.start("parsing");
+  InputFile input;
+  if (!input.open(argv[argi])) {
+    return 9;
+  }
+  OutputFile file;
+  if (!file.open(argv[argi + 1])) {
+    return 9;
+  }
+  IndexOutput output(file);
+  output.write(annotation_format::MAGIC, annotation_format::HEADER_SIZE);
+
+  // Interned seqnames, sources, features, scores, gene_ids and transcript_ids
+  IdDictionary dictionaries[annotation_format::DICTIONARIES];
+  // Columns of records
+  std::vector<uint32_t> ids[4], genes, transcripts;
+  std::vector<uint64_t> starts, ends, attributes, attributes_lengths, comments;
+  std::vector<uint8_t> strands, phases;
+  GtfRecord record;
+  for (std::string line; input.getline(line); ) {
+    if (line.empty()) {
+      std::cerr << "Unexpected empty line within annotations file '" << argv[argi] << "'." << std::endl;
+      return 4;
+    }
+    if (line[0] == '#') { // Comments are kept with their position
+      comments.push_back(starts.size());
+      comments.push_back(output.position());
+      comments.push_back(line.size());
+      output.write(line.data(), line.size());
+      continue;
+    }
+    int error = record.parse(line);
+    if (error != 0) {
+      return error;
+    }
+    const std::string_view values[] = { record.seqname, record.source, record.feature, record.score };
+    for (size_t i = 0; i < 4; ++i) {
+      ids[i].push_back(dictionaries[i].insert(values[i]));
+    }
+    genes.push_back(record.gene_id.empty() ? AnnotationIndex::NONE : dictionaries[annotation_format::GENES].insert(record.gene_id));
+    transcripts.push_back(record.transcript_id.empty() ? AnnotationIndex::NONE : dictionaries[annotation_format::TRANSCRIPTS].insert(record.transcript_id));
+    starts.push_back(record.start);
+    ends.push_back(record.end);
+    strands.push_back((uint8_t)record.strand);
+    phases.push_back((uint8_t)record.phase);
+    attributes.push_back(output.position());
+    attributes_lengths.push_back(record.attributes.size());
+    output.write(record.attributes.data(), record.attributes.size());
+  }
+  if (input.failed()) {
+    return 10;
+  }
+  stats.stop(starts.size() + comments.size() / 3);
+
+  stats.start("index output");
+
+  // Offsets and numbers of items of sections
+  uint64_t sections[annotation_format::SECTIONS][2];
+  for (size_t i = 0; i < annotation_format::DICTIONARIES; ++i) {
+    std::vector<uint64_t> name_starts;
+    for (uint32_t id = 0; id < dictionaries[i].size(); ++id) {
+      std::string_view name = dictionaries[i].name(id);
+      name_starts.push_back(output.position());
+      output.write(name.data(), name.size());
+    }
+    name_starts.push_back(output.position());
+    sections[i][0] = output.write_section(name_starts);
+    sections[i][1] = dictionaries[i].size();
+  }
+  for (size_t i = 0; i < 4; ++i) {
+    sections[annotation_format::SEQNAME + i][0] = output.write_section(ids[i]);
+  }
+  sections[annotation_format::START][0] = output.write_section(starts);
+  sections[annotation_format::END][0] = output.write_section(ends);
+  sections[annotation_format::STRAND][0] = output.write_section(strands);
+  sections[annotation_format::PHASE][0] = output.write_section(phases);
+  sections[annotation_format::GENE][0] = output.write_section(genes);
+  sections[annotation_format::TRANSCRIPT][0] = output.write_section(transcripts);
+  sections[annotation_format::ATTRIBUTES][0] = output.write_section(attributes);
+  sections[annotation_format::ATTRIBUTES_LENGTH][0] = output.write_section(attributes_lengths);
+  for (size_t i = annotation_format::SEQNAME; i < annotation_format::COMMENTS; ++i) {
+    sections[i][1] = starts.size();
+  }
+  sections[annotation_format::COMMENTS][0] = output.write_section(comments);
+  sections[annotation_format::COMMENTS][1] = comments.size() / 3;
+  output.align();
+  output.write(sections, sizeof(sections));
+  uint64_t count = annotation_format::SECTIONS;
+  output.write(&count, sizeof(count));
+  if (!file.close()) {
+    return 9;
+  }
+  stats.stop();
+  stats.add("records", starts.size());
+  stats.add("comments", comments.size() / 3);
+  stats.add("gene_ids", dictionaries[annotation_format::GENES].size());
+  stats.add("transcript_ids", dictionaries[annotation_format::TRANSCRIPTS].size());
+  stats.add("index_bytes", output.position());
+  return stats.report() ? 0 : 9;
+}
@@ -0,0 +1,860 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef COMPRESSED_IO_H
+#define COMPRESSED_IO_H
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <zlib.h>
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+#include "parallel.h"
+
+/// <summary>
+/// BGZF format (blocked gzip used by BAM files): a series of gzip members of at most 64 kB with the total size in the 'BC' extra subfield.
+/// </summary>
+namespace bgzf {
+  /// <summary>
+  /// Size of the header (including the extra subfield) and of the footer (CRC32 and the uncompressed size).
+  /// </summary>
+  constexpr size_t HEADER_SIZE = 18;
+  constexpr size_t FOOTER_SIZE = 8;
+  /// <summary>
+  /// Maximal size of uncompressed data within a single block.
+  /// </summary>
+  constexpr size_t MAX_DATA = 65536;
+  /// <summary>
+  /// Size of uncompressed data within written blocks.
+  /// </summary>
+  constexpr size_t BLOCK_DATA = 0xff00;
+
+  /// <summary>
+  /// Whether data start with a header of a BGZF block.
+  /// </summary>
+  inline bool is_header(const unsigned char* data, const size_t size) {
+    return size >= HEADER_SIZE && data[0] == 0x1f && data[1] == 0x8b && data[2] == 8 && (data[3] & 4) != 0
+      && data[10] == 6 && data[11] == 0 && data[12] == 'B' && data[13] == 'C' && data[14] == 2 && data[15] == 0;
+  }
+
+  /// <summary>
+  /// Size of a whole block given by its header.
+  /// </summary>
+  inline size_t block_size(const unsigned char* header) {
+    return ((size_t)header[16] | ((size_t)header[17] << 8)) + 1;
+  }
+
+  /// <summary>
+  /// Reads a little-endian 32-bit integer of a footer.
+  /// </summary>
+  inline uint32_t footer_value(const unsigned char* data) {
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+  }
+
+  /// <summary>
+  /// Compresses data into a single block.
+  /// </summary>
+  /// <param name="data">Data of at most BLOCK_DATA bytes.</param>
+  /// <param name="size">Length of the data.</param>
+  /// <param name="level">Compression level of zlib.</param>
+  /// <param name="block">The whole block (output).</param>
+  /// <returns>FALSE if the compression failed.</returns>
+  inline bool compress(const char* data, const size_t size, const int level, std::vector<unsigned char>& block) {
+    block.resize(compressBound((uLong)size) + HEADER_SIZE + FOOTER_SIZE);
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      return false;
+    }
+    stream.next_in = (Bytef*)data;
+    stream.avail_in = (uInt)size;
+    stream.next_out = block.data() + HEADER_SIZE;
+    stream.avail_out = (uInt)(block.size() - HEADER_SIZE - FOOTER_SIZE);
+    int status = deflate(&stream, Z_FINISH);
+    size_t deflated = stream.total_out;
+    deflateEnd(&stream);
+    if (status != Z_STREAM_END) {
+      return false;
+    }
+    size_t total = deflated + HEADER_SIZE + FOOTER_SIZE;
+    // Gzip header with the 'BC' extra subfield holding the total block size minus 1
+    static const unsigned char header[] = { 0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0 };
+    std::memcpy(block.data(), header, sizeof(header));
+    block[16] = (unsigned char)((total - 1) & 0xff);
+    block[17] = (unsigned char)((total - 1) >> 8);
+    uint32_t crc = (uint32_t)crc32(crc32(0, Z_NULL, 0), (const Bytef*)data, (uInt)size);
+    unsigned char* footer = block.data() + HEADER_SIZE + deflated;
+    for (size_t i = 0; i < 4; ++i) {
+      footer[i] = (unsigned char)(crc >> (8 * i));
+      footer[4 + i] = (unsigned char)((uint32_t)size >> (8 * i));
+    }
+    block.resize(total);
+    return true;
+  }
+}
+
+/// <summary>
+/// Input file that is transparently decompressed if it is in gzip format (including BGZF used by BAM files, which is a series of gzip members),
+/// or in zstd format (only if compiled with USE_ZSTD defined and linked with libzstd).
+/// BGZF blocks are decompressed by multiple threads if allowed by set_threads().
+/// </summary>
+class InputFile {
+public:
+  enum class Format { PLAIN, GZIP, BGZF, ZSTD };
+
+private:
+  /// <summary>
+  /// Number of BGZF blocks decompressed at once by a single thread.
+  /// </summary>
+  static const size_t BLOCKS_PER_THREAD = 16;
+
+  FILE* file;
+  std::string path;
+  z_stream stream;
+  Format format;
+  size_t threads;
+  bool finished;
+  bool error;
+  std::vector<unsigned char> raw;
+  std::vector<char> buffer;
+  size_t buffer_from;
+  size_t buffer_to;
+  /// <summary>
+  /// Whole BGZF blocks read at once, their starts and starts of their data within the buffer.
+  /// </summary>
+  std::vector<unsigned char> blocks;
+  std::vector<size_t> block_starts, data_starts;
+  /// <summary>
+  /// Decompression streams reused by blocks with the same index within the batch; zlib keeps their addresses, so they must not move.
+  /// </summary>
+  std::deque<z_stream> inflaters;
+#ifdef USE_ZSTD
+  ZSTD_DStream* zstd_stream = nullptr;
+  ZSTD_inBuffer zstd_input = { nullptr, 0, 0 };
+  /// <summary>
+  /// Hint of zstd, 0 if the last frame is complete.
+  /// </summary>
+  size_t zstd_pending = 0;
+#endif
+
+  /// <summary>
+  /// Reads next piece of the raw file into the raw buffer.
+  /// </summary>
+  /// <returns>Number of read bytes.</returns>
+  size_t fill_raw() {
+    size_t size = std::fread(raw.data(), 1, raw.size(), file);
+    stream.next_in = raw.data();
+    stream.avail_in = (uInt)size;
+    return size;
+  }
+
+  /// <summary>
+  /// Reads raw bytes, that are available in the raw buffer first.
+  /// </summary>
+  /// <returns>Number of read bytes; less than size only at the end of the file.</returns>
+  size_t read_raw(unsigned char* data, const size_t size) {
+    size_t done = std::min<size_t>(size, stream.avail_in);
+    std::memcpy(data, stream.next_in, done);
+    stream.next_in += done;
+    stream.avail_in -= (uInt)done;
+    if (done < size) {
+      done += std::fread(data + done, 1, size - done, file);
+    }
+    return done;
+  }
+
+  /// <summary>
+  /// Reports corrupted data.
+  /// </summary>
+  bool corrupted() {
+    std::cerr << "Corrupted compressed data within file '" << path << "'." << std::endl;
+    error = true;
+    return false;
+  }
+
+  /// <summary>
+  /// Reports an incomplete file.
+  /// </summary>
+  bool truncated() {
+    std::cerr << "Unexpected end of compressed file '" << path << "'." << std::endl;
+    error = true;
+    return false;
+  }
+
+  /// <summary>
+  /// Reads a batch of BGZF blocks and decompresses them in parallel into the buffer.
+  /// </summary>
+  /// <returns>FALSE if no more data are available.</returns>
+  bool fill_blocks() {
+    while (buffer_to == 0) {
+      blocks.clear();
+      block_starts.clear();
+      data_starts.assign(1, 0);
+      while (block_starts.size() < threads * BLOCKS_PER_THREAD) {
+        size_t start = blocks.size();
+        blocks.resize(start + bgzf::HEADER_SIZE);
+        size_t size = read_raw(blocks.data() + start, bgzf::HEADER_SIZE);
+        if (size == 0) {
+          blocks.resize(start);
+          break;
+        }
+        if (size < bgzf::HEADER_SIZE) {
+          return truncated();
+        }
+        if (!bgzf::is_header(blocks.data() + start, size)) {
+          std::cerr << "Unexpected gzip member that is not a BGZF block within file '" << path << "'." << std::endl;
+          error = true;
+          return false;
+        }
+        size_t total = bgzf::block_size(blocks.data() + start);
+        if (total < bgzf::HEADER_SIZE + bgzf::FOOTER_SIZE) {
+          return corrupted();
+        }
+        blocks.resize(start + total);
+        if (read_raw(blocks.data() + start + bgzf::HEADER_SIZE, total - bgzf::HEADER_SIZE) != total - bgzf::HEADER_SIZE) {
+          return truncated();
+        }
+        size_t data_size = bgzf::footer_value(blocks.data() + start + total - 4);
+        if (data_size > bgzf::MAX_DATA) {
+          return corrupted();
+        }
+        block_starts.push_back(start);
+        data_starts.push_back(data_starts.back() + data_size);
+      }
+      if (block_starts.empty()) {
+        finished = true;
+        return false;
+      }
+      block_starts.push_back(blocks.size());
+      if (buffer.size() < data_starts.back()) {
+        buffer.resize(data_starts.back());
+      }
+      while (inflaters.size() < block_starts.size() - 1) {
+        inflaters.emplace_back();
+        std::memset(&inflaters.back(), 0, sizeof(z_stream));
+        if (inflateInit2(&inflaters.back(), -15) != Z_OK) {
+          inflaters.pop_back();
+          return corrupted();
+        }
+      }
+      int failed = parallel_for(block_starts.size() - 1, threads, [this](const size_t i) {
+        z_stream& inflater = inflaters[i];
+        inflateReset(&inflater);
+        size_t data_size = data_starts[i + 1] - data_starts[i];
+        inflater.next_in = blocks.data() + block_starts[i] + bgzf::HEADER_SIZE;
+        inflater.avail_in = (uInt)(block_starts[i + 1] - block_starts[i] - bgzf::HEADER_SIZE - bgzf::FOOTER_SIZE);
+        inflater.next_out = (Bytef*)buffer.data() + data_starts[i];
+        inflater.avail_out = (uInt)data_size;
+        if (inflate(&inflater, Z_FINISH) != Z_STREAM_END || inflater.total_out != data_size) {
+          return 1;
+        }
+        uint32_t crc = (uint32_t)crc32(crc32(0, Z_NULL, 0), (const Bytef*)buffer.data() + data_starts[i], (uInt)data_size);
+        return crc == bgzf::footer_value(blocks.data() + block_starts[i + 1] - bgzf::FOOTER_SIZE) ? 0 : 1;
+      });
+      if (failed != 0) {
+        return corrupted();
+      }
+      buffer_to = data_starts.back();
+    }
+    return true;
+  }
+
+#ifdef USE_ZSTD
+  /// <summary>
+  /// Decompresses next piece of zstd frames into the buffer.
+  /// </summary>
+  /// <returns>FALSE if no more data are available.</returns>
+  bool fill_zstd() {
+    while (buffer_to == 0) {
+      if (zstd_input.pos == zstd_input.size) {
+        size_t size = std::fread(raw.data(), 1, raw.size(), file);
+        if (size == 0) {
+          finished = true;
+          return zstd_pending == 0 ? false : truncated();
+        }
+        zstd_input = { raw.data(), size, 0 };
+      }
+      ZSTD_outBuffer output = { buffer.data(), buffer.size(), 0 };
+      zstd_pending = ZSTD_decompressStream(zstd_stream, &output, &zstd_input);
+      if (ZSTD_isError(zstd_pending)) {
+        return corrupted();
+      }
+      buffer_to = output.pos;
+    }
+    return true;
+  }
+#endif
+
+  /// <summary>
+  /// Decompresses (or copies) next piece of the file into the buffer.
+  /// </summary>
+  /// <returns>FALSE if no more data are available.</returns>
+  bool fill() {
+    buffer_from = 0;
+    buffer_to = 0;
+    if (finished || error || file == nullptr) {
+      return false;
+    }
+    if (format == Format::PLAIN) {
+      buffer_to = std::fread(buffer.data(), 1, buffer.size(), file);
+      if (buffer_to == 0) {
+        finished = true;
+      }
+      return buffer_to != 0;
+    }
+    if (format == Format::BGZF && threads > 1) {
+      return fill_blocks();
+    }
+#ifdef USE_ZSTD
+    if (format == Format::ZSTD) {
+      return fill_zstd();
+    }
+#endif
+    while (buffer_to == 0) {
+      if (stream.avail_in == 0 && fill_raw() == 0) {
+        finished = true;
+        if (stream.total_in != 0) { // The last gzip member was not completed
+          truncated();
+        }
+        return false;
+      }
+      stream.next_out = (Bytef*)buffer.data();
+      stream.avail_out = (uInt)buffer.size();
+      int status = inflate(&stream, Z_NO_FLUSH);
+      buffer_to = buffer.size() - stream.avail_out;
+      if (status == Z_STREAM_END) { // End of a gzip member, another one (e.g. next BGZF block) may follow
+        inflateReset(&stream);
+      } else if (status != Z_OK && status != Z_BUF_ERROR) {
+        corrupted();
+        return buffer_to != 0;
+      }
+    }
+    return true;
+  }
+
+public:
+  InputFile() : file(nullptr), format(Format::PLAIN), threads(1), finished(false), error(false), buffer_from(0), buffer_to(0) {
+    std::memset(&stream, 0, sizeof(stream));
+  }
+
+  InputFile(const InputFile&) = delete;
+  InputFile& operator=(const InputFile&) = delete;
+
+  ~InputFile() {
+    close();
+    for (z_stream& inflater : inflaters) {
+      inflateEnd(&inflater);
+    }
+  }
+
+  /// <summary>
+  /// Sets the number of threads decompressing BGZF blocks of files opened afterwards.
+  /// </summary>
+  inline void set_threads(const size_t threads) {
+    this->threads = std::max<size_t>(threads, 1);
+  }
+
+  /// <summary>
+  /// Opens a file and detects whether it is compressed.
+  /// </summary>
+  /// <param name="filename">Path to the file; '-' stands for the standard input.</param>
+  /// <returns>TRUE if the file was opened.</returns>
+  bool open(const std::string& filename) {
+    close();
+    path = filename;
+    file = filename == "-" ? stdin : std::fopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+      std::cerr << "Unable to open file '" << filename << "'." << std::endl;
+      return false;
+    }
+    finished = false;
+    error = false;
+    raw.resize(1 << 16);
+    buffer.resize(1 << 18);
+    std::memset(&stream, 0, sizeof(stream));
+    size_t size = fill_raw();
+    buffer_from = 0;
+    buffer_to = 0;
+    if (size >= 2 && raw[0] == 0x1f && raw[1] == 0x8b) {
+      format = bgzf::is_header(raw.data(), size) ? Format::BGZF : Format::GZIP;
+      if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+        std::cerr << "Unable to initialize decompression of file '" << filename << "'." << std::endl;
+        error = true;
+        return false;
+      }
+    } else if (size >= 4 && raw[0] == 0x28 && raw[1] == 0xb5 && raw[2] == 0x2f && raw[3] == 0xfd) {
+      format = Format::ZSTD;
+#ifdef USE_ZSTD
+      zstd_stream = ZSTD_createDStream();
+      zstd_input = { raw.data(), size, 0 };
+      zstd_pending = 0;
+#else
+      std::cerr << "File '" << filename << "' is compressed by zstd, which is not supported by this build (compile with -DUSE_ZSTD and link with -lzstd)." << std::endl;
+      error = true;
+      return false;
+#endif
+    } else { // Already read bytes are the first piece of data
+      format = Format::PLAIN;
+      std::memcpy(buffer.data(), raw.data(), size);
+      buffer_to = size;
+    }
+    return true;
+  }
+
+  /// <summary>
+  /// Closes the file.
+  /// </summary>
+  void close() {
+    if (file != nullptr) {
+      if (format == Format::GZIP || format == Format::BGZF) {
+        inflateEnd(&stream);
+      }
+#ifdef USE_ZSTD
+      if (zstd_stream != nullptr) {
+        ZSTD_freeDStream(zstd_stream);
+        zstd_stream = nullptr;
+      }
+#endif
+      if (file != stdin) {
+        std::fclose(file);
+      }
+      file = nullptr;
+    }
+    format = Format::PLAIN;
+    buffer_from = 0;
+    buffer_to = 0;
+  }
+
+  /// <summary>
+  /// Whether the file could not be opened or contains corrupted data.
+  /// </summary>
+  inline bool failed() const { return error || file == nullptr; }
+
+  /// <summary>
+  /// Whether the file was compressed (in any format).
+  /// </summary>
+  inline bool is_compressed() const { return format != Format::PLAIN; }
+
+  /// <summary>
+  /// Detected format of the file.
+  /// </summary>
+  inline Format compression() const { return format; }
+
+  /// <summary>
+  /// Provides an access to the first bytes of data without consuming them.
+  /// </summary>
+  /// <param name="size">Requested number of bytes.</param>
+  /// <returns>Available bytes, possibly less than requested if the file is shorter.</returns>
+  std::string peek(const size_t size) {
+    if (buffer_from == buffer_to) {
+      fill();
+    }
+    return std::string(buffer.data() + buffer_from, std::min(size, buffer_to - buffer_from));
+  }
+
+  /// <summary>
+  /// Reads exactly given number of bytes.
+  /// </summary>
+  /// <param name="data">Where to store data.</param>
+  /// <param name="size">Number of bytes.</param>
+  /// <returns>Number of read bytes; less than size only at the end of the file or on error.</returns>
+  size_t read(char* data, const size_t size) {
+    size_t done = 0;
+    while (done < size) {
+      if (buffer_from == buffer_to && !fill()) {
+        break;
+      }
+      size_t step = std::min(size - done, buffer_to - buffer_from);
+      std::memcpy(data + done, buffer.data() + buffer_from, step);
+      buffer_from += step;
+      done += step;
+    }
+    return done;
+  }
+
+  /// <summary>
+  /// Reads a line without the trailing '\n', the same way as std::getline.
+  /// </summary>
+  /// <param name="line">The read line (output).</param>
+  /// <returns>FALSE if there is no more line.</returns>
+  bool getline(std::string& line) {
+    line.clear();
+    bool any = false;
+    while (true) {
+      if (buffer_from == buffer_to && !fill()) {
+        return any;
+      }
+      any = true;
+      const char* begin = buffer.data() + buffer_from;
+      const char* end = (const char*)std::memchr(begin, '\n', buffer_to - buffer_from);
+      if (end != nullptr) {
+        line.append(begin, end - begin);
+        buffer_from += end - begin + 1;
+        return true;
+      }
+      line.append(begin, buffer_to - buffer_from);
+      buffer_from = buffer_to;
+    }
+  }
+};
+
+/// <summary>
+/// Output file that is either written as is, or compressed in BGZF format (blocked gzip used by BAM files, readable by gzip as well),
+/// or in zstd format (only if compiled with USE_ZSTD defined and linked with libzstd).
+/// Multiple threads compress BGZF blocks (or zstd frames) in parallel if allowed by set_threads().
+/// </summary>
+class OutputFile {
+public:
+  /// <summary>
+  /// AUTO chooses the compression by the file name extension (see by_extension).
+  /// </summary>
+  enum class Compression { NONE, BGZF, ZSTD, AUTO };
+
+private:
+  FILE* file;
+  std::string path;
+  Compression compression;
+  size_t threads;
+  int level;
+  std::atomic<bool> error;
+  std::vector<char> buffer;
+  size_t buffer_size;
+  /// <summary>
+  /// Compressed blocks of the buffer.
+  /// </summary>
+  std::vector<std::vector<unsigned char>> blocks;
+  /// <summary>
+  /// Whether a full buffer is compressed and written by a background thread while the next one is filled.
+  /// </summary>
+  bool write_behind;
+  std::thread writer;
+  std::mutex writer_mutex;
+  std::condition_variable writer_signal;
+  /// <summary>
+  /// Buffer handed over to the background thread; it is empty when the thread is idle.
+  /// </summary>
+  std::vector<char> pending;
+  size_t pending_size;
+  bool writer_stop;
+#ifdef USE_ZSTD
+  ZSTD_CCtx* zstd_context = nullptr;
+  std::vector<char> zstd_output;
+#endif
+
+  /// <summary>
+  /// Writes raw bytes into the file.
+  /// </summary>
+  void write_raw(const void* data, const size_t size) {
+    if (!error && std::fwrite(data, 1, size, file) != size) {
+      std::cerr << "Unable to write into file '" << path << "'." << std::endl;
+      error = true;
+    }
+  }
+
+  /// <summary>
+  /// Compresses data into BGZF blocks (in parallel) and writes them.
+  /// </summary>
+  void write_blocks(const char* data, const size_t size) {
+    size_t count = (size + bgzf::BLOCK_DATA - 1) / bgzf::BLOCK_DATA;
+    if (blocks.size() < count) {
+      blocks.resize(count);
+    }
+    int failed = parallel_for(count, threads, [&](const size_t i) {
+      size_t from = i * bgzf::BLOCK_DATA;
+      return bgzf::compress(data + from, std::min(bgzf::BLOCK_DATA, size - from), level, blocks[i]) ? 0 : 1;
+    });
+    if (failed != 0) {
+      std::cerr << "Unable to compress data for file '" << path << "'." << std::endl;
+      error = true;
+      return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      write_raw(blocks[i].data(), blocks[i].size());
+    }
+  }
+
+#ifdef USE_ZSTD
+  /// <summary>
+  /// Compresses data into zstd frames and writes them.
+  /// </summary>
+  /// <param name="directive">ZSTD_e_continue, or ZSTD_e_end to finish the frame.</param>
+  void write_zstd(const char* data, const size_t size, const ZSTD_EndDirective directive) {
+    ZSTD_inBuffer input = { data, size, 0 };
+    size_t remaining;
+    do {
+      ZSTD_outBuffer output = { zstd_output.data(), zstd_output.size(), 0 };
+      remaining = ZSTD_compressStream2(zstd_context, &output, &input, directive);
+      if (ZSTD_isError(remaining)) {
+        std::cerr << "Unable to compress data for file '" << path << "'." << std::endl;
+        error = true;
+        return;
+      }
+      write_raw(zstd_output.data(), output.pos);
+    } while (directive == ZSTD_e_end ? remaining != 0 : input.pos < input.size);
+  }
+#endif
+
+  /// <summary>
+  /// Writes (compresses) a piece of data.
+  /// </summary>
+  void write_data(const char* data, const size_t size) {
+    if (compression == Compression::BGZF) {
+      write_blocks(data, size);
+#ifdef USE_ZSTD
+    } else if (compression == Compression::ZSTD) {
+      write_zstd(data, size, ZSTD_e_continue);
+#endif
+    } else {
+      write_raw(data, size);
+    }
+  }
+
+  /// <summary>
+  /// Body of the background thread writing pending buffers.
+  /// </summary>
+  void write_pending() {
+    std::unique_lock<std::mutex> lock(writer_mutex);
+    while (true) {
+      writer_signal.wait(lock, [this]() { return pending_size != 0 || writer_stop; });
+      if (pending_size == 0) {
+        return;
+      }
+      lock.unlock();
+      write_data(pending.data(), pending_size);
+      lock.lock();
+      pending_size = 0;
+      writer_signal.notify_all();
+    }
+  }
+
+  /// <summary>
+  /// Writes (compresses) the content of the buffer, or hands it over to the background thread.
+  /// </summary>
+  void flush_buffer() {
+    if (buffer_size == 0) {
+      return;
+    }
+    if (writer.joinable()) {
+      std::unique_lock<std::mutex> lock(writer_mutex);
+      writer_signal.wait(lock, [this]() { return pending_size == 0; });
+      buffer.swap(pending);
+      pending_size = buffer_size;
+      buffer.resize(pending.size());
+      writer_signal.notify_all();
+    } else {
+      write_data(buffer.data(), buffer_size);
+    }
+    buffer_size = 0;
+  }
+
+  /// <summary>
+  /// Waits until all pending data are written and stops the background thread.
+  /// </summary>
+  void stop_writer() {
+    if (!writer.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(writer_mutex);
+      writer_stop = true;
+    }
+    writer_signal.notify_all();
+    writer.join();
+  }
+
+public:
+  OutputFile() : file(nullptr), compression(Compression::NONE), threads(1), level(Z_DEFAULT_COMPRESSION), error(false), buffer_size(0), write_behind(false), pending_size(0), writer_stop(false) {}
+
+  OutputFile(const OutputFile&) = delete;
+  OutputFile& operator=(const OutputFile&) = delete;
+
+  ~OutputFile() {
+    close();
+  }
+
+  /// <summary>
+  /// Compression implied by a file name: BGZF for '.gz' and '.bgz', zstd for '.zst', none otherwise (and for the standard output).
+  /// </summary>
+  static Compression by_extension(const std::string& filename) {
+    auto ends_with = [&filename](const std::string& suffix) {
+      return filename.size() > suffix.size() && filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    if (ends_with(".gz") || ends_with(".bgz")) {
+      return Compression::BGZF;
+    }
+    return ends_with(".zst") ? Compression::ZSTD : Compression::NONE;
+  }
+
+  /// <summary>
+  /// Sets the number of threads compressing files opened afterwards.
+  /// </summary>
+  inline void set_threads(const size_t threads) {
+    this->threads = std::max<size_t>(threads, 1);
+  }
+
+  /// <summary>
+  /// Sets whether files opened afterwards are written by a background thread, so that producing the data overlaps with compression and the disk.
+  /// Larger buffers are used then.
+  /// </summary>
+  inline void set_write_behind(const bool write_behind) {
+    this->write_behind = write_behind;
+  }
+
+  /// <summary>
+  /// Opens (truncates) a file for writing.
+  /// </summary>
+  /// <param name="filename">Path to the file; '-' stands for the standard output.</param>
+  /// <param name="compression">Whether the output should be compressed.</param>
+  /// <returns>TRUE if the file was opened.</returns>
+  bool open(const std::string& filename, const Compression compression = Compression::NONE) {
+    close();
+    path = filename;
+    this->compression = compression == Compression::AUTO ? by_extension(filename) : compression;
+    error = false;
+#ifndef USE_ZSTD
+    if (this->compression == Compression::ZSTD) {
+      std::cerr << "Unable to create file '" << filename << "', zstd compression is not supported by this build (compile with -DUSE_ZSTD and link with -lzstd)." << std::endl;
+      error = true;
+      return false;
+    }
+#endif
+    file = filename == "-" ? stdout : std::fopen(filename.c_str(), "wb");
+    if (file == nullptr) {
+      std::cerr << "Unable to create file '" << filename << "'." << std::endl;
+      error = true;
+      return false;
+    }
+    // Buffers are larger if they are written in the background, every BGZF batch has a block for each thread
+    size_t blocks_per_thread = write_behind ? 16 : 1;
+    buffer.resize(this->compression == Compression::BGZF ? threads * blocks_per_thread * bgzf::BLOCK_DATA : (write_behind ? 1 << 22 : 1 << 18));
+    buffer_size = 0;
+#ifdef USE_ZSTD
+    if (this->compression == Compression::ZSTD) {
+      zstd_context = ZSTD_createCCtx();
+      ZSTD_CCtx_setParameter(zstd_context, ZSTD_c_compressionLevel, ZSTD_CLEVEL_DEFAULT);
+      if (threads > 1) { // Ignored error if libzstd is built without multithreading
+        ZSTD_CCtx_setParameter(zstd_context, ZSTD_c_nbWorkers, (int)threads);
+      }
+      zstd_output.resize(ZSTD_CStreamOutSize());
+    }
+#endif
+    if (write_behind) {
+      pending.resize(buffer.size());
+      pending_size = 0;
+      writer_stop = false;
+      writer = std::thread(&OutputFile::write_pending, this);
+    }
+    return true;
+  }
+
+  /// <summary>
+  /// Writes all buffered data and closes the file; BGZF output is terminated by the standard empty EOF block.
+  /// </summary>
+  /// <returns>TRUE if no error occured.</returns>
+  bool close() {
+    if (file == nullptr) {
+      return !error;
+    }
+    flush_buffer();
+    stop_writer();
+    if (compression == Compression::BGZF) {
+      static const unsigned char eof[] = { 0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0, 0x1b, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+      write_raw(eof, sizeof(eof));
+    }
+#ifdef USE_ZSTD
+    if (zstd_context != nullptr) {
+      write_zstd(nullptr, 0, ZSTD_e_end);
+      ZSTD_freeCCtx(zstd_context);
+      zstd_context = nullptr;
+    }
+#endif
+    if (file == stdout) {
+      if (std::fflush(file) != 0 && !error) {
+        std::cerr << "Unable to write into file '" << path << "'." << std::endl;
+        error = true;
+      }
+    } else if (std::fclose(file) != 0 && !error) {
+      std::cerr << "Unable to write into file '" << path << "'." << std::endl;
+      error = true;
+    }
+    file = nullptr;
+    return !error;
+  }
+
+  /// <summary>
+  /// Whether the file could not be created or written.
+  /// </summary>
+  inline bool failed() const { return error || file == nullptr; }
+
+  /// <summary>
+  /// Writes data into the file.
+  /// </summary>
+  /// <param name="data">Data to be written.</param>
+  /// <param name="size">Length of the data.</param>
+  void write(const char* data, size_t size) {
+    while (size > 0) {
+      size_t step = std::min(size, buffer.size() - buffer_size);
+      std::memcpy(buffer.data() + buffer_size, data, step);
+      buffer_size += step;
+      data += step;
+      size -= step;
+      if (buffer_size == buffer.size()) {
+        flush_buffer();
+      }
+    }
+  }
+
+  inline void write(const std::string& data) { write(data.data(), data.size()); }
+
+  inline void put(const char c) {
+    if (buffer_size == buffer.size()) {
+      flush_buffer();
+    }
+    buffer[buffer_size++] = c;
+  }
+};
+
+/// <summary>
+/// Parses '--compress FORMAT' option if it is the argument at the given position; FORMAT is 'gzip' (BGZF, readable by gzip), 'zstd' or 'none'.
+/// </summary>
+/// <param name="argi">Position of the examined argument; it is moved after the option if present.</param>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Arguments.</param>
+/// <param name="compression">Compression of outputs (output); unchanged if the option is not present.</param>
+/// <returns>FALSE if the option is present, but its value is invalid.</returns>
+inline bool parse_compression(int& argi, const int argc, char* argv[], OutputFile::Compression& compression) {
+  if (argi >= argc || std::string(argv[argi]) != "--compress") {
+    return true;
+  }
+  if (argi + 1 >= argc) {
+    std::cerr << "Missing value of option '--compress'." << std::endl;
+    return false;
+  }
+  std::string value(argv[argi + 1]);
+  if (value == "gzip" || value == "bgzf") {
+    compression = OutputFile::Compression::BGZF;
+  } else if (value == "zstd") {
+    compression = OutputFile::Compression::ZSTD;
+  } else if (value == "none") {
+    compression = OutputFile::Compression::NONE;
+  } else {
+    std::cerr << "Unknown compression format '" << value << "'." << std::endl;
+    return false;
+  }
+  argi += 2;
+  return true;
+}
+
+#endif
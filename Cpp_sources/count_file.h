@@ -0,0 +1,242 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef COUNT_FILE_H
+#define COUNT_FILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+#include "mapped_file.h"
+
+/// <summary>
+/// Binary format of read counts (written by read_counts --binary), all numbers are little-endian:
+/// - header: magic "RPCOUNT1", uint32 shortest read length (0 if reads are not grouped by lengths), uint32 number of read lengths (width);
+/// - a block for each reference (sorted by names): for each position with a non-zero count varints
+///   'position - previous position' (the first one from 0) and width counts (one per read length);
+/// - reference names concatenated;
+/// - index: for each reference uint64 offset of its block, uint64 offset of its name, uint32 length of the name, uint32 number of positions;
+/// - trailer: uint64 offset of the index, uint64 number of references.
+/// </summary>
+namespace count_format {
+  const char MAGIC[] = "RPCOUNT1";
+  const size_t HEADER_SIZE = 16;
+  const size_t INDEX_ENTRY_SIZE = 24;
+  const size_t TRAILER_SIZE = 16;
+
+  /// <summary>
+  /// Appends an unsigned number in LEB128 format (7 bits per byte, the highest bit marks a continuation).
+  /// </summary>
+  inline void append_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+      out += (char)((value & 0x7f) | 0x80);
+      value >>= 7;
+    }
+    out += (char)value;
+  }
+
+  /// <summary>
+  /// Reads an unsigned number in LEB128 format.
+  /// </summary>
+  /// <param name="it">Position of the number, it is moved after the number.</param>
+  /// <param name="end">End of the data.</param>
+  /// <param name="value">The number (output).</param>
+  /// <returns>FALSE if the number is incomplete or too long.</returns>
+  inline bool read_varint(const unsigned char*& it, const unsigned char* end, uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; it < end && shift < 64; shift += 7) {
+      unsigned char byte = *it++;
+      value |= (uint64_t)(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+}
+
+/// <summary>
+/// Read counts in the binary format mapped into memory; blocks of references are decoded on demand.
+/// </summary>
+class CountFile {
+private:
+  MappedFile file;
+  const unsigned char* data;
+  std::string path;
+  size_t index;
+  size_t count;
+
+  template <typename T>
+  inline T get(const size_t offset) const { return file.get<T>(offset); }
+
+  bool invalid() {
+    std::cerr << "Unexpected file format: corrupted binary read counts file '" << path << "'" << std::endl;
+    close();
+    return false;
+  }
+
+public:
+  CountFile() : data(nullptr), index(0), count(0) {}
+  CountFile(const CountFile&) = delete;
+  CountFile& operator=(const CountFile&) = delete;
+  ~CountFile() { close(); }
+
+  /// <summary>
+  /// Whether a file is in the binary format (judged by its magic).
+  /// </summary>
+  static bool is_count_file(const std::string& filename) {
+    return MappedFile::has_magic(filename, count_format::MAGIC);
+  }
+
+  /// <summary>
+  /// Maps a file into memory and checks its index.
+  /// </summary>
+  /// <param name="filename">Path to the file.</param>
+  /// <returns>TRUE if the file was opened.</returns>
+  bool open(const std::string& filename) {
+    close();
+    path = filename;
+    if (!file.open(filename)) {
+      return false;
+    }
+    data = file.data();
+    if (!file.starts_with(count_format::MAGIC, count_format::HEADER_SIZE + count_format::TRAILER_SIZE) || width() == 0) {
+      return invalid();
+    }
+    const size_t size = file.size();
+    index = (size_t)get<uint64_t>(size - count_format::TRAILER_SIZE);
+    count = (size_t)get<uint64_t>(size - count_format::TRAILER_SIZE + 8);
+    if (index < count_format::HEADER_SIZE || index > size - count_format::TRAILER_SIZE || (size - count_format::TRAILER_SIZE - index) / count_format::INDEX_ENTRY_SIZE != count) {
+      return invalid();
+    }
+    for (size_t i = 0; i < count; ++i) {
+      uint64_t block = get<uint64_t>(entry(i)), name = get<uint64_t>(entry(i) + 8);
+      if (block > index || name > index || get<uint32_t>(entry(i) + 16) > index - name) {
+        return invalid();
+      }
+    }
+    return true;
+  }
+
+  /// <summary>
+  /// Unmaps the file.
+  /// </summary>
+  void close() {
+    file.close();
+    data = nullptr;
+    index = count = 0;
+  }
+
+  /// <summary>
+  /// Offset of the index entry of a reference.
+  /// </summary>
+  inline size_t entry(const size_t reference) const { return index + reference * count_format::INDEX_ENTRY_SIZE; }
+
+  /// <summary>
+  /// Number of references.
+  /// </summary>
+  inline size_t references() const { return count; }
+
+  /// <summary>
+  /// The shortest read length (0 if reads are not grouped by lengths).
+  /// </summary>
+  inline uint32_t min_length() const { return get<uint32_t>(8); }
+
+  /// <summary>
+  /// Number of read lengths, whose counts are stored for each position.
+  /// </summary>
+  inline uint32_t width() const { return get<uint32_t>(12); }
+
+  /// <summary>
+  /// Name of a reference.
+  /// </summary>
+  inline std::string_view name(const size_t reference) const {
+    return std::string_view((const char*)data + get<uint64_t>(entry(reference) + 8), get<uint32_t>(entry(reference) + 16));
+  }
+
+  /// <summary>
+  /// Finds a reference by its name (references are sorted by names).
+  /// </summary>
+  /// <returns>Index of the reference, or references() if it is missing.</returns>
+  size_t find(const std::string_view reference) const {
+    size_t from = 0, to = count;
+    while (from < to) {
+      size_t middle = from + (to - from) / 2;
+      if (name(middle) < reference) {
+        from = middle + 1;
+      } else {
+        to = middle;
+      }
+    }
+    return from < count && name(from) == reference ? from : count;
+  }
+
+  /// <summary>
+  /// Decodes positions of a reference with their cumulative counts (summed over all read lengths).
+  /// </summary>
+  /// <param name="reference">Index of the reference.</param>
+  /// <param name="positions">Positions with a non-zero count in the increasing order (output).</param>
+  /// <param name="cumulative">cumulative[i] is the total count of positions[0], ..., positions[i - 1]; it has one item more than positions (output).</param>
+  /// <returns>FALSE if the block is corrupted.</returns>
+  bool read(const size_t reference, std::vector<uint64_t>& positions, std::vector<uint64_t>& cumulative) const {
+    uint32_t n = get<uint32_t>(entry(reference) + 20);
+    positions.resize(n);
+    cumulative.resize(n + 1);
+    cumulative[0] = 0;
+    const unsigned char* it = data + get<uint64_t>(entry(reference));
+    const unsigned char* end = data + index;
+    uint64_t pos = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+      uint64_t delta, total = 0;
+      if (!count_format::read_varint(it, end, delta)) {
+        return false;
+      }
+      pos += delta;
+      for (uint32_t j = width(); j > 0; --j) {
+        uint64_t value;
+        if (!count_format::read_varint(it, end, value)) {
+          return false;
+        }
+        total += value;
+      }
+      positions[i] = pos;
+      cumulative[i + 1] = cumulative[i] + total;
+    }
+    return true;
+  }
+
+  /// <summary>
+  /// Decodes positions of a reference with their counts of each read length.
+  /// </summary>
+  /// <param name="reference">Index of the reference.</param>
+  /// <param name="callback">Called with a position (in the increasing order) and its counts (width() counts indexed by read length - min_length()).</param>
+  /// <returns>FALSE if the block is corrupted.</returns>
+  template <typename Callback>
+  bool scan(const size_t reference, Callback callback) const {
+    uint32_t n = get<uint32_t>(entry(reference) + 20);
+    std::vector<uint64_t> counts(width());
+    const unsigned char* it = data + get<uint64_t>(entry(reference));
+    const unsigned char* end = data + index;
+    uint64_t pos = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+      uint64_t delta;
+      if (!count_format::read_varint(it, end, delta)) {
+        return false;
+      }
+      pos += delta;
+      for (uint64_t& count : counts) {
+        if (!count_format::read_varint(it, end, count)) {
+          return false;
+        }
+      }
+      callback(pos, (const std::vector<uint64_t>&)counts);
+    }
+    return true;
+  }
+};
+
+#endif
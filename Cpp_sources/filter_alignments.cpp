@@ -0,0 +1,9 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#include "served_tools.h"
+
+int main(int argc, char* argv[]) {
+  return filter_alignments_main(argc, argv);
+}
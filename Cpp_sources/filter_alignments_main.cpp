@@ -0,0 +1,133 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#include <iostream>
+#include <string>
+#include "alignment_filters.h"
+#include "reference_cache.h"
+#include "served_tools.h"
+
+/// <summary>
+/// Entry point of the tool; reference_server runs it in forked jobs, which find references loaded by the server.
+/// </summary>
+int filter_alignments_main(int argc, char* argv[]) {
+  // Annotations file in GTF format for the gene ambiguity filter
+  std::string annotations;
+  // File with transcript_ids for the transcript selection
+  std::string transcripts;
+  // Whether reads mapped to the reverse strand should be filtered out
+  bool reverse = false;
+  // Number of threads shared by file pairs and chunks of a file
+  size_t threads = 1;
+  // Compression of SAM outputs
+  OutputFile::Compression compression = OutputFile::Compression::AUTO;
+  // Grouping of QNAMEs and pruning of the header
+  GroupingOptions grouping;
+  int argi = 1;
+  for (; argi < argc && std::string(argv[argi]).rfind("--", 0) == 0; ++argi) {
+    std::string option(argv[argi]);
+    if (option == "--threads") {
+      if (!parse_threads(argi, argc, argv, threads)) {
+        return 1;
+      }
+      --argi;
+    } else if (option == "--compress") {
+      if (!parse_compression(argi, argc, argv, compression)) {
+        return 1;
+      }
+      --argi;
+    } else if (option == "--ungrouped" || option == "--prune-references" || option == "--memory" || option == "--temp") {
+      if (!parse_grouping(argi, argc, argv, grouping)) {
+        return 1;
+      }
+      --argi;
+    } else if (option == "--stats" || option == "--stats-json") {
+      if (!parse_stats(argi, argc, argv)) {
+        return 1;
+      }
+      --argi;
+    } else if (option == "--cache") {
+      if (!parse_cache(argi, argc, argv)) {
+        return 1;
+      }
+      --argi;
+    } else if (option == "--reverse") {
+      reverse = true;
+    } else if (option == "--genes" && argi + 1 < argc) {
+      annotations = argv[++argi];
+    } else if (option == "--transcripts" && argi + 1 < argc) {
+      transcripts = argv[++argi];
+    } else {
+      std::cerr << "Unknown option '" << option << "'." << std::endl;
+      return 1;
+    }
+  }
+  if (argi == argc || (argc - argi) % 2 != 0 || (!reverse && annotations.empty() && transcripts.empty())) {
+    std::cout << "filter_alignments [--threads N] [--compress FORMAT] [--ungrouped [--memory MB] [--temp DIR]] [--prune-references] [--cache DIR] [--stats | --stats-json FILE] [--reverse] [--genes <annotations>] [--transcripts <transcript_ids>] (<input> <output>)+\n";
+    std::cout << "\t Takes <input> file in SAM or BAM format, applies the chosen filters in a single pass and writes the rest to\n";
+    std::cout << "\t <output> file (in BAM format if its name ends with '.bam', in SAM format otherwise). Filters are applied in\n";
+    std::cout << "\t the following order and the result is the same as if the corresponding programs were run one after another:\n";
+    std::cout << "\t --reverse                       \t filter out all reads mapped to reverse strand (filter_reverse_reads);\n";
+    std::cout << "\t --genes <annotations>           \t filter out all reads mapped into multiple transcripts from different genes\n";
+    std::cout << "\t                                 \t according to <annotations> in GTF format or its index (filter_ambiguous_genes);\n";
+    std::cout << "\t --transcripts <transcript_ids>  \t filter only transcripts from <transcript_ids> file (one id per line)\n";
+    std::cout << "\t                                 \t (select_transcripts).\n";
+    std::cout << "\t --threads N                     \t use up to N threads: pairs of files are processed\n";
+    std::cout << "\t                                 \t simultaneously and a single file is split into chunks of whole reads.\n";
+    std::cout << "\t --compress FORMAT               \t compress SAM outputs by 'gzip' (BGZF), 'zstd' or 'none'; by default\n";
+    std::cout << "\t                                 \t outputs ending with '.gz' or '.zst' are compressed. Inputs may be compressed.\n";
+    std::cout << "\t --ungrouped                     \t input is not grouped by QNAME (e.g. sorted by coordinates), so alignments\n";
+    std::cout << "\t                                 \t are grouped by an external sort in runs of at most MB megabytes (default 512)\n";
+    std::cout << "\t                                 \t spilled into DIR (default TMPDIR or /tmp).\n";
+    std::cout << "\t --prune-references              \t remove '@SQ' lines of references without preserved alignments (the output\n";
+    std::cout << "\t                                 \t is stored in DIR first).\n";
+    print_stats_usage("\t ", 32);
+    print_cache_usage("\t ", 32);
+    std::cout << "\t It expectes that the input file has grouped QNAMEs (unless --ungrouped is given) and that NH:i:Nmap is valid.\n";
+    std::cout << "\t FLAG (a new primary alignment), MAPQ, NH:i:Nmap and HI:i:I are updated once after all filters.\n";
+    std::cout << "Created by Jan Jelínek (jan.jelinek@biomed.cas.cz); last update: 2026-10-14; license: Apache License 2.0" << std::endl;
+    return argc == 1 ? 0 : 1;
+  }
+
+  ResultCache::global().setup("filter_alignments", argi, argv);
+  RunStats& stats = RunStats::global();
+  stats.start("annotations load");
+  // Loaded data are kept by the cache, so they outlive the stages
+  const TranscriptGenes no_genes;
+  const IdDictionary no_transcripts;
+  const TranscriptGenes* transcript_gene = &no_genes;
+  const IdDictionary* transcript_ids = &no_transcripts;
+  if (!annotations.empty()) {
+    int error;
+    transcript_gene = ReferenceCache::global().transcript_genes(annotations, error);
+    if (transcript_gene == nullptr) {
+      return error;
+    }
+  }
+  if (!transcripts.empty()) {
+    transcript_ids = ReferenceCache::global().transcript_ids(transcripts);
+  }
+  ReverseStrandFilter reverse_filter;
+  AmbiguousGeneFilter gene_filter(*transcript_gene, annotations);
+  TranscriptFilter transcript_filter(*transcript_ids);
+  std::vector<const AlignmentStage*> stages;
+  if (reverse) {
+    stages.push_back(&reverse_filter);
+  }
+  if (!annotations.empty()) {
+    stages.push_back(&gene_filter);
+  }
+  if (!transcripts.empty()) {
+    stages.push_back(&transcript_filter);
+  }
+
+  // Foreach pair of filenames
+  stats.start("filtering");
+  int error = filter_file_pairs(stages, argv + argi, (argc - argi) / 2, threads, compression, grouping);
+  stats.stop(stats.counter("input_alignments"));
+  if (!stats.report() && error == 0) {
+    return 9;
+  }
+  return error;
+}
@@ -0,0 +1,76 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#include <iostream>
+#include "alignment_filters.h"
+#include "reference_cache.h"
+#include "served_tools.h"
+
+/// <summary>
+/// Entry point of the tool; reference_server runs it in forked jobs, which find references loaded by the server.
+/// </summary>
+int filter_ambiguous_genes_main(int argc, char* argv[]) {
+  // Number of file pairs processed simultaneously
+  size_t threads = 1;
+  // Compression of SAM outputs
+  OutputFile::Compression compression = OutputFile::Compression::AUTO;
+  // Grouping of QNAMEs and pruning of the header
+  GroupingOptions grouping;
+  int argi = 1;
+  for (int previous = 0; previous != argi; ) { // Options may be in any order
+    previous = argi;
+    if (!parse_threads(argi, argc, argv, threads) || !parse_compression(argi, argc, argv, compression) || !parse_grouping(argi, argc, argv, grouping)
+      || !parse_stats(argi, argc, argv) || !parse_cache(argi, argc, argv)) {
+      return 1;
+    }
+  }
+  if (argi == argc || ((argc - argi) % 2) != 1) {
+    std::cout << "filter_ambiguous_genes [--threads N] [--compress FORMAT] [--ungrouped [--memory MB] [--temp DIR]] [--prune-references] [--cache DIR] [--stats | --stats-json FILE] <annotations> (<input> <output>)+\t It takes transcript_id => gene_id mapping from\n";
+    std::cout << "                                                        \t <annotations> file in GTF format (or its index compiled\n";
+    std::cout << "                                                        \t by compile_annotations) and then it read\n";
+    std::cout << "                                                        \t <input> file in SAM or BAM format, filter out all reads\n";
+    std::cout << "                                                        \t that are mapped into multiple transcripts from different\n";
+    std::cout << "                                                        \t genes (multiple transcripts from the same gene are\n";
+    std::cout << "                                                        \t allowed), and write the rest to <output> file (in BAM\n";
+    std::cout << "                                                        \t format if its name ends with '.bam', in SAM otherwise).\n";
+    std::cout << "                                                        \t --threads N\t use up to N threads (pairs of files are\n";
+    std::cout << "                                                        \t            \t processed simultaneously, a file is split into\n";
+    std::cout << "                                                        \t            \t chunks of whole reads; the mapping is shared).\n";
+    std::cout << "                                                        \t --compress FORMAT\t compress SAM outputs by 'gzip' (BGZF), 'zstd' or 'none';\n";
+    std::cout << "                                                        \t                  \t by default outputs ending with '.gz' or '.zst' are compressed.\n";
+    std::cout << "                                                        \t --ungrouped\t input is not grouped by QNAME (e.g. sorted by coordinates), so alignments\n";
+    std::cout << "                                                        \t            \t are grouped by an external sort in runs of at most MB megabytes (default 512)\n";
+    std::cout << "                                                        \t            \t spilled into DIR (default TMPDIR or /tmp).\n";
+    std::cout << "                                                        \t --prune-references\t remove '@SQ' lines of references without preserved alignments\n";
+    std::cout << "                                                        \t                   \t (the output is stored in DIR first).\n";
+    print_stats_usage("                                                        \t ");
+    print_cache_usage("                                                        \t ");
+    std::cout << "Created by Jan Jelínek (jan.jelinek@biomed.cas.cz); last update: 2026-10-14; license: Apache License 2.0" << std::endl;
+    return 0;
+  }
+
+  ResultCache& cache = ResultCache::global();
+  cache.setup("filter_ambiguous_genes", argi, argv);
+  cache.input(argv[argi]);
+  RunStats& stats = RunStats::global();
+  stats.start("annotations load");
+  // Mapping saying, what gene_id corresponds to a given transcript_id
+  int error;
+  const TranscriptGenes* transcript_gene = ReferenceCache::global().transcript_genes(argv[argi], error);
+  if (transcript_gene == nullptr) {
+    return error;
+  }
+
+  AmbiguousGeneFilter gene_filter(*transcript_gene, argv[argi]);
+  const std::vector<const AlignmentStage*> stages = { &gene_filter };
+  ++argi;
+  // Foreach pair of filenames
+  stats.start("filtering");
+  error = filter_file_pairs(stages, argv + argi, (argc - argi) / 2, threads, compression, grouping);
+  stats.stop(stats.counter("input_alignments"));
+  if (!stats.report() && error == 0) {
+    return 9;
+  }
+  return error;
+}
@@ -0,0 +1,516 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#include <cstdint>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include "annotation_index.h"
+#include "base_counts.h"
+#include "compressed_io.h"
+#include "genome_file.h"
+#include "id_dictionary.h"
+#include "parallel.h"
+#include "reference_cache.h"
+#include "result_cache.h"
+#include "run_stats.h"
+#include "sam_fields.h"
+#include "served_tools.h"
+#include "strand.h"
+
+/// <summary>
+/// Annotated region, whose bases are counted.
+/// </summary>
+struct Region {
+  /// <summary>
+  /// Index of the (chromosome, gene) pair and the feature type, whose counts the region belongs to.
+  /// </summary>
+  uint32_t gene, feature;
+  /// <summary>
+  /// 0-based boundaries [from; to) within the chromosome.
+  /// </summary>
+  uint64_t from, to;
+  /// <summary>
+  /// Start of the first codon from the 5' end of the region (the phase of a CDS), NO_PHASE if it is unknown.
+  /// </summary>
+  uint32_t phase;
+  /// <summary>
+  /// TRUE for the forward strand.
+  /// </summary>
+  bool strand;
+
+  static constexpr uint32_t NO_PHASE = UINT32_MAX;
+};
+
+/// <summary>
+/// Exons of a transcript, which are needed for windows around its start and stop codons.
+/// </summary>
+struct TranscriptExons {
+  /// <summary>
+  /// Sequence index of the chromosome.
+  /// </summary>
+  size_t sequence;
+  /// <summary>
+  /// Index of the (chromosome, gene) pair.
+  /// </summary>
+  uint32_t gene;
+  bool strand;
+  /// <summary>
+  /// 0-based boundaries [from; to) of exons within the chromosome.
+  /// </summary>
+  std::vector<std::pair<uint64_t, uint64_t>> exons;
+
+  /// <summary>
+  /// Splits a part of the spliced transcript into parts of exons (in the direction of the transcript).
+  /// </summary>
+  /// <param name="from">0-based start of the part in transcript coordinates.</param>
+  /// <param name="to">0-based end of the part (exclusive) in transcript coordinates.</param>
+  /// <param name="add">Function taking 0-based boundaries [from; to) of a part within the chromosome and its start in transcript coordinates.</param>
+  template <typename Add>
+  void project(const uint64_t from, const uint64_t to, Add add) const {
+	// The strand is dispatched once for all exons
+	with_strand(strand, [&](auto direction) {
+	  uint64_t offset = 0;
+	  for (const std::pair<uint64_t, uint64_t>& exon : exons) {
+		uint64_t length = exon.second - exon.first;
+		uint64_t part_from = std::max(from, offset), part_to = std::min(to, offset + length);
+		if (part_from < part_to) {
+		  if constexpr (decltype(direction)::forward) {
+			add(exon.first + (part_from - offset), exon.first + (part_to - offset), part_from);
+		  } else {
+			add(exon.second - (part_to - offset), exon.second - (part_from - offset), part_from);
+		  }
+		}
+		offset += length;
+	  }
+	});
+  }
+};
+
+/// <summary>
+/// Entry point of the tool; reference_server runs it in forked jobs, which find references loaded by the server.
+/// </summary>
+int gc_content_main(int argc, char* argv[]) {
+  // Number of threads counting bases of chromosomes
+  size_t threads = 1;
+  // Start and stop codon positions in transcript coordinates (output of transcripts_startstop_positions), empty if no windows are used
+  std::string windows_file;
+  // Number of bases of windows upstream and downstream of start and stop codons
+  uint64_t flank = 0;
+  // Length of counted k-mers, 0 if only GC content is computed
+  size_t kmer = 0;
+  // Whether only codons in the frame given by phases are counted
+  bool codons = false;
+  // Compression of the standard output
+  OutputFile::Compression compression = OutputFile::Compression::NONE;
+  bool help = false;
+  int argi = 1;
+  for (; argi < argc && std::string(argv[argi]).rfind("--", 0) == 0; ++argi) {
+	std::string option(argv[argi]);
+	if (option == "--threads") {
+	  if (!parse_threads(argi, argc, argv, threads)) {
+		return 1;
+	  }
+	  --argi;
+	} else if (option == "--compress") {
+	  if (!parse_compression(argi, argc, argv, compression)) {
+		return 1;
+	  }
+	  --argi;
+	} else if (option == "--stats" || option == "--stats-json") {
+	  if (!parse_stats(argi, argc, argv)) {
+		return 1;
+	  }
+	  --argi;
+	} else if (option == "--cache") {
+	  if (!parse_cache(argi, argc, argv)) {
+		return 1;
+	  }
+	  --argi;
+	} else if (option == "--windows" && argi + 2 < argc) {
+	  windows_file = argv[++argi];
+	  if (!parse_integer(std::string_view(argv[++argi]), flank) || flank == 0) {
+		std::cerr << "Invalid window flank '" << argv[argi] << "'." << std::endl;
+		return 1;
+	  }
+	} else if (option == "--kmers" && argi + 1 < argc) {
+	  if (!parse_integer(std::string_view(argv[++argi]), kmer) || kmer == 0 || kmer > 4) {
+		std::cerr << "Invalid k-mer length '" << argv[argi] << "'." << std::endl;
+		return 1;
+	  }
+	} else if (option == "--codons") {
+	  codons = true;
+	} else if (option == "--help") {
+	  argi = argc;
+	  help = true;
+	} else {
+	  std::cerr << "Unknown option '" << option << "'." << std::endl;
+	  return 1;
+	}
+  }
+  if (codons && kmer != 0 && kmer != 3) {
+	std::cerr << "Option '--codons' counts 3-mers, it cannot be combined with '--kmers " << kmer << "'." << std::endl;
+	return 1;
+  }
+  if (codons) {
+	kmer = 3;
+  }
+  if (help || argc - argi != 2) {
+	std::cout << "gc_content [--threads N] [--windows <positions> FLANK] [--kmers K] [--codons] [--compress FORMAT] [--cache DIR] [--stats | --stats-json FILE] <genome> <annotations>\n";
+	std::cout << "                                 \t Compute GC content for each feature type and gene id\n";
+	std::cout << "                                 \t based on <genome> in FASTA format (or packed by 'pack_genome', which is mapped into memory) and\n";
+	std::cout << "                                 \t its <annotations> in GTF file format (or their index compiled by 'compile_annotations').\n";
+	std::cout << "                                 \t --windows <positions> FLANK\t add features 'start_window' and 'stop_window' of FLANK bases upstream\n";
+	std::cout << "                                 \t                            \t and downstream of start and stop codons across exons; <positions> are\n";
+	std::cout << "                                 \t                            \t start and stop codons in transcript coordinates (transcripts_startstop_positions).\n";
+	std::cout << "                                 \t --kmers K  \t add frequencies of all overlapping K-mers (K = 1 to 4) for each feature type\n";
+	std::cout << "                                 \t            \t (columns '<feature>_<K-mer>') read in the direction of the gene.\n";
+	std::cout << "                                 \t --codons   \t add frequencies of codons in the frame given by phases (CDS, windows)\n";
+	std::cout << "                                 \t            \t for each feature type; codons across exon boundaries are not counted\n";
+	std::cout << "                                 \t            \t (it can be combined only with '--kmers 3').\n";
+	std::cout << "                                 \t --compress FORMAT\t compress the output by 'gzip' (BGZF), 'zstd' or 'none'.\n";
+	print_stats_usage("                                 \t ");
+	print_cache_usage("                                 \t ");
+	std::cout << "                                 \t --threads N\t up to N chromosomes are processed simultaneously (default 1).\n";
+	std::cout << "                                 \t --help     \t print this help.\n";
+	std::cout << "Created by Jan Jelínek (jan.jelinek@biomed.cas.cz); last update: 2026-10-14; license: Apache License 2.0" << std::endl;
+	return (help || argc == 1) ? 0 : 1;
+  }
+  const char* genome_file = argv[argi];
+  const char* annotations_file = argv[argi + 1];
+
+  RunStats& run_stats = RunStats::global();
+  ResultCache& cache = ResultCache::global();
+  cache.setup("gc_content", argi, argv);
+  ResultCache::Result result = cache.result({ genome_file, annotations_file }, { "-" });
+  if (result.restore()) {
+	run_stats.add("reused_outputs", 1);
+	return run_stats.report() ? 0 : 9;
+  }
+  run_stats.start("genome load");
+  // Chromosome sequences
+  int error;
+  const Genome* genome = ReferenceCache::global().genome(genome_file, error);
+  if (genome == nullptr) {
+	return error;
+  }
+  const Genome& sequences = *genome;
+  run_stats.stop(sequences.sequence_count());
+
+  // UTR5, CDS, etc.
+  IdDictionary features;
+  // Pairs 'chromosome\tgene_id' (a gene is reported for each chromosome separately)
+  IdDictionary genes;
+  // Regions grouped by sequence indices of chromosomes
+  std::vector<std::vector<Region>> regions(sequences.sequence_count());
+  // Line number of each region (in the same layout), the first unsupported base is reported in the order of lines
+  std::vector<std::vector<size_t>> region_lines(sequences.sequence_count());
+  // Whether a (chromosome, gene) pair has a region of a feature type (present[feature][gene]); numbers of features and genes are not known in advance
+  std::vector<std::vector<bool>> present;
+  // Transcripts with exons (only for windows)
+  IdDictionary transcripts;
+  std::vector<TranscriptExons> transcript_exons;
+  // Marks that a (chromosome, gene) pair has a feature type
+  auto mark_present = [&present](const uint32_t gene, const uint32_t feature) {
+	if (present.size() <= feature) {
+	  present.resize(feature + 1);
+	}
+	if (present[feature].size() <= gene) {
+	  present[feature].resize(gene + 1, false);
+	}
+	present[feature][gene] = true;
+  };
+  // Marks a region of a feature type of a (chromosome, gene) pair and adds it to counted regions
+  auto add_region = [&](const size_t sequence_id, const Region& region, const size_t line_number) {
+	mark_present(region.gene, region.feature);
+	if (region.from < region.to) {
+	  regions[sequence_id].push_back(region);
+	  region_lines[sequence_id].push_back(line_number);
+	}
+  };
+  size_t line_number = 0;
+  run_stats.start("annotations load");
+  // Adds a region of a feature type (except genes and transcripts); the line (given by a function) is used only in error messages
+  auto add_annotation = [&](const GtfRecord& record, const auto& line) {
+	uint32_t feature = features.insert(record.feature);
+	bool strand = record.strand == '+';
+	uint32_t phase = record.phase == '.' ? Region::NO_PHASE : record.phase - '0';
+	// Chromosome where the current gene is
+	size_t sequence_id = sequences.find(record.seqname);
+	if (sequence_id == Genome::NONE) {
+	  std::cerr << "Missing sequence of chromosome '" << record.seqname << "' for a line within annotations file: '" << line() << "'." << std::endl;
+	  return 31;
+	}
+	if (record.start <= record.end && (record.start == 0 || record.end > sequences.length(sequence_id))) {
+	  std::cerr << "Region out of sequence of chromosome '" << record.seqname << "' in a line within annotations file: '" << line() << "'." << std::endl;
+	  return 32;
+	}
+	uint32_t gene = genes.insert(std::string(record.seqname) + '\t' + std::string(record.gene_id));
+	add_region(sequence_id, Region{ gene, feature, record.start - 1, record.end, phase, strand }, line_number);
+
+	if (record.feature == "exon" && !windows_file.empty() && record.start <= record.end) { // Exons of transcripts are kept for windows
+	  if (record.transcript_id.empty()) {
+		std::cerr << "Warning: missing 'transcript_id' field in an exon line within annotations file, the exon is not used for windows: '" << line() << "'." << std::endl;
+		run_stats.add("skipped_window_exons", 1);
+		return 0;
+	  }
+	  uint32_t transcript = transcripts.insert(record.transcript_id);
+	  if (transcript == transcript_exons.size()) {
+		transcript_exons.push_back(TranscriptExons{ sequence_id, gene, strand, {} });
+	  } else if (transcript_exons[transcript].sequence != sequence_id || transcript_exons[transcript].strand != strand) {
+		std::cerr << "Warning: ambiguous chromosome or strand for transcript '" << transcripts.name(transcript) << "', the exon is not used for windows: '" << line() << "'." << std::endl;
+		run_stats.add("skipped_window_exons", 1);
+		return 0;
+	  }
+	  transcript_exons[transcript].exons.emplace_back(record.start - 1, record.end);
+	}
+	return 0;
+  };
+  // Checks a parsed record of the annotations file (or its index) and adds it unless it is a gene or a transcript
+  auto add_record = [&](const GtfRecord& record, const auto& line) {
+	if (record.feature == "gene" || record.feature == "transcript") {
+	  return 0;
+	}
+	if (record.strand == '.') {
+	  std::cerr << "Unexpected strand format in a line within annotations file: '" << line() << "'." << std::endl;
+	  return 34;
+	}
+	if (record.gene_id.empty()) {
+	  std::cerr << "Missing 'gene_id' field in a line within annotations file: '" << line() << "'." << std::endl;
+	  return 8;
+	}
+	return add_annotation(record, line);
+  };
+  if (AnnotationIndex::is_annotation_index(annotations_file)) { // Annotations are already parsed
+	AnnotationIndex index;
+	if (!index.open(annotations_file)) {
+	  return 9;
+	}
+	int error = index.read([&](const uint64_t, const GtfRecord& record) {
+	  ++line_number;
+	  return add_record(record, [&record]() { return record.to_line(); });
+	}, [](const std::string_view) { return 0; });
+	if (error != 0) {
+	  return error;
+	}
+  } else { // Processing input GTF file
+	// Input GTF file
+	InputFile annotations_input;
+	if (!annotations_input.open(annotations_file)) {
+	  return 9;
+	}
+	GtfRecord record;
+	for (std::string line; annotations_input.getline(line); ) {
+	  ++line_number;
+	  if (line.empty()) {
+		std::cerr << "Unexpected empty line within annotations file '" << annotations_file << "'." << std::endl;
+		return 4;
+	  }
+	  if (line[0] != '#') { // It is not a comment
+		int error = record.parse(line);
+		if (error == 0) {
+		  error = add_record(record, [&line]() { return line; });
+		}
+		if (error != 0) {
+		  return error;
+		}
+	  }
+	}
+  }
+
+  run_stats.stop(line_number);
+
+  if (!windows_file.empty()) { // Windows around start and stop codons split into parts of exons
+	run_stats.start("windows load");
+	size_t annotation_lines = line_number;
+	uint32_t start_window = features.insert("start_window"), stop_window = features.insert("stop_window");
+	for (TranscriptExons& transcript : transcript_exons) {
+	  std::sort(transcript.exons.begin(), transcript.exons.end(), [&transcript](const std::pair<uint64_t, uint64_t>& a, const std::pair<uint64_t, uint64_t>& b) {
+		return transcript.strand ? a.first < b.first : a.first > b.first;
+	  });
+	}
+	// Tab-separated input file with lines in '<transcript_id>\t<start>\t<stop>' format
+	InputFile windows_input;
+	if (!windows_input.open(windows_file)) {
+	  return 9;
+	}
+	for (std::string line; windows_input.getline(line); ) {
+	  ++line_number;
+	  size_t tab_first = line.find('\t');
+	  size_t tab_second = tab_first == line.npos ? line.npos : line.find('\t', tab_first + 1);
+	  uint64_t codons_positions[2];
+	  if (tab_second == line.npos || !parse_integer(std::string_view(line).substr(tab_first + 1, tab_second - tab_first - 1), codons_positions[0])
+		|| !parse_integer(std::string_view(line).substr(tab_second + 1), codons_positions[1]) || codons_positions[0] == 0 || codons_positions[1] == 0) {
+		std::cerr << "Unexpected line format, three columns expected: " << line << std::endl;
+		continue;
+	  }
+	  uint32_t transcript = transcripts.find(std::string_view(line).substr(0, tab_first));
+	  if (transcript == IdDictionary::NONE) {
+		std::cerr << "Transcript '" << line.substr(0, tab_first) << "' is missing in the annotations file" << std::endl;
+		continue;
+	  }
+	  const TranscriptExons& exons = transcript_exons[transcript];
+	  for (size_t i = 0; i < 2; ++i) {
+		// 0-based position of the codon in transcript coordinates
+		uint64_t codon = codons_positions[i] - 1;
+		uint32_t feature = i == 0 ? start_window : stop_window;
+		exons.project(codon >= flank ? codon - flank : 0, codon + flank, [&](const uint64_t from, const uint64_t to, const uint64_t start) {
+		  uint32_t phase = (uint32_t)((codon + 3 - start % 3) % 3);
+		  add_region(exons.sequence, Region{ exons.gene, feature, from, to, phase, exons.strand }, line_number);
+		});
+		mark_present(exons.gene, feature); // Windows out of exons are still reported
+	  }
+	}
+	run_stats.stop(line_number - annotation_lines);
+  }
+
+  run_stats.start("counting");
+  size_t region_count = 0;
+  for (const std::vector<Region>& sequence_regions : regions) {
+	region_count += sequence_regions.size();
+  }
+  run_stats.add("regions", region_count);
+  run_stats.add("genes", genes.size());
+  run_stats.add("feature_types", features.size());
+
+  // Base counts of (chromosome, gene) pairs and feature types (at index gene * features + feature); chromosomes write disjoint items
+  std::vector<BaseCounts> stats(genes.size() * features.size());
+  // Number of distinct k-mers
+  const size_t kmers = kmer == 0 ? 0 : (size_t)1 << (2 * kmer);
+  // K-mer counts of (chromosome, gene) pairs and feature types (at index (gene * features + feature) * kmers + code)
+  std::vector<uint32_t> kmer_counts(stats.size() * kmers, 0);
+  // The first line with an unsupported base and the base for each chromosome (0 if there is none)
+  std::vector<std::pair<size_t, char>> unsupported(sequences.sequence_count(), std::pair<size_t, char>(0, 0));
+  parallel_for(sequences.sequence_count(), threads, [&](const size_t sequence_id) {
+	// Decoded bases of a region (only for a packed genome)
+	std::string buffer;
+	for (size_t i = 0; i < regions[sequence_id].size(); ++i) {
+	  const Region& region = regions[sequence_id][i];
+	  // Counts are taken without decoding a packed genome, bases of the current region are decoded only for k-mers and errors
+	  BaseCounts counts = sequences.base_counts(sequence_id, region.from, region.to);
+	  std::string_view sequence;
+	  if (!region.strand) { // Complementary counts if the gene is in a reverse strand
+		if (counts.others() > 0) {
+		  sequence = sequences.bases(sequence_id, region.from, region.to, buffer);
+		  char base = *std::find_if(sequence.begin(), sequence.end(), [](const char c) { return std::string_view(BaseCounts::BASES).find(c) == std::string_view::npos; });
+		  unsupported[sequence_id] = std::pair<size_t, char>(region_lines[sequence_id][i], base);
+		  break;
+		}
+		counts = counts.complement();
+	  }
+	  stats[region.gene * features.size() + region.feature] += counts;
+	  if (kmer > 0 && (!codons || region.phase != Region::NO_PHASE)) {
+		sequence = sequences.bases(sequence_id, region.from, region.to, buffer);
+		count_kmers(sequence, region.strand, kmer, codons ? 3 : 1, codons ? region.phase : 0, kmer_counts.data() + (region.gene * features.size() + region.feature) * kmers);
+	  }
+	}
+	return 0;
+  });
+  // The first unsupported base within the annotations file
+  std::pair<size_t, char> first(0, 0);
+  for (const std::pair<size_t, char>& base : unsupported) {
+	if (base.first > 0 && (first.first == 0 || base.first < first.first)) {
+	  first = base;
+	}
+  }
+  if (first.first > 0) {
+	std::cerr << "Unsuported base code: '" << first.second << "'." << std::endl;
+	return 30;
+  }
+  run_stats.stop(region_count);
+
+  // Feature types and (chromosome, gene) pairs are printed in the alphabetical order (genes within chromosomes)
+  std::vector<uint32_t> feature_order(features.size()), gene_order(genes.size());
+  for (uint32_t i = 0; i < feature_order.size(); ++i) {
+	feature_order[i] = i;
+  }
+  std::sort(feature_order.begin(), feature_order.end(), [&features](const uint32_t a, const uint32_t b) { return features.name(a) < features.name(b); });
+  for (uint32_t i = 0; i < gene_order.size(); ++i) {
+	gene_order[i] = i;
+  }
+  // Chromosome and gene_id of a pair
+  auto split = [&genes](const uint32_t gene) {
+	std::string_view key = genes.name(gene);
+	size_t tab = key.find('\t');
+	return std::pair<std::string_view, std::string_view>(key.substr(0, tab), key.substr(tab + 1));
+  };
+  std::sort(gene_order.begin(), gene_order.end(), [&split](const uint32_t a, const uint32_t b) { return split(a) < split(b); });
+
+  run_stats.start("output");
+  OutputFile output;
+  output.set_threads(threads);
+  if (!output.open(result.target(0), compression)) {
+	return 9;
+  }
+  // Rows are formatted by a stream to keep the default formatting of frequencies
+  std::ostringstream row;
+  // Print header
+  row << "gene_id";
+  for (uint32_t feature : feature_order) {
+	row << '\t' << features.name(feature);
+  }
+  // K-mers in the order of their codes
+  std::vector<std::string> kmer_names(kmers, std::string(kmer, 'A'));
+  for (size_t code = 0; code < kmers; ++code) {
+	for (size_t i = 0; i < kmer; ++i) {
+	  kmer_names[code][kmer - 1 - i] = "ACGT"[(code >> (2 * i)) & 3];
+	}
+  }
+  for (uint32_t feature : feature_order) {
+	for (const std::string& name : kmer_names) {
+	  row << '\t' << features.name(feature) << '_' << name;
+	}
+  }
+  // Print stats
+  for (uint32_t gene : gene_order) {
+	output.write(row.str());
+	row.str(std::string());
+	row << '\n' << split(gene).second;
+	for (uint32_t feature : feature_order) {
+	  if (present.size() <= feature || present[feature].size() <= gene || !present[feature][gene]) { // The current gene has no region of the current feature type
+		row << "\tNA";
+	  } else {
+		const BaseCounts& stat = stats[gene * features.size() + feature];
+		uint64_t gc = stat.c() + stat.g();
+		uint64_t all = gc + stat.a() + stat.t() + stat.u(); // Ns are ignored for the stats.
+		if (all == 0) { // Only Ns
+		  row << "\tNA";
+		} else {
+		  row << '\t' << 1.0 * gc / all;
+		}
+	  }
+	}
+	for (uint32_t feature : feature_order) {
+	  if (present.size() <= feature || present[feature].size() <= gene || !present[feature][gene]) {
+		for (size_t code = 0; code < kmers; ++code) {
+		  row << "\tNA";
+		}
+		continue;
+	  }
+	  const uint32_t* counts = kmer_counts.data() + (gene * features.size() + feature) * kmers;
+	  uint64_t total = 0;
+	  for (size_t code = 0; code < kmers; ++code) {
+		total += counts[code];
+	  }
+	  for (size_t code = 0; code < kmers; ++code) { // No k-mer is counted e.g. in features without phases (codons) or shorter than k-mers
+		if (total == 0) {
+		  row << "\tNA";
+		} else {
+		  row << '\t' << 1.0 * counts[code] / total;
+		}
+	  }
+	}
+  }
+  row << '\n';
+  output.write(row.str());
+  if (!output.close() || !result.store()) {
+	return 9;
+  }
+  run_stats.stop(gene_order.size());
+  return run_stats.report() ? 0 : 9;
+}
@@ -0,0 +1,367 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef GENOME_FILE_H
+#define GENOME_FILE_H
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+#include "base_counts.h"
+#include "compressed_io.h"
+#include "id_dictionary.h"
+#include "mapped_file.h"
+
+/// <summary>
+/// Packed genome format (written by pack_genome), all numbers are little-endian:
+/// - magic "RPGENOM1";
+/// - for each sequence: bases packed by 2 bits (A = 0, C = 1, G = 2, T = 3; the first base in the lowest bits of a byte),
+///   runs (uint64 start, uint32 length, uint32 upper-case character) of exceptions, i.e. characters other than A, C, G, T (e.g. N),
+///   and runs (uint64 start, uint32 length, uint32 0) of lower-case (soft-masked) bases;
+/// - sequence names concatenated;
+/// - index: for each sequence (in the FASTA order) uint64 offset and length of its name, uint64 length of the sequence,
+///   uint64 offset of packed bases, uint64 offset and number of exception runs, uint64 offset and number of lower-case runs;
+/// - trailer: uint64 offset of the index, uint64 number of sequences.
+/// So the original sequence (including N runs, IUPAC codes and soft-masking) is restored exactly.
+/// </summary>
+namespace genome_format {
+  const char MAGIC[] = "RPGENOM1";
+  const size_t HEADER_SIZE = 8;
+  const size_t INDEX_ENTRY_SIZE = 64;
+  const size_t TRAILER_SIZE = 16;
+  const size_t RUN_SIZE = 16;
+
+  /// <summary>
+  /// 2-bit code of an upper-case base, or 4 for an exception.
+  /// </summary>
+  inline unsigned code(const char base) {
+    switch (base) {
+      case 'A': return 0;
+      case 'C': return 1;
+      case 'G': return 2;
+      case 'T': return 3;
+      default: return 4;
+    }
+  }
+}
+
+/// <summary>
+/// Reads sequences from a file in FASTA format (optionally gzip-compressed); names are the first space-separated parts of header lines (Ensembl format).
+/// </summary>
+/// <param name="filename">The FASTA file.</param>
+/// <param name="on_sequence">Function called with a name at the start of each sequence; it returns 0, or an error code to stop reading.</param>
+/// <param name="on_bases">Function called with each line of bases of the current sequence.</param>
+/// <returns>0 if no error occured; otherwise the error code to be returned from the program.</returns>
+template <typename OnSequence, typename OnBases>
+int read_fasta(const std::string& filename, OnSequence on_sequence, OnBases on_bases) {
+  InputFile input;
+  if (!input.open(filename)) {
+    return 9;
+  }
+  bool started = false;
+  for (std::string line; input.getline(line); ) {
+    if (line.empty()) {
+      std::cerr << "Unexpected empty line within sequences file '" << filename << "'." << std::endl;
+      return 2;
+    }
+    if (line[0] == '>') { // Header line
+      // Trim '>' from header line and take first space-separated part (Ensembl format)
+      size_t sep = line.find(' ', 1);
+      int error = on_sequence(line.substr(1, sep == line.npos ? line.npos : sep - 1));
+      if (error != 0) {
+        return error;
+      }
+      started = true;
+    } else {
+      if (!started) { // Bases without a header form a sequence with an empty name
+        int error = on_sequence(std::string());
+        if (error != 0) {
+          return error;
+        }
+        started = true;
+      }
+      on_bases(std::string_view(line));
+    }
+  }
+  return input.failed() ? 10 : 0;
+}
+
+/// <summary>
+/// Genome sequences either loaded from a FASTA file, or mapped into memory from a packed genome file.
+/// </summary>
+class Genome {
+public:
+  static constexpr size_t NONE = SIZE_MAX;
+
+private:
+  /// <summary>
+  /// Names of sequences (ids are indices of sequences).
+  /// </summary>
+  IdDictionary names;
+  /// <summary>
+  /// Sequences loaded from a FASTA file.
+  /// </summary>
+  std::vector<std::string> sequences;
+
+  /// <summary>
+  /// Mapped packed genome file.
+  /// </summary>
+  MappedFile file;
+  size_t index = 0;
+  size_t count = 0;
+
+  template <typename T>
+  inline T get(const size_t offset) const { return file.get<T>(offset); }
+
+  inline size_t entry(const size_t sequence) const { return index + sequence * genome_format::INDEX_ENTRY_SIZE; }
+
+  bool invalid(const std::string& filename) {
+    std::cerr << "Unexpected file format: corrupted packed genome file '" << filename << "'" << std::endl;
+    close();
+    return false;
+  }
+
+  /// <summary>
+  /// Applies runs overlapping [from; to) to the decoded bases.
+  /// </summary>
+  template <typename Apply>
+  void apply_runs(const size_t offset, const size_t runs, const uint64_t from, const uint64_t to, Apply apply) const {
+    // The first run, which ends after from
+    size_t low = 0, high = runs;
+    while (low < high) {
+      size_t middle = low + (high - low) / 2;
+      size_t run = offset + middle * genome_format::RUN_SIZE;
+      if (get<uint64_t>(run) + get<uint32_t>(run + 8) <= from) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    for (size_t i = low; i < runs; ++i) {
+      size_t run = offset + i * genome_format::RUN_SIZE;
+      uint64_t start = get<uint64_t>(run);
+      if (start >= to) {
+        break;
+      }
+      apply(run, std::max(start, from), std::min(start + get<uint32_t>(run + 8), to));
+    }
+  }
+
+  /// <summary>
+  /// Adds (or subtracts) counts of 2-bit codes of packed bases [from; to) to A, C, G and T counts; codes are counted by popcounts of 32 bases at once.
+  /// </summary>
+  void add_packed_counts(const unsigned char* packed, uint64_t from, const uint64_t to, const bool subtract, uint64_t* counts) const {
+    constexpr uint64_t LOW = 0x5555555555555555ULL;
+    uint64_t local[4] = { 0 };
+    for (; from < to && (from & 3) != 0; ++from) {
+      ++local[(packed[from >> 2] >> ((from & 3) << 1)) & 3];
+    }
+    for (; from + 32 <= to; from += 32) {
+      uint64_t word;
+      std::memcpy(&word, packed + (from >> 2), sizeof(word));
+      uint64_t low = word & LOW, high = (word >> 1) & LOW;
+      local[0] += (uint64_t)__builtin_popcountll(~(low | high) & LOW);
+      local[1] += (uint64_t)__builtin_popcountll(low & ~high);
+      local[2] += (uint64_t)__builtin_popcountll(high & ~low);
+      local[3] += (uint64_t)__builtin_popcountll(low & high);
+    }
+    for (; from < to; ++from) {
+      ++local[(packed[from >> 2] >> ((from & 3) << 1)) & 3];
+    }
+    for (size_t i = 0; i < 4; ++i) {
+      counts[i] = subtract ? counts[i] - local[i] : counts[i] + local[i];
+    }
+  }
+
+  /// <summary>
+  /// Adds (or subtracts) counts of upper-case bases [from; to) of a packed sequence (exceptions replace packed bases, lower-case runs are ignored).
+  /// </summary>
+  void add_upper_counts(const size_t e, const uint64_t from, const uint64_t to, const bool subtract, uint64_t* counts) const {
+    const unsigned char* packed = file.data() + get<uint64_t>(e + 24);
+    add_packed_counts(packed, from, to, subtract, counts);
+    apply_runs(get<uint64_t>(e + 32), get<uint64_t>(e + 40), from, to, [&](const size_t run, const uint64_t run_from, const uint64_t run_to) {
+      add_packed_counts(packed, run_from, run_to, !subtract, counts);
+      const char* base = std::find(BaseCounts::BASES, BaseCounts::BASES + BaseCounts::SIZE, (char)get<uint32_t>(run + 12));
+      if (base != BaseCounts::BASES + BaseCounts::SIZE) {
+        uint64_t& count = counts[base - BaseCounts::BASES];
+        count = subtract ? count - (run_to - run_from) : count + (run_to - run_from);
+      }
+    });
+  }
+
+public:
+  Genome() {}
+  Genome(const Genome&) = delete;
+  Genome& operator=(const Genome&) = delete;
+  ~Genome() { close(); }
+
+  /// <summary>
+  /// Whether a file is a packed genome (judged by its magic).
+  /// </summary>
+  static bool is_packed(const std::string& filename) {
+    return MappedFile::has_magic(filename, genome_format::MAGIC);
+  }
+
+  /// <summary>
+  /// Loads a genome from a packed genome file (mapped into memory), or from a FASTA file.
+  /// </summary>
+  /// <param name="filename">The packed genome or FASTA file.</param>
+  /// <returns>0 if no error occured; otherwise the error code to be returned from the program.</returns>
+  int load(const std::string& filename) {
+    if (is_packed(filename)) {
+      return open_packed(filename) ? 0 : 9;
+    }
+    return load_fasta(filename);
+  }
+
+  /// <summary>
+  /// Loads all sequences from a FASTA file into memory.
+  /// </summary>
+  /// <param name="filename">The FASTA file.</param>
+  /// <returns>0 if no error occured; otherwise the error code to be returned from the program.</returns>
+  int load_fasta(const std::string& filename) {
+    close();
+    return read_fasta(filename, [this](const std::string& name) {
+      if (names.insert(name) != sequences.size()) {
+        std::cerr << "Multiple sequences with the same id '" << name << "'." << std::endl;
+        return 3;
+      }
+      sequences.emplace_back();
+      return 0;
+    }, [this](const std::string_view bases) {
+      sequences.back().append(bases);
+    });
+  }
+
+  /// <summary>
+  /// Maps a packed genome file into memory and checks its index.
+  /// </summary>
+  /// <param name="filename">The packed genome file.</param>
+  /// <returns>TRUE if the file was opened.</returns>
+  bool open_packed(const std::string& filename) {
+    close();
+    if (!file.open(filename)) {
+      return false;
+    }
+    if (!file.starts_with(genome_format::MAGIC, genome_format::HEADER_SIZE + genome_format::TRAILER_SIZE)) {
+      return invalid(filename);
+    }
+    const size_t size = file.size();
+    index = (size_t)get<uint64_t>(size - genome_format::TRAILER_SIZE);
+    count = (size_t)get<uint64_t>(size - genome_format::TRAILER_SIZE + 8);
+    if (index < genome_format::HEADER_SIZE || index > size - genome_format::TRAILER_SIZE || (size - genome_format::TRAILER_SIZE - index) / genome_format::INDEX_ENTRY_SIZE != count) {
+      return invalid(filename);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      size_t e = entry(i);
+      if (get<uint64_t>(e) > index || get<uint64_t>(e + 8) > index - get<uint64_t>(e)
+        || get<uint64_t>(e + 24) > index || (get<uint64_t>(e + 16) + 3) / 4 > index - get<uint64_t>(e + 24)
+        || get<uint64_t>(e + 32) > index || get<uint64_t>(e + 40) > (index - get<uint64_t>(e + 32)) / genome_format::RUN_SIZE
+        || get<uint64_t>(e + 48) > index || get<uint64_t>(e + 56) > (index - get<uint64_t>(e + 48)) / genome_format::RUN_SIZE) {
+        return invalid(filename);
+      }
+      std::string_view name((const char*)file.data() + get<uint64_t>(e), get<uint64_t>(e + 8));
+      if (names.insert(name) != i) {
+        std::cerr << "Multiple sequences with the same id '" << name << "'." << std::endl;
+        return invalid(filename);
+      }
+    }
+    return true;
+  }
+
+  /// <summary>
+  /// Releases all sequences.
+  /// </summary>
+  void close() {
+    file.close();
+    index = count = 0;
+    names.clear();
+    sequences.clear();
+  }
+
+  /// <summary>
+  /// Number of sequences.
+  /// </summary>
+  inline size_t sequence_count() const { return names.size(); }
+
+  /// <summary>
+  /// Name of a sequence.
+  /// </summary>
+  inline std::string_view name(const size_t sequence) const { return names.name((uint32_t)sequence); }
+
+  /// <summary>
+  /// Finds a sequence by its name.
+  /// </summary>
+  /// <returns>Index of the sequence, or NONE if it is missing.</returns>
+  inline size_t find(const std::string_view name) const {
+    uint32_t id = names.find(name);
+    return id == IdDictionary::NONE ? NONE : id;
+  }
+
+  /// <summary>
+  /// Length of a sequence.
+  /// </summary>
+  inline uint64_t length(const size_t sequence) const {
+    return !file.is_open() ? sequences[sequence].size() : get<uint64_t>(entry(sequence) + 16);
+  }
+
+  /// <summary>
+  /// Returns bases of a part of a sequence as they are in the FASTA file.
+  /// </summary>
+  /// <param name="sequence">Index of the sequence.</param>
+  /// <param name="from">0-based start of the part.</param>
+  /// <param name="to">0-based end of the part (exclusive); it must not exceed the length of the sequence.</param>
+  /// <param name="buffer">Buffer for decoded bases, the result points into it for a packed genome.</param>
+  /// <returns>The bases; valid until the buffer is changed.</returns>
+  std::string_view bases(const size_t sequence, const uint64_t from, const uint64_t to, std::string& buffer) const {
+    if (!file.is_open()) {
+      return std::string_view(sequences[sequence]).substr(from, to - from);
+    }
+    static const char BASES[] = "ACGT";
+    size_t e = entry(sequence);
+    const unsigned char* packed = file.data() + get<uint64_t>(e + 24);
+    buffer.resize(to - from);
+    for (uint64_t i = from; i < to; ++i) {
+      buffer[i - from] = BASES[(packed[i >> 2] >> ((i & 3) << 1)) & 3];
+    }
+    apply_runs(get<uint64_t>(e + 32), get<uint64_t>(e + 40), from, to, [&](const size_t run, const uint64_t run_from, const uint64_t run_to) {
+      std::fill(buffer.begin() + (run_from - from), buffer.begin() + (run_to - from), (char)get<uint32_t>(run + 12));
+    });
+    apply_runs(get<uint64_t>(e + 48), get<uint64_t>(e + 56), from, to, [&](const size_t, const uint64_t run_from, const uint64_t run_to) {
+      for (uint64_t i = run_from; i < run_to; ++i) {
+        buffer[i - from] = (char)std::tolower((unsigned char)buffer[i - from]);
+      }
+    });
+    return buffer;
+  }
+
+  /// <summary>
+  /// Counts bases of a part of a sequence like count_bases of its bases; a packed sequence is counted without decoding it.
+  /// </summary>
+  /// <param name="sequence">Index of the sequence.</param>
+  /// <param name="from">0-based start of the part.</param>
+  /// <param name="to">0-based end of the part (exclusive); it must not exceed the length of the sequence.</param>
+  /// <returns>The counts.</returns>
+  BaseCounts base_counts(const size_t sequence, const uint64_t from, const uint64_t to) const {
+    if (!file.is_open()) {
+      return count_bases(std::string_view(sequences[sequence]).substr(from, to - from));
+    }
+    BaseCounts result;
+    result.length = to - from;
+    size_t e = entry(sequence);
+    add_upper_counts(e, from, to, false, result.counts);
+    // Lower-case bases are not counted (like other characters)
+    apply_runs(get<uint64_t>(e + 48), get<uint64_t>(e + 56), from, to, [&](const size_t, const uint64_t run_from, const uint64_t run_to) {
+      add_upper_counts(e, run_from, run_to, true, result.counts);
+    });
+    return result;
+  }
+};
+
+#endif
@@ -0,0 +1,181 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef ID_DICTIONARY_H
+#define ID_DICTIONARY_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// <summary>
+/// Dictionary of interned identifiers (e.g. transcript_ids or gene_ids) with dense integer ids 0, 1, ..., size() - 1 in the order of insertion.
+/// All names are stored once in a single buffer and they are looked up by an open-addressing hash table directly by string views.
+/// </summary>
+class IdDictionary {
+public:
+  /// <summary>
+  /// Id returned for unknown names.
+  /// </summary>
+  static constexpr uint32_t NONE = UINT32_MAX;
+
+private:
+  /// <summary>
+  /// Concatenated names.
+  /// </summary>
+  std::string buffer;
+  /// <summary>
+  /// Start offsets of names within the buffer (and the end of the last name).
+  /// </summary>
+  std::vector<size_t> starts = { 0 };
+  /// <summary>
+  /// Hash values of names (in the order of ids).
+  /// </summary>
+  std::vector<uint64_t> hashes;
+  /// <summary>
+  /// Hash table with linear probing; slots contain ids, or NONE for empty slots. Its size is a power of 2.
+  /// </summary>
+  std::vector<uint32_t> slots;
+
+  /// <summary>
+  /// FNV-1a hash.
+  /// </summary>
+  static inline uint64_t hash(const std::string_view name) {
+    uint64_t value = 14695981039346656037ULL;
+    for (char c : name) {
+      value = (value ^ (unsigned char)c) * 1099511628211ULL;
+    }
+    return value ^ (value >> 32);
+  }
+
+  /// <summary>
+  /// Returns the slot containing the name, or the empty slot, where it should be inserted.
+  /// </summary>
+  inline size_t slot(const std::string_view name, const uint64_t name_hash) const {
+    size_t mask = slots.size() - 1;
+    for (size_t i = name_hash & mask; ; i = (i + 1) & mask) {
+      uint32_t id = slots[i];
+      if (id == NONE || (hashes[id] == name_hash && this->name(id) == name)) {
+        return i;
+      }
+    }
+  }
+
+  /// <summary>
+  /// Doubles the hash table, all ids are preserved.
+  /// </summary>
+  void grow() {
+    slots.assign(slots.empty() ? 16 : 2 * slots.size(), NONE);
+    size_t mask = slots.size() - 1;
+    for (uint32_t id = 0; id < hashes.size(); ++id) {
+      size_t i = hashes[id] & mask;
+      while (slots[i] != NONE) {
+        i = (i + 1) & mask;
+      }
+      slots[i] = id;
+    }
+  }
+
+public:
+  /// <summary>
+  /// Number of names.
+  /// </summary>
+  inline size_t size() const {
+    return hashes.size();
+  }
+
+  /// <summary>
+  /// Returns the name of an id.
+  /// </summary>
+  /// <param name="id">Valid id.</param>
+  /// <returns>The name, it is valid until the next insertion.</returns>
+  inline std::string_view name(const uint32_t id) const {
+    return std::string_view(buffer.data() + starts[id], starts[id + 1] - starts[id]);
+  }
+
+  /// <summary>
+  /// Returns the id of a name.
+  /// </summary>
+  /// <param name="name">The name.</param>
+  /// <returns>The id, or NONE if the name is unknown.</returns>
+  inline uint32_t find(const std::string_view name) const {
+    return slots.empty() ? NONE : slots[slot(name, hash(name))];
+  }
+
+  /// <summary>
+  /// Returns the id of a name; unknown names get a new id.
+  /// </summary>
+  /// <param name="name">The name.</param>
+  /// <returns>The id.</returns>
+  uint32_t insert(const std::string_view name) {
+    uint64_t name_hash = hash(name);
+    if (2 * (hashes.size() + 1) > slots.size()) { // Load factor is kept at most 1/2
+      grow();
+    }
+    size_t i = slot(name, name_hash);
+    if (slots[i] == NONE) {
+      slots[i] = (uint32_t)hashes.size();
+      hashes.push_back(name_hash);
+      buffer.append(name);
+      starts.push_back(buffer.size());
+    }
+    return slots[i];
+  }
+
+  /// <summary>
+  /// Removes all names.
+  /// </summary>
+  void clear() {
+    buffer.clear();
+    starts.assign(1, 0);
+    hashes.clear();
+    slots.clear();
+  }
+};
+
+/// <summary>
+/// Mapping transcript_id => gene_id, in which both kinds of ids are interned and genes are identified by dense integer ids.
+/// </summary>
+struct TranscriptGenes {
+  /// <summary>
+  /// Known transcript_ids.
+  /// </summary>
+  IdDictionary transcripts;
+  /// <summary>
+  /// Known gene_ids.
+  /// </summary>
+  IdDictionary genes;
+  /// <summary>
+  /// Gene ids of transcripts (in the order of transcript ids).
+  /// </summary>
+  std::vector<uint32_t> transcript_genes;
+
+  /// <summary>
+  /// Assigns a gene to a transcript; an already known transcript is assigned to the new gene.
+  /// </summary>
+  /// <param name="transcript_id">The transcript_id.</param>
+  /// <param name="gene_id">The gene_id.</param>
+  void add(const std::string_view transcript_id, const std::string_view gene_id) {
+    uint32_t transcript = transcripts.insert(transcript_id);
+    uint32_t gene = genes.insert(gene_id);
+    if (transcript == transcript_genes.size()) {
+      transcript_genes.push_back(gene);
+    } else {
+      transcript_genes[transcript] = gene;
+    }
+  }
+
+  /// <summary>
+  /// Returns the gene id of a transcript.
+  /// </summary>
+  /// <param name="transcript_id">The transcript_id.</param>
+  /// <returns>The gene id, or IdDictionary::NONE if the transcript is unknown.</returns>
+  inline uint32_t gene(const std::string_view transcript_id) const {
+    uint32_t transcript = transcripts.find(transcript_id);
+    return transcript == IdDictionary::NONE ? IdDictionary::NONE : transcript_genes[transcript];
+  }
+};
+
+#endif
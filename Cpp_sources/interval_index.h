@@ -0,0 +1,239 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef INTERVAL_INDEX_H
+#define INTERVAL_INDEX_H
+
+#include <cstdint>
+#include <algorithm>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "id_dictionary.h"
+
+/// <summary>
+/// Genomic intervals of all references (chromosomes) with values, which finds intervals overlapping a position or a range.
+/// Intervals of a reference are stored in a single array sorted by starts, which is an implicit augmented interval tree at the same time
+/// (the layout of cgranges by Heng Li): the node at index i has the level of the number of trailing 1-bits of i, its children are
+/// i -/+ 2^(level - 1), and each node stores the largest end within its subtree. So no pointers are stored and queries read consecutive memory.
+/// </summary>
+/// <typeparam name="Value">Value of an interval (e.g. an id of a transcript or of a feature).</typeparam>
+template <typename Value>
+class IntervalIndex {
+public:
+  static constexpr uint32_t NONE = IdDictionary::NONE;
+
+  struct Interval {
+    /// <summary>
+    /// 1-based boundaries [from; to].
+    /// </summary>
+    uint64_t from, to;
+    /// <summary>
+    /// The largest end within the subtree of the node (valid after build()).
+    /// </summary>
+    uint64_t max;
+    Value value;
+  };
+
+private:
+  /// <summary>
+  /// Names of references; their ids index intervals and levels.
+  /// </summary>
+  IdDictionary references;
+  std::vector<std::vector<Interval>> intervals;
+  /// <summary>
+  /// Level of the root of each reference (-1 if it has no interval).
+  /// </summary>
+  std::vector<int> levels;
+
+  /// <summary>
+  /// Sorts intervals of a reference and computes ends of subtrees; nodes after the end of the array are virtual
+  /// and take the largest end of the last node.
+  /// </summary>
+  /// <returns>Level of the root.</returns>
+  static int build(std::vector<Interval>& items) {
+    const size_t n = items.size();
+    if (n == 0) {
+      return -1;
+    }
+    std::sort(items.begin(), items.end(), [](const Interval& a, const Interval& b) { return a.from < b.from || (a.from == b.from && a.to < b.to); });
+    size_t last_i = 0;
+    uint64_t last = 0;
+    for (size_t i = 0; i < n; i += 2) {
+      last_i = i;
+      last = items[i].max = items[i].to;
+    }
+    int level = 1;
+    for (; ((size_t)1 << level) <= n; ++level) {
+      const size_t x = (size_t)1 << (level - 1), step = x << 2;
+      for (size_t i = (x << 1) - 1; i < n; i += step) {
+        uint64_t left = items[i - x].max, right = i + x < n ? items[i + x].max : last;
+        items[i].max = std::max(items[i].to, std::max(left, right));
+      }
+      last_i = (last_i >> level) & 1 ? last_i - x : last_i + x;
+      if (last_i < n && items[last_i].max > last) {
+        last = items[last_i].max;
+      }
+    }
+    return level - 1;
+  }
+
+public:
+  /// <summary>
+  /// Returns id of a reference, or NONE if it was not added.
+  /// </summary>
+  inline uint32_t reference(const std::string_view name) const {
+    return references.find(name);
+  }
+
+  /// <summary>
+  /// Number of references.
+  /// </summary>
+  inline uint32_t size() const {
+    return (uint32_t)intervals.size();
+  }
+
+  /// <summary>
+  /// Intervals of a reference sorted by starts (after build()).
+  /// </summary>
+  inline const std::vector<Interval>& items(const uint32_t reference) const {
+    return intervals[reference];
+  }
+
+  /// <summary>
+  /// Adds a reference (e.g. to have the same ids as another dictionary of references), it may have no interval.
+  /// </summary>
+  /// <returns>Id of the reference.</returns>
+  uint32_t add_reference(const std::string_view reference) {
+    uint32_t id = references.insert(reference);
+    if (id == intervals.size()) {
+      intervals.emplace_back();
+    }
+    return id;
+  }
+
+  /// <summary>
+  /// Adds an interval; queries are possible only after build().
+  /// </summary>
+  /// <param name="reference">Name of the reference.</param>
+  /// <param name="from">1-based start.</param>
+  /// <param name="to">1-based end (inclusive).</param>
+  /// <param name="value">Value of the interval.</param>
+  void add(const std::string_view reference, const uint64_t from, const uint64_t to, const Value& value) {
+    intervals[add_reference(reference)].push_back(Interval{ from, to, to, value });
+  }
+
+  /// <summary>
+  /// Builds trees of all references, when all intervals are added.
+  /// </summary>
+  void build() {
+    levels.resize(intervals.size());
+    for (size_t i = 0; i < intervals.size(); ++i) {
+      levels[i] = build(intervals[i]);
+    }
+  }
+
+  /// <summary>
+  /// Finds all intervals overlapping a range.
+  /// </summary>
+  /// <param name="reference">Id of the reference.</param>
+  /// <param name="from">1-based start of the range.</param>
+  /// <param name="to">1-based end of the range (inclusive).</param>
+  /// <param name="callback">Function taking an overlapping interval; intervals are reported in the order of starts.</param>
+  template <typename Callback>
+  void overlaps(const uint32_t reference, const uint64_t from, const uint64_t to, Callback callback) const {
+    const std::vector<Interval>& items = intervals[reference];
+    const size_t n = items.size();
+    if (n == 0) {
+      return;
+    }
+    // Nodes to be visited: index, level and whether its left subtree was already visited; at most two nodes per level are waiting
+    struct Node {
+      size_t x;
+      int level;
+      bool left_done;
+    } stack[2 * 64];
+    size_t t = 0;
+    stack[t++] = Node{ ((size_t)1 << levels[reference]) - 1, levels[reference], false };
+    while (t > 0) {
+      Node node = stack[--t];
+      if (node.level <= 3) { // Small subtrees are scanned linearly
+        size_t i = node.x >> node.level << node.level, end = std::min(n, i + ((size_t)1 << (node.level + 1)) - 1);
+        for (; i < end && items[i].from <= to; ++i) {
+          if (from <= items[i].to) {
+            callback(items[i]);
+          }
+        }
+      } else if (!node.left_done) {
+        // The left child may be virtual (after the end of the array), then its subtree is visited anyway
+        size_t y = node.x - ((size_t)1 << (node.level - 1));
+        stack[t++] = Node{ node.x, node.level, true };
+        if (y >= n || items[y].max >= from) {
+          stack[t++] = Node{ y, node.level - 1, false };
+        }
+      } else if (node.x < n && items[node.x].from <= to) {
+        if (from <= items[node.x].to) {
+          callback(items[node.x]);
+        }
+        stack[t++] = Node{ node.x + ((size_t)1 << (node.level - 1)), node.level - 1, false };
+      }
+    }
+  }
+
+  /// <summary>
+  /// Finds intervals overlapping each of a batch of ranges of a reference. Ranges sorted by starts are joined with intervals in a single sweep:
+  /// intervals are visited in the order of starts once, only those overlapping a range are kept active for the next ranges, and intervals starting
+  /// in a gap between ranges are skipped by a binary search (the long ones reaching the next range are found in the tree). Unsorted ranges are queried one by one.
+  /// </summary>
+  /// <param name="reference">Id of the reference.</param>
+  /// <param name="ranges">1-based ranges [from; to].</param>
+  /// <param name="count">Number of ranges.</param>
+  /// <param name="callback">Function taking an index of a range and an interval overlapping it; intervals of a range are reported in the order of starts.</param>
+  template <typename Callback>
+  void overlaps(const uint32_t reference, const std::pair<uint64_t, uint64_t>* ranges, const size_t count, Callback callback) const {
+    if (!std::is_sorted(ranges, ranges + count, [](const auto& a, const auto& b) { return a.first < b.first; })) {
+      for (size_t i = 0; i < count; ++i) {
+        overlaps(reference, ranges[i].first, ranges[i].second, [&](const Interval& interval) { callback(i, interval); });
+      }
+      return;
+    }
+    const std::vector<Interval>& items = intervals[reference];
+    // Indices of visited intervals (before next), which may overlap the current and next ranges, in the order of starts
+    std::vector<size_t> active;
+    size_t next = 0;
+    for (size_t i = 0; i < count; ++i) {
+      const uint64_t from = ranges[i].first, to = ranges[i].second;
+      // Intervals ending before the range end before all next ranges too
+      active.erase(std::remove_if(active.begin(), active.end(), [&](const size_t x) { return items[x].to < from; }), active.end());
+      // Intervals starting before the range (in the gap after the previous one) overlap it only if they reach it
+      size_t first = std::lower_bound(items.begin() + next, items.end(), from, [](const Interval& interval, const uint64_t start) { return interval.from < start; }) - items.begin();
+      if (first - next <= 16) {
+        for (; next < first; ++next) {
+          if (items[next].to >= from) {
+            active.push_back(next);
+          }
+        }
+      } else {
+        overlaps(reference, from, from, [&](const Interval& interval) {
+          size_t x = &interval - items.data();
+          if (x >= next && x < first) {
+            active.push_back(x);
+          }
+        });
+        next = first;
+      }
+      // Intervals starting within the range
+      for (; next < items.size() && items[next].from <= to; ++next) {
+        active.push_back(next);
+      }
+      for (const size_t x : active) {
+        if (items[x].from <= to) {
+          callback(i, items[x]);
+        }
+      }
+    }
+  }
+};
+
+#endif
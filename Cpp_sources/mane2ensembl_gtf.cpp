@@ -1,25 +1,29 @@
 // Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
-// Last update: 2021-08-26
+// Last update: 2026-10-14
 // Released under Apache License 2.0
 
+#include <string>
+#include <string_view>
 #include <vector>
-#include <sstream>
 #include <iostream>
-#include <fstream>
+#include "annotation_index.h"
+#include "compressed_io.h"
+#include "run_stats.h"
+#include "strand.h"
 
 /// <summary>
-/// Determine, whether it is 5'UTR, or 3'UTR
+/// Determine, whether it is 5'UTR, or 3'UTR; boundaries are compared in the direction of the transcript, so both strands share the logic
 /// </summary>
-/// <param name="five_lower">UTR end for forward strand; start codon end for reverse strand</param>
-/// <param name="five_upper">Start codon begin for forward strand; UTR begin for reverse strand</param>
-/// <param name="three_lower">Stop codon begin for forward strand; UTR end for reverse strand</param>
-/// <param name="three_upper">UTR begin for forward strand; stop codon end for reverse strand</param>
+/// <param name="range">Boundaries of the current line</param>
+/// <param name="start_codon">Start codon boundaries</param>
+/// <param name="stop_codon">Stop codon boundaries</param>
 /// <param name="parts">Splitted line</param>
 /// <param name="transcript">The current transcript</param>
-void classify_utr(const size_t five_lower, const size_t five_upper, const size_t three_lower, const size_t three_upper, std::vector<std::string>& parts, const std::string& transcript) {
-  if (five_lower < five_upper) {
+template <typename S>
+void classify_utr(const size_t range[2], const size_t start_codon[2], const size_t stop_codon[2], std::vector<std::string>& parts, const std::string& transcript) {
+  if (S::three_prime(range[0], range[1]) < S::five_prime(start_codon[0], start_codon[1])) {
     parts[2] = "five_prime_utr";
-  } else if (three_lower <= three_upper) {
+  } else if (S::five_prime(stop_codon[0], stop_codon[1]) <= S::five_prime(range[0], range[1])) {
     parts[2] = "three_prime_utr";
   } else {
     std::cerr << "Unexpected file format - UTR region occures between start and stop codons for " << transcript << std::endl;
@@ -27,29 +31,29 @@ void classify_utr(const size_t five_lower, const size_t five_upper, const size_t
 }
 
 /// <summary>
-/// Remove stop codon from 3'UTR region
+/// Remove stop codon from 3'UTR region; boundaries are compared in the direction of the transcript, so both strands share the logic
 /// </summary>
 /// <param name="parts">The current line</param>
 /// <param name="trimmed">What length of 3'UTR was stripped of stop codon</param>
 /// <param name="range">Boundaries of the line</param>
-/// <param name="index">'0' for forward strand, '1' for reverse strand</param>
-/// <param name="lower">Boundaries of the current line for forward strand; stop codon boundaries for reverse strand</param>
-/// <param name="upper">Stop codon boundaries for forward strand; boundaries of the current line for reverse strand</param>
-/// <param name="new_boundary">New boundary of the current line if stop codon is removed</param>
+/// <param name="stop_codon">Stop codon boundaries</param>
 /// <param name="transcript">The current transcript</param>
 /// <returns>TRUE if line should be further processed; FALSE if it is completely covered by a stop codon</returns>
-bool adjust_boundaries(std::vector<std::string>& parts, size_t& trimmed, size_t range[2], 
-                       const size_t index, const size_t lower[2], const size_t upper[2], const size_t new_boundary, const std::string& transcript) {
-  if (lower[0] <= upper[1]) { // The current exon is not all after stop codon
+template <typename S>
+bool adjust_boundaries(std::vector<std::string>& parts, size_t& trimmed, size_t range[2], const size_t stop_codon[2], const std::string& transcript) {
+  // 3' end of the stop codon
+  const uint64_t stop_end = S::three_prime(stop_codon[0], stop_codon[1]);
+  if (S::five_prime(range[0], range[1]) <= stop_end) { // The current exon is not all after stop codon
     if (trimmed >= 3) { // Inconsistency in exons 
       std::cerr << transcript << " contains stop_codon longer than 3 bases";
     }
     trimmed += range[1] - range[0] + 1;
-    if (lower[1-index] <= upper[1-index]) { // The line is just a duplication of a stop_codon, can be omitted
+    if (S::three_prime(range[0], range[1]) <= stop_end) { // The line is just a duplication of a stop_codon, can be omitted
       return false;
     }
-    // Update boundaries of the 3'UTR
-    range[index] = new_boundary;
+    // Update the 5' boundary of the 3'UTR (the start on the forward strand, the end on the reverse one)
+    const size_t index = S::forward ? 0 : 1;
+    range[index] = S::orient(stop_end + 1);
     parts[index+3] = std::to_string(range[index]);
   }
   return true;
@@ -89,12 +93,13 @@ void init(const std::string& transcript, const size_t value, size_t start_codon[
 /// </summary>
 /// <param name="boundaries">Boundaries of the codon</param>
 /// <param name="length">Length of the codon</param>
-/// <param name="line">The current line</param>
+/// <param name="line">Function returning the current line, it is called only for error messages</param>
 /// <param name="parts">Splitted current line</param>
 /// <returns>TRUE if line should be further processed; FALSE if it should be skipped</returns>
-bool process_codon(size_t boundaries[2], size_t& length, const std::string& line, const std::vector<std::string>& parts, const std::string &codon) {
+template <typename Line>
+bool process_codon(size_t boundaries[2], size_t& length, const Line& line, const std::vector<std::string>& parts, const std::string &codon) {
   if (length == 3) { // It is already complete
-    std::cerr << "Unexpected file format - multiple " << codon << " codons: " << line << std::endl;
+    std::cerr << "Unexpected file format - multiple " << codon << " codons: " << line() << std::endl;
     return false;
   }
   // Update boundaries
@@ -109,29 +114,119 @@ bool process_codon(size_t boundaries[2], size_t& length, const std::string& line
   // Update length
   length += range[1] - range[0] + 1;
   if (length > 3) {
-    std::cerr << "Unexpected file format - strange " << codon << "_codon length: " << line << std::endl;
+    std::cerr << "Unexpected file format - strange " << codon << "_codon length: " << line() << std::endl;
   }
   return true;
 }
 
+/// <summary>
+/// Writes transformed attributes in a single pass: '*_id "id.version"' is split into '*_id "id"; *_version "version"'
+/// and '*_type' tags are replaced by '*_biotype'.
+/// </summary>
+/// <param name="attributes">The ninth attributes field.</param>
+/// <param name="result">The transformed attributes (output), its memory is reused.</param>
+/// <param name="line">Function returning the current line, it is called only for error messages</param>
+template <typename Line>
+void rewrite_attributes(const std::string_view attributes, std::string& result, const Line& line) {
+  result.clear();
+  // Attributes are copied up to this position
+  size_t copied = 0;
+  // Text from the last space before '_id "' to it, e.g. ' transcript'; the space can be within the already transformed part (as ids are split one by one)
+  auto key = [&](const size_t id) {
+    size_t space = attributes.rfind(' ', id);
+    if (space != attributes.npos && space >= copied) {
+      return std::string(attributes.substr(space, id - space));
+    }
+    space = result.rfind(' ');
+    return result.substr(space == result.npos ? 0 : space) + std::string(attributes.substr(copied, id - copied));
+  };
+  // The next '_id "', its dot to be replaced and the next '_type "'
+  size_t id = attributes.find("_id \""), dot = attributes.npos, type = attributes.find("_type \"");
+  while (id != attributes.npos || dot != attributes.npos || type != attributes.npos) {
+    if (dot == attributes.npos && id != attributes.npos) { // Check the id value first
+      dot = attributes.find('.', id + 5);
+      size_t quote = attributes.find('"', id + 5);
+      if (quote == attributes.npos) {
+        std::cerr << "Uncompleted value of '" << key(id) << "_id': " << line() << std::endl;
+      }
+      if (dot == attributes.npos || quote < dot) { // The value is kept
+        std::cerr << "Unexpected format of '" << key(id) << "_id': " << line() << std::endl;
+        dot = attributes.npos;
+        id = attributes.find("_id \"", id + 5);
+      }
+      continue;
+    }
+    if (dot != attributes.npos && (type == attributes.npos || dot < type)) {
+      size_t space = attributes.rfind(' ', id);
+      // Mostly the key follows a space after the previous attribute
+      bool separated = space != attributes.npos && space >= copied;
+      std::string prefix = separated ? std::string() : key(id);
+      result.append(attributes, copied, dot - copied);
+      result.append("\"; ");
+      if (separated) {
+        result.append(attributes, space, id - space);
+      } else {
+        result.append(prefix);
+      }
+      result.append("_version \"");
+      copied = dot + 1;
+      dot = attributes.npos;
+      id = attributes.find("_id \"", id + 5);
+    } else {
+      result.append(attributes, copied, type + 1 - copied);
+      result.append("bio");
+      copied = type + 1;
+      type = attributes.find("_type \"", type + 7);
+    }
+  }
+  result.append(attributes, copied);
+}
+
 int main(int argc, char* argv[]) {
-  if (argc != 3) {
-    std::cout << "mane2ensembl_gtf <input> <output>\tTakes MANE's annotations in GTF format for Ensembl identifiers from file <input>,\n";
+  // Compression of the output, by default implied by its extension
+  OutputFile::Compression compression = OutputFile::Compression::AUTO;
+  int argi = 1;
+  for (int previous = 0; previous != argi; ) {
+    previous = argi;
+    if (!parse_compression(argi, argc, argv, compression) || !parse_stats(argi, argc, argv)) {
+      return 1;
+    }
+  }
+  if (argc != argi + 2) {
+    std::cout << "mane2ensembl_gtf [--compress FORMAT] [--stats | --stats-json FILE] <input> <output>\tTakes MANE's annotations in GTF format for Ensembl identifiers from file <input>,\n";
     std::cout << "                                 \ttransform them to be consistent with annotations in GTF format provided by Ensembl\n";
-    std::cout << "                                 \tand store them in file <output>.\n\n";
+    std::cout << "                                 \tand store them in file <output>.\n";
+    std::cout << "                                 \t<input> can be also gzip-compressed, or an annotation index compiled by compile_annotations.\n";
+    std::cout << "                                 \t --compress FORMAT\t compress <output> by 'gzip' (BGZF), 'zstd' or 'none'; by default\n";
+    std::cout << "                                 \t                  \t <output> ending with '.gz' or '.zst' is compressed.\n";
+    print_stats_usage("                                 \t ", 17);
+    std::cout << "\n";
     std::cout << "Transformations are:\n";
     std::cout << "1. 'chr' is removed from beginning of seqname;\n";
     std::cout << "2. 'UTR' feature is classified as 'five_prime_utr' or 'three_prime_utr';\n";
     std::cout << "3. stop_codon is not considered to be a part of 3'UTR;\n";
     std::cout << "4. gene_id attribute is splitted into gene_id and gene_version, the same for transcript_id etc.;\n";
-    std::cout << "5. 'gene_type' tag is replaced by 'gene_biotype', the same for 'transcript_type'." << std::endl;
+    std::cout << "5. 'gene_type' tag is replaced by 'gene_biotype', the same for 'transcript_type'.\n";
+    std::cout << "Created by Jan Jelínek (jan.jelinek@biomed.cas.cz); last update: 2026-10-14; license: Apache License 2.0" << std::endl;
     return (argc == 1) ? 0 : 1;
   }
 
+  RunStats& stats = RunStats::global();
+  stats.start("transformation");
+  // Numbers of transformed feature lines and copied comment lines
+  uint64_t feature_lines = 0, comment_lines = 0;
+  // Whether the input is an annotation index instead of a GTF file
+  const bool index_input = AnnotationIndex::is_annotation_index(argv[argi]);
   // Input GTF file
-  std::ifstream input(/*/"C:\\Working\\Valasek\\_references\\genome\\ensembl\\MANE.GRCh38.v0.95.select_ensembl_genomic.gtf" /*/argv[1]/**/);
+  InputFile input;
+  if (!index_input && !input.open(argv[argi])) {
+    return 9;
+  }
   // Output GTF file
-  std::ofstream output(/*/"C:\\Working\\Valasek\\_references\\genome\\ensembl\\MANE.GRCh38.v0.95.select_ensembl_genomic-104.gtf" /*/argv[2]/**/);
+  OutputFile output;
+  if (!output.open(argv[argi + 1], compression)) {
+    return 9;
+  }
   // Transcript_id of the currently processed transcript
   std::string current_transcript = "";
   // Boundaries of start codon
@@ -144,28 +239,122 @@ int main(int argc, char* argv[]) {
   size_t stop_codon_length = 3;
   // Length of 3'UTR regions that were stripped of stop codon
   size_t trimmed = 3;
-  for (std::string line; std::getline(input, line); ) {
+  // Transformed attributes of the current line
+  std::string rewritten;
+  // Transforms a line split into the first 8 fields and the ninth attributes field and prints it; the line (given by a function) is used only in error messages
+  auto process = [&](std::vector<std::string>& parts, const std::string_view attributes, const auto& line) {
+    ++feature_lines;
+    // Solution of problem #1 - trim 'chr' from beginning of seqid
+    if (parts[0].rfind("chr", 0) != 0) {
+      std::cerr << "Unexpected line format - seqname does not start with 'chr': " << line() << std::endl;
+    }
+    parts[0] = parts[0].substr(3);
+
+    if (parts[2] == "gene") {
+      // Initialize and set values that do not endanger transcript checks
+      init(current_transcript, 3, start_codon, start_codon_length, stop_codon, stop_codon_length, trimmed);
+      current_transcript = "";
+    } else if (parts[2] == "transcript") {
+      // Initialize
+      init(current_transcript, 0, start_codon, start_codon_length, stop_codon, stop_codon_length, trimmed);
+      size_t from = attributes.find("transcript_id \"");
+      if (from == attributes.npos) {
+        std::cerr << "Unexpected line format - transcript row does not contains attribute transcript_id: " << line() << std::endl;
+      }
+      from += 15;
+      size_t to = attributes.find('"', from);
+      if (to == attributes.npos) {
+        std::cerr << "Unexpected line format - transcript row does not contains unfinished transcript_id: " << line() << std::endl;
+      }
+      current_transcript = attributes.substr(from, to-from);
+    } else if (parts[2] == "start_codon") {
+      if (!process_codon(start_codon, start_codon_length, line, parts, "start")) return;
+    } else if (parts[2] == "stop_codon") {
+      if (!process_codon(stop_codon, stop_codon_length, line, parts, "stop")) return;
+    } else if (parts[2] == "UTR") {
+      if (start_codon[0] == -1 || start_codon[1] == -1) {
+        std::cerr << "Unexpected file format - start_codon line is missing or is not prior an UTR line: " << line() << std::endl;
+        return;
+      }
+      if (stop_codon[0] == -1 || stop_codon[1] == -1) {
+        std::cerr << "Unexpected file format - stop_codon line is missing or is not prior an UTR line: " << line() << std::endl;
+        return;
+      }
+      size_t range[] = { std::stoull(parts[3]), std::stoull(parts[4]) };
+
+      if (parts[6] != "+" && parts[6] != "-") {
+        std::cerr << "Unexpected line format - unsupported strain identifier: " << line() << std::endl;
+      } else if (!with_strand(parts[6] == "+", [&](auto direction) {
+        // Solution of problem #2 - classify UTR as 5'UTR, or 3'UTR
+        classify_utr<decltype(direction)>(range, start_codon, stop_codon, parts, current_transcript);
+        // Solution of problem #3 - exclude stop codon from 3'UTR
+        return parts[2] != "three_prime_utr" || adjust_boundaries<decltype(direction)>(parts, trimmed, range, stop_codon, current_transcript);
+      })) {
+        return;
+      }
+    }
+
+    // Solution of problem #4 and #5 - split '*_id "id.version"' into '*_id "id"; *_version "version"' and replace '*_type' with '*_biotype'
+    rewrite_attributes(attributes, rewritten, line);
+
+    // Print repaired line
+    for (size_t i = 0; i < parts.size(); i++) {
+      output.write(parts[i]);
+      output.put('\t');
+    }
+    output.write(rewritten);
+    output.put('\n');
+  };
+
+  // Fields of the current line; their memory is reused
+  std::vector<std::string> parts(8);
+  if (index_input) { // Annotations are already parsed
+    AnnotationIndex index;
+    if (!index.open(argv[argi])) {
+      return 9;
+    }
+    index.read([&](const uint64_t, const GtfRecord& record) {
+      parts[0] = record.seqname;
+      parts[1] = record.source;
+      parts[2] = record.feature;
+      parts[3] = std::to_string(record.start);
+      parts[4] = std::to_string(record.end);
+      parts[5] = record.score;
+      parts[6].assign(1, record.strand);
+      parts[7].assign(1, record.phase);
+      auto line = [&record]() { return record.to_line(); };
+      process(parts, record.attributes, line);
+      return 0;
+    }, [&](const std::string_view comment) {
+      ++comment_lines;
+      output.write(comment.data(), comment.size());
+      output.put('\n');
+      return 0;
+    });
+  }
+  for (std::string line; !index_input && input.getline(line); ) {
     if (line.empty()) { // Not expected
       std::cerr << "Unexpected empty line." << std::endl;
     } else if (line[0] == '#') { // Comments
-      output << line << '\n';
+      ++comment_lines;
+      output.write(line);
+      output.put('\n');
     } else { // The interesting part
       // Parsing columns
       size_t from = 0;
-      
+
       // Parsing first 8 features fields
-      std::vector<std::string> parts;
-      parts.reserve(8);
-      for (size_t i = 0; i < 8; i++) {
+      size_t columns = 0;
+      for (; columns < 8; columns++) {
         size_t to = line.find('\t', from);
         if (to == line.npos) {
           std::cerr << "Unexpected line format - not enough columns: " << line << std::endl;
           break;
         }
-        parts.push_back(line.substr(from, to - from));
+        parts[columns].assign(line, from, to - from);
         from = to + 1;
       }
-      if (parts.size() != 8) {
+      if (columns != 8) {
         continue;
       }
       if (line.find('\t', from) != line.npos) {
@@ -173,99 +362,18 @@ int main(int argc, char* argv[]) {
         continue;
       }
       // The ninth attributes field
-      std::string attributes = line.substr(from);
-
-      // Solution of problem #1 - trim 'chr' from beginning of seqid
-      if (parts[0].rfind("chr", 0) != 0) {
-        std::cerr << "Unexpected line format - seqname does not start with 'chr': " << line << std::endl;
-      }
-      parts[0] = parts[0].substr(3);
-
-      if (parts[2] == "gene") {
-        // Initialize and set values that do not endanger transcript checks
-        init(current_transcript, 3, start_codon, start_codon_length, stop_codon, stop_codon_length, trimmed);
-        current_transcript = "";
-      } else if (parts[2] == "transcript") {
-        // Initialize
-        init(current_transcript, 0, start_codon, start_codon_length, stop_codon, stop_codon_length, trimmed);
-        size_t from = attributes.find("transcript_id \"");
-        if (from == attributes.npos) {
-          std::cerr << "Unexpected line format - transcript row does not contains attribute transcript_id: " << line << std::endl;
-        }
-        from += 15;
-        size_t to = attributes.find('"', from);
-        if (to == attributes.npos) {
-          std::cerr << "Unexpected line format - transcript row does not contains unfinished transcript_id: " << line << std::endl;
-        }
-        current_transcript = attributes.substr(from, to-from);
-      } else if (parts[2] == "start_codon") {
-        if (!process_codon(start_codon, start_codon_length, line, parts, "start")) continue;
-      } else if (parts[2] == "stop_codon") {
-        if (!process_codon(stop_codon, stop_codon_length, line, parts, "stop")) continue;
-      } else if (parts[2] == "UTR") {
-        if (start_codon[0] == -1 || start_codon[1] == -1) {
-          std::cerr << "Unexpected file format - start_codon line is missing or is not prior an UTR line: " << line << std::endl;
-          continue;
-        }
-        if (stop_codon[0] == -1 || stop_codon[1] == -1) {
-          std::cerr << "Unexpected file format - stop_codon line is missing or is not prior an UTR line: " << line << std::endl;
-          continue;
-        }
-        size_t range[] = { std::stoull(parts[3]), std::stoull(parts[4]) };
-
-        // Solution of problem #2 - classify UTR as 5'UTR, or 3'UTR
-        if (parts[6] == "+") {
-          classify_utr(range[1], start_codon[0], stop_codon[0], range[0], parts, current_transcript);
-        } else if (parts[6] == "-") {
-          classify_utr(start_codon[1], range[0], range[1], stop_codon[1], parts, current_transcript);
-        } else {
-          std::cerr << "Unexpected line format - unsupported strain identifier: " << line << std::endl;
-        }
-
-        // Solution of problem #3 - exclude stop codon from 3'UTR
-        if (parts[2] == "three_prime_utr") {
-          if (parts[6] == "+") {
-            if (!adjust_boundaries(parts, trimmed, range, 0, range, stop_codon, stop_codon[1]+1, current_transcript)) continue;
-          } else if (parts[6] == "-") {
-            if (!adjust_boundaries(parts, trimmed, range, 1, stop_codon, range, stop_codon[0]-1, current_transcript)) continue;
-          } else {
-            std::cerr << "Unexpected line format - unsupported strain identifier: " << line << std::endl;
-          }
-        }
-      }
-
-      // Solution of problem #4 - split '*_id "id.version"' into '*_id "id"; *_version "version"'
-      for (size_t i = attributes.find("_id \""); i != attributes.npos; i = attributes.find("_id \"", i+5)) {
-        size_t begin = attributes.rfind(' ', i);
-        if (begin == attributes.npos) {
-          begin = 0;
-        }
-        size_t dot = attributes.find('.', i + 5);
-        size_t quote = attributes.find('"', i + 5);
-        if (quote == attributes.npos) {
-          std::cerr << "Uncompleted value of '" << attributes.substr(begin, i + 3 - begin) << "': " << line << std::endl;
-        }
-        if (dot == attributes.npos || quote < dot) {
-          std::cerr << "Unexpected format of '" << attributes.substr(begin, i + 3 - begin) << "': " << line << std::endl;
-        }
-        attributes.replace(dot, 1, "\"; " + attributes.substr(begin, i - begin) + "_version \"");
-      }
-
-      // Solution of problem #5 - replace '*_type' with '*_biotype'
-      for (size_t i = attributes.find("_type \""); i != attributes.npos; i = attributes.find("_type \"", i + 10)) {
-        attributes.insert(i + 1, "bio");
-      }
-
-      // Print repaired line
-      for (size_t i = 0; i < parts.size(); i++) {
-        output << parts[i] << '\t';
-      }
-      output << attributes << '\n';
+      process(parts, std::string_view(line).substr(from), [&line]() -> const std::string& { return line; });
     }
   }
-  output.flush();
-  output.close();
-  input.close();
-
-  return 0;
+  if (!index_input && input.failed()) {
+    std::cerr << "Unable to read file '" << argv[argi] << "'." << std::endl;
+    return 10;
+  }
+  if (!output.close()) {
+    return 9;
+  }
+  stats.stop(feature_lines + comment_lines);
+  stats.add("feature_lines", feature_lines);
+  stats.add("comment_lines", comment_lines);
+  return stats.report() ? 0 : 9;
 }
@@ -0,0 +1,126 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// <summary>
+/// Appends a number in the binary (little-endian) representation, e.g. to a block of a binary format.
+/// </summary>
+template <typename T>
+inline void append_binary(std::string& out, const T value) {
+  out.append((const char*)&value, sizeof(T));
+}
+
+/// <summary>
+/// A file mapped read-only into memory (binary formats of counts, genomes and annotations), it is unmapped by close() or the destructor.
+/// </summary>
+class MappedFile {
+private:
+  const unsigned char* bytes = nullptr;
+  size_t length = 0;
+
+public:
+  /// <summary>
+  /// Size of magics identifying binary formats.
+  /// </summary>
+  static constexpr size_t MAGIC_SIZE = 8;
+
+  MappedFile() {}
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() { close(); }
+
+  /// <summary>
+  /// Whether a file starts with the magic of a binary format.
+  /// </summary>
+  /// <param name="filename">Path to the file.</param>
+  /// <param name="magic">MAGIC_SIZE characters of the magic.</param>
+  static bool has_magic(const std::string& filename, const char* magic) {
+    char start[MAGIC_SIZE] = { 0 };
+    FILE* file = std::fopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+      return false;
+    }
+    bool result = std::fread(start, 1, MAGIC_SIZE, file) == MAGIC_SIZE && std::memcmp(start, magic, MAGIC_SIZE) == 0;
+    std::fclose(file);
+    return result;
+  }
+
+  /// <summary>
+  /// Maps a file into memory; an empty file is opened with no data (so its format is invalid).
+  /// </summary>
+  /// <param name="filename">Path to the file.</param>
+  /// <returns>TRUE if the file was mapped.</returns>
+  bool open(const std::string& filename) {
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+      std::cerr << "Unable to open file '" << filename << "'." << std::endl;
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      return false;
+    }
+    size_t size = (size_t)info.st_size;
+    void* mapped = size == 0 ? nullptr : mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+      std::cerr << "Unable to map file '" << filename << "' into memory." << std::endl;
+      return false;
+    }
+    bytes = (const unsigned char*)mapped;
+    length = mapped == nullptr ? 0 : size;
+    return true;
+  }
+
+  /// <summary>
+  /// Unmaps the file.
+  /// </summary>
+  void close() {
+    if (bytes != nullptr) {
+      munmap((void*)bytes, length);
+    }
+    bytes = nullptr;
+    length = 0;
+  }
+
+  /// <summary>
+  /// Whether a file is mapped (and not empty).
+  /// </summary>
+  inline bool is_open() const { return bytes != nullptr; }
+
+  inline const unsigned char* data() const { return bytes; }
+  inline size_t size() const { return length; }
+
+  /// <summary>
+  /// Whether the mapped file starts with the magic of a binary format and has at least minimal_size bytes.
+  /// </summary>
+  inline bool starts_with(const char* magic, const size_t minimal_size) const {
+    return length >= minimal_size && length >= MAGIC_SIZE && std::memcmp(bytes, magic, MAGIC_SIZE) == 0;
+  }
+
+  /// <summary>
+  /// Reads a number in the binary (little-endian) representation; the offset is not checked.
+  /// </summary>
+  template <typename T>
+  inline T get(const size_t offset) const {
+    T value;
+    std::memcpy(&value, bytes + offset, sizeof(T));
+    return value;
+  }
+};
+
+#endif
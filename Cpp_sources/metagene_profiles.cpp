@@ -0,0 +1,365 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "compressed_io.h"
+#include "count_file.h"
+#include "id_dictionary.h"
+#include "run_stats.h"
+#include "sam_fields.h"
+
+/// <summary>
+/// The longest read length accepted from tab-separated counts (a longer one is a corrupted line).
+/// </summary>
+const uint32_t MAX_READ_LENGTH = 1 << 16;
+
+/// <summary>
+/// Counts of positions in frames of coding sequences and around start and stop codons, grouped by read lengths.
+/// All of them are kept in arrays of a fixed size per read length, so counts file is processed in a single pass.
+/// </summary>
+class MetageneProfile {
+private:
+  /// <summary>
+  /// Number of positions of UTRs and CDSs around start and stop codons.
+  /// </summary>
+  const uint32_t utr;
+  const uint32_t cds;
+  /// <summary>
+  /// Number of distances in a profile around a codon (utr + cds + 1).
+  /// </summary>
+  const size_t distances;
+  /// <summary>
+  /// Counts of frames 0, 1 and 2 (at index length * 3 + frame).
+  /// </summary>
+  std::vector<uint64_t> frames;
+  /// <summary>
+  /// Counts at distances from start codons (-utr to cds) and stop codons (-cds to utr) at index length * distances + distance.
+  /// </summary>
+  std::vector<uint64_t> starts;
+  std::vector<uint64_t> stops;
+  /// <summary>
+  /// Whether a read length occured.
+  /// </summary>
+  std::vector<bool> lengths;
+
+  /// <summary>
+  /// Adds arrays for read lengths up to the given one.
+  /// </summary>
+  inline void reserve(const uint32_t length) {
+    if (length >= lengths.size()) {
+      lengths.resize(length + 1, false);
+      frames.resize(3 * lengths.size(), 0);
+      starts.resize(distances * lengths.size(), 0);
+      stops.resize(distances * lengths.size(), 0);
+    }
+  }
+
+  /// <summary>
+  /// Sums counts of all read lengths.
+  /// </summary>
+  /// <param name="counts">Counts at index length * width + item.</param>
+  /// <param name="width">Number of items per read length.</param>
+  static std::vector<uint64_t> totals(const std::vector<uint64_t>& counts, const size_t width) {
+    std::vector<uint64_t> result(width, 0);
+    for (size_t i = 0; i < counts.size(); ++i) {
+      result[i % width] += counts[i];
+    }
+    return result;
+  }
+
+  /// <summary>
+  /// Writes a row of frame counts and their fractions.
+  /// </summary>
+  static void write_frames(OutputFile& output, const std::string& length, const uint64_t* counts) {
+    uint64_t total = counts[0] + counts[1] + counts[2];
+    output.write(length);
+    for (size_t frame = 0; frame < 3; ++frame) {
+      output.put('\t');
+      output.write(std::to_string(counts[frame]));
+    }
+    for (size_t frame = 0; frame < 3; ++frame) {
+      output.put('\t');
+      output.write(total == 0 ? std::string("NA") : std::to_string((double)counts[frame] / total));
+    }
+    output.put('\n');
+  }
+
+  /// <summary>
+  /// Writes rows of a profile around a codon.
+  /// </summary>
+  /// <param name="codon">Name of the codon.</param>
+  /// <param name="first">Distance of the first item.</param>
+  static void write_profile(OutputFile& output, const std::string& codon, const int64_t first, const std::string& length, const uint64_t* counts, const size_t distances) {
+    for (size_t i = 0; i < distances; ++i) {
+      output.write(codon);
+      output.put('\t');
+      output.write(std::to_string(first + (int64_t)i));
+      output.put('\t');
+      output.write(length);
+      output.put('\t');
+      output.write(std::to_string(counts[i]));
+      output.put('\n');
+    }
+  }
+
+public:
+  MetageneProfile(const uint32_t utr, const uint32_t cds) : utr(utr), cds(cds), distances((size_t)utr + cds + 1) {
+    reserve(0);
+  }
+
+  /// <summary>
+  /// Adds a count of a position of a transcript.
+  /// </summary>
+  /// <param name="codons">1-based positions of the first nucleotides of the start and stop codons of the transcript.</param>
+  /// <param name="position">1-based position in the transcript.</param>
+  /// <param name="length">Read length (0 if reads are not grouped by lengths).</param>
+  /// <param name="count">Count of the position.</param>
+  inline void add(const std::pair<uint64_t, uint64_t>& codons, const uint64_t position, const uint32_t length, const uint64_t count) {
+    if (count == 0) {
+      return;
+    }
+    reserve(length);
+    lengths[length] = true;
+    // Codons from the start codon to the last one before the stop codon
+    if (codons.first <= position && position < codons.second) {
+      frames[3 * length + (position - codons.first) % 3] += count;
+    }
+    // Distances are shifted, so the first item of a profile is 0
+    uint64_t from_start = position + utr - codons.first;
+    if (position + utr >= codons.first && from_start < distances) {
+      starts[length * distances + from_start] += count;
+    }
+    uint64_t from_stop = position + cds - codons.second;
+    if (position + cds >= codons.second && from_stop < distances) {
+      stops[length * distances + from_stop] += count;
+    }
+  }
+
+  /// <summary>
+  /// Writes frame counts and fractions for each read length and all of them ('all') in tab-separated values file format with a header.
+  /// </summary>
+  /// <returns>FALSE if the file could not be written.</returns>
+  bool write_frames(const std::string& filename) const {
+    OutputFile output;
+    if (!output.open(filename)) {
+      return false;
+    }
+    output.write("length\tframe_0\tframe_1\tframe_2\tfraction_0\tfraction_1\tfraction_2\n");
+    for (uint32_t length = 1; length < lengths.size(); ++length) {
+      if (lengths[length]) {
+        write_frames(output, std::to_string(length), frames.data() + 3 * length);
+      }
+    }
+    write_frames(output, "all", totals(frames, 3).data());
+    return output.close();
+  }
+
+  /// <summary>
+  /// Writes counts at distances from start and stop codons for each read length and all of them ('all') in tab-separated values file format with a header.
+  /// </summary>
+  /// <returns>FALSE if the file could not be written.</returns>
+  bool write_profiles(const std::string& filename) const {
+    OutputFile output;
+    if (!output.open(filename)) {
+      return false;
+    }
+    output.write("codon\tdistance\tlength\tcount\n");
+    for (uint32_t length = 1; length < lengths.size(); ++length) {
+      if (lengths[length]) {
+        write_profile(output, "start", -(int64_t)utr, std::to_string(length), starts.data() + length * distances, distances);
+      }
+    }
+    write_profile(output, "start", -(int64_t)utr, "all", totals(starts, distances).data(), distances);
+    for (uint32_t length = 1; length < lengths.size(); ++length) {
+      if (lengths[length]) {
+        write_profile(output, "stop", -(int64_t)cds, std::to_string(length), stops.data() + length * distances, distances);
+      }
+    }
+    write_profile(output, "stop", -(int64_t)cds, "all", totals(stops, distances).data(), distances);
+    return output.close();
+  }
+
+  /// <summary>
+  /// Number of distinct read lengths.
+  /// </summary>
+  size_t length_count() const {
+    size_t result = 0;
+    for (bool occured : lengths) {
+      result += occured;
+    }
+    return result;
+  }
+};
+
+/// <summary>
+/// Parses an unsigned option value.
+/// </summary>
+/// <returns>FALSE if the option is present, but its value is not valid.</returns>
+bool parse_window(int& argi, const int argc, char* argv[], const std::string& option, uint32_t& value) {
+  if (argi >= argc || argv[argi] != option) {
+    return true;
+  }
+  if (argi + 1 >= argc || !parse_integer(std::string_view(argv[argi + 1]), value) || value > (1 << 20)) {
+    std::cerr << "Option " << option << " requires a number of positions." << std::endl;
+    return false;
+  }
+  argi += 2;
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  // Positions of UTRs and CDSs around start and stop codons
+  uint32_t utr = 50, cds = 50;
+  int argi = 1;
+  for (int previous = 0; previous != argi; ) {
+    previous = argi;
+    if (!parse_window(argi, argc, argv, "--utr", utr) || !parse_window(argi, argc, argv, "--cds", cds) || !parse_stats(argi, argc, argv)) {
+      return 1;
+    }
+  }
+  if (argc != argi + 3) {
+    std::cout << "metagene_profiles [--utr N] [--cds N] [--stats | --stats-json FILE] <startstop> <counts> <prefix>\t Reads start and stop codon positions for each transcript from <startstop>\n";
+    std::cout << "                                     \t (written by transcripts_startstop_positions) and counts of positions in transcripts from <counts>\n";
+    std::cout << "                                     \t (written by read_counts, possibly with --lengths or --offsets), and writes summaries of triplet\n";
+    std::cout << "                                     \t periodicity in a single pass over the counts:\n";
+    std::cout << "                                     \t '<prefix>frames.tsv' has counts and fractions of frames 0, 1 and 2 (relative to the start\n";
+    std::cout << "                                     \t codon) from the start codon to the stop codon (excluded) for each read length and all ('all');\n";
+    std::cout << "                                     \t '<prefix>metagene.tsv' has counts at each distance from start codons (-N of UTR to N of CDS)\n";
+    std::cout << "                                     \t and stop codons (-N of CDS to N of UTR) for each read length and all ('all').\n";
+    std::cout << "                                     \t <counts> should have lines in format '[transcript_id]\\t[position]\\t[count]' or\n";
+    std::cout << "                                     \t '[transcript_id]\\t[position]\\t[length]\\t[count]' ('-' for the standard input, so it can be\n";
+    std::cout << "                                     \t piped from read_counts), or it can be in the binary format written by 'read_counts --binary'.\n";
+    std::cout << "                                     \t --utr N    \t number of UTR positions in profiles (default 50).\n";
+    std::cout << "                                     \t --cds N    \t number of CDS positions in profiles (default 50).\n";
+    print_stats_usage("                                     \t ");
+    std::cout << "Created by Jan Jelínek (jan.jelinek@biomed.cas.cz); last update: 2026-10-14; license: Apache License 2.0" << std::endl;
+    return (argc == 1) ? 0 : 1;
+  }
+  const std::string startstop_filename(argv[argi]), counts_filename(argv[argi + 1]), prefix(argv[argi + 2]);
+
+  RunStats& stats = RunStats::global();
+  stats.start("codons load");
+  // Transcripts with defined start and stop codons
+  IdDictionary ids;
+  // 1-based positions of start and stop codons indexed by ids of transcripts
+  std::vector<std::pair<uint64_t, uint64_t>> codons;
+  {
+    // Tab-separated input file with lines in '<transcript_id>\t<start>\t<stop>' format
+    InputFile startstop_file;
+    if (!startstop_file.open(startstop_filename)) {
+      return 9;
+    }
+    for (std::string line; startstop_file.getline(line); ) {
+      size_t tab_first = line.find('\t');
+      size_t tab_second = tab_first == line.npos ? line.npos : line.find('\t', tab_first + 1);
+      std::pair<uint64_t, uint64_t> positions;
+      if (tab_second == line.npos || !parse_integer(std::string_view(line).substr(tab_first + 1, tab_second - tab_first - 1), positions.first)
+        || !parse_integer(std::string_view(line).substr(tab_second + 1), positions.second)) {
+        std::cerr << "Unexpected line format, three columns expected: " << line << std::endl;
+        continue;
+      }
+      uint32_t id = ids.insert(std::string_view(line).substr(0, tab_first));
+      if (codons.size() <= id) {
+        codons.resize(id + 1);
+      }
+      codons[id] = positions;
+    }
+    if (startstop_file.failed()) {
+      std::cerr << "Unable to read file '" << startstop_filename << "'." << std::endl;
+      return 10;
+    }
+  }
+  stats.stop(ids.size());
+  stats.add("transcripts", ids.size());
+
+  stats.start("counting");
+  MetageneProfile profile(utr, cds);
+  // Counted positions (with lengths) and identifiers of counts missing in <startstop>
+  uint64_t positions = 0, unannotated = 0;
+  if (CountFile::is_count_file(counts_filename)) {
+    // Binary file is mapped into memory
+    CountFile counts_file;
+    if (!counts_file.open(counts_filename)) {
+      return 9;
+    }
+    for (size_t i = 0; i < counts_file.references(); ++i) {
+      uint32_t id = ids.find(counts_file.name(i));
+      if (id == IdDictionary::NONE) {
+        ++unannotated;
+        continue;
+      }
+      const std::pair<uint64_t, uint64_t>& transcript = codons[id];
+      const uint32_t min_length = counts_file.min_length();
+      bool valid = counts_file.scan(i, [&](const uint64_t position, const std::vector<uint64_t>& counts) {
+        for (size_t j = 0; j < counts.size(); ++j) {
+          profile.add(transcript, position, min_length == 0 ? 0 : min_length + (uint32_t)j, counts[j]);
+        }
+        ++positions;
+      });
+      if (!valid) {
+        std::cerr << "Unexpected file format: corrupted block of identifier '" << counts_file.name(i) << "' in file '" << counts_filename << "'" << std::endl;
+        return 10;
+      }
+    }
+  } else {
+    // Tab-separated input file with lines in '<transcript_id>\t<position>[\t<length>]\t<count>' format
+    InputFile counts_file;
+    if (!counts_file.open(counts_filename)) {
+      return 9;
+    }
+    // Lines of a transcript are consecutive (read_counts sorts them), so the last transcript is not searched again
+    std::string last_name;
+    uint32_t last_id = IdDictionary::NONE;
+    for (std::string line; counts_file.getline(line); ) {
+      std::string_view fields[4];
+      size_t columns = 0;
+      for (size_t from = 0; ; ++columns) {
+        size_t to = line.find('\t', from);
+        if (columns < 4) {
+          fields[columns] = std::string_view(line).substr(from, to == line.npos ? line.npos : to - from);
+        }
+        if (to == line.npos) {
+          ++columns;
+          break;
+        }
+        from = to + 1;
+      }
+      uint64_t position, count;
+      uint32_t length = 0;
+      if ((columns != 3 && columns != 4) || !parse_integer(fields[1], position) || !parse_integer(fields[columns - 1], count)
+        || (columns == 4 && (!parse_integer(fields[2], length) || length == 0 || length > MAX_READ_LENGTH))) {
+        std::cerr << "Unexpected line format, three or four columns expected: " << line << std::endl;
+        continue;
+      }
+      if (fields[0] != last_name) {
+        last_name.assign(fields[0]);
+        last_id = ids.find(fields[0]);
+        unannotated += last_id == IdDictionary::NONE;
+      }
+      if (last_id != IdDictionary::NONE) {
+        profile.add(codons[last_id], position, length, count);
+        ++positions;
+      }
+    }
+    if (counts_file.failed()) {
+      std::cerr << "Unable to read file '" << counts_filename << "'." << std::endl;
+      return 10;
+    }
+  }
+  stats.stop(positions);
+  stats.add("unannotated_identifiers", unannotated);
+  stats.add("read_lengths", profile.length_count());
+
+  stats.start("output");
+  if (!profile.write_frames(prefix + "frames.tsv") || !profile.write_profiles(prefix + "metagene.tsv")) {
+    return 9;
+  }
+  stats.stop(2);
+  return stats.report() ? 0 : 9;
+}
@@ -0,0 +1,186 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+#include "compressed_io.h"
+#include "genome_file.h"
+#include "id_dictionary.h"
+#include "run_stats.h"
+
+/// <summary>
+/// Runs of equal characters within a sequence.
+/// </summary>
+class Runs {
+private:
+  /// <summary>
+  /// Encoded runs (see genome_file.h).
+  /// </summary>
+  std::string runs;
+  uint64_t start = 0;
+  uint32_t length = 0;
+  uint32_t character = 0;
+
+  void finish() {
+    if (length > 0) {
+      append_binary<uint64_t>(runs, start);
+      append_binary<uint32_t>(runs, length);
+      append_binary<uint32_t>(runs, character);
+      length = 0;
+    }
+  }
+
+public:
+  /// <summary>
+  /// Adds a character at the given position, positions have to be increasing.
+  /// </summary>
+  inline void add(const uint64_t pos, const uint32_t c) {
+    if (length > 0 && start + length == pos && character == c && length < UINT32_MAX) {
+      ++length;
+    } else {
+      finish();
+      start = pos;
+      length = 1;
+      character = c;
+    }
+  }
+
+  /// <summary>
+  /// Returns encoded runs and starts new ones.
+  /// </summary>
+  std::string take() {
+    finish();
+    std::string result;
+    result.swap(runs);
+    return result;
+  }
+};
+
+int main(int argc, char* argv[]) {
+  int argi = 1;
+  if (!parse_stats(argi, argc, argv)) {
+    return 1;
+  }
+  if (argc != argi + 2) {
+    std::cout << "pack_genome [--stats | --stats-json FILE] <genome> <packed_genome>\t Converts <genome> in FASTA format (optionally gzip-compressed) into <packed_genome>,\n";
+    std::cout << "                                    \t in which bases are stored by 2 bits with runs of other characters (e.g. N) and soft-masked bases.\n";
+    std::cout << "                                    \t <packed_genome> is mapped into memory by 'gc_content' instead of loading the whole FASTA file.\n";
+    print_stats_usage("                                    \t ");
+    std::cout << "Created by Jan Jelínek (jan.jelinek@biomed.cas.cz); last update: 2026-10-14; license: Apache License 2.0" << std::endl;
+    return (argc == 1) ? 0 : 1;
+  }
+
+  RunStats& stats = RunStats::global();
+  stats.start("packing");
+  OutputFile output;
+  if (!output.open(argv[argi + 1])) {
+    return 9;
+  }
+  output.write(genome_format::MAGIC, genome_format::HEADER_SIZE);
+  uint64_t offset = genome_format::HEADER_SIZE;
+  // Names of sequences to detect duplicates
+  IdDictionary names;
+  // Index entries (with name offsets relative to the start of names)
+  std::string index;
+  // Packed bases of the current sequence not yet written
+  std::string packed;
+  // Runs of exceptions and lower-case bases of the current sequence
+  Runs exceptions, lower;
+  // Length of the current sequence and offset of its packed bases
+  uint64_t length = 0, packed_start = 0;
+  bool started = false;
+  // Number of bases of all sequences
+  uint64_t base_count = 0;
+
+  // Writes the remaining data of the current sequence and completes its index entry
+  auto finish_sequence = [&]() {
+    if (!started) {
+      return;
+    }
+    output.write(packed);
+    offset += packed.size();
+    packed.clear();
+    std::string runs = exceptions.take();
+    append_binary<uint64_t>(index, length);
+    append_binary<uint64_t>(index, packed_start);
+    append_binary<uint64_t>(index, offset);
+    append_binary<uint64_t>(index, runs.size() / genome_format::RUN_SIZE);
+    output.write(runs);
+    offset += runs.size();
+    runs = lower.take();
+    append_binary<uint64_t>(index, offset);
+    append_binary<uint64_t>(index, runs.size() / genome_format::RUN_SIZE);
+    output.write(runs);
+    offset += runs.size();
+  };
+
+  int error = read_fasta(argv[argi], [&](const std::string& name) {
+    finish_sequence();
+    if (names.insert(name) != index.size() / genome_format::INDEX_ENTRY_SIZE) {
+      std::cerr << "Multiple sequences with the same id '" << name << "'." << std::endl;
+      return 3;
+    }
+    append_binary<uint64_t>(index, 0); // Replaced by the name offset in the end
+    append_binary<uint64_t>(index, name.size());
+    length = 0;
+    packed_start = offset;
+    started = true;
+    return 0;
+  }, [&](const std::string_view bases) {
+    base_count += bases.size();
+    for (char c : bases) {
+      char upper = (char)std::toupper((unsigned char)c);
+      if (upper != c) {
+        lower.add(length, 0);
+      }
+      unsigned code = genome_format::code(upper);
+      if (code > 3) {
+        exceptions.add(length, (unsigned char)upper);
+        code = 0;
+      }
+      if ((length & 3) == 0) {
+        packed += (char)code;
+      } else {
+        packed.back() = (char)(packed.back() | (code << ((length & 3) << 1)));
+      }
+      ++length;
+      if ((length & 3) == 0 && packed.size() >= (1 << 20)) {
+        output.write(packed);
+        offset += packed.size();
+        packed.clear();
+      }
+    }
+  });
+  if (error != 0) {
+    output.close();
+    return error;
+  }
+  finish_sequence();
+
+  // Names follow all sequences
+  uint64_t count = index.size() / genome_format::INDEX_ENTRY_SIZE;
+  for (uint64_t i = 0; i < count; ++i) {
+    std::string_view name = names.name((uint32_t)i);
+    uint64_t name_offset = offset;
+    std::memcpy(&index[i * genome_format::INDEX_ENTRY_SIZE], &name_offset, 8);
+    output.write(name.data(), name.size());
+    offset += name.size();
+  }
+  append_binary<uint64_t>(index, offset);
+  append_binary<uint64_t>(index, count);
+  output.write(index);
+  if (!output.close()) {
+    std::cerr << "Unable to write file '" << argv[argi + 1] << "'." << std::endl;
+    return 9;
+  }
+  stats.stop(base_count);
+  stats.add("sequences", count);
+  stats.add("output_bytes", offset + index.size());
+  return stats.report() ? 0 : 9;
+}
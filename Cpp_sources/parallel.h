@@ -0,0 +1,303 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+/// <summary>
+/// Parses '--threads N' option if it is the argument at the given position.
+/// </summary>
+/// <param name="argi">Position of the examined argument; it is moved after the option if present.</param>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Arguments.</param>
+/// <param name="threads">Number of threads (output); unchanged if the option is not present.</param>
+/// <returns>FALSE if the option is present, but its value is invalid.</returns>
+inline bool parse_threads(int& argi, const int argc, char* argv[], size_t& threads) {
+  if (argi >= argc || std::string(argv[argi]) != "--threads") {
+    return true;
+  }
+  if (argi + 1 >= argc) {
+    std::cerr << "Missing value of option '--threads'." << std::endl;
+    return false;
+  }
+  char* end;
+  long value = std::strtol(argv[argi + 1], &end, 10);
+  if (*end != '\0' || value <= 0) {
+    std::cerr << "Invalid number of threads '" << argv[argi + 1] << "'." << std::endl;
+    return false;
+  }
+  threads = (size_t)value;
+  argi += 2;
+  return true;
+}
+
+/// <summary>
+/// Performs a task for items 0, 1, ..., count - 1 by a pool of threads; items are taken in their order.
+/// If a task fails, no further item is started, but items already started by other threads (possibly with higher indices) still finish and write their outputs;
+/// so the returned error is the same as if items were processed one by one and the processing stopped on the first error, outputs of later items may exist.
+/// </summary>
+/// <param name="count">Number of items.</param>
+/// <param name="threads">Maximal number of threads, 1 means processing in the calling thread.</param>
+/// <param name="task">Task taking index of an item and returning 0 if no error occured, or an error code.</param>
+/// <returns>0 if all tasks succeeded; otherwise the error code of the failed item with the lowest index.</returns>
+template <typename Task>
+int parallel_for(const size_t count, const size_t threads, Task task) {
+  std::vector<int> results(count, 0);
+  std::atomic<size_t> next(0);
+  std::atomic<bool> failed(false);
+  auto worker = [&]() {
+    for (size_t i; !failed && (i = next++) < count; ) {
+      results[i] = task(i);
+      if (results[i] != 0) {
+        failed = true;
+      }
+    }
+  };
+  if (threads <= 1 || count <= 1) {
+    worker();
+  } else {
+    std::vector<std::thread> pool;
+    for (size_t i = 0; i < threads && i < count; ++i) {
+      pool.emplace_back(worker);
+    }
+    for (std::thread& thread : pool) {
+      thread.join();
+    }
+  }
+  for (int result : results) {
+    if (result != 0) {
+      return result;
+    }
+  }
+  return 0;
+}
+
+/// <summary>
+/// Processes a sequence of chunks by a pool of threads while preserving their order:
+/// chunks are produced one by one in the calling thread, transformed simultaneously by workers and consumed one by one in the original order by a writer thread.
+/// So the result is the same as if each chunk was produced, transformed and consumed before the next one.
+/// Consumed chunks are recycled, so produce gets a previously used chunk (to be cleared) whenever possible and buffers of chunks are reused.
+/// </summary>
+/// <param name="threads">Number of transforming threads, 1 means processing without any extra thread.</param>
+/// <param name="produce">Function filling a chunk; returns 0 if a chunk was produced, -1 at the end of the input, or an error code (the chunk read so far is still processed).</param>
+/// <param name="transform">Function processing a chunk; returns 0 if no error occured, or an error code (the processed part of the chunk is still consumed).</param>
+/// <param name="consume">Function storing a processed chunk; returns 0 if no error occured, or an error code.</param>
+/// <returns>0 if no error occured; otherwise the error code of the first failed step in the order of chunks.</returns>
+template <typename Chunk, typename Produce, typename Transform, typename Consume>
+int ordered_pipeline(const size_t threads, Produce produce, Transform transform, Consume consume) {
+  // Processes a chunk after it was transformed; returns the first error of all the steps
+  auto finish = [&](Chunk& chunk, const int produced, const int transformed) {
+    int consumed = consume(chunk);
+    return transformed != 0 ? transformed : (consumed != 0 ? consumed : produced);
+  };
+  if (threads <= 1) {
+    for (Chunk chunk; ; ) {
+      int produced = produce(chunk);
+      if (produced < 0) {
+        return 0;
+      }
+      int result = finish(chunk, produced, transform(chunk));
+      if (result != 0) {
+        return result;
+      }
+    }
+  }
+
+  struct Item {
+    Chunk chunk;
+    bool done = false;
+    int produced = 0;
+    int transformed = 0;
+  };
+  std::mutex mutex;
+  std::condition_variable changed;
+  // Chunks in the original order, which were not consumed yet
+  std::deque<std::unique_ptr<Item>> items;
+  // Chunks waiting for a worker
+  std::queue<Item*> work;
+  // Whether the last chunk was produced
+  bool finished = false;
+  // The first error in the order of chunks
+  int error = 0;
+  // Maximal number of chunks in memory
+  const size_t capacity = 2 * threads + 2;
+  // Consumed chunks to be reused by produce
+  std::vector<std::unique_ptr<Item>> spare;
+
+  auto worker = [&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      changed.wait(lock, [&]() { return !work.empty() || finished || error != 0; });
+      if (work.empty() || error != 0) {
+        return;
+      }
+      Item* item = work.front();
+      work.pop();
+      lock.unlock();
+      int result = transform(item->chunk);
+      lock.lock();
+      item->transformed = result;
+      item->done = true;
+      changed.notify_all();
+    }
+  };
+  auto writer = [&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      changed.wait(lock, [&]() { return (!items.empty() && items.front()->done) || (finished && items.empty()) || error != 0; });
+      if (error != 0 || items.empty()) {
+        return;
+      }
+      std::unique_ptr<Item> item = std::move(items.front());
+      items.pop_front();
+      changed.notify_all();
+      lock.unlock();
+      int result = finish(item->chunk, item->produced, item->transformed);
+      lock.lock();
+      spare.push_back(std::move(item));
+      if (result != 0) {
+        error = result;
+        changed.notify_all();
+        return;
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (size_t i = 0; i < threads; ++i) {
+    pool.emplace_back(worker);
+  }
+  pool.emplace_back(writer);
+  for (int produced = 0; produced == 0; ) {
+    std::unique_ptr<Item> item;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!spare.empty()) {
+        item = std::move(spare.back());
+        spare.pop_back();
+        item->done = false;
+        item->produced = item->transformed = 0;
+      }
+    }
+    if (!item) {
+      item.reset(new Item());
+    }
+    produced = produce(item->chunk);
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&]() { return items.size() < capacity || error != 0; });
+    if (error != 0 || produced < 0) {
+      break;
+    }
+    // A failed chunk is still processed, the error is reported after it is stored
+    item->produced = produced;
+    work.push(item.get());
+    items.push_back(std::move(item));
+    changed.notify_all();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+    changed.notify_all();
+  }
+  for (std::thread& thread : pool) {
+    thread.join();
+  }
+  return error;
+}
+
+/// <summary>
+/// Processes a sequence of chunks by a pool of threads in any order: chunks are produced one by one in the calling thread
+/// and each worker processes them with its own state (e.g. partial results, which are combined afterwards).
+/// </summary>
+/// <param name="states">States of workers; their number is the number of threads, a single state means processing without any extra thread.</param>
+/// <param name="produce">Function filling a chunk; returns 0 if a chunk was produced, -1 at the end of the input, or an error code.</param>
+/// <param name="process">Function taking a state and a chunk; returns 0 if no error occured, or an error code.</param>
+/// <returns>0 if no error occured; otherwise an error code of a failed step.</returns>
+template <typename Chunk, typename State, typename Produce, typename Process>
+int unordered_pipeline(std::vector<State>& states, Produce produce, Process process) {
+  if (states.size() <= 1) {
+    for (Chunk chunk; ; ) {
+      int result = produce(chunk);
+      if (result < 0) {
+        return 0;
+      }
+      if (result != 0 || (result = process(states[0], chunk)) != 0) {
+        return result;
+      }
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  // Chunks waiting for a worker
+  std::queue<std::unique_ptr<Chunk>> work;
+  // Whether the last chunk was produced
+  bool finished = false;
+  int error = 0;
+  // Maximal number of waiting chunks
+  const size_t capacity = 2 * states.size();
+
+  auto worker = [&](State& state) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      changed.wait(lock, [&]() { return !work.empty() || finished || error != 0; });
+      if (work.empty() || error != 0) {
+        return;
+      }
+      std::unique_ptr<Chunk> chunk = std::move(work.front());
+      work.pop();
+      changed.notify_all();
+      lock.unlock();
+      int result = process(state, *chunk);
+      lock.lock();
+      if (result != 0 && error == 0) {
+        error = result;
+        changed.notify_all();
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (State& state : states) {
+    pool.emplace_back(worker, std::ref(state));
+  }
+  while (true) {
+    std::unique_ptr<Chunk> chunk(new Chunk());
+    int result = produce(*chunk);
+    std::unique_lock<std::mutex> lock(mutex);
+    if (result > 0 && error == 0) {
+      error = result;
+    }
+    if (error != 0 || result < 0) {
+      break;
+    }
+    changed.wait(lock, [&]() { return work.size() < capacity || error != 0; });
+    work.push(std::move(chunk));
+    changed.notify_all();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+    changed.notify_all();
+  }
+  for (std::thread& thread : pool) {
+    thread.join();
+  }
+  return error;
+}
+
+#endif
@@ -0,0 +1,257 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef POSITION_COUNTS_H
+#define POSITION_COUNTS_H
+
+#include <cstdint>
+#include <algorithm>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "compressed_io.h"
+#include "count_file.h"
+#include "id_dictionary.h"
+#include "mapped_file.h"
+
+/// <summary>
+/// Read counts grouped by reference (RNAME), position (POS) and optionally by read length.
+/// Counts of a reference are stored in pages of PAGE consecutive positions (and read lengths within a position); a page is allocated
+/// when the first read is mapped into it, so memory is proportional to the covered parts of references, not to their lengths
+/// (e.g. of chromosomes from '@SQ' header lines of genome alignments), and the last page ends with the reference if its length is known.
+/// </summary>
+class PositionCounts {
+private:
+  /// <summary>
+  /// The shortest counted read length (0 if reads are not grouped by lengths).
+  /// </summary>
+  uint32_t min_length;
+  /// <summary>
+  /// Number of counted read lengths (1 if reads are not grouped by lengths); counts of a position occupy this number of items.
+  /// </summary>
+  uint32_t width;
+  /// <summary>
+  /// Reference names; their ids index the following vectors.
+  /// </summary>
+  IdDictionary references;
+  /// <summary>
+  /// Expected reference lengths, 0 if unknown.
+  /// </summary>
+  std::vector<uint32_t> lengths;
+  /// <summary>
+  /// Pages of read counts of references; a page is indexed by positions within the page (from 0 as POS = 0 is used by unmapped reads)
+  /// times width plus read length bins, pages not covered by any read are empty.
+  /// </summary>
+  std::vector<std::vector<std::vector<uint32_t>>> counts;
+
+  static constexpr uint32_t PAGE_BITS = 12;
+  static constexpr uint64_t PAGE = (uint64_t)1 << PAGE_BITS;
+
+  /// <summary>
+  /// Returns a page of counts of a reference with at least the given number of positions; it is allocated on the first access.
+  /// </summary>
+  inline std::vector<uint32_t>& page_counts(const uint32_t reference, const uint64_t page, const uint64_t positions) {
+    std::vector<std::vector<uint32_t>>& pages = counts[reference];
+    if (page >= pages.size()) {
+      pages.resize(std::max<uint64_t>(page + 1, lengths[reference] / PAGE + 1));
+    }
+    std::vector<uint32_t>& values = pages[page];
+    if (values.size() < positions * width) {
+      // A page within the known length of the reference ends with it, other pages are complete
+      uint64_t start = page * PAGE, size = PAGE;
+      if (start + positions <= (uint64_t)lengths[reference] + 1) {
+        size = std::min<uint64_t>(PAGE, lengths[reference] + 1 - start);
+      }
+      values.resize(size * width, 0);
+    }
+    return values;
+  }
+
+public:
+  /// <summary>
+  /// Creates empty counts.
+  /// </summary>
+  /// <param name="min_length">The shortest counted read length if reads are grouped by lengths.</param>
+  /// <param name="max_length">The longest counted read length if reads are grouped by lengths, 0 otherwise.</param>
+  PositionCounts(const uint32_t min_length = 0, const uint32_t max_length = 0)
+    : min_length(max_length == 0 ? 0 : min_length), width(max_length == 0 ? 1 : max_length - min_length + 1) {}
+
+  /// <summary>
+  /// Whether reads are grouped by their lengths.
+  /// </summary>
+  inline bool by_length() const {
+    return min_length > 0;
+  }
+
+  /// <summary>
+  /// Removes all counts and references; the grouping is preserved.
+  /// </summary>
+  void clear() {
+    references.clear();
+    lengths.clear();
+    counts.clear();
+  }
+
+  /// <summary>
+  /// Registers a reference; it is not necessary, but it saves reallocations of counts and lookups of names.
+  /// </summary>
+  /// <param name="name">Reference name.</param>
+  /// <param name="length">Reference length.</param>
+  /// <returns>Id of the reference.</returns>
+  uint32_t add_reference(const std::string_view name, const uint32_t length = 0) {
+    uint32_t reference = references.insert(name);
+    if (reference == counts.size()) {
+      counts.emplace_back();
+      lengths.push_back(length);
+    } else if (length > lengths[reference]) {
+      lengths[reference] = length;
+    }
+    return reference;
+  }
+
+  /// <summary>
+  /// Adds a read mapped to the given position.
+  /// </summary>
+  /// <param name="reference">Reference id.</param>
+  /// <param name="pos">1-based position.</param>
+  /// <param name="length">Read length within the counted range if reads are grouped by lengths (ignored otherwise).</param>
+  inline void add(const uint32_t reference, const uint64_t pos, const uint32_t length = 0) {
+    const uint64_t offset = pos & (PAGE - 1);
+    ++page_counts(reference, pos >> PAGE_BITS, offset + 1)[offset * width + (by_length() ? length - min_length : 0)];
+  }
+
+  /// <summary>
+  /// Adds a read mapped to the given position.
+  /// </summary>
+  /// <param name="reference">Reference name.</param>
+  /// <param name="pos">1-based position.</param>
+  /// <param name="length">Read length within the counted range if reads are grouped by lengths (ignored otherwise).</param>
+  inline void add(const std::string_view reference, const uint64_t pos, const uint32_t length = 0) {
+    uint32_t id = references.find(reference);
+    add(id == IdDictionary::NONE ? add_reference(reference) : id, pos, length);
+  }
+
+  /// <summary>
+  /// Adds all counts of other (e.g. partial) counts with the same grouping.
+  /// </summary>
+  /// <param name="other">The added counts.</param>
+  void merge(const PositionCounts& other) {
+    for (uint32_t i = 0; i < other.counts.size(); ++i) {
+      uint32_t reference = add_reference(other.references.name(i), other.lengths[i]);
+      for (uint64_t page = 0; page < other.counts[i].size(); ++page) {
+        const std::vector<uint32_t>& values = other.counts[i][page];
+        if (values.empty()) {
+          continue;
+        }
+        std::vector<uint32_t>& target = page_counts(reference, page, values.size() / width);
+        for (size_t j = 0; j < values.size(); ++j) {
+          target[j] += values[j];
+        }
+      }
+    }
+  }
+
+  /// <summary>
+  /// Returns reference ids sorted by reference names.
+  /// </summary>
+  std::vector<uint32_t> sorted_references() const {
+    std::vector<uint32_t> order(references.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [this](const uint32_t a, const uint32_t b) { return references.name(a) < references.name(b); });
+    return order;
+  }
+
+  /// <summary>
+  /// Writes counts in the binary format (see count_file.h); references without any read are left out.
+  /// </summary>
+  /// <param name="output">The output file.</param>
+  void write_binary(OutputFile& output) const {
+    std::string block(count_format::MAGIC, 8);
+    append_binary<uint32_t>(block, min_length);
+    append_binary<uint32_t>(block, width);
+    output.write(block);
+    uint64_t offset = block.size();
+    // Index entries and names are written after all blocks
+    std::string index, names;
+    for (uint32_t reference : sorted_references()) {
+      block.clear();
+      uint32_t n = 0;
+      uint64_t previous = 0;
+      for (uint64_t page = 0; page < counts[reference].size(); ++page) {
+        const std::vector<uint32_t>& positions = counts[reference][page];
+        for (size_t i = 0; i < positions.size(); i += width) {
+          const uint32_t* values = positions.data() + i;
+          if (std::all_of(values, values + width, [](const uint32_t value) { return value == 0; })) {
+            continue;
+          }
+          uint64_t pos = page * PAGE + i / width;
+          count_format::append_varint(block, pos - previous);
+          for (uint32_t j = 0; j < width; ++j) {
+            count_format::append_varint(block, values[j]);
+          }
+          previous = pos;
+          ++n;
+        }
+      }
+      if (n == 0) {
+        continue;
+      }
+      std::string_view name = references.name(reference);
+      append_binary<uint64_t>(index, offset);
+      append_binary<uint64_t>(index, names.size());
+      append_binary<uint32_t>(index, (uint32_t)name.size());
+      append_binary<uint32_t>(index, n);
+      names.append(name);
+      output.write(block);
+      offset += block.size();
+    }
+    uint64_t references = index.size() / count_format::INDEX_ENTRY_SIZE;
+    // Offsets of names are relative to the start of names so far
+    for (uint64_t i = 0; i < references; ++i) {
+      uint64_t name;
+      std::memcpy(&name, index.data() + i * count_format::INDEX_ENTRY_SIZE + 8, 8);
+      name += offset;
+      std::memcpy(&index[i * count_format::INDEX_ENTRY_SIZE + 8], &name, 8);
+    }
+    output.write(names);
+    append_binary<uint64_t>(index, offset + names.size());
+    append_binary<uint64_t>(index, references);
+    output.write(index);
+  }
+
+  /// <summary>
+  /// Writes non-zero counts as TAB-separated values RNAME, POS, (read length,) count; sorted by RNAME, POS (and read length).
+  /// </summary>
+  /// <param name="output">The output file.</param>
+  void write_tsv(OutputFile& output) const {
+    std::vector<uint32_t> order = sorted_references();
+    char number[24];
+    for (uint32_t reference : order) {
+      std::string_view name = references.name(reference);
+      for (uint64_t page = 0; page < counts[reference].size(); ++page) {
+        const std::vector<uint32_t>& positions = counts[reference][page];
+        for (size_t i = 0; i < positions.size(); ++i) {
+          if (positions[i] == 0) {
+            continue;
+          }
+          output.write(name.data(), name.size());
+          output.put('\t');
+          output.write(number, std::to_chars(number, number + sizeof(number), page * PAGE + i / width).ptr - number);
+          if (by_length()) {
+            output.put('\t');
+            output.write(number, std::to_chars(number, number + sizeof(number), min_length + i % width).ptr - number);
+          }
+          output.put('\t');
+          output.write(number, std::to_chars(number, number + sizeof(number), positions[i]).ptr - number);
+          output.put('\n');
+        }
+      }
+    }
+  }
+};
+
+#endif
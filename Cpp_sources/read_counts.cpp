@@ -1,47 +1,726 @@
-﻿// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
-// Last update: 2023-03-29
-// Released under Apache License 2.0
-
-#include <iostream>
-#include <sstream>
-#include <map>
-
-int main(int argc, char* argv[]) {
-  if (argc != 1) {
-    std::cout << "read_counts\t Read file in SAM format from standard input, group reads by RNAME and POS and\n";
-    std::cout << "           \t print read counts to standard output in TAB-separated values file format.\n";
-    std::cout << "Created by Jan Jelínek (jan.jelinek@biomed.cas.cz); last update: 2023-03-29; license: Apache License 2.0" << std::endl;
-    return 0;
-  }
-
-  std::map<std::string, std::map<size_t, size_t>> counts;
-  for (std::string line; std::getline(std::cin, line); ) {
-    if (line.size() > 0 && line[0] != '@') {
-      std::stringstream parts(line);
-      std::string part;
-      std::string rname;
-      size_t pos;
-      for (size_t i = 0; i < 4; i++) {
-        if (!std::getline(parts, part, '\t')) {
-          std::cerr << "Unexpected line format - not enough columns: " << line << std::endl;
-          part = "";
-          break;
-        }
-        if (i == 2) {
-          rname = part;
-        } else if (i == 3) {
-          pos = std::stoull(part);
-        }
-      }
-      if (part.empty()) {
-        continue;
-      }
-      ++counts[rname][pos];
-    }
-  }
-  for (auto counts_it = counts.begin(); counts_it != counts.end(); ++counts_it) {
-    for (auto counts_it_it = counts_it->second.begin(); counts_it_it != counts_it->second.end(); ++counts_it_it) {
-      std::cout << counts_it->first << '\t' << counts_it_it->first << '\t' << counts_it_it->second << '\n';
-    }
-  }
-}
+﻿// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "alignment_io.h"
+#include "parallel.h"
+#include "position_counts.h"
+#include "result_cache.h"
+#include "run_stats.h"
+#include "sam_fields.h"
+#include "transcript_projection.h"
+
+/// <summary>
+/// Size of a block of SAM lines processed by a single thread.
+/// </summary>
+const size_t SAM_CHUNK = 1 << 20;
+/// <summary>
+/// Number of BAM records processed by a single thread at once.
+/// </summary>
+const size_t BAM_CHUNK = 16384;
+
+/// <summary>
+/// What reads are counted and which of their positions.
+/// </summary>
+struct CountingOptions {
+  /// <summary>
+  /// Value of offsets for read lengths without an offset.
+  /// </summary>
+  static constexpr int32_t NO_OFFSET = INT32_MIN;
+
+  /// <summary>
+  /// Range of counted read lengths if reads are grouped by lengths; 0 - 0 otherwise.
+  /// </summary>
+  uint32_t min_length = 0;
+  uint32_t max_length = 0;
+  /// <summary>
+  /// P-site offsets indexed by read lengths (NO_OFFSET if reads of the length are not counted); empty if positions are not shifted.
+  /// </summary>
+  std::vector<int32_t> offsets;
+  /// <summary>
+  /// Transcripts, into which reads aligned to a genome are projected; nullptr if reads are counted in coordinates of their references.
+  /// </summary>
+  const Transcriptome* transcripts = nullptr;
+  /// <summary>
+  /// Features, which reads aligned to a genome are assigned to; nullptr if reads are counted by positions.
+  /// </summary>
+  const GenomicFeatures* features = nullptr;
+
+  /// <summary>
+  /// Whether read lengths must be computed from CIGAR.
+  /// </summary>
+  inline bool uses_cigar() const {
+    return max_length > 0 || !offsets.empty() || transcripts != nullptr || features != nullptr;
+  }
+
+  /// <summary>
+  /// Checks whether reads of a length are counted and returns their P-site offset.
+  /// </summary>
+  /// <param name="query">Read length.</param>
+  /// <param name="offset">P-site offset, 0 if positions are not shifted (output).</param>
+  /// <returns>Whether reads of the length are counted.</returns>
+  inline bool counted(const uint32_t query, int32_t& offset) const {
+    if (max_length > 0 && (query < min_length || query > max_length)) {
+      return false;
+    }
+    offset = 0;
+    if (offsets.empty()) {
+      return true;
+    }
+    if (query >= offsets.size() || offsets[query] == NO_OFFSET) {
+      return false;
+    }
+    offset = offsets[query];
+    return true;
+  }
+
+  /// <summary>
+  /// Returns the counted position of a read.
+  /// </summary>
+  /// <param name="pos">1-based POS.</param>
+  /// <param name="flag">FLAG.</param>
+  /// <param name="query">Read length.</param>
+  /// <param name="span">Length of the aligned part of the reference.</param>
+  /// <returns>The position, or 0 if the read is not counted.</returns>
+  inline uint64_t position(const uint64_t pos, const uint16_t flag, const uint32_t query, const uint32_t span) const {
+    int32_t offset;
+    if (!counted(query, offset)) {
+      return 0;
+    }
+    if (offsets.empty()) {
+      return pos;
+    }
+    // P-site is measured from the 5' end of the read, which is the last aligned base for the reverse strand
+    int64_t site = flag & 16 ? (int64_t)pos + span - 1 - offset : (int64_t)pos + offset;
+    return site < 1 ? 0 : (uint64_t)site;
+  }
+
+  /// <summary>
+  /// Projects the 5' end of a read into all transcripts on the strand of the read, whose exons contain it; the P-site offset is applied
+  /// in transcript coordinates, so it may cross exon junctions.
+  /// </summary>
+  /// <param name="reference">Id of the chromosome in transcripts.</param>
+  /// <param name="pos">1-based POS.</param>
+  /// <param name="flag">FLAG.</param>
+  /// <param name="query">Read length.</param>
+  /// <param name="span">Length of the aligned part of the reference.</param>
+  /// <param name="add">Function taking a transcript id and the counted 1-based position within the transcript.</param>
+  template <typename Add>
+  inline void project(const uint32_t reference, const uint64_t pos, const uint16_t flag, const uint32_t query, const uint32_t span, Add add) const {
+    int32_t offset;
+    if (!counted(query, offset)) {
+      return;
+    }
+    bool reverse = flag & 16;
+    transcripts->project(reference, reverse ? pos + span - 1 : pos, !reverse, [&](const uint32_t transcript, const uint64_t position) {
+      int64_t site = (int64_t)position + offset;
+      if (site >= 1 && (uint64_t)site <= transcripts->transcript(transcript).length()) {
+        add(transcript, (uint64_t)site);
+      }
+    });
+  }
+
+  /// <summary>
+  /// Finds all features on the strand of a read, which contain its 5' end (or its P-site); the P-site offset is applied in genomic coordinates.
+  /// </summary>
+  /// <param name="reference">Id of the chromosome in features.</param>
+  /// <param name="pos">1-based POS.</param>
+  /// <param name="flag">FLAG.</param>
+  /// <param name="query">Read length.</param>
+  /// <param name="span">Length of the aligned part of the reference.</param>
+  /// <param name="add">Function taking a feature id.</param>
+  /// <returns>Number of features, which the read was assigned to.</returns>
+  template <typename Add>
+  inline size_t assign(const uint32_t reference, const uint64_t pos, const uint16_t flag, const uint32_t query, const uint32_t span, Add add) const {
+    int32_t offset;
+    if (!counted(query, offset)) {
+      return 0;
+    }
+    bool reverse = flag & 16;
+    int64_t site = reverse ? (int64_t)pos + span - 1 - offset : (int64_t)pos + offset;
+    size_t found = 0;
+    if (site >= 1) {
+      features->find(reference, (uint64_t)site, !reverse, [&](const uint32_t feature) {
+        ++found;
+        add(feature);
+      });
+    }
+    return found;
+  }
+
+  /// <summary>
+  /// Loads P-site offsets.
+  /// </summary>
+  /// <param name="filename">TAB-separated values file with read length and offset per line; lines starting with '#' are ignored.</param>
+  /// <returns>0 if no error occured; otherwise the error code to be returned from the program.</returns>
+  int load_offsets(const std::string& filename) {
+    InputFile input;
+    if (!input.open(filename)) {
+      return 9;
+    }
+    for (std::string line; input.getline(line); ) {
+      if (line.empty() || line[0] == '#') {
+        continue;
+      }
+      size_t tab = line.find('\t');
+      uint32_t length;
+      int32_t offset;
+      if (tab == line.npos || !parse_integer(std::string_view(line).substr(0, tab), length) || !parse_integer(std::string_view(line).substr(tab + 1), offset) || length > 100000) {
+        std::cerr << "Unexpected line format - read length and P-site offset expected: " << line << std::endl;
+        return 2;
+      }
+      if (length >= offsets.size()) {
+        offsets.resize(length + 1, NO_OFFSET);
+      }
+      offsets[length] = offset;
+    }
+    if (input.failed()) {
+      std::cerr << "Unable to read file '" << filename << "'." << std::endl;
+      return 10;
+    }
+    return 0;
+  }
+};
+
+/// <summary>
+/// Part of an input file; either lines of a SAM file, or BAM records.
+/// </summary>
+struct CountsChunk {
+  std::string lines;
+  std::vector<Alignment> records;
+};
+
+/// <summary>
+/// Read counts of features (see CountingOptions::features), optionally grouped by read lengths.
+/// </summary>
+class FeatureCounts {
+private:
+  /// <summary>
+  /// Whether reads are grouped by their lengths (even if the range has a single length).
+  /// </summary>
+  bool grouped = false;
+  uint32_t min_length = 0;
+  /// <summary>
+  /// Number of read lengths (1 if reads are not grouped by lengths).
+  /// </summary>
+  uint32_t width = 1;
+  /// <summary>
+  /// Counts indexed by feature * width + read length - min_length.
+  /// </summary>
+  std::vector<uint64_t> counts;
+
+public:
+  FeatureCounts() {}
+  FeatureCounts(const uint32_t features, const uint32_t min_length, const uint32_t max_length)
+    : grouped(max_length > 0), min_length(min_length), width(max_length > 0 ? max_length - min_length + 1 : 1), counts((size_t)features * width, 0) {}
+
+  /// <summary>
+  /// Adds a read of the given length (which must be within the range of lengths if reads are grouped by lengths).
+  /// </summary>
+  inline void add(const uint32_t feature, const uint32_t query) {
+    ++counts[(size_t)feature * width + (grouped ? query - min_length : 0)];
+  }
+
+  /// <summary>
+  /// Adds counts of the same features and read lengths.
+  /// </summary>
+  void merge(const FeatureCounts& other) {
+    if (counts.empty()) {
+      *this = other;
+      return;
+    }
+    for (size_t i = 0; i < other.counts.size(); ++i) {
+      counts[i] += other.counts[i];
+    }
+  }
+
+  void clear() {
+    counts = std::vector<uint64_t>();
+  }
+
+  /// <summary>
+  /// Whether no feature is registered (e.g. the counts were not created for features yet, or they were cleared).
+  /// </summary>
+  inline bool empty() const {
+    return counts.empty();
+  }
+
+  /// <summary>
+  /// Writes lines 'transcript_id\tfeature\tcount' for all features in the order of annotations; if reads are grouped by lengths,
+  /// lines 'transcript_id\tfeature\tlength\tcount' only for non-zero counts.
+  /// </summary>
+  void write_tsv(OutputFile& output, const GenomicFeatures& features) const {
+    char number[24];
+    for (size_t i = 0; i < counts.size(); ++i) {
+      if (grouped && counts[i] == 0) {
+        continue;
+      }
+      std::string_view name = features.name((uint32_t)(i / width));
+      output.write(name.data(), name.size());
+      output.put('\t');
+      if (grouped) {
+        output.write(number, std::to_chars(number, number + sizeof(number), min_length + i % width).ptr - number);
+        output.put('\t');
+      }
+      output.write(number, std::to_chars(number, number + sizeof(number), counts[i]).ptr - number);
+      output.put('\n');
+    }
+  }
+};
+
+/// <summary>
+/// Counts of a single thread; they occupy separate cache lines.
+/// </summary>
+struct alignas(64) ThreadCounts {
+  PositionCounts counts;
+  FeatureCounts features;
+  /// <summary>
+  /// Reference ids in counts indexed by reference ids of the header, or by transcript ids if reads are projected into transcripts.
+  /// </summary>
+  std::vector<uint32_t> references;
+};
+
+/// <summary>
+/// Counts reads of a single file grouped by RNAME and POS.
+/// </summary>
+/// <param name="filename">Input file in SAM or BAM format; '-' stands for the standard input.</param>
+/// <param name="options">What reads are counted and which of their positions.</param>
+/// <param name="threads">Number of threads parsing and counting reads.</param>
+/// <param name="counts">Counts, which the reads are added to (output); the first thread counts into them directly, so they can accumulate multiple files.</param>
+/// <param name="feature_counts">Counts of features, which the reads are added to if they are assigned to features (output); used in the same way as counts.</param>
+/// <returns>0 if no error occured; otherwise the error code to be returned from the program.</returns>
+int count_reads(const std::string& filename, const CountingOptions& options, const size_t threads, PositionCounts& counts, FeatureCounts& feature_counts) {
+  AlignmentReader input;
+  AlignmentHeader header;
+  if (!input.open(filename, threads) || !input.read_header(header)) {
+    return 9;
+  }
+  // Every thread has own counts, they are summed at the end; the first thread adds directly to the given counts, so only the other threads allocate partial counts
+  std::vector<ThreadCounts> partial(std::max<size_t>(threads, 1));
+  partial[0].counts = std::move(counts);
+  partial[0].features = std::move(feature_counts);
+  for (size_t t = 0; t < partial.size(); ++t) {
+    ThreadCounts& thread = partial[t];
+    if (t > 0) {
+      thread.counts = PositionCounts(options.min_length, options.max_length);
+    }
+    if (options.features != nullptr) {
+      if (thread.features.empty()) {
+        thread.features = FeatureCounts(options.features->size(), options.min_length, options.max_length);
+      }
+      continue;
+    }
+    if (options.transcripts != nullptr) {
+      for (uint32_t i = 0; i < options.transcripts->size(); ++i) {
+        thread.references.push_back(thread.counts.add_reference(options.transcripts->name(i), (uint32_t)options.transcripts->transcript(i).length()));
+      }
+      continue;
+    }
+    // Lengths of references from the header say, where the last pages of counts of references end
+    for (size_t i = 0; i < header.names.size(); ++i) {
+      thread.references.push_back(thread.counts.add_reference(header.names[i], header.lengths[i]));
+    }
+  }
+  // Chromosomes in transcripts (or in features) indexed by reference ids of the header
+  std::vector<uint32_t> chromosomes;
+  if (options.transcripts != nullptr || options.features != nullptr) {
+    for (const std::string& name : header.names) {
+      chromosomes.push_back(options.features != nullptr ? options.features->reference(name) : options.transcripts->reference(name));
+    }
+  }
+  auto read_chunk = [&](CountsChunk& chunk) {
+    bool any;
+    if (input.is_binary()) {
+      chunk.records.resize(BAM_CHUNK);
+      size_t size = 0;
+      while (size < BAM_CHUNK && input.next(chunk.records[size])) {
+        ++size;
+      }
+      chunk.records.resize(size);
+      any = size > 0;
+    } else {
+      any = input.read_lines(chunk.lines, SAM_CHUNK);
+    }
+    if (input.failed()) {
+      return 10;
+    }
+    return any ? 0 : -1;
+  };
+  std::atomic<uint64_t>& alignments = RunStats::global().counter("alignments");
+  std::atomic<uint64_t>* assigned_reads = options.features != nullptr ? &RunStats::global().counter("assigned_reads") : nullptr;
+  std::atomic<uint64_t>* ambiguous_reads = options.features != nullptr ? &RunStats::global().counter("ambiguous_reads") : nullptr;
+  auto count_chunk = [&](ThreadCounts& thread, CountsChunk& chunk) {
+    // Number of records of the chunk (for statistics)
+    uint64_t records = chunk.records.size();
+    // Reads assigned to any feature and to more than one feature
+    uint64_t assigned = 0, ambiguous = 0;
+    auto assign = [&](const uint32_t chromosome, const uint64_t pos, const uint16_t flag, const uint32_t query, const uint32_t span) {
+      size_t found = options.assign(chromosome, pos, flag, query, span, [&](const uint32_t feature) { thread.features.add(feature, query); });
+      assigned += found > 0 ? 1 : 0;
+      ambiguous += found > 1 ? 1 : 0;
+    };
+    for (const Alignment& record : chunk.records) {
+      int32_t reference = record.reference_id();
+      uint64_t pos;
+      if (!record.position(pos) || pos > INT32_MAX) {
+        std::cerr << "Unexpected record format - invalid POS: " << record.qname() << std::endl;
+        continue;
+      }
+      uint32_t query = 0, span;
+      if (options.features != nullptr) {
+        if (reference >= 0 && (size_t)reference < chromosomes.size() && chromosomes[reference] != GenomicFeatures::NONE && record.cigar_lengths(query, span)) {
+          assign(chromosomes[reference], pos, record.flag(), query, span);
+        }
+        continue;
+      }
+      if (options.transcripts != nullptr) {
+        if (reference >= 0 && (size_t)reference < chromosomes.size() && chromosomes[reference] != Transcriptome::NONE && record.cigar_lengths(query, span)) {
+          options.project(chromosomes[reference], pos, record.flag(), query, span, [&](const uint32_t transcript, const uint64_t site) {
+            thread.counts.add(thread.references[transcript], site, query);
+          });
+        }
+        continue;
+      }
+      if (options.uses_cigar() && (!record.cigar_lengths(query, span) || (pos = options.position(pos, record.flag(), query, span)) == 0)) {
+        continue;
+      }
+      if (reference < 0 || (size_t)reference >= header.names.size()) {
+        thread.counts.add("*", pos, query);
+      } else {
+        thread.counts.add(thread.references[reference], pos, query);
+      }
+    }
+    std::string_view lines(chunk.lines);
+    for (size_t from = 0; from < lines.size(); ) {
+      size_t to = lines.find('\n', from);
+      std::string_view line = lines.substr(from, to - from);
+      from = to + 1;
+      if (line.size() > 0 && line[0] != '@') {
+        ++records;
+        SamRecord record;
+        if (!record.parse(line, 4)) {
+          std::cerr << "Unexpected line format - not enough columns: " << line << std::endl;
+          continue;
+        }
+        uint64_t pos;
+        if (!record.pos(pos) || pos > INT32_MAX) {
+          std::cerr << "Unexpected line format - invalid POS: " << line << std::endl;
+          continue;
+        }
+        uint32_t query = 0;
+        if (options.uses_cigar()) {
+          uint16_t flag;
+          uint32_t span;
+          if (!record.flag(flag)) {
+            std::cerr << "Unexpected line format - invalid FLAG: " << line << std::endl;
+            continue;
+          }
+          // Unmapped reads (CIGAR '*') are not counted
+          if (!parse_cigar_lengths(record.cigar(), query, span)) {
+            continue;
+          }
+          if (options.features != nullptr) {
+            uint32_t chromosome = options.features->reference(record.rname());
+            if (chromosome != GenomicFeatures::NONE) {
+              assign(chromosome, pos, flag, query, span);
+            }
+            continue;
+          }
+          if (options.transcripts != nullptr) {
+            uint32_t chromosome = options.transcripts->reference(record.rname());
+            if (chromosome != Transcriptome::NONE) {
+              options.project(chromosome, pos, flag, query, span, [&](const uint32_t transcript, const uint64_t site) {
+                thread.counts.add(thread.references[transcript], site, query);
+              });
+            }
+            continue;
+          }
+          if ((pos = options.position(pos, flag, query, span)) == 0) {
+            continue;
+          }
+        }
+        thread.counts.add(record.rname(), pos, query);
+      }
+    }
+    alignments += records;
+    if (options.features != nullptr) {
+      *assigned_reads += assigned;
+      *ambiguous_reads += ambiguous;
+    }
+    return 0;
+  };
+  int error = unordered_pipeline<CountsChunk>(partial, read_chunk, count_chunk);
+  counts = std::move(partial[0].counts);
+  feature_counts = std::move(partial[0].features);
+  // Partial counts are freed one by one, so at most one more copy of them is in memory while they are summed
+  for (size_t t = 1; t < partial.size(); ++t) {
+    if (options.features != nullptr) {
+      feature_counts.merge(partial[t].features);
+      partial[t].features.clear();
+    } else {
+      counts.merge(partial[t].counts);
+      partial[t].counts.clear();
+    }
+  }
+  return error;
+}
+
+/// <summary>
+/// Writes counts in TAB-separated values file format, or in the binary format.
+/// </summary>
+/// <param name="counts">The counts.</param>
+/// <param name="filename">Output file; '-' stands for the standard output.</param>
+/// <param name="binary">Whether the binary format (see count_file.h) should be used; it is never compressed to stay memory mappable.</param>
+/// <param name="compression">Compression of the TAB-separated values file.</param>
+/// <param name="threads">Number of threads compressing the output.</param>
+/// <param name="features">Features if reads were assigned to them (their counts are written instead of counts of positions); nullptr otherwise.</param>
+/// <param name="feature_counts">Counts of features.</param>
+/// <returns>0 if no error occured; otherwise the error code to be returned from the program.</returns>
+int write_counts(const PositionCounts& counts, const std::string& filename, const bool binary, const OutputFile::Compression compression, const size_t threads,
+  const GenomicFeatures* features, const FeatureCounts& feature_counts) {
+  OutputFile output;
+  output.set_threads(threads);
+  if (!output.open(filename, binary ? OutputFile::Compression::NONE : compression)) {
+    return 9;
+  }
+  if (features != nullptr) {
+    feature_counts.write_tsv(output, *features);
+  } else if (binary) {
+    counts.write_binary(output);
+  } else {
+    counts.write_tsv(output);
+  }
+  return output.close() ? 0 : 9;
+}
+
+int main(int argc, char* argv[]) {
+  // Number of threads shared by files and chunks of a file
+  size_t threads = 1;
+  // Whether each input file has its own output file
+  bool separate = false;
+  // Whether counts are written in the binary format
+  bool binary = false;
+  // Compression of TAB-separated values outputs
+  OutputFile::Compression compression = OutputFile::Compression::AUTO;
+  CountingOptions options;
+  Transcriptome transcripts;
+  // Annotations with features, which reads are assigned to, and the types of the features
+  std::string features_file;
+  std::vector<std::string> feature_types = { "five_prime_utr", "CDS", "three_prime_utr" };
+  GenomicFeatures features;
+  RunStats& stats = RunStats::global();
+  bool help = false;
+  int argi = 1;
+  for (; argi < argc && std::string(argv[argi]).rfind("--", 0) == 0; ++argi) {
+    std::string option(argv[argi]);
+    if (option == "--threads") {
+      if (!parse_threads(argi, argc, argv, threads)) {
+        return 1;
+      }
+      --argi;
+    } else if (option == "--compress") {
+      if (!parse_compression(argi, argc, argv, compression)) {
+        return 1;
+      }
+      --argi;
+    } else if (option == "--stats" || option == "--stats-json") {
+      if (!parse_stats(argi, argc, argv)) {
+        return 1;
+      }
+      --argi;
+    } else if (option == "--cache") {
+      if (!parse_cache(argi, argc, argv)) {
+        return 1;
+      }
+      --argi;
+    } else if (option == "--separate") {
+      separate = true;
+    } else if (option == "--binary") {
+      binary = true;
+    } else if (option == "--lengths" && argi + 1 < argc) {
+      std::string_view range(argv[++argi]);
+      size_t dash = range.find('-');
+      if (dash == range.npos || !parse_integer(range.substr(0, dash), options.min_length) || !parse_integer(range.substr(dash + 1), options.max_length)
+        || options.min_length == 0 || options.min_length > options.max_length || options.max_length - options.min_length > 1000) {
+        std::cerr << "Invalid range of read lengths '" << range << "'." << std::endl;
+        return 1;
+      }
+    } else if (option == "--offsets" && argi + 1 < argc) {
+      stats.start("offsets load");
+      int error = options.load_offsets(argv[++argi]);
+      if (error != 0) {
+        return error;
+      }
+      stats.stop();
+    } else if (option == "--transcripts" && argi + 1 < argc) {
+      stats.start("annotations load");
+      int error = transcripts.load(argv[++argi]);
+      if (error != 0) {
+        return error;
+      }
+      stats.stop(transcripts.size());
+      options.transcripts = &transcripts;
+    } else if (option == "--features" && argi + 1 < argc) {
+      features_file = argv[++argi];
+    } else if (option == "--feature-types" && argi + 1 < argc) {
+      feature_types.clear();
+      std::string_view list(argv[++argi]);
+      for (size_t from = 0; from <= list.size(); ) {
+        size_t to = std::min(list.find(',', from), list.size());
+        if (to > from) {
+          feature_types.emplace_back(list.substr(from, to - from));
+        }
+        from = to + 1;
+      }
+    } else if (option == "--help") {
+      argi = argc;
+      help = true;
+    } else {
+      std::cerr << "Unknown option '" << option << "'." << std::endl;
+      return 1;
+    }
+  }
+  if (!features_file.empty() && (options.transcripts != nullptr || binary)) {
+    std::cerr << "Reads assigned to features (--features) cannot be counted in transcripts nor written in the binary format." << std::endl;
+    return 1;
+  }
+  if (help || (separate && (argi == argc || (argc - argi) % 2 != 0))) {
+    std::cout << "read_counts [--threads N] [--lengths MIN-MAX] [--offsets <offsets>] [--transcripts <annotations> | --features <annotations> [--feature-types LIST]] [--binary | --compress FORMAT] [--cache DIR] [--stats | --stats-json FILE] [<input>*]\n";
+    std::cout << "                                    \t Read files in SAM or BAM format (standard input if no file is given),\n";
+    std::cout << "                                    \t group reads by RNAME and POS and print read counts of all files together\n";
+    std::cout << "                                    \t to standard output in TAB-separated values file format.\n";
+    std::cout << "read_counts [--threads N] [--lengths MIN-MAX] [--offsets <offsets>] [--transcripts <annotations> | --features <annotations> [--feature-types LIST]] [--binary | --compress FORMAT] [--cache DIR] [--stats | --stats-json FILE] --separate (<input> <output>)+\n";
+    std::cout << "                                    \t Write read counts of each <input> file to its own <output> file.\n";
+    std::cout << "                                    \t --lengths MIN-MAX\t count only reads of lengths MIN to MAX (computed from CIGAR) and\n";
+    std::cout << "                                    \t                  \t group them also by the length (an extra column before the count).\n";
+    std::cout << "                                    \t --offsets <offsets>\t count P-sites instead of POS; <offsets> has TAB-separated read\n";
+    std::cout << "                                    \t                    \t length and P-site offset from the 5' end on each line, reads of\n";
+    std::cout << "                                    \t                    \t other lengths are not counted.\n";
+    std::cout << "                                    \t --transcripts <annotations>\t count reads aligned to a genome in coordinates of transcripts\n";
+    std::cout << "                                    \t                            \t (transcript_id instead of RNAME) from exons in <annotations>\n";
+    std::cout << "                                    \t                            \t in GTF format or compiled by compile_annotations; the 5' end\n";
+    std::cout << "                                    \t                            \t (or the P-site) of a read is counted in all transcripts on\n";
+    std::cout << "                                    \t                            \t its strand, whose exons contain the 5' end.\n";
+    std::cout << "                                    \t --features <annotations>\t assign reads aligned to a genome to features of transcripts\n";
+    std::cout << "                                    \t                         \t (e.g. written by mane2ensembl_gtf) in <annotations> in GTF format\n";
+    std::cout << "                                    \t                         \t or compiled by compile_annotations in a single pass; the 5' end (or\n";
+    std::cout << "                                    \t                         \t the P-site, offset in genomic coordinates) of a read is counted in\n";
+    std::cout << "                                    \t                         \t all features on its strand containing it. The output has lines\n";
+    std::cout << "                                    \t                         \t 'transcript_id\\tfeature\\tcount' for all features (with a length\n";
+    std::cout << "                                    \t                         \t column before the count and only non-zero counts with --lengths).\n";
+    std::cout << "                                    \t --feature-types LIST\t comma-separated feature types of --features\n";
+    std::cout << "                                    \t                     \t (default 'five_prime_utr,CDS,three_prime_utr').\n";
+    std::cout << "                                    \t --binary   \t write counts in a compact binary format with an index, which can be\n";
+    std::cout << "                                    \t            \t read by region_readcounts.\n";
+    std::cout << "                                    \t --compress FORMAT\t compress TAB-separated outputs by 'gzip' (BGZF), 'zstd' or 'none';\n";
+    std::cout << "                                    \t                  \t by default outputs ending with '.gz' or '.zst' are compressed.\n";
+    std::cout << "                                    \t --threads N\t use up to N threads (files are processed simultaneously\n";
+    std::cout << "                                    \t            \t and a single file is parsed and counted in chunks).\n";
+    print_stats_usage("                                    \t ");
+    print_cache_usage("                                    \t ");
+    std::cout << "                                    \t --help     \t print this help.\n";
+    std::cout << "Created by Jan Jelínek (jan.jelinek@biomed.cas.cz); last update: 2026-10-14; license: Apache License 2.0" << std::endl;
+    return help ? 0 : 1;
+  }
+
+  if (!features_file.empty()) {
+    stats.start("annotations load");
+    int error = features.load(features_file, feature_types);
+    if (error != 0) {
+      return error;
+    }
+    stats.stop(features.size());
+    options.features = &features;
+  }
+
+  std::vector<std::string> inputs;
+  std::vector<std::string> outputs;
+  for (int i = argi; i < argc; i += separate ? 2 : 1) {
+    inputs.push_back(argv[i]);
+    if (separate) {
+      outputs.push_back(argv[i + 1]);
+    }
+  }
+  if (inputs.empty()) {
+    inputs.push_back("-");
+  }
+  ResultCache& cache = ResultCache::global();
+  cache.setup("read_counts", argi, argv);
+  // Counts of all files together are a single result (inputs are not hashed for it with --separate), each separate output is a result of its own
+  ResultCache::Result result = separate ? cache.uncached({ "-" }) : cache.result(inputs, { "-" });
+  if (!separate && result.restore()) {
+    stats.add("reused_outputs", 1);
+    return stats.report() ? 0 : 9;
+  }
+  // Files are processed simultaneously first, the remaining threads split files into chunks
+  size_t files = std::min(threads, inputs.size());
+  size_t chunk_threads = std::max<size_t>(1, threads / files);
+  // One accumulator per simultaneously processed file; a file is counted into any free one (sums do not depend on the order of files),
+  // so memory does not grow with the number of files
+  std::vector<PositionCounts> counts(files, PositionCounts(options.min_length, options.max_length));
+  std::vector<FeatureCounts> feature_counts(files);
+  std::vector<size_t> free_slots;
+  for (size_t slot = files; slot > 0; --slot) {
+    free_slots.push_back(slot - 1);
+  }
+  std::mutex slots_mutex;
+  stats.start("counting");
+  // Counts a file into a free accumulator, which is returned to the free ones by release()
+  auto acquire = [&]() {
+    std::lock_guard<std::mutex> lock(slots_mutex);
+    size_t slot = free_slots.back();
+    free_slots.pop_back();
+    return slot;
+  };
+  auto release = [&](const size_t slot) {
+    std::lock_guard<std::mutex> lock(slots_mutex);
+    free_slots.push_back(slot);
+  };
+  int error = parallel_for(inputs.size(), files, [&](const size_t i) {
+    if (!separate) {
+      size_t slot = acquire();
+      int error = count_reads(inputs[i], options, chunk_threads, counts[slot], feature_counts[slot]);
+      release(slot);
+      return error;
+    }
+    ResultCache::Result separate_result = cache.result({ inputs[i] }, { outputs[i] });
+    if (separate_result.restore()) {
+      stats.add("reused_outputs", 1);
+      return 0;
+    }
+    size_t slot = acquire();
+    int error = count_reads(inputs[i], options, chunk_threads, counts[slot], feature_counts[slot]);
+    if (error == 0) {
+      error = write_counts(counts[slot], separate_result.target(0), binary, compression, chunk_threads, options.features, feature_counts[slot]);
+    }
+    counts[slot].clear();
+    feature_counts[slot].clear();
+    release(slot);
+    if (error == 0 && !separate_result.store()) {
+      error = 9;
+    }
+    return error;
+  });
+  stats.stop(stats.counter("alignments"));
+  if (error == 0 && !separate) {
+    stats.start("output");
+    for (size_t i = 1; i < counts.size(); ++i) {
+      counts[0].merge(counts[i]);
+      counts[i].clear();
+      feature_counts[0].merge(feature_counts[i]);
+      feature_counts[i].clear();
+    }
+    error = write_counts(counts[0], result.target(0), binary, compression, threads, options.features, feature_counts[0]);
+    if (error == 0 && !result.store()) {
+      error = 9;
+    }
+  }
+  if (!stats.report() && error == 0) {
+    return 9;
+  }
+  return error;
+}
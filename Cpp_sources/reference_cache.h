@@ -0,0 +1,187 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef REFERENCE_CACHE_H
+#define REFERENCE_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sys/stat.h>
+#include "alignment_filters.h"
+#include "genome_file.h"
+#include "id_dictionary.h"
+
+/// <summary>
+/// References loaded by the tools (transcript_id => gene_id mappings, selected transcript_ids and genomes), which are kept for the whole process.
+/// A file is identified by its device and inode, so any path to it finds the loaded reference; a reference is loaded again once its file is modified.
+/// Tools load references only through the cache, so reference_server can load them once and run jobs in forked processes sharing them.
+/// </summary>
+class ReferenceCache {
+private:
+  template <typename T>
+  struct Entry {
+    std::string filename;
+    dev_t device;
+    ino_t inode;
+    int64_t modified;
+    int64_t size;
+    std::unique_ptr<T> value;
+  };
+
+  std::vector<Entry<TranscriptGenes>> annotations;
+  std::vector<Entry<IdDictionary>> transcript_id_lists;
+  std::vector<Entry<Genome>> genomes;
+
+  ReferenceCache() {}
+
+  /// <summary>
+  /// Fills the identity of a file into an entry.
+  /// </summary>
+  /// <returns>FALSE if the file does not exist.</returns>
+  template <typename T>
+  static bool identify(const std::string& filename, Entry<T>& entry) {
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+      return false;
+    }
+    entry.filename = filename;
+    entry.device = info.st_dev;
+    entry.inode = info.st_ino;
+    entry.modified = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+    entry.size = (int64_t)info.st_size;
+    return true;
+  }
+
+  /// <summary>
+  /// Returns a loaded reference, or loads it and keeps it.
+  /// </summary>
+  /// <param name="entries">Loaded references of the kind.</param>
+  /// <param name="filename">File of the reference.</param>
+  /// <param name="error">0 if no error occured; otherwise the error code to be returned from the program (output).</param>
+  /// <param name="load">Function loading the file into the reference and returning an error code.</param>
+  /// <returns>The reference, nullptr if it could not be loaded.</returns>
+  template <typename T, typename Load>
+  static const T* get(std::vector<Entry<T>>& entries, const std::string& filename, int& error, Load load) {
+    error = 0;
+    Entry<T> entry;
+    if (identify(filename, entry)) {
+      for (const Entry<T>& loaded : entries) {
+        if (loaded.device == entry.device && loaded.inode == entry.inode && loaded.modified == entry.modified && loaded.size == entry.size) {
+          return loaded.value.get();
+        }
+      }
+    }
+    // A missing or special file (e.g. a pipe) is loaded as before, it reports its errors
+    entry.value.reset(new T());
+    error = load(filename, *entry.value);
+    if (error != 0) {
+      return nullptr;
+    }
+    if (entry.filename.empty()) {
+      static std::vector<std::unique_ptr<T>> uncached;
+      uncached.push_back(std::move(entry.value));
+      return uncached.back().get();
+    }
+    entries.push_back(std::move(entry));
+    return entries.back().value.get();
+  }
+
+  /// <summary>
+  /// Removes references, whose files were modified or removed, and loads the modified ones again.
+  /// </summary>
+  /// <returns>Number of the loaded references.</returns>
+  template <typename T, typename Load>
+  static size_t refresh(std::vector<Entry<T>>& entries, Load load) {
+    size_t reloaded = 0;
+    for (size_t i = 0; i < entries.size(); ) {
+      Entry<T> current;
+      if (identify(entries[i].filename, current) && current.device == entries[i].device && current.inode == entries[i].inode
+        && current.modified == entries[i].modified && current.size == entries[i].size) {
+        ++i;
+        continue;
+      }
+      std::string filename = entries[i].filename;
+      entries.erase(entries.begin() + i);
+      int error;
+      if (!current.filename.empty() && get(entries, filename, error, load) != nullptr) {
+        ++reloaded;
+      }
+    }
+    return reloaded;
+  }
+
+  static int load_transcript_genes(const std::string& filename, TranscriptGenes& transcript_gene) {
+    return AmbiguousGeneFilter::load(filename, transcript_gene);
+  }
+
+  static int load_transcript_ids(const std::string& filename, IdDictionary& transcript_ids) {
+    TranscriptFilter::load(filename, transcript_ids);
+    return 0;
+  }
+
+  static int load_genome(const std::string& filename, Genome& genome) {
+    return genome.load(filename);
+  }
+
+public:
+  ReferenceCache(const ReferenceCache&) = delete;
+  ReferenceCache& operator=(const ReferenceCache&) = delete;
+
+  /// <summary>
+  /// The cache of the process.
+  /// </summary>
+  static ReferenceCache& global() {
+    static ReferenceCache cache;
+    return cache;
+  }
+
+  /// <summary>
+  /// Returns transcript_id => gene_id mapping from annotations in GTF format, or from their index (see AmbiguousGeneFilter::load).
+  /// </summary>
+  /// <param name="filename">Annotations file.</param>
+  /// <param name="error">0 if no error occured; otherwise the error code to be returned from the program (output).</param>
+  /// <returns>The mapping, nullptr if it could not be loaded.</returns>
+  const TranscriptGenes* transcript_genes(const std::string& filename, int& error) {
+    return get(annotations, filename, error, load_transcript_genes);
+  }
+
+  /// <summary>
+  /// Returns transcript_ids listed one per line (see TranscriptFilter::load); an unreadable file gives no transcript_ids.
+  /// </summary>
+  /// <param name="filename">File with one transcript_id per line.</param>
+  const IdDictionary* transcript_ids(const std::string& filename) {
+    int error;
+    return get(transcript_id_lists, filename, error, load_transcript_ids);
+  }
+
+  /// <summary>
+  /// Returns a genome from a packed genome file or a FASTA file (see Genome::load).
+  /// </summary>
+  /// <param name="filename">The packed genome or FASTA file.</param>
+  /// <param name="error">0 if no error occured; otherwise the error code to be returned from the program (output).</param>
+  /// <returns>The genome, nullptr if it could not be loaded.</returns>
+  const Genome* genome(const std::string& filename, int& error) {
+    return get(genomes, filename, error, load_genome);
+  }
+
+  /// <summary>
+  /// Removes references, whose files were modified or removed, and loads the modified ones again.
+  /// </summary>
+  /// <returns>Number of the loaded references.</returns>
+  size_t refresh() {
+    return refresh(annotations, load_transcript_genes) + refresh(transcript_id_lists, load_transcript_ids) + refresh(genomes, load_genome);
+  }
+
+  /// <summary>
+  /// Number of kept references.
+  /// </summary>
+  inline size_t size() const {
+    return annotations.size() + transcript_id_lists.size() + genomes.size();
+  }
+};
+
+#endif
@@ -0,0 +1,454 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "reference_cache.h"
+#include "served_tools.h"
+
+/// <summary>
+/// Tool, which can be run by the server.
+/// </summary>
+struct ServedTool {
+  const char* name;
+  int (*main)(int argc, char* argv[]);
+};
+
+const ServedTool served_tools[] = {
+  { "filter_alignments", filter_alignments_main },
+  { "filter_ambiguous_genes", filter_ambiguous_genes_main },
+  { "gc_content", gc_content_main },
+  { "select_transcripts", select_transcripts_main },
+};
+
+/// <summary>
+/// Request sent by a client together with its standard input, output and error output (as SCM_RIGHTS).
+/// </summary>
+struct RequestHeader {
+  uint32_t magic;
+  uint32_t length; // of the payload: the working directory and the arguments (starting by the tool), each ended by '\0'
+};
+
+const uint32_t REQUEST_MAGIC = 0x52424f31; // "RBO1"
+const uint32_t MAX_PAYLOAD = 1 << 20;
+
+volatile sig_atomic_t stop_requested = 0;
+
+void request_stop(int) {
+  stop_requested = 1;
+}
+
+/// <summary>
+/// Reads or writes exactly length bytes (restarting interrupted calls).
+/// </summary>
+/// <returns>FALSE if the connection was closed or broken.</returns>
+template <typename Transfer>
+bool transfer_all(int fd, char* data, size_t length, Transfer transfer) {
+  while (length > 0) {
+    ssize_t done = transfer(fd, data, length);
+    if (done < 0 && errno == EINTR) {
+      continue;
+    }
+    if (done <= 0) {
+      return false;
+    }
+    data += done;
+    length -= (size_t)done;
+  }
+  return true;
+}
+
+inline bool read_all(int fd, void* data, size_t length) {
+  return transfer_all(fd, (char*)data, length, [](int fd, char* data, size_t length) { return read(fd, data, length); });
+}
+
+inline bool write_all(int fd, const void* data, size_t length) {
+  return transfer_all(fd, (char*)const_cast<void*>(data), length, [](int fd, char* data, size_t length) { return write(fd, data, length); });
+}
+
+/// <summary>
+/// Fills the address of a socket.
+/// </summary>
+/// <returns>FALSE if the path is too long.</returns>
+bool socket_address(const std::string& path, sockaddr_un& address) {
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "Path of the socket '" << path << "' is too long." << std::endl;
+    return false;
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size());
+  return true;
+}
+
+/// <summary>
+/// Receives a request: the header with file descriptors of the standard streams of the client and the payload.
+/// </summary>
+/// <param name="connection">Connected socket.</param>
+/// <param name="fds">Received standard input, output and error output (output).</param>
+/// <param name="payload">Working directory and arguments (output).</param>
+/// <returns>FALSE if the request is not valid.</returns>
+bool receive_request(int connection, int (&fds)[3], std::vector<char>& payload) {
+  RequestHeader header;
+  iovec data = { &header, sizeof(header) };
+  union {
+    cmsghdr align;
+    char buffer[CMSG_SPACE(sizeof(fds))];
+  } control;
+  msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  message.msg_iov = &data;
+  message.msg_iovlen = 1;
+  message.msg_control = control.buffer;
+  message.msg_controllen = sizeof(control.buffer);
+  ssize_t received;
+  do {
+    received = recvmsg(connection, &message, MSG_CMSG_CLOEXEC);
+  } while (received < 0 && errno == EINTR);
+  fds[0] = fds[1] = fds[2] = -1;
+  cmsghdr* fd_message = CMSG_FIRSTHDR(&message);
+  if (fd_message != nullptr && fd_message->cmsg_level == SOL_SOCKET && fd_message->cmsg_type == SCM_RIGHTS && fd_message->cmsg_len == CMSG_LEN(sizeof(fds))) {
+    std::memcpy(fds, CMSG_DATA(fd_message), sizeof(fds));
+  }
+  if (received <= 0 || fds[0] < 0) {
+    return false;
+  }
+  // The rest of the header may come separately
+  if ((size_t)received < sizeof(header) && !read_all(connection, (char*)&header + received, sizeof(header) - received)) {
+    return false;
+  }
+  if (header.magic != REQUEST_MAGIC || header.length == 0 || header.length > MAX_PAYLOAD) {
+    return false;
+  }
+  payload.resize(header.length);
+  return read_all(connection, payload.data(), payload.size()) && payload.back() == '\0';
+}
+
+/// <summary>
+/// Creates the listening socket, which only the user of the server can connect to (mode 0600). A socket file left by a server,
+/// which did not stop cleanly, is removed; a socket of a running server or another file is not replaced.
+/// </summary>
+/// <returns>The listening socket, or -1 if it could not be created.</returns>
+int listen_socket(const std::string& path, const sockaddr_un& address) {
+  struct stat info;
+  if (lstat(path.c_str(), &info) == 0) {
+    if (!S_ISSOCK(info.st_mode)) {
+      std::cerr << "Unable to listen on '" << path << "': the file exists and it is not a socket." << std::endl;
+      return -1;
+    }
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool running = probe >= 0 && connect(probe, (const sockaddr*)&address, sizeof(address)) == 0;
+    int connect_error = errno;
+    if (probe >= 0) {
+      close(probe);
+    }
+    if (running) {
+      std::cerr << "Unable to listen on '" << path << "': another server is listening there." << std::endl;
+      return -1;
+    }
+    if (connect_error != ECONNREFUSED) {
+      std::cerr << "Unable to listen on '" << path << "': " << std::strerror(connect_error) << std::endl;
+      return -1;
+    }
+    if (unlink(path.c_str()) != 0) {
+      std::cerr << "Unable to remove the socket '" << path << "' of a stopped server: " << std::strerror(errno) << std::endl;
+      return -1;
+    }
+    std::cerr << "Removed the socket '" << path << "' of a stopped server." << std::endl;
+  }
+  int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener < 0) {
+    std::cerr << "Unable to listen on '" << path << "': " << std::strerror(errno) << std::endl;
+    return -1;
+  }
+  // The socket file is never accessible by other users, not even between bind and chmod
+  mode_t mask = umask(0077);
+  bool bound = bind(listener, (const sockaddr*)&address, sizeof(address)) == 0;
+  umask(mask);
+  if (!bound || chmod(path.c_str(), 0600) != 0 || listen(listener, 64) != 0) {
+    std::cerr << "Unable to listen on '" << path << "': " << std::strerror(errno) << std::endl;
+    close(listener);
+    return -1;
+  }
+  return listener;
+}
+
+/// <summary>
+/// Whether the client on a connection runs as the same user as the server (jobs run with rights of the server).
+/// </summary>
+bool same_user(int connection) {
+  ucred credentials;
+  socklen_t length = sizeof(credentials);
+  return getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0 && length == sizeof(credentials) && credentials.uid == geteuid();
+}
+
+/// <summary>
+/// Runs a request in the forked process: changes into the working directory of the client, takes over its standard streams and runs the tool.
+/// </summary>
+/// <returns>Exit code of the tool.</returns>
+int run_request(const int (&fds)[3], std::vector<char>& payload) {
+  std::vector<char*> arguments;
+  for (size_t i = 0; i < payload.size(); i += std::strlen(payload.data() + i) + 1) {
+    arguments.push_back(payload.data() + i);
+  }
+  for (int i = 0; i < 3; ++i) {
+    if (dup2(fds[i], i) < 0) {
+      return 10;
+    }
+    close(fds[i]);
+  }
+  signal(SIGPIPE, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+  signal(SIGINT, SIG_DFL);
+  if (arguments.size() < 2 || chdir(arguments[0]) != 0) {
+    std::cerr << "Unable to change the working directory to '" << arguments[0] << "'." << std::endl;
+    return 9;
+  }
+  for (const ServedTool& tool : served_tools) {
+    if (std::strcmp(tool.name, arguments[1]) == 0) {
+      arguments.push_back(nullptr);
+      return tool.main((int)arguments.size() - 2, arguments.data() + 1);
+    }
+  }
+  std::cerr << "The tool '" << arguments[1] << "' is not served." << std::endl;
+  return 1;
+}
+
+/// <summary>
+/// Job running in a forked process and the connection of its client.
+/// </summary>
+struct Job {
+  pid_t pid;
+  int connection;
+};
+
+/// <summary>
+/// Loads references and runs requests of clients until it gets SIGTERM or SIGINT.
+/// </summary>
+/// <returns>Exit code of the server.</returns>
+int serve(const std::string& path, const std::vector<std::string>& annotations, const std::vector<std::string>& transcript_ids, const std::vector<std::string>& genomes) {
+  ReferenceCache& cache = ReferenceCache::global();
+  int error;
+  for (const std::string& filename : annotations) {
+    if (cache.transcript_genes(filename, error) == nullptr) {
+      return error;
+    }
+  }
+  for (const std::string& filename : transcript_ids) {
+    cache.transcript_ids(filename);
+  }
+  for (const std::string& filename : genomes) {
+    if (cache.genome(filename, error) == nullptr) {
+      return error;
+    }
+  }
+
+  sockaddr_un address;
+  if (!socket_address(path, address)) {
+    return 1;
+  }
+  int listener = listen_socket(path, address);
+  if (listener < 0) {
+    return 9;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_handler = request_stop; // without SA_RESTART, so poll is interrupted
+  sigaction(SIGTERM, &action, nullptr);
+  sigaction(SIGINT, &action, nullptr);
+  std::cerr << "Serving on '" << path << "' with " << cache.size() << " loaded references." << std::endl;
+
+  std::vector<Job> jobs;
+  while (!stop_requested) {
+    // Report finished jobs to their clients
+    for (size_t i = 0; i < jobs.size(); ) {
+      int status;
+      if (waitpid(jobs[i].pid, &status, WNOHANG) != jobs[i].pid) {
+        ++i;
+        continue;
+      }
+      int32_t code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+      write_all(jobs[i].connection, &code, sizeof(code));
+      close(jobs[i].connection);
+      jobs.erase(jobs.begin() + i);
+    }
+    pollfd waiting = { listener, POLLIN, 0 };
+    // Jobs are checked at least each 50 ms
+    if (poll(&waiting, 1, jobs.empty() ? -1 : 50) <= 0 || !(waiting.revents & POLLIN)) {
+      continue;
+    }
+    int connection = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if (connection < 0) {
+      continue;
+    }
+    if (!same_user(connection)) {
+      std::cerr << "Request of another user refused." << std::endl;
+      int32_t code = 1;
+      write_all(connection, &code, sizeof(code));
+      close(connection);
+      continue;
+    }
+    int fds[3];
+    std::vector<char> payload;
+    if (!receive_request(connection, fds, payload)) {
+      std::cerr << "Invalid request refused." << std::endl;
+      int32_t code = 1;
+      write_all(connection, &code, sizeof(code));
+      close(connection);
+      for (int fd : fds) {
+        if (fd >= 0) {
+          close(fd);
+        }
+      }
+      continue;
+    }
+    // Modified references are loaded again, so the next jobs share them
+    cache.refresh();
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(listener);
+      close(connection);
+      int code = run_request(fds, payload);
+      std::cout.flush();
+      std::cerr.flush();
+      std::fflush(nullptr);
+      _exit(code);
+    }
+    for (int fd : fds) {
+      close(fd);
+    }
+    if (pid < 0) {
+      std::cerr << "Unable to start a job: " << std::strerror(errno) << std::endl;
+      int32_t code = 1;
+      write_all(connection, &code, sizeof(code));
+      close(connection);
+      continue;
+    }
+    jobs.push_back({ pid, connection });
+  }
+  // Running jobs are finished, but their clients are no longer informed
+  for (const Job& job : jobs) {
+    close(job.connection);
+    waitpid(job.pid, nullptr, 0);
+  }
+  close(listener);
+  unlink(path.c_str());
+  return 0;
+}
+
+/// <summary>
+/// Sends a request with the standard streams of the process to the server and waits for the exit code of the job.
+/// </summary>
+/// <returns>Exit code of the job.</returns>
+int request(const std::string& path, int argc, char* argv[]) {
+  std::vector<char> payload;
+  std::vector<char> directory(4096);
+  while (getcwd(directory.data(), directory.size()) == nullptr) {
+    if (errno != ERANGE) {
+      std::cerr << "Unable to get the working directory." << std::endl;
+      return 9;
+    }
+    directory.resize(2 * directory.size());
+  }
+  payload.insert(payload.end(), directory.data(), directory.data() + std::strlen(directory.data()) + 1);
+  for (int i = 0; i < argc; ++i) {
+    payload.insert(payload.end(), argv[i], argv[i] + std::strlen(argv[i]) + 1);
+  }
+
+  sockaddr_un address;
+  if (!socket_address(path, address)) {
+    return 1;
+  }
+  int connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (connection < 0 || connect(connection, (sockaddr*)&address, sizeof(address)) != 0) {
+    std::cerr << "Unable to connect to the server on '" << path << "': " << std::strerror(errno) << std::endl;
+    return 9;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  RequestHeader header = { REQUEST_MAGIC, (uint32_t)payload.size() };
+  const int fds[3] = { 0, 1, 2 };
+  iovec data = { &header, sizeof(header) };
+  union {
+    cmsghdr align;
+    char buffer[CMSG_SPACE(sizeof(fds))];
+  } control;
+  std::memset(&control, 0, sizeof(control));
+  msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  message.msg_iov = &data;
+  message.msg_iovlen = 1;
+  message.msg_control = control.buffer;
+  message.msg_controllen = sizeof(control.buffer);
+  cmsghdr* fd_message = CMSG_FIRSTHDR(&message);
+  fd_message->cmsg_level = SOL_SOCKET;
+  fd_message->cmsg_type = SCM_RIGHTS;
+  fd_message->cmsg_len = CMSG_LEN(sizeof(fds));
+  std::memcpy(CMSG_DATA(fd_message), fds, sizeof(fds));
+  ssize_t sent;
+  do {
+    sent = sendmsg(connection, &message, 0);
+  } while (sent < 0 && errno == EINTR);
+  int32_t code;
+  if (sent != (ssize_t)sizeof(header) || !write_all(connection, payload.data(), payload.size()) || !read_all(connection, &code, sizeof(code))) {
+    std::cerr << "The server on '" << path << "' did not finish the job." << std::endl;
+    close(connection);
+    return 10;
+  }
+  close(connection);
+  return code;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc >= 3 && std::string(argv[1]) == "--listen") {
+    const std::string path(argv[2]);
+    std::vector<std::string> annotations, transcript_ids, genomes;
+    int argi = 3;
+    for (; argi + 1 < argc; argi += 2) {
+      const std::string option(argv[argi]);
+      if (option == "--annotations") {
+        annotations.push_back(argv[argi + 1]);
+      } else if (option == "--transcript-ids") {
+        transcript_ids.push_back(argv[argi + 1]);
+      } else if (option == "--genome") {
+        genomes.push_back(argv[argi + 1]);
+      } else {
+        break;
+      }
+    }
+    if (argi == argc) {
+      return serve(path, annotations, transcript_ids, genomes);
+    }
+  } else if (argc >= 3 && argv[1][0] != '-') {
+    return request(argv[1], argc - 2, argv + 2);
+  }
+  std::cout << "reference_server --listen <socket> [--annotations <file>]* [--transcript-ids <file>]* [--genome <file>]*\n";
+  std::cout << "                                   \t It loads given annotations (GTF or their index), lists of transcript_ids and genomes\n";
+  std::cout << "                                   \t (packed or FASTA) once and listens on Unix <socket> for jobs until SIGTERM or SIGINT.\n";
+  std::cout << "                                   \t Each job runs in a forked process sharing the loaded references; a reference is\n";
+  std::cout << "                                   \t loaded again once its file is modified, references not given here are loaded by jobs.\n";
+  std::cout << "                                   \t Only the user of the server can connect to <socket> (it has mode 0600); a socket left\n";
+  std::cout << "                                   \t by a stopped server is replaced.\n";
+  std::cout << "reference_server <socket> <tool> [arguments]\n";
+  std::cout << "                                   \t It runs <tool> (filter_alignments, filter_ambiguous_genes, gc_content or\n";
+  std::cout << "                                   \t select_transcripts) with [arguments] by the server on <socket> in the current\n";
+  std::cout << "                                   \t directory with the standard input and outputs of this process and returns its exit code.\n";
+  std::cout << "Created by Jan Jelínek (jan.jelinek@biomed.cas.cz); last update: 2026-10-14; license: Apache License 2.0" << std::endl;
+  return (argc == 1) ? 0 : 1;
+}
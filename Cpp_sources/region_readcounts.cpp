@@ -1,100 +1,253 @@
-﻿// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
-// Last update: 2023-03-31
-// Released under Apache License 2.0
-
-#include <iostream>
-#include <fstream>
-#include <sstream>
-#include <map>
-#include <set>
-
-int main(int argc, char* argv[]) {
-  if (argc != 3) {
-	std::cout << "region_readcounts <ranges> <counts>\t Reads ranges [from; to) or lengths for each identifier from <ranges> in tab-separated values file format; and\n";
-	std::cout << "                                   \t computes an total read count within the region from <counts> file in tab-separated values file format.\n\n";
-	std::cout << "                                   \t <ranges> should have lines in format '[identifier]\\t[from]\\t[to]' or '[identifier]\\t[length]'; and\n";
-	std::cout << "                                   \t <counts> should have lines in format '[identifier]\\t[position]\\t[count]'.\n";
-	std::cout << "Created by Jan Jelínek (jan.jelinek@biomed.cas.cz); last update: 2023-03-31; license: Apache License 2.0" << std::endl;
-	return 0;
-  }
-
-  // <id; <from; to>> Boundaries of the examined region [from; to) for each identifier
-  std::map<std::string, std::pair<size_t, size_t>> ranges;
-  {
-	// Tab-separated input file with lines in '<id>\t<length>' or '<id>\t<from>\t<to>' format
-	std::ifstream ranges_file(argv[1]);
-	for (std::string line; std::getline(ranges_file, line);) {
-	  // Position of the first separator
-	  size_t tab_first = line.find('\t');
-	  if (tab_first == line.npos) {
-		std::cerr << "Unexpected line format, three columns expected, but only one occured: " << line << std::endl;
-		continue;
-	  }
-	  // Position of the second separator
-	  size_t tab_second = line.find('\t', tab_first + 1);
-	  if (tab_second == line.npos) {
-		ranges[line.substr(0, tab_first)] = std::pair<size_t, size_t>(1, 1+std::stoull(line.substr(tab_first + 1)));
-	  } else {
-		if (line.find('\t', tab_second + 1) != line.npos) {
-		  std::cerr << "Unexpected line format, three columns expected, but at least four occured: " << line << std::endl;
-		  continue;
-		}
-		ranges[line.substr(0, tab_first)] = std::pair<size_t, size_t>(std::stoull(line.substr(tab_first + 1, tab_second - tab_first - 1)), std::stoull(line.substr(tab_second + 1)));
-	  }
-	}
-  }
-
-  // <id, coef> Total read count within a region for each identifier
-  std::map<std::string, double> coefs;
-  {
-	// Tab-separated input file with lines in '<id>\t<position>\t<count>' format
-	std::ifstream counts_file(argv[2]);
-	// Set of identifiers missing in ranges to do not repat the error message
-	std::set<std::string> missing;
-	for (std::string line; std::getline(counts_file, line);) {
-	  // Position of the first separator
-	  size_t tab_first = line.find('\t');
-	  if (tab_first == line.npos) {
-		std::cerr << "Unexpected line format, three columns expected, but only one occured: " << line << std::endl;
-		continue;
-	  }
-	  // Position of the second separator
-	  size_t tab_second = line.find('\t', tab_first + 1);
-	  if (tab_second == line.npos) {
-		std::cerr << "Unexpected line format, three columns expected, but only two occured: " << line << std::endl;
-		continue;
-	  }
-	  if (line.find('\t', tab_second + 1) != line.npos) {
-		std::cerr << "Unexpected line format, three columns expected, but at least four occured: " << line << std::endl;
-		continue;
-	  }
-	  // The current identifier
-	  std::string id = line.substr(0, tab_first);
-	  // Pointer to the current identifier in ranges map
-	  auto ranges_it = ranges.find(id);
-	  if (ranges_it == ranges.end()) {
-		if (missing.find(id) == missing.end()) {
-		  std::cerr << "Identifier '" << id << "' is missing in the ranges file" << std::endl;
-		  missing.emplace(id);
-		}
-		continue;
-	  }
-	  // Position from the current line
-	  size_t pos = std::stoull(line.substr(tab_first + 1, tab_second - tab_first - 1));
-	  if (ranges_it->second.first <= pos && pos < ranges_it->second.second) {
-		coefs[id] += std::stod(line.substr(tab_second + 1));
-	  }
-	}
-  }
-
-  if (coefs.empty()) {
-	std::cerr << "No coefficent was loaded, it is not possible to normalize" << std::endl;
-	return 2;
-  }
-  std::cout.precision(10);
-  for (auto coefs_it = coefs.begin(); coefs_it != coefs.end(); ++coefs_it) {
-	std::cout << coefs_it->first << '\t' << coefs_it->second << '\n';
-  }
-
-  return 0;
-}
+﻿// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "compressed_io.h"
+#include "count_file.h"
+#include "id_dictionary.h"
+#include "result_cache.h"
+#include "run_stats.h"
+
+/// <summary>
+/// The longest reference, whose prefix sums of counts are stored for all positions.
+/// </summary>
+const size_t DENSE_LIMIT = 1 << 24;
+
+int main(int argc, char* argv[]) {
+  // Compression of the standard output
+  OutputFile::Compression compression = OutputFile::Compression::NONE;
+  int argi = 1;
+  for (int previous = 0; previous != argi; ) {
+	previous = argi;
+	if (!parse_compression(argi, argc, argv, compression) || !parse_stats(argi, argc, argv) || !parse_cache(argi, argc, argv)) {
+	  return 1;
+	}
+  }
+  if (argc - argi < 2) {
+	std::cout << "region_readcounts [--compress FORMAT] [--cache DIR] [--stats | --stats-json FILE] (<ranges>)+ <counts>\t Reads ranges [from; to) or lengths for each identifier from <ranges> in tab-separated values file format; and\n";
+	std::cout << "                                      \t computes an total read count within the region from <counts> file in tab-separated values file format.\n";
+	std::cout << "                                      \t Multiple <ranges> files (e.g. 5'UTRs, CDSs and 3'UTRs) are evaluated in a single pass over <counts>,\n";
+	std::cout << "                                      \t the output has a column of total read counts for each of them (in the order of arguments).\n\n";
+	std::cout << "                                      \t <ranges> should have lines in format '[identifier]\\t[from]\\t[to]' or '[identifier]\\t[length]'; and\n";
+	std::cout << "                                      \t <counts> should have lines in format '[identifier]\\t[position]\\t[count]', or it can be\n";
+	std::cout << "                                      \t in the binary format written by 'read_counts --binary'.\n";
+	std::cout << "                                      \t --compress FORMAT\t compress the output by 'gzip' (BGZF), 'zstd' or 'none'.\n";
+	print_stats_usage("                                      \t ");
+	print_cache_usage("                                      \t ");
+	std::cout << "Created by Jan Jelínek (jan.jelinek@biomed.cas.cz); last update: 2026-10-14; license: Apache License 2.0" << std::endl;
+	return 0;
+  }
+
+  RunStats& stats = RunStats::global();
+  ResultCache& cache = ResultCache::global();
+  cache.setup("region_readcounts", argi, argv);
+  ResultCache::Result result = cache.result(std::vector<std::string>(argv + argi, argv + argc), { "-" });
+  if (result.restore()) {
+	stats.add("reused_outputs", 1);
+	return stats.report() ? 0 : 9;
+  }
+  stats.start("ranges load");
+  // Number of lines of all ranges files
+  uint64_t range_lines = 0;
+  // Number of region sets (ranges files)
+  const size_t sets = argc - argi - 1;
+  // Identifiers occuring in any ranges file
+  IdDictionary ids;
+  // <from; to> Boundaries of the examined region [from; to) for each identifier and region set (at index id * sets + set); empty if the identifier is missing in the set
+  std::vector<std::pair<size_t, size_t>> ranges;
+  for (size_t set = 0; set < sets; ++set) {
+	// Tab-separated input file with lines in '<id>\t<length>' or '<id>\t<from>\t<to>' format
+	InputFile ranges_file;
+	if (!ranges_file.open(argv[argi + set])) {
+	  return 9;
+	}
+	for (std::string line; ranges_file.getline(line);) {
+	  ++range_lines;
+	  // Position of the first separator
+	  size_t tab_first = line.find('\t');
+	  if (tab_first == line.npos) {
+		std::cerr << "Unexpected line format, three columns expected, but only one occured: " << line << std::endl;
+		continue;
+	  }
+	  // Position of the second separator
+	  size_t tab_second = line.find('\t', tab_first + 1);
+	  std::pair<size_t, size_t> range;
+	  if (tab_second == line.npos) {
+		range = std::pair<size_t, size_t>(1, 1+std::stoull(line.substr(tab_first + 1)));
+	  } else {
+		if (line.find('\t', tab_second + 1) != line.npos) {
+		  std::cerr << "Unexpected line format, three columns expected, but at least four occured: " << line << std::endl;
+		  continue;
+		}
+		range = std::pair<size_t, size_t>(std::stoull(line.substr(tab_first + 1, tab_second - tab_first - 1)), std::stoull(line.substr(tab_second + 1)));
+	  }
+	  uint32_t id = ids.insert(std::string_view(line).substr(0, tab_first));
+	  if (ranges.size() <= id * sets) {
+		ranges.resize((id + 1) * sets, std::pair<size_t, size_t>(0, 0));
+	  }
+	  ranges[id * sets + set] = range;
+	}
+  }
+
+  stats.stop(range_lines);
+  stats.add("identifiers", ids.size());
+
+  stats.start("counting");
+  // Number of identifiers (binary counts) or lines (tab-separated counts) read from the counts file
+  uint64_t count_records = 0;
+  // Total read count within a region for each identifier and region set (at index id * sets + set)
+  std::vector<double> coefs(ranges.size(), 0);
+  // Whether at least one position of an identifier lies within any of its regions
+  std::vector<bool> counted(ids.size(), false);
+  if (CountFile::is_count_file(argv[argc - 1])) {
+	// Binary file is mapped into memory
+	CountFile counts_file;
+	if (!counts_file.open(argv[argc - 1])) {
+	  return 9;
+	}
+	// Positions with non-zero counts of the current identifier and their prefix sums
+	std::vector<uint64_t> positions, cumulative;
+	// dense[pos] is the total count of all positions lower than pos, so a region is summed in O(1)
+	std::vector<uint64_t> dense;
+	for (size_t i = 0; i < counts_file.references(); ++i) {
+	  // The current identifier
+	  std::string_view name = counts_file.name(i);
+	  ++count_records;
+	  uint32_t id = ids.find(name);
+	  if (id == IdDictionary::NONE) {
+		std::cerr << "Identifier '" << name << "' is missing in the ranges file" << std::endl;
+		continue;
+	  }
+	  if (!counts_file.read(i, positions, cumulative)) {
+		std::cerr << "Unexpected file format: corrupted block of identifier '" << name << "' in file '" << argv[argc - 1] << "'" << std::endl;
+		return 10;
+	  }
+	  if (positions.empty()) {
+		continue;
+	  }
+	  // Too long references (e.g. whole chromosomes) are searched in the sparse positions instead
+	  bool use_dense = positions.back() < DENSE_LIMIT;
+	  if (use_dense) {
+		dense.assign(positions.back() + 2, 0);
+		for (size_t j = 0, pos = 0; pos < dense.size(); ++pos) {
+		  while (j < positions.size() && positions[j] < pos) {
+			++j;
+		  }
+		  dense[pos] = cumulative[j];
+		}
+	  }
+	  // Total count of all positions lower than pos
+	  auto prefix = [&](const size_t pos) {
+		if (use_dense) {
+		  return dense[std::min(pos, dense.size() - 1)];
+		}
+		return cumulative[std::lower_bound(positions.begin(), positions.end(), pos) - positions.begin()];
+	  };
+	  for (size_t set = 0; set < sets; ++set) {
+		const std::pair<size_t, size_t>& range = ranges[id * sets + set];
+		if (range.first < range.second) {
+		  uint64_t total = prefix(range.second) - prefix(range.first);
+		  coefs[id * sets + set] = (double)total;
+		  counted[id] = counted[id] || total > 0;
+		}
+	  }
+	}
+  } else {
+	// Tab-separated input file with lines in '<id>\t<position>\t<count>' format
+	InputFile counts_file;
+	if (!counts_file.open(argv[argc - 1])) {
+	  return 9;
+	}
+	// Identifiers missing in ranges to do not repat the error message
+	IdDictionary missing;
+	for (std::string line; counts_file.getline(line);) {
+	  ++count_records;
+	  // Position of the first separator
+	  size_t tab_first = line.find('\t');
+	  if (tab_first == line.npos) {
+		std::cerr << "Unexpected line format, three columns expected, but only one occured: " << line << std::endl;
+		continue;
+	  }
+	  // Position of the second separator
+	  size_t tab_second = line.find('\t', tab_first + 1);
+	  if (tab_second == line.npos) {
+		std::cerr << "Unexpected line format, three columns expected, but only two occured: " << line << std::endl;
+		continue;
+	  }
+	  if (line.find('\t', tab_second + 1) != line.npos) {
+		std::cerr << "Unexpected line format, three columns expected, but at least four occured: " << line << std::endl;
+		continue;
+	  }
+	  // The current identifier
+	  std::string_view name = std::string_view(line).substr(0, tab_first);
+	  uint32_t id = ids.find(name);
+	  if (id == IdDictionary::NONE) {
+		if (missing.find(name) == IdDictionary::NONE) {
+		  std::cerr << "Identifier '" << name << "' is missing in the ranges file" << std::endl;
+		  missing.insert(name);
+		}
+		continue;
+	  }
+	  // Position from the current line
+	  size_t pos = std::stoull(line.substr(tab_first + 1, tab_second - tab_first - 1));
+	  // Count is parsed only if the position lies within some region
+	  bool parsed = false;
+	  double count = 0;
+	  for (size_t set = 0; set < sets; ++set) {
+		const std::pair<size_t, size_t>& range = ranges[id * sets + set];
+		if (range.first <= pos && pos < range.second) {
+		  if (!parsed) {
+			count = std::stod(line.substr(tab_second + 1));
+			parsed = true;
+		  }
+		  coefs[id * sets + set] += count;
+		  counted[id] = true;
+		}
+	  }
+	}
+  }
+
+  stats.stop(count_records);
+
+  stats.start("output");
+  // Identifiers are printed in the alphabetical order
+  std::vector<uint32_t> order;
+  for (uint32_t id = 0; id < ids.size(); ++id) {
+	if (counted[id]) {
+	  order.push_back(id);
+	}
+  }
+  if (order.empty()) {
+	std::cerr << "No coefficent was loaded, it is not possible to normalize" << std::endl;
+	return 2;
+  }
+  std::sort(order.begin(), order.end(), [&ids](const uint32_t a, const uint32_t b) { return ids.name(a) < ids.name(b); });
+  OutputFile output;
+  if (!output.open(result.target(0), compression)) {
+	return 9;
+  }
+  // Rows are formatted by a stream to keep the precision of counts
+  std::ostringstream row;
+  row.precision(10);
+  for (uint32_t id : order) {
+	row.str(std::string());
+	row << ids.name(id);
+	for (size_t set = 0; set < sets; ++set) {
+	  row << '\t' << coefs[id * sets + set];
+	}
+	row << '\n';
+	output.write(row.str());
+  }
+
+  if (!output.close() || !result.store()) {
+	return 9;
+  }
+  stats.stop(order.size());
+  stats.add("counted_identifiers", order.size());
+  return stats.report() ? 0 : 9;
+}
@@ -0,0 +1,583 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// <summary>
+/// Streaming 64-bit hash of file contents (the XXH64 algorithm).
+/// </summary>
+class ContentHash {
+private:
+  static constexpr uint64_t P1 = 11400714785074694791ULL;
+  static constexpr uint64_t P2 = 14029467366897019727ULL;
+  static constexpr uint64_t P3 = 1609587929392839161ULL;
+  static constexpr uint64_t P4 = 9650029242287828579ULL;
+  static constexpr uint64_t P5 = 2870177450012600261ULL;
+
+  uint64_t lanes[4];
+  unsigned char buffer[32];
+  size_t buffered;
+  uint64_t total;
+
+  static inline uint64_t rotate(const uint64_t value, const int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+  static inline uint64_t read64(const unsigned char* data) {
+    uint64_t value;
+    std::memcpy(&value, data, 8);
+    return value;
+  }
+
+  static inline uint64_t round(uint64_t lane, const uint64_t input) {
+    return rotate(lane + input * P2, 31) * P1;
+  }
+
+  inline void stripe(const unsigned char* data) {
+    for (size_t i = 0; i < 4; ++i) {
+      lanes[i] = round(lanes[i], read64(data + 8 * i));
+    }
+  }
+
+public:
+  ContentHash() : lanes{ P1 + P2, P2, 0, 0 - P1 }, buffered(0), total(0) {}
+
+  /// <summary>
+  /// Adds bytes to the hashed content.
+  /// </summary>
+  void update(const void* data, size_t size) {
+    const unsigned char* it = (const unsigned char*)data;
+    total += size;
+    if (buffered > 0) {
+      size_t part = std::min(size, 32 - buffered);
+      std::memcpy(buffer + buffered, it, part);
+      buffered += part;
+      it += part;
+      size -= part;
+      if (buffered < 32) {
+        return;
+      }
+      stripe(buffer);
+      buffered = 0;
+    }
+    for (; size >= 32; it += 32, size -= 32) {
+      stripe(it);
+    }
+    std::memcpy(buffer, it, size);
+    buffered = size;
+  }
+
+  inline void update(const std::string_view text) { update(text.data(), text.size()); }
+
+  /// <summary>
+  /// Hash of the content added so far.
+  /// </summary>
+  uint64_t digest() const {
+    uint64_t hash;
+    if (total >= 32) {
+      hash = rotate(lanes[0], 1) + rotate(lanes[1], 7) + rotate(lanes[2], 12) + rotate(lanes[3], 18);
+      for (uint64_t lane : lanes) {
+        hash = (hash ^ round(0, lane)) * P1 + P4;
+      }
+    } else {
+      hash = P5;
+    }
+    hash += total;
+    size_t i = 0;
+    for (; i + 8 <= buffered; i += 8) {
+      hash = rotate(hash ^ round(0, read64(buffer + i)), 27) * P1 + P4;
+    }
+    if (i + 4 <= buffered) {
+      uint32_t value;
+      std::memcpy(&value, buffer + i, 4);
+      hash = rotate(hash ^ (value * P1), 23) * P2 + P3;
+      i += 4;
+    }
+    for (; i < buffered; ++i) {
+      hash = rotate(hash ^ (buffer[i] * P5), 11) * P1;
+    }
+    hash ^= hash >> 33;
+    hash *= P2;
+    hash ^= hash >> 29;
+    hash *= P3;
+    hash ^= hash >> 32;
+    return hash;
+  }
+
+  /// <summary>
+  /// Hash of the content as 16 hexadecimal digits.
+  /// </summary>
+  std::string hex() const {
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", (unsigned long long)digest());
+    return std::string(text, 16);
+  }
+};
+
+/// <summary>
+/// Directory of cached outputs of the tools (enabled by '--cache DIR').
+/// A result is keyed by the tool, a hash of its executable, relevant options (files given as options by their content hashes) and content hashes of its inputs;
+/// it is stored as '<key>.<n>' files (the n-th output) with a sidecar manifest '<key>.manifest' listing the key material and hashes of the outputs.
+/// Hashes of files are remembered in '<identity>.hash' files (by device, inode, size and modification time), so an unchanged file is hashed once.
+/// All files are written under temporary names and renamed, so tools may share the directory simultaneously.
+/// </summary>
+class ResultCache {
+private:
+  std::string directory;
+  /// <summary>
+  /// Key material shared by all results of the process: the tool, its executable and options.
+  /// </summary>
+  std::string request;
+  /// <summary>
+  /// Paths of inputs (written to manifests for information only, they are not a part of keys).
+  /// </summary>
+  std::string sources;
+  bool valid;
+  mutable std::atomic<uint64_t> temporary_files;
+
+  ResultCache() : valid(false), temporary_files(0) {}
+
+  /// <summary>
+  /// Unique name of a temporary file for the given file.
+  /// </summary>
+  std::string temporary(const std::string& filename) const {
+    return filename + ".tmp" + std::to_string(getpid()) + "_" + std::to_string(temporary_files++);
+  }
+
+  /// <summary>
+  /// Writes a file under a temporary name and renames it.
+  /// </summary>
+  /// <returns>FALSE if the file could not be written.</returns>
+  bool write_file(const std::string& filename, const std::string& content) const {
+    std::string partial = temporary(filename);
+    FILE* file = std::fopen(partial.c_str(), "wb");
+    if (file == nullptr) {
+      return false;
+    }
+    bool written = std::fwrite(content.data(), 1, content.size(), file) == content.size();
+    written = std::fclose(file) == 0 && written;
+    if (!written || std::rename(partial.c_str(), filename.c_str()) != 0) {
+      std::remove(partial.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  /// <summary>
+  /// Reads a whole file.
+  /// </summary>
+  /// <returns>FALSE if the file could not be read.</returns>
+  static bool read_file(const std::string& filename, std::string& content) {
+    FILE* file = std::fopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+      return false;
+    }
+    content.clear();
+    char block[4096];
+    for (size_t n; (n = std::fread(block, 1, sizeof(block), file)) > 0; ) {
+      content.append(block, n);
+    }
+    bool read = !std::ferror(file);
+    std::fclose(file);
+    return read;
+  }
+
+  /// <summary>
+  /// Copies a file (to the standard output if the target is '-').
+  /// </summary>
+  /// <returns>FALSE if the file could not be copied.</returns>
+  static bool copy_file(const std::string& from, const std::string& to) {
+    FILE* input = std::fopen(from.c_str(), "rb");
+    if (input == nullptr) {
+      return false;
+    }
+    FILE* output = to == "-" ? stdout : std::fopen(to.c_str(), "wb");
+    bool copied = output != nullptr;
+    std::vector<char> block(1 << 20);
+    for (size_t n; copied && (n = std::fread(block.data(), 1, block.size(), input)) > 0; ) {
+      copied = std::fwrite(block.data(), 1, n, output) == n;
+    }
+    copied = copied && !std::ferror(input);
+    std::fclose(input);
+    if (output != nullptr) {
+      copied = (output == stdout ? std::fflush(output) : std::fclose(output)) == 0 && copied;
+    }
+    return copied;
+  }
+
+  /// <summary>
+  /// Places a file to another path as a hard link, or as a copy if the link is not possible (e.g. across file systems).
+  /// </summary>
+  /// <returns>FALSE if the file could not be placed.</returns>
+  bool place_file(const std::string& from, const std::string& to) const {
+    if (to == "-") {
+      return copy_file(from, to);
+    }
+    struct stat source, target;
+    if (stat(from.c_str(), &source) == 0 && stat(to.c_str(), &target) == 0 && source.st_dev == target.st_dev && source.st_ino == target.st_ino) {
+      return true; // Already linked
+    }
+    std::string partial = temporary(to);
+    if (link(from.c_str(), partial.c_str()) != 0 && !copy_file(from, partial)) {
+      std::remove(partial.c_str());
+      return false;
+    }
+    if (std::rename(partial.c_str(), to.c_str()) != 0) {
+      std::remove(partial.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  /// <summary>
+  /// How an output is written besides its content: compression and the format are chosen by its extension (e.g. '.bam', '.gz').
+  /// </summary>
+  static std::string output_kind(const std::string& filename) {
+    if (filename == "-") {
+      return "-";
+    }
+    size_t name = filename.find_last_of('/');
+    size_t dot = filename.find('.', name == filename.npos ? 0 : name + 1);
+    return dot == filename.npos ? std::string() : filename.substr(dot);
+  }
+
+public:
+  /// <summary>
+  /// Result of a tool, which is restored from the cache or stored in it.
+  /// A result without the cache (or with an input, which cannot be hashed, e.g. the standard input) writes its outputs directly.
+  /// </summary>
+  class Result {
+  private:
+    friend class ResultCache;
+    const ResultCache* cache;
+    std::string key;
+    std::string request;
+    std::string sources;
+    std::vector<std::string> outputs;
+    /// <summary>
+    /// Files written by the tool: outputs, or temporary files for the standard output.
+    /// </summary>
+    std::vector<std::string> targets;
+    bool stored;
+
+    Result(const ResultCache* cache, const std::vector<std::string>& outputs) : cache(cache), outputs(outputs), targets(outputs), stored(false) {}
+
+    inline std::string cached(const size_t i) const { return cache->directory + '/' + key + '.' + std::to_string(i); }
+    inline std::string manifest() const { return cache->directory + '/' + key + ".manifest"; }
+
+  public:
+    Result(const Result&) = delete;
+    Result& operator=(const Result&) = delete;
+    Result(Result&& other) : cache(other.cache), key(std::move(other.key)), request(std::move(other.request)), sources(std::move(other.sources)), outputs(std::move(other.outputs)),
+      targets(std::move(other.targets)), stored(other.stored) {
+      other.stored = true;
+    }
+
+    ~Result() {
+      if (cache == nullptr || stored) {
+        return;
+      }
+      for (size_t i = 0; i < outputs.size(); ++i) {
+        if (outputs[i] == "-") {
+          std::remove(targets[i].c_str());
+        }
+      }
+    }
+
+    /// <summary>
+    /// Whether the result is cached.
+    /// </summary>
+    inline bool cacheable() const { return cache != nullptr; }
+
+    /// <summary>
+    /// File, which the tool writes instead of the given output.
+    /// </summary>
+    inline const std::string& target(const size_t i) const { return targets[i]; }
+
+    /// <summary>
+    /// Writes outputs from the cache if a valid result is there: its manifest has the same key material and the outputs still have the recorded hashes.
+    /// Otherwise files of outputs are removed (and not overwritten), so linked cached outputs stay valid.
+    /// </summary>
+    /// <returns>TRUE if the outputs were restored.</returns>
+    bool restore() {
+      if (cache == nullptr) {
+        return false;
+      }
+      std::string content;
+      bool valid = read_file(manifest(), content) && content.compare(0, request.size(), request) == 0;
+      size_t line = request.size();
+      for (size_t i = 0; valid && i < outputs.size(); ++i) {
+        std::string expected = "output\t" + std::to_string(i) + '\t';
+        std::string hash;
+        valid = content.compare(line, expected.size(), expected) == 0 && cache->hash_file(cached(i), hash) && content.compare(line + expected.size(), hash.size() + 1, hash + '\n') == 0;
+        line += expected.size() + hash.size() + 1;
+      }
+      for (size_t i = 0; valid && i < outputs.size(); ++i) {
+        valid = cache->place_file(cached(i), outputs[i]);
+        if (!valid) {
+          std::cerr << "Unable to restore cached output '" << outputs[i] << "'." << std::endl;
+        }
+      }
+      if (valid) {
+        stored = true;
+        return true;
+      }
+      for (const std::string& output : outputs) {
+        if (output != "-") {
+          unlink(output.c_str());
+        }
+      }
+      return false;
+    }
+
+    /// <summary>
+    /// Stores outputs written by the tool in the cache; the standard output is written from its temporary file.
+    /// </summary>
+    /// <returns>FALSE if the standard output could not be written; a result, which could not be cached, is only reported.</returns>
+    bool store() {
+      if (cache == nullptr || stored) {
+        return true;
+      }
+      stored = true;
+      std::string content = request;
+      bool cached_all = true;
+      for (size_t i = 0; i < outputs.size(); ++i) {
+        std::string hash;
+        bool placed = outputs[i] == "-" ? std::rename(targets[i].c_str(), cached(i).c_str()) == 0 : cache->place_file(outputs[i], cached(i));
+        if (outputs[i] == "-" && !placed) {
+          std::cerr << "Unable to store outputs in the cache '" << cache->directory << "'." << std::endl;
+          bool written = copy_file(targets[i], "-");
+          std::remove(targets[i].c_str());
+          return written;
+        }
+        if (outputs[i] == "-" && !copy_file(cached(i), "-")) {
+          std::cerr << "Unable to write the standard output." << std::endl;
+          return false;
+        }
+        cached_all = cached_all && placed && cache->hash_file(cached(i), hash);
+        content += "output\t" + std::to_string(i) + '\t' + hash + '\n';
+      }
+      content += sources;
+      if (!cached_all || !cache->write_file(manifest(), content)) {
+        std::cerr << "Unable to store outputs in the cache '" << cache->directory << "'." << std::endl;
+      }
+      return true;
+    }
+  };
+
+  ResultCache(const ResultCache&) = delete;
+  ResultCache& operator=(const ResultCache&) = delete;
+
+  /// <summary>
+  /// The cache of the process.
+  /// </summary>
+  static ResultCache& global() {
+    static ResultCache cache;
+    return cache;
+  }
+
+  /// <summary>
+  /// Whether results are cached.
+  /// </summary>
+  inline bool enabled() const { return valid; }
+
+  /// <summary>
+  /// Uses a directory for cached results; it is created if it does not exist.
+  /// </summary>
+  /// <returns>FALSE if the directory could not be created.</returns>
+  bool open(const std::string& path) {
+    if (mkdir(path.c_str(), 0777) != 0 && errno != EEXIST) {
+      std::cerr << "Unable to create the cache directory '" << path << "'." << std::endl;
+      return false;
+    }
+    directory = path;
+    return true;
+  }
+
+  /// <summary>
+  /// Content hash of a regular file, which is remembered in the cache directory.
+  /// </summary>
+  /// <param name="filename">Path to the file.</param>
+  /// <param name="hash">The hash as hexadecimal digits (output).</param>
+  /// <returns>FALSE if the file is not a readable regular file.</returns>
+  bool hash_file(const std::string& filename, std::string& hash) const {
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+      return false;
+    }
+    ContentHash identity;
+    uint64_t fields[] = { (uint64_t)info.st_dev, (uint64_t)info.st_ino, (uint64_t)info.st_size, (uint64_t)info.st_mtim.tv_sec, (uint64_t)info.st_mtim.tv_nsec };
+    identity.update(fields, sizeof(fields));
+    std::string remembered = directory + '/' + identity.hex() + ".hash";
+    if (read_file(remembered, hash) && hash.size() == 16) {
+      return true;
+    }
+    FILE* file = std::fopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+      return false;
+    }
+    ContentHash content;
+    std::vector<char> block(1 << 20);
+    for (size_t n; (n = std::fread(block.data(), 1, block.size(), file)) > 0; ) {
+      content.update(block.data(), n);
+    }
+    bool read = !std::ferror(file);
+    std::fclose(file);
+    if (!read) {
+      return false;
+    }
+    hash = content.hex();
+    write_file(remembered, hash);
+    return true;
+  }
+
+  /// <summary>
+  /// Starts the key material of all results of the process by the tool, its executable and options; arguments naming files are replaced by content hashes.
+  /// Options, which do not change outputs (threads, statistics, the cache, memory and temporary files of grouping), are left out.
+  /// </summary>
+  /// <param name="tool">Name of the tool.</param>
+  /// <param name="argi">Position of the first argument after options.</param>
+  /// <param name="argv">Arguments.</param>
+  void setup(const std::string& tool, const int argi, char* argv[]) {
+    if (directory.empty()) {
+      return;
+    }
+    std::string executable;
+    if (!hash_file("/proc/self/exe", executable)) {
+      std::cerr << "Outputs are not cached, the executable of the tool cannot be read." << std::endl;
+      return;
+    }
+    valid = true;
+    request = "tool\t" + tool + "\nexecutable\t" + executable + '\n';
+    for (int i = 1; i < argi; ++i) {
+      const std::string option(argv[i]);
+      if (option == "--threads" || option == "--stats-json" || option == "--cache" || option == "--memory" || option == "--temp") {
+        ++i;
+      } else if (option != "--stats") {
+        argument(option);
+      }
+    }
+  }
+
+  /// <summary>
+  /// Adds an argument shared by all results to the key material (by its content hash if it names a file).
+  /// </summary>
+  /// <returns>FALSE if the argument names a file, which cannot be read (results are not cached then).</returns>
+  bool argument(const std::string& value) {
+    struct stat info;
+    if (!valid || stat(value.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+      request += "argument\t" + value + '\n';
+      return true;
+    }
+    return input(value);
+  }
+
+  /// <summary>
+  /// Adds an input shared by all results to the key material by its content hash.
+  /// </summary>
+  /// <returns>FALSE if the input cannot be hashed (e.g. the standard input), results are not cached then.</returns>
+  bool input(const std::string& filename) {
+    std::string hash;
+    if (!valid) {
+      return false;
+    }
+    if (!hash_file(filename, hash)) {
+      valid = false;
+      return false;
+    }
+    request += "input\t" + hash + '\n';
+    sources += "# input " + filename + '\n';
+    return true;
+  }
+
+  /// <summary>
+  /// Prepares a result of the shared key material, further inputs and outputs ('-' stands for the standard output).
+  /// </summary>
+  Result result(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs) const {
+    if (!valid) {
+      return Result(nullptr, outputs);
+    }
+    std::string key_material = request;
+    for (const std::string& input : inputs) {
+      std::string hash;
+      if (!hash_file(input, hash)) {
+        return Result(nullptr, outputs);
+      }
+      key_material += "input\t" + hash + '\n';
+    }
+    for (const std::string& output : outputs) {
+      key_material += "kind\t" + output_kind(output) + '\n';
+    }
+    ContentHash key;
+    key.update(key_material);
+    Result result(this, outputs);
+    result.key = key.hex();
+    result.request = key_material;
+    result.sources = sources;
+    for (const std::string& input : inputs) {
+      result.sources += "# input " + input + '\n';
+    }
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      if (outputs[i] == "-") {
+        result.targets[i] = temporary(result.cached(i));
+      }
+    }
+    return result;
+  }
+
+  /// <summary>
+  /// Prepares a result, which is not cached and writes its outputs directly (e.g. a result, which is not used by the tool in this run), without hashing inputs.
+  /// </summary>
+  Result uncached(const std::vector<std::string>& outputs) const {
+    return Result(nullptr, outputs);
+  }
+};
+
+/// <summary>
+/// Parses '--cache DIR' option if it is the argument at the given position, and enables reuse of cached outputs (see ResultCache).
+/// </summary>
+/// <param name="argi">Position of the examined argument; it is moved after the option if present.</param>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Arguments.</param>
+/// <returns>FALSE if the option is present, but its value is missing or the directory cannot be created.</returns>
+inline bool parse_cache(int& argi, const int argc, char* argv[]) {
+  if (argi >= argc || std::string(argv[argi]) != "--cache") {
+    return true;
+  }
+  if (argi + 1 >= argc) {
+    std::cerr << "Missing value of option '--cache'." << std::endl;
+    return false;
+  }
+  if (!ResultCache::global().open(argv[argi + 1])) {
+    return false;
+  }
+  argi += 2;
+  return true;
+}
+
+/// <summary>
+/// Prints help of '--cache DIR' option (see parse_cache) as two lines of the usage of a tool.
+/// </summary>
+/// <param name="indent">Text preceding options in the usage of the tool, e.g. spaces and a tab.</param>
+/// <param name="width">Width of the column of options in the usage.</param>
+inline void print_cache_usage(const std::string& indent, const size_t width = 11) {
+  std::string option("--cache DIR");
+  option.resize(std::max(width, option.size()), ' ');
+  std::cout << indent << option << "\t reuse outputs cached in DIR if the tool, its options and contents of inputs\n";
+  std::cout << indent << std::string(option.size(), ' ') << "\t are unchanged; new outputs are cached there with a manifest of their inputs.\n";
+}
+
+#endif
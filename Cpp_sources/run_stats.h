@@ -0,0 +1,284 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef RUN_STATS_H
+#define RUN_STATS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <iostream>
+#include <sys/resource.h>
+
+/// <summary>
+/// Process-wide statistics of a run: wall and CPU time of phases (annotation load, main pass, output...), named counters and peak memory.
+/// Nothing is reported unless enabled by '--stats' (text to the standard error output) or '--stats-json FILE'.
+/// Counters are atomic, so threads may add to them; they should be looked up once and updated in batches.
+/// </summary>
+class RunStats {
+private:
+  struct Phase {
+    std::string name;
+    double wall;
+    double cpu;
+    uint64_t records;
+  };
+
+  std::string tool;
+  bool text;
+  std::string json_file;
+  std::chrono::steady_clock::time_point created;
+  double created_cpu;
+  /// <summary>
+  /// Finished phases and the start of the running one (empty name if no phase is running).
+  /// </summary>
+  std::vector<Phase> phases;
+  std::string phase;
+  std::chrono::steady_clock::time_point phase_start;
+  double phase_start_cpu;
+  /// <summary>
+  /// Counters in the order of their registration; deque keeps their addresses.
+  /// </summary>
+  std::deque<std::pair<std::string, std::atomic<uint64_t>>> counters;
+  std::mutex counters_mutex;
+
+  RunStats() : text(false), created(std::chrono::steady_clock::now()), created_cpu(cpu_time()), phase_start_cpu(0) {}
+
+  /// <summary>
+  /// CPU time of all threads of the process in seconds.
+  /// </summary>
+  static double cpu_time() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+  }
+
+  /// <summary>
+  /// Peak resident set size of the process in bytes.
+  /// </summary>
+  static uint64_t peak_rss() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)usage.ru_maxrss * 1024;
+  }
+
+  static double seconds(const std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double>(duration).count();
+  }
+
+  /// <summary>
+  /// Escapes a string for JSON.
+  /// </summary>
+  static std::string quoted(const std::string& value) {
+    std::string result = "\"";
+    for (char c : value) {
+      if (c == '"' || c == '\\') {
+        result += '\\';
+        result += c;
+      } else if ((unsigned char)c < 0x20) {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        result += escaped;
+      } else {
+        result += c;
+      }
+    }
+    return result + '"';
+  }
+
+public:
+  RunStats(const RunStats&) = delete;
+  RunStats& operator=(const RunStats&) = delete;
+
+  /// <summary>
+  /// The statistics of the process.
+  /// </summary>
+  static RunStats& global() {
+    static RunStats stats;
+    return stats;
+  }
+
+  /// <summary>
+  /// Whether the statistics will be reported.
+  /// </summary>
+  inline bool enabled() const { return text || !json_file.empty(); }
+
+  /// <summary>
+  /// Enables reporting as text to the standard error output.
+  /// </summary>
+  /// <param name="tool">Name of the program.</param>
+  void enable_text(const std::string& tool) {
+    this->tool = tool;
+    text = true;
+  }
+
+  /// <summary>
+  /// Enables writing the statistics in JSON format.
+  /// </summary>
+  /// <param name="tool">Name of the program.</param>
+  /// <param name="filename">Output JSON file.</param>
+  void enable_json(const std::string& tool, const std::string& filename) {
+    this->tool = tool;
+    json_file = filename;
+  }
+
+  /// <summary>
+  /// Starts a phase; the running phase (if any) is finished without a number of records.
+  /// </summary>
+  /// <param name="name">Name of the phase.</param>
+  void start(const std::string& name) {
+    if (!phase.empty()) {
+      stop();
+    }
+    phase = name;
+    phase_start = std::chrono::steady_clock::now();
+    phase_start_cpu = cpu_time();
+  }
+
+  /// <summary>
+  /// Finishes the running phase.
+  /// </summary>
+  /// <param name="records">Number of records (lines, alignments...) processed in the phase, 0 if not applicable.</param>
+  void stop(const uint64_t records = 0) {
+    if (phase.empty()) {
+      return;
+    }
+    phases.push_back(Phase{ phase, seconds(std::chrono::steady_clock::now() - phase_start), cpu_time() - phase_start_cpu, records });
+    phase.clear();
+  }
+
+  /// <summary>
+  /// Returns a counter of the given name; it is registered (with value 0) if it does not exist.
+  /// </summary>
+  std::atomic<uint64_t>& counter(const std::string& name) {
+    std::lock_guard<std::mutex> lock(counters_mutex);
+    for (auto& counter : counters) {
+      if (counter.first == name) {
+        return counter.second;
+      }
+    }
+    counters.emplace_back(std::piecewise_construct, std::forward_as_tuple(name), std::forward_as_tuple(0));
+    return counters.back().second;
+  }
+
+  /// <summary>
+  /// Adds a value to a counter.
+  /// </summary>
+  inline void add(const std::string& name, const uint64_t value) {
+    counter(name) += value;
+  }
+
+  /// <summary>
+  /// Reports the statistics if enabled; the running phase is finished first.
+  /// </summary>
+  /// <returns>FALSE if the JSON file could not be written.</returns>
+  bool report() {
+    stop();
+    if (!enabled()) {
+      return true;
+    }
+    double total_wall = seconds(std::chrono::steady_clock::now() - created);
+    double total_cpu = cpu_time() - created_cpu;
+    uint64_t rss = peak_rss();
+    if (text) {
+      char line[160];
+      std::cerr << "Statistics of " << tool << ":\n";
+      std::snprintf(line, sizeof(line), "%-24s %10s %10s %14s %14s\n", "phase", "wall [s]", "CPU [s]", "records", "records/s");
+      std::cerr << line;
+      for (const Phase& phase : phases) {
+        if (phase.records != 0) {
+          std::snprintf(line, sizeof(line), "%-24s %10.3f %10.3f %14llu %14.0f\n", phase.name.c_str(), phase.wall, phase.cpu, (unsigned long long)phase.records,
+            phase.wall > 0 ? phase.records / phase.wall : 0.0);
+        } else {
+          std::snprintf(line, sizeof(line), "%-24s %10.3f %10.3f %14s %14s\n", phase.name.c_str(), phase.wall, phase.cpu, "-", "-");
+        }
+        std::cerr << line;
+      }
+      std::snprintf(line, sizeof(line), "%-24s %10.3f %10.3f\n", "total", total_wall, total_cpu);
+      std::cerr << line;
+      std::snprintf(line, sizeof(line), "%-24s %10.1f MiB\n", "peak RSS", rss / 1048576.0);
+      std::cerr << line;
+      for (const auto& counter : counters) {
+        std::cerr << counter.first << ": " << counter.second.load() << '\n';
+      }
+      std::cerr.flush();
+    }
+    if (json_file.empty()) {
+      return true;
+    }
+    FILE* file = std::fopen(json_file.c_str(), "w");
+    if (file == nullptr) {
+      std::cerr << "Unable to create file '" << json_file << "'." << std::endl;
+      return false;
+    }
+    std::fprintf(file, "{\"tool\": %s, \"phases\": [", quoted(tool).c_str());
+    for (size_t i = 0; i < phases.size(); ++i) {
+      const Phase& phase = phases[i];
+      std::fprintf(file, "%s{\"name\": %s, \"wall_seconds\": %.6f, \"cpu_seconds\": %.6f, \"records\": %llu, \"records_per_second\": %.1f}", i == 0 ? "" : ", ",
+        quoted(phase.name).c_str(), phase.wall, phase.cpu, (unsigned long long)phase.records, phase.wall > 0 ? phase.records / phase.wall : 0.0);
+    }
+    std::fprintf(file, "], \"total\": {\"wall_seconds\": %.6f, \"cpu_seconds\": %.6f}, \"peak_rss_bytes\": %llu, \"counters\": {", total_wall, total_cpu, (unsigned long long)rss);
+    bool first = true;
+    for (const auto& counter : counters) {
+      std::fprintf(file, "%s%s: %llu", first ? "" : ", ", quoted(counter.first).c_str(), (unsigned long long)counter.second.load());
+      first = false;
+    }
+    std::fprintf(file, "}}\n");
+    if (std::fclose(file) != 0) {
+      std::cerr << "Unable to write into file '" << json_file << "'." << std::endl;
+      return false;
+    }
+    return true;
+  }
+};
+
+/// <summary>
+/// Parses '--stats' or '--stats-json FILE' option if it is the argument at the given position, and enables the statistics of the process.
+/// </summary>
+/// <param name="argi">Position of the examined argument; it is moved after the option if present.</param>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Arguments; argv[0] names the tool in the statistics.</param>
+/// <returns>FALSE if the option is present, but its value is missing.</returns>
+inline bool parse_stats(int& argi, const int argc, char* argv[]) {
+  if (argi >= argc) {
+    return true;
+  }
+  std::string option(argv[argi]);
+  std::string tool(argv[0]);
+  tool = tool.substr(tool.find_last_of('/') + 1);
+  if (option == "--stats") {
+    RunStats::global().enable_text(tool);
+    ++argi;
+  } else if (option == "--stats-json") {
+    if (argi + 1 >= argc) {
+      std::cerr << "Missing value of option '--stats-json'." << std::endl;
+      return false;
+    }
+    RunStats::global().enable_json(tool, argv[argi + 1]);
+    argi += 2;
+  }
+  return true;
+}
+
+/// <summary>
+/// Prints help of '--stats' and '--stats-json FILE' options (see parse_stats) as two lines of the usage of a tool.
+/// </summary>
+/// <param name="indent">Text preceding options in the usage of the tool, e.g. spaces and a tab.</param>
+/// <param name="width">Width of the column of options in the usage.</param>
+inline void print_stats_usage(const std::string& indent, const size_t width = 11) {
+  std::string option("--stats");
+  option.resize(std::max(width, option.size()), ' ');
+  std::cout << indent << option << "\t print times of phases, records/s, peak memory and counters to the standard\n";
+  std::cout << indent << std::string(option.size(), ' ') << "\t error output; --stats-json FILE writes them into FILE in JSON format.\n";
+}
+
+#endif
@@ -0,0 +1,209 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef SAM_FIELDS_H
+#define SAM_FIELDS_H
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+
+/// <summary>
+/// Parses an unsigned or signed integer occupying the whole text.
+/// </summary>
+/// <param name="text">The examined text.</param>
+/// <param name="value">The parsed value (output).</param>
+/// <returns>TRUE if the whole text is a valid integer of the given type.</returns>
+template <typename T>
+inline bool parse_integer(const std::string_view text, T& value) {
+  const char* end = text.data() + text.size();
+  auto result = std::from_chars(text.data(), end, value);
+  return result.ec == std::errc() && result.ptr == end;
+}
+
+/// <summary>
+/// Whether a CIGAR operation consumes the query (read); operations are given by their BAM codes (index in "MIDNSHP=X").
+/// </summary>
+inline bool cigar_consumes_query(const uint32_t code) {
+  return code < 9 && ((0x193 >> code) & 1);
+}
+
+/// <summary>
+/// Whether a CIGAR operation consumes the reference; operations are given by their BAM codes (index in "MIDNSHP=X").
+/// </summary>
+inline bool cigar_consumes_reference(const uint32_t code) {
+  return code < 9 && ((0x18D >> code) & 1);
+}
+
+/// <summary>
+/// Computes lengths of the read and of the aligned part of the reference from CIGAR in the textual form.
+/// </summary>
+/// <param name="cigar">The CIGAR string.</param>
+/// <param name="query">Length of the read including soft clips (output).</param>
+/// <param name="reference">Length of the aligned part of the reference (output).</param>
+/// <returns>FALSE if CIGAR is unavailable ('*') or invalid.</returns>
+inline bool parse_cigar_lengths(const std::string_view cigar, uint32_t& query, uint32_t& reference) {
+  static const char OPERATIONS[] = "MIDNSHP=X";
+  query = reference = 0;
+  const char* it = cigar.data();
+  const char* end = it + cigar.size();
+  while (it < end) {
+    uint32_t length;
+    auto result = std::from_chars(it, end, length);
+    if (result.ec != std::errc() || result.ptr == end) {
+      return false;
+    }
+    const char* op = (const char*)std::memchr(OPERATIONS, *result.ptr, 9);
+    if (op == nullptr) {
+      return false;
+    }
+    uint32_t code = (uint32_t)(op - OPERATIONS);
+    query += cigar_consumes_query(code) ? length : 0;
+    reference += cigar_consumes_reference(code) ? length : 0;
+    it = result.ptr + 1;
+  }
+  return !cigar.empty();
+}
+
+/// <summary>
+/// Positions of tab-separated columns within a SAM line; the line is scanned only once and columns are provided as string views.
+/// Only offsets are stored, so they stay valid if the line is moved (unlike the views).
+/// </summary>
+struct SamColumns {
+  /// <summary>
+  /// Number of mandatory columns (QNAME, FLAG, RNAME, POS, MAPQ, CIGAR, RNEXT, PNEXT, TLEN, SEQ, QUAL).
+  /// </summary>
+  static constexpr size_t MANDATORY = 11;
+
+  /// <summary>
+  /// Start offsets of the mandatory columns; the last item is the start offset of the optional fields
+  /// (size of the line + 1 if there is no optional field).
+  /// </summary>
+  uint32_t starts[MANDATORY + 1];
+
+  /// <summary>
+  /// Splits a line into columns.
+  /// </summary>
+  /// <param name="line">SAM line without the trailing '\n'.</param>
+  /// <param name="required">Minimal number of columns.</param>
+  /// <returns>FALSE if the line has less columns than required; the missing columns are empty.</returns>
+  bool split(const std::string_view line, const size_t required = MANDATORY) {
+    const char* begin = line.data();
+    const char* end = begin + line.size();
+    const char* it = begin;
+    // Number of found columns (including the start of optional fields)
+    size_t found = 1;
+    starts[0] = 0;
+    while (found <= MANDATORY) {
+      const char* tab = (const char*)std::memchr(it, '\t', end - it);
+      if (tab == nullptr) {
+        break;
+      }
+      it = tab + 1;
+      starts[found++] = (uint32_t)(it - begin);
+    }
+    for (size_t i = found; i <= MANDATORY; ++i) {
+      starts[i] = (uint32_t)line.size() + 1;
+    }
+    return std::min(found, MANDATORY) >= required;
+  }
+
+  /// <summary>
+  /// Returns a mandatory column.
+  /// </summary>
+  /// <param name="line">The split line.</param>
+  /// <param name="index">0-based index of the column.</param>
+  inline std::string_view get(const std::string_view line, const size_t index) const {
+    if (starts[index] > line.size()) {
+      return std::string_view();
+    }
+    return line.substr(starts[index], starts[index + 1] - starts[index] - 1);
+  }
+
+  /// <summary>
+  /// Returns all optional fields separated by tabs (without the leading one).
+  /// </summary>
+  /// <param name="line">The split line.</param>
+  inline std::string_view optional(const std::string_view line) const {
+    return starts[MANDATORY] > line.size() ? std::string_view() : line.substr(starts[MANDATORY]);
+  }
+
+  /// <summary>
+  /// Updates offsets after the length of a column was changed.
+  /// </summary>
+  /// <param name="index">0-based index of the changed column.</param>
+  /// <param name="difference">Difference between the new and the old length.</param>
+  inline void shift(const size_t index, const int64_t difference) {
+    for (size_t i = index + 1; i <= MANDATORY; ++i) {
+      starts[i] = (uint32_t)(starts[i] + difference);
+    }
+  }
+
+  /// <summary>
+  /// Finds an optional field.
+  /// </summary>
+  /// <param name="line">The split line.</param>
+  /// <param name="tag">Two-character tag followed by the type, e.g. "NH:i".</param>
+  /// <param name="from">Offset of the value within the line (output).</param>
+  /// <param name="to">End offset of the value within the line (output).</param>
+  /// <returns>FALSE if the field is missing.</returns>
+  bool find_tag(const std::string_view line, const char* tag, size_t& from, size_t& to) const {
+    for (size_t start = starts[MANDATORY]; start < line.size(); ) {
+      size_t end = line.find('\t', start);
+      if (end == line.npos) {
+        end = line.size();
+      }
+      if (end - start >= 5 && line[start + 4] == ':' && line.compare(start, 4, tag, 4) == 0) {
+        from = start + 5;
+        to = end;
+        return true;
+      }
+      start = end + 1;
+    }
+    return false;
+  }
+};
+
+/// <summary>
+/// SAM line split into string views.
+/// </summary>
+struct SamRecord {
+  std::string_view line;
+  SamColumns columns;
+
+  /// <summary>
+  /// Splits a line into columns.
+  /// </summary>
+  /// <param name="line">SAM line without the trailing '\n', it must outlive the record.</param>
+  /// <param name="required">Minimal number of columns.</param>
+  /// <returns>FALSE if the line has less columns than required.</returns>
+  inline bool parse(const std::string_view line, const size_t required = SamColumns::MANDATORY) {
+    this->line = line;
+    return columns.split(line, required);
+  }
+
+  inline std::string_view column(const size_t index) const { return columns.get(line, index); }
+  inline std::string_view qname() const { return column(0); }
+  inline std::string_view rname() const { return column(2); }
+  inline std::string_view cigar() const { return column(5); }
+
+  inline bool flag(uint16_t& value) const { return parse_integer(column(1), value); }
+  inline bool pos(uint64_t& value) const { return parse_integer(column(3), value); }
+
+  /// <summary>
+  /// Returns a value of an optional field of an integer type.
+  /// </summary>
+  /// <param name="tag">Two-character tag.</param>
+  /// <param name="value">The value (output).</param>
+  /// <returns>FALSE if the field is missing or it is not a valid integer.</returns>
+  bool tag_int(const char* tag, int64_t& value) const {
+    const char typed[] = { tag[0], tag[1], ':', 'i' };
+    size_t from, to;
+    return columns.find_tag(line, typed, from, to) && parse_integer(line.substr(from, to - from), value);
+  }
+};
+
+#endif
@@ -0,0 +1,70 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#include <iostream>
+#include "alignment_filters.h"
+#include "reference_cache.h"
+#include "served_tools.h"
+
+/// <summary>
+/// Entry point of the tool; reference_server runs it in forked jobs, which find references loaded by the server.
+/// </summary>
+int select_transcripts_main(int argc, char* argv[]) {
+  // Number of file pairs processed simultaneously
+  size_t threads = 1;
+  // Compression of SAM outputs
+  OutputFile::Compression compression = OutputFile::Compression::AUTO;
+  // Grouping of QNAMEs and pruning of the header
+  GroupingOptions grouping;
+  int argi = 1;
+  for (int previous = 0; previous != argi; ) { // Options may be in any order
+	previous = argi;
+	if (!parse_threads(argi, argc, argv, threads) || !parse_compression(argi, argc, argv, compression) || !parse_grouping(argi, argc, argv, grouping)
+		|| !parse_stats(argi, argc, argv) || !parse_cache(argi, argc, argv)) {
+		return 1;
+	}
+  }
+  if (argc - argi < 3 || (argc - argi) % 2 != 1) {
+	std::cout << "select_transcripts [--threads N] [--compress FORMAT] [--ungrouped [--memory MB] [--temp DIR]] [--prune-references] [--cache DIR] [--stats | --stats-json FILE] <transcript_ids> (<input> <output>)+\t Filters <input> SAM or BAM file only for transcripts from\n";
+	std::cout << "                                                    \t <transcript_ids> file (one id per line) and store them in\n";
+	std::cout << "                                                    \t <output> file (in BAM format if its name ends with '.bam',\n";
+	std::cout << "                                                    \t in SAM format otherwise).\n";
+	std::cout << "                                                    \t '@SQ', Flags, MAPq, 'NH:i:Nmap' and 'HI:i:id' fileds are\n";
+	std::cout << "                                                    \t updated.\n";
+	std::cout << "                                                    \t --threads N\t use up to N threads (pairs of files are processed\n";
+	std::cout << "                                                    \t            \t simultaneously, a file is split into chunks of whole\n";
+	std::cout << "                                                    \t            \t reads; the transcript_ids are shared).\n";
+	std::cout << "                                                    \t --compress FORMAT\t compress SAM outputs by 'gzip' (BGZF), 'zstd' or 'none';\n";
+	std::cout << "                                                    \t                  \t by default outputs ending with '.gz' or '.zst' are compressed.\n";
+	std::cout << "                                                    \t --ungrouped\t input is not grouped by QNAME (e.g. sorted by coordinates), so alignments\n";
+	std::cout << "                                                    \t            \t are grouped by an external sort in runs of at most MB megabytes (default 512)\n";
+	std::cout << "                                                    \t            \t spilled into DIR (default TMPDIR or /tmp).\n";
+	std::cout << "                                                    \t --prune-references\t remove '@SQ' lines of references without preserved alignments\n";
+	std::cout << "                                                    \t                   \t (the output is stored in DIR first).\n";
+	print_stats_usage("                                                    \t ");
+	print_cache_usage("                                                    \t ");
+	std::cout << "Created by Jan Jelínek (jan.jelinek@biomed.cas.cz); last update: 2026-10-14; license: Apache License 2.0" << std::endl;
+	return 0;
+  }
+
+  ResultCache& cache = ResultCache::global();
+  cache.setup("select_transcripts", argi, argv);
+  cache.input(argv[argi]);
+  RunStats& stats = RunStats::global();
+  stats.start("transcript_ids load");
+  // Load, what transcript_ids should be preserved
+  const IdDictionary* transcript_ids = ReferenceCache::global().transcript_ids(argv[argi]);
+
+  // Filter input files
+  TranscriptFilter transcript_filter(*transcript_ids);
+  const std::vector<const AlignmentStage*> stages = { &transcript_filter };
+  ++argi;
+  stats.start("filtering");
+  int error = filter_file_pairs(stages, argv + argi, (argc - argi) / 2, threads, compression, grouping);
+  stats.stop(stats.counter("input_alignments"));
+  if (!stats.report() && error == 0) {
+    return 9;
+  }
+  return error;
+}
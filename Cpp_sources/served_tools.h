@@ -0,0 +1,32 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef SERVED_TOOLS_H
+#define SERVED_TOOLS_H
+
+/// Entry points of tools, which can be run by reference_server (library ribo_served_tools, sources <tool>_main.cpp).
+/// Each takes the arguments of the tool (argv[0] names the tool) and returns its exit code; references are loaded through
+/// ReferenceCache::global(), so jobs forked by the server share the references loaded by it.
+
+/// <summary>
+/// Entry point of filter_alignments.
+/// </summary>
+int filter_alignments_main(int argc, char* argv[]);
+
+/// <summary>
+/// Entry point of filter_ambiguous_genes.
+/// </summary>
+int filter_ambiguous_genes_main(int argc, char* argv[]);
+
+/// <summary>
+/// Entry point of gc_content.
+/// </summary>
+int gc_content_main(int argc, char* argv[]);
+
+/// <summary>
+/// Entry point of select_transcripts.
+/// </summary>
+int select_transcripts_main(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,72 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef STRAND_H
+#define STRAND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+/// <summary>
+/// Strand of a feature as a compile-time parameter, so kernels are written once in the direction of the feature (from its 5' end) without strand branches.
+/// Oriented positions are genomic positions on the forward strand and negated genomic positions (modulo 2^64) on the reverse strand,
+/// so they increase from the 5' end to the 3' end on both strands (genomic positions must not be 0); orienting an oriented position gives the genomic one.
+/// </summary>
+/// <typeparam name="Forward">TRUE for the forward strand.</typeparam>
+template <bool Forward>
+struct Strand {
+  static constexpr bool forward = Forward;
+
+  /// <summary>
+  /// Oriented position of a genomic position, or genomic position of an oriented one.
+  /// </summary>
+  static constexpr uint64_t orient(const uint64_t position) {
+    return Forward ? position : 0 - position;
+  }
+
+  /// <summary>
+  /// Oriented 5' end of genomic boundaries [from; to].
+  /// </summary>
+  static constexpr uint64_t five_prime(const uint64_t from, const uint64_t to) {
+    return Forward ? from : 0 - to;
+  }
+
+  /// <summary>
+  /// Oriented 3' end of genomic boundaries [from; to].
+  /// </summary>
+  static constexpr uint64_t three_prime(const uint64_t from, const uint64_t to) {
+    return Forward ? to : 0 - from;
+  }
+
+  /// <summary>
+  /// Genomic boundaries [from; to] of oriented boundaries [five_prime; three_prime].
+  /// </summary>
+  static constexpr std::pair<uint64_t, uint64_t> genomic(const uint64_t five_prime, const uint64_t three_prime) {
+    return Forward ? std::pair<uint64_t, uint64_t>(five_prime, three_prime) : std::pair<uint64_t, uint64_t>(0 - three_prime, 0 - five_prime);
+  }
+
+  /// <summary>
+  /// The i-th base of bases (given on the forward strand) read from the 5' end of the feature.
+  /// </summary>
+  static inline char base(const std::string_view bases, const size_t i) {
+    return Forward ? bases[i] : bases[bases.size() - 1 - i];
+  }
+};
+
+/// <summary>
+/// Calls a function with Strand<true> or Strand<false>; the strand is dispatched once, e.g. per feature or transcript.
+/// </summary>
+/// <param name="forward">TRUE for the forward strand.</param>
+/// <param name="function">Generic function taking the strand (e.g. '[&](auto strand) { ... }'), both strands have to return the same type.</param>
+template <typename Function>
+inline decltype(auto) with_strand(const bool forward, Function&& function) {
+  if (forward) {
+    return function(Strand<true>());
+  }
+  return function(Strand<false>());
+}
+
+#endif
@@ -0,0 +1,479 @@
+// Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
+// Last update: 2026-10-14
+// Released under Apache License 2.0
+
+#ifndef TRANSCRIPT_PROJECTION_H
+#define TRANSCRIPT_PROJECTION_H
+
+#include <cstdint>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <iostream>
+#include "annotation_index.h"
+#include "compressed_io.h"
+#include "id_dictionary.h"
+#include "interval_index.h"
+#include "strand.h"
+
+/// <summary>
+/// Exons of a single transcript with cumulative lengths, which project genomic positions into transcript coordinates (and back) by binary search.
+/// Exons are kept in the direction of the transcript; positions of the reverse strand are negated (modulo 2^64), so they increase as well.
+/// </summary>
+class ExonIndex {
+private:
+  bool strand = true;
+  /// <summary>
+  /// Directed boundaries [from; to] of exons.
+  /// </summary>
+  std::vector<std::pair<uint64_t, uint64_t>> exons;
+  /// <summary>
+  /// Length of the transcript preceding each exon and the whole length as the last item; computed by build().
+  /// </summary>
+  std::vector<uint64_t> offsets;
+
+  inline uint64_t directed(const uint64_t position) const {
+    return strand ? position : -position;
+  }
+
+  /// <summary>
+  /// Returns the exon containing a directed position, or size() if there is none.
+  /// </summary>
+  inline size_t find(const uint64_t position) const {
+    auto exon = std::upper_bound(exons.begin(), exons.end(), position, [](const uint64_t value, const std::pair<uint64_t, uint64_t>& item) { return value < item.first; });
+    if (exon == exons.begin() || position > (--exon)->second) {
+      return exons.size();
+    }
+    return exon - exons.begin();
+  }
+
+public:
+  /// <summary>
+  /// Position outside exons (positions are 1-based).
+  /// </summary>
+  static constexpr uint64_t NONE = 0;
+
+  /// <summary>
+  /// Removes all exons and sets the strand; allocated memory is reused.
+  /// </summary>
+  /// <param name="strand">TRUE for the forward strand.</param>
+  void reset(const bool strand) {
+    this->strand = strand;
+    exons.clear();
+    offsets.clear();
+  }
+
+  inline void reserve(const size_t size) {
+    exons.reserve(size);
+    offsets.reserve(size + 1);
+  }
+
+  inline bool forward() const {
+    return strand;
+  }
+
+  inline size_t size() const {
+    return exons.size();
+  }
+
+  inline bool empty() const {
+    return exons.empty();
+  }
+
+  /// <summary>
+  /// Adds an exon; exons can be added in any order.
+  /// </summary>
+  /// <param name="from">1-based genomic start of the exon.</param>
+  /// <param name="to">1-based genomic end of the exon (inclusive), at least from.</param>
+  inline void add(const uint64_t from, const uint64_t to) {
+    with_strand(strand, [&](auto direction) {
+      exons.emplace_back(direction.five_prime(from, to), direction.three_prime(from, to));
+    });
+  }
+
+  /// <summary>
+  /// Returns the genomic position of the first base of an exon (the highest one on the reverse strand).
+  /// </summary>
+  inline uint64_t start(const size_t exon) const {
+    return directed(exons[exon].first);
+  }
+
+  /// <summary>
+  /// Returns 1-based genomic boundaries [from; to] of an exon.
+  /// </summary>
+  inline std::pair<uint64_t, uint64_t> boundaries(const size_t exon) const {
+    return with_strand(strand, [&](auto direction) {
+      return direction.genomic(exons[exon].first, exons[exon].second);
+    });
+  }
+
+  /// <summary>
+  /// Sorts exons in the direction of the transcript; exons with the same start keep the order, in which they were added.
+  /// </summary>
+  void sort() {
+    std::stable_sort(exons.begin(), exons.end(), [](const std::pair<uint64_t, uint64_t>& a, const std::pair<uint64_t, uint64_t>& b) { return a.first < b.first; });
+  }
+
+  /// <summary>
+  /// Sorts exons and computes cumulative lengths; it has to be called before any projection.
+  /// </summary>
+  /// <returns>Index of the first exon overlapping the preceding one (in the direction of the transcript) or containing position 0, or size() if exons are valid.</returns>
+  size_t build() {
+    sort();
+    offsets.assign(1, 0);
+    for (size_t i = 0; i < exons.size(); ++i) {
+      if ((i > 0 ? exons[i - 1].second : 0) >= exons[i].first) {
+        offsets.clear();
+        return i;
+      }
+      offsets.push_back(offsets.back() + exons[i].second - exons[i].first + 1);
+    }
+    return exons.size();
+  }
+
+  /// <summary>
+  /// Length of the spliced transcript.
+  /// </summary>
+  inline uint64_t length() const {
+    return offsets.empty() ? 0 : offsets.back();
+  }
+
+  /// <summary>
+  /// Projects a genomic position into transcript coordinates.
+  /// </summary>
+  /// <param name="position">1-based genomic position.</param>
+  /// <returns>1-based position within the spliced transcript (from its 5' end), or NONE if the position is outside exons.</returns>
+  inline uint64_t project(const uint64_t position) const {
+    uint64_t directed_position = directed(position);
+    size_t exon = find(directed_position);
+    return exon == exons.size() ? NONE : offsets[exon] + (directed_position - exons[exon].first) + 1;
+  }
+
+  /// <summary>
+  /// Projects genomic positions into transcript coordinates; consecutive positions within the same exon (e.g. of sorted reads) skip the binary search.
+  /// </summary>
+  /// <param name="positions">1-based genomic positions.</param>
+  /// <param name="count">Number of positions.</param>
+  /// <param name="result">1-based positions within the spliced transcript, or NONE for positions outside exons (output).</param>
+  void project(const uint64_t* positions, const size_t count, uint64_t* result) const {
+    // The strand is dispatched once for all positions
+    with_strand(strand, [&](auto direction) {
+      size_t exon = exons.size();
+      for (size_t i = 0; i < count; ++i) {
+        uint64_t directed_position = direction.orient(positions[i]);
+        if (exon == exons.size() || directed_position < exons[exon].first || directed_position > exons[exon].second) {
+          exon = find(directed_position);
+        }
+        result[i] = exon == exons.size() ? NONE : offsets[exon] + (directed_position - exons[exon].first) + 1;
+      }
+    });
+  }
+
+  /// <summary>
+  /// Projects a position within the spliced transcript into genomic coordinates.
+  /// </summary>
+  /// <param name="position">1-based position within the spliced transcript.</param>
+  /// <returns>1-based genomic position, or NONE if the position is outside the transcript.</returns>
+  inline uint64_t genomic(const uint64_t position) const {
+    if (position == 0 || position > length()) {
+      return NONE;
+    }
+    size_t exon = std::upper_bound(offsets.begin(), offsets.end() - 1, position - 1) - offsets.begin() - 1;
+    return directed(exons[exon].first + (position - 1 - offsets[exon]));
+  }
+};
+
+/// <summary>
+/// Reads records (non-comment lines) of annotations.
+/// </summary>
+/// <param name="filename">Annotations in GTF format (optionally gzip-compressed), or an annotation index compiled by compile_annotations.</param>
+/// <param name="on_record">Function taking a record.</param>
+/// <returns>0 if no error occured; otherwise the error code to be returned from the program.</returns>
+template <typename OnRecord>
+int read_annotation_records(const std::string& filename, OnRecord on_record) {
+  if (AnnotationIndex::is_annotation_index(filename)) {
+    AnnotationIndex index;
+    if (!index.open(filename)) {
+      return 9;
+    }
+    return index.read([&on_record](const uint64_t, const GtfRecord& record) {
+      on_record(record);
+      return 0;
+    }, [](const std::string_view) { return 0; });
+  }
+  InputFile input;
+  if (!input.open(filename)) {
+    return 9;
+  }
+  GtfRecord record;
+  for (std::string line; input.getline(line); ) {
+    if (line.empty()) {
+      std::cerr << "Unexpected empty line within annotations file '" << filename << "'." << std::endl;
+      return 4;
+    }
+    if (line[0] == '#') {
+      continue;
+    }
+    int error = record.parse(line);
+    if (error != 0) {
+      return error;
+    }
+    on_record(record);
+  }
+  if (input.failed()) {
+    std::cerr << "Unable to read file '" << filename << "'." << std::endl;
+    return 10;
+  }
+  return 0;
+}
+
+/// <summary>
+/// Exons of all transcripts within annotations; finds transcripts containing a genomic position and projects the position into their coordinates.
+/// </summary>
+class Transcriptome {
+private:
+  /// <summary>
+  /// Names of chromosomes (seqnames); they have the same ids in exons.
+  /// </summary>
+  IdDictionary references;
+  /// <summary>
+  /// Transcript_ids; their ids index the following vectors.
+  /// </summary>
+  IdDictionary names;
+  std::vector<ExonIndex> transcripts;
+  std::vector<uint32_t> transcript_references;
+  /// <summary>
+  /// Whether exons of a transcript are consistent; other transcripts are not projected onto.
+  /// </summary>
+  std::vector<bool> valid;
+  /// <summary>
+  /// Exons of valid transcripts within each chromosome with their transcript ids.
+  /// </summary>
+  IntervalIndex<uint32_t> exons;
+
+  /// <summary>
+  /// Adds an exon line of annotations.
+  /// </summary>
+  void add(const GtfRecord& record) {
+    if (record.transcript_id.empty()) {
+      return;
+    }
+    uint32_t transcript = names.insert(record.transcript_id);
+    uint32_t reference = references.insert(record.seqname);
+    if (transcript == transcripts.size()) {
+      transcripts.emplace_back();
+      transcripts.back().reset(record.strand == '+');
+      transcript_references.push_back(reference);
+      valid.push_back(true);
+    }
+    if (!valid[transcript]) {
+      return;
+    }
+    if (record.strand == '.' || transcripts[transcript].forward() != (record.strand == '+') || transcript_references[transcript] != reference) {
+      std::cerr << "Ambiguous strand or chromosome for transcript '" << record.transcript_id << "', it is not counted." << std::endl;
+      valid[transcript] = false;
+    } else if (record.start == 0 || record.start > record.end) {
+      std::cerr << "Transcript '" << record.transcript_id << "' contains a line with unordered start-stop positions: " << record.start << ", " << record.end << std::endl;
+      valid[transcript] = false;
+    } else {
+      transcripts[transcript].add(record.start, record.end);
+    }
+  }
+
+  /// <summary>
+  /// Builds projections of transcripts and exons of chromosomes, when all exons are added.
+  /// </summary>
+  void build() {
+    for (uint32_t reference = 0; reference < references.size(); ++reference) {
+      exons.add_reference(references.name(reference));
+    }
+    for (uint32_t transcript = 0; transcript < transcripts.size(); ++transcript) {
+      ExonIndex& index = transcripts[transcript];
+      if (!valid[transcript]) {
+        index.reset(index.forward());
+        continue;
+      }
+      if (index.build() != index.size()) {
+        std::cerr << "Transcript '" << names.name(transcript) << "' contains overlapping exons, it is not counted." << std::endl;
+        index.reset(index.forward());
+        valid[transcript] = false;
+        continue;
+      }
+      std::string_view reference = references.name(transcript_references[transcript]);
+      for (size_t i = 0; i < index.size(); ++i) {
+        std::pair<uint64_t, uint64_t> exon = index.boundaries(i);
+        exons.add(reference, exon.first, exon.second, transcript);
+      }
+    }
+    exons.build();
+  }
+
+public:
+  static constexpr uint32_t NONE = IdDictionary::NONE;
+
+  /// <summary>
+  /// Loads exons of transcripts (lines with feature 'exon' and a transcript_id) from annotations.
+  /// Transcripts with exons on different strands or chromosomes, or with overlapping exons, are reported and left out.
+  /// </summary>
+  /// <param name="filename">Annotations in GTF format (optionally gzip-compressed), or an annotation index compiled by compile_annotations.</param>
+  /// <returns>0 if no error occured; otherwise the error code to be returned from the program.</returns>
+  int load(const std::string& filename) {
+    int error = read_annotation_records(filename, [this](const GtfRecord& record) {
+      if (record.feature == "exon") {
+        add(record);
+      }
+    });
+    if (error != 0) {
+      return error;
+    }
+    build();
+    return 0;
+  }
+
+  /// <summary>
+  /// Number of transcript ids including the left out transcripts.
+  /// </summary>
+  inline uint32_t size() const {
+    return (uint32_t)transcripts.size();
+  }
+
+  inline std::string_view name(const uint32_t transcript) const {
+    return names.name(transcript);
+  }
+
+  /// <summary>
+  /// Projection of a transcript; it has no exons if the transcript was left out.
+  /// </summary>
+  inline const ExonIndex& transcript(const uint32_t transcript) const {
+    return transcripts[transcript];
+  }
+
+  /// <summary>
+  /// Returns id of a chromosome, or NONE if it has no transcript.
+  /// </summary>
+  inline uint32_t reference(const std::string_view name) const {
+    return references.find(name);
+  }
+
+  /// <summary>
+  /// Projects a genomic position into all transcripts on the given strand, whose exons contain it.
+  /// </summary>
+  /// <param name="reference">Id of the chromosome.</param>
+  /// <param name="position">1-based genomic position.</param>
+  /// <param name="strand">TRUE for transcripts on the forward strand.</param>
+  /// <param name="add">Function taking a transcript id and the 1-based position within the spliced transcript.</param>
+  template <typename Add>
+  void project(const uint32_t reference, const uint64_t position, const bool strand, Add add) const {
+    exons.overlaps(reference, position, position, [&](const IntervalIndex<uint32_t>::Interval& exon) {
+      const ExonIndex& index = transcripts[exon.value];
+      if (index.forward() == strand) {
+        add(exon.value, index.project(position));
+      }
+    });
+  }
+};
+
+/// <summary>
+/// Features of transcripts (e.g. 5'UTRs, CDSs and 3'UTRs written by mane2ensembl_gtf) in genomic coordinates; finds features containing a genomic position.
+/// A feature is identified by transcript_id and the feature type, lines of the same feature (e.g. CDS in multiple exons) are merged.
+/// </summary>
+class GenomicFeatures {
+private:
+  /// <summary>
+  /// Loaded feature types.
+  /// </summary>
+  IdDictionary types;
+  /// <summary>
+  /// Keys 'transcript_id\tfeature'; their ids index strands.
+  /// </summary>
+  IdDictionary keys;
+  /// <summary>
+  /// Strand of each feature ('+', '-', or '.' if it is counted on both strands).
+  /// </summary>
+  std::vector<char> strands;
+  /// <summary>
+  /// Lines of features within each chromosome with their feature ids.
+  /// </summary>
+  IntervalIndex<uint32_t> lines;
+
+public:
+  static constexpr uint32_t NONE = IdDictionary::NONE;
+
+  /// <summary>
+  /// Loads lines of the given feature types with a transcript_id from annotations.
+  /// </summary>
+  /// <param name="filename">Annotations in GTF format (optionally gzip-compressed), or an annotation index compiled by compile_annotations.</param>
+  /// <param name="feature_types">Feature types (the third column) to be loaded.</param>
+  /// <returns>0 if no error occured; otherwise the error code to be returned from the program.</returns>
+  int load(const std::string& filename, const std::vector<std::string>& feature_types) {
+    for (const std::string& type : feature_types) {
+      types.insert(type);
+    }
+    std::string key;
+    int error = read_annotation_records(filename, [&](const GtfRecord& record) {
+      if (types.find(record.feature) == IdDictionary::NONE || record.transcript_id.empty()) {
+        return;
+      }
+      if (record.start == 0 || record.start > record.end) {
+        std::cerr << "Transcript '" << record.transcript_id << "' contains a line with unordered start-stop positions: " << record.start << ", " << record.end << std::endl;
+        return;
+      }
+      key.assign(record.transcript_id);
+      key += '\t';
+      key.append(record.feature);
+      uint32_t feature = keys.insert(key);
+      if (feature == strands.size()) {
+        strands.push_back(record.strand);
+      } else if (strands[feature] != record.strand && strands[feature] != '.') {
+        std::cerr << "Ambiguous strand of " << record.feature << " of transcript '" << record.transcript_id << "', it is counted on both strands." << std::endl;
+        strands[feature] = '.';
+      }
+      lines.add(record.seqname, record.start, record.end, feature);
+    });
+    lines.build();
+    return error;
+  }
+
+  /// <summary>
+  /// Number of features.
+  /// </summary>
+  inline uint32_t size() const {
+    return (uint32_t)strands.size();
+  }
+
+  /// <summary>
+  /// Key of a feature: transcript_id and the feature type separated by TAB.
+  /// </summary>
+  inline std::string_view name(const uint32_t feature) const {
+    return keys.name(feature);
+  }
+
+  /// <summary>
+  /// Returns id of a chromosome, or NONE if it has no feature.
+  /// </summary>
+  inline uint32_t reference(const std::string_view name) const {
+    return lines.reference(name);
+  }
+
+  /// <summary>
+  /// Finds all features on the given strand (or without a strand) containing a genomic position.
+  /// </summary>
+  /// <param name="reference">Id of the chromosome.</param>
+  /// <param name="position">1-based genomic position.</param>
+  /// <param name="strand">TRUE for features on the forward strand.</param>
+  /// <param name="add">Function taking a feature id.</param>
+  template <typename Add>
+  void find(const uint32_t reference, const uint64_t position, const bool strand, Add add) const {
+    // Lines of a single feature are not expected to overlap, so each containing feature is found once
+    lines.overlaps(reference, position, position, [&](const IntervalIndex<uint32_t>::Interval& line) {
+      char feature_strand = strands[line.value];
+      if (feature_strand == '.' || (feature_strand == '+') == strand) {
+        add(line.value);
+      }
+    });
+  }
+};
+
+#endif
@@ -1,22 +1,45 @@
 // Created by Jan Jelínek (jan.jelinek@biomed.cas.cz)
-// Last update: 2023-03-29
+// Last update: 2026-10-14
 // Released under Apache License 2.0
 
-#include <fstream>
 #include <iostream>
-#include <sstream>
-#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 #include <algorithm>
+#include "annotation_index.h"
+#include "compressed_io.h"
+#include "result_cache.h"
+#include "run_stats.h"
+#include "sam_fields.h"
+#include "strand.h"
+#include "transcript_projection.h"
 
 class Transcript {
 private:
 	std::string id;
 	bool strand;
-	std::map<size_t, size_t> exons;
+	/// <summary>
+	/// Exons in the direction of the transcript; sorted once all are added.
+	/// </summary>
+	ExonIndex exons;
 	size_t start_codon;
 	size_t stop_codon;
 	bool error;
 
+	/// <summary>
+	/// Update a codon position by its fragment; the codon is kept as the oriented 5' end of its first fragment in the direction of the transcript.
+	/// </summary>
+	/// <param name="codon">The codon position (0 if no fragment was added yet).</param>
+	/// <param name="from">Start position of the fragment.</param>
+	/// <param name="to">Stop position of the fragment.</param>
+	template <typename S>
+	static inline void update_codon(size_t& codon, const size_t from, const size_t to) {
+		size_t five_prime = S::five_prime(from, to);
+		codon = codon == 0 ? five_prime : std::min(codon, five_prime);
+	}
+
 public:
 	static const std::pair<size_t, size_t> UNDEFINED;
 
@@ -25,7 +48,24 @@ public:
 	/// </summary>
 	/// <param name="transcript_id">Identifier of the transcript.</param>
 	/// <param name="strand">Strand direction of the transcript.</param>
-	Transcript(const std::string transcript_id, const bool strand) : id(transcript_id), strand(strand), start_codon(0), stop_codon(0), error(false) {}
+	Transcript(const std::string_view transcript_id, const bool strand) : id(transcript_id), strand(strand), start_codon(0), stop_codon(0), error(false) {
+		exons.reset(strand);
+		exons.reserve(64);
+	}
+
+	/// <summary>
+	/// Reinitialize the current object for another transcript; already allocated memory is reused.
+	/// </summary>
+	/// <param name="transcript_id">Identifier of the transcript.</param>
+	/// <param name="strand">Strand direction of the transcript.</param>
+	void reset(const std::string_view transcript_id, const bool strand) {
+		id.assign(transcript_id);
+		this->strand = strand;
+		exons.reset(strand);
+		start_codon = 0;
+		stop_codon = 0;
+		error = false;
+	}
 
 	/// <summary>
 	/// Provides an access to the transcript_id.
@@ -35,25 +75,17 @@ public:
 
 	/// <summary>
 	/// Add an interval to the list of exons.
-	/// For the simplicity, only start index of the exon is checked for duplicity; the rest will be checked during coordinates extraction.
+	/// For the simplicity, only start index of the exon is checked for duplicity (when exons are sorted); the rest will be checked during coordinates extraction.
 	/// </summary>
 	/// <param name="from">Start position of the exon.</param>
 	/// <param name="to">Stop position of the exon.</param>
 	inline void add_exon(const size_t from, const size_t to) {
-		size_t from_ = strand ? from : -to;
-		size_t to_ = strand ? to : -from;
 		if (from > to) {
 			std::cerr << "Transcript '" << id << "' contains a line with unordered start-stop positions: " << from << ", " << to << std::endl;
 			error = true;
 			return;
 		}
-		auto exons_it = exons.find(from_);
-		if (exons_it != exons.end()) {
-			std::cerr << "Transcript '" << id << "' contains overlapping exons at position " << (strand ? from : to) << std::endl;
-			error = true;
-			return;
-		}
-		exons[from_] = to_;
+		exons.add(from, to);
 	}
 
 	/// <summary>
@@ -71,11 +103,7 @@ public:
 	/// <param name="from">Start position of the fragment.</param>
 	/// <param name="to">Stop position of the fragment.</param>
 	inline void update_start_codon(const size_t from, const size_t to) {
-		if (this->start_codon == 0) {
-			this->start_codon = strand ? from : -to;
-		} else {
-			this->start_codon = std::min(this->start_codon, strand ? from : -to);
-		}
+		with_strand(strand, [&](auto direction) { update_codon<decltype(direction)>(start_codon, from, to); });
 	}
 
 	/// <summary>
@@ -84,11 +112,7 @@ public:
 	/// <param name="from">Start position of the fragment.</param>
 	/// <param name="to">Stop position of the fragment.</param>
 	inline void update_stop_codon(const size_t from, const size_t to) {
-		if (this->stop_codon == 0) {
-			this->stop_codon = strand ? from : -to;
-		} else {
-			this->stop_codon = std::min(this->stop_codon, strand ? from : -to);
-		}
+		with_strand(strand, [&](auto direction) { update_codon<decltype(direction)>(stop_codon, from, to); });
 	}
 
 	/// <summary>
@@ -99,6 +123,17 @@ public:
 		if (error || id.empty()) {
 			return UNDEFINED;
 		}
+		// Exons with the same start are reported in the order of the original lines
+		exons.sort();
+		for (size_t i = 1; i < exons.size(); ++i) {
+			if (exons.start(i) == exons.start(i - 1)) {
+				std::cerr << "Transcript '" << id << "' contains overlapping exons at position " << exons.start(i) << std::endl;
+				error = true;
+			}
+		}
+		if (error) {
+			return UNDEFINED;
+		}
 		if (start_codon == 0) {
 			std::cerr << "Transcript '" << id << "' does not have defined start_codon" << std::endl;
 			error = true;
@@ -119,48 +154,28 @@ public:
 			error = true;
 			return UNDEFINED;
 		}
-		{
-			size_t last = 0;
-			for (auto exons_it = exons.begin(); exons_it != exons.end(); ++exons_it) {
-				if (last >= exons_it->first) {
-					std::cerr << "No exon defined for transcript '" << id << "'" << std::endl;
-					error = true;
-					return UNDEFINED;
-				}
-				last = exons_it->second;
-			}
+		if (exons.build() != exons.size()) {
+			std::cerr << "No exon defined for transcript '" << id << "'" << std::endl;
+			error = true;
+			return UNDEFINED;
 		}
-		size_t start_position = 0;
-		for (auto exons_it = exons.begin(); exons_it != exons.end(); ++exons_it) {
-			if (start_codon < exons_it->first) {
-				std::cerr << "Transcript '" << id << "' has start_codon outside exons" << std::endl;
-				error = true;
-				return UNDEFINED;
-			}
-			if (start_codon <= exons_it->second) {
-				size_t stop_position = start_position;
-				start_position += start_codon - exons_it->first + 1;
-				do {
-					if (stop_codon < exons_it->first) {
-						std::cerr << "Transcript '" << id << "' has stop_codon outside exons" << std::endl;
-						error = true;
-						return UNDEFINED;
-					}
-					if (stop_codon <= exons_it->second) {
-						stop_position += stop_codon - exons_it->first + 1;
-						return std::pair<size_t, size_t>(start_position, stop_position);
-					}
-					stop_position += exons_it->second - exons_it->first + 1;
-				} while (++exons_it != exons.end());
-				std::cerr << "Transcript '" << id << "' has stop_codon outside exons" << std::endl;
-				error = true;
-				return UNDEFINED;
-			}
-			start_position += exons_it->second - exons_it->first + 1;
+		// Codons are kept in the direction of the transcript like exons were
+		std::pair<size_t, size_t> positions = with_strand(strand, [&](auto direction) {
+			return std::pair<size_t, size_t>(exons.project(direction.orient(start_codon)), exons.project(direction.orient(stop_codon)));
+		});
+		size_t start_position = positions.first;
+		if (start_position == ExonIndex::NONE) {
+			std::cerr << "Transcript '" << id << "' has start_codon outside exons" << std::endl;
+			error = true;
+			return UNDEFINED;
+		}
+		size_t stop_position = positions.second;
+		if (stop_position == ExonIndex::NONE) {
+			std::cerr << "Transcript '" << id << "' has stop_codon outside exons" << std::endl;
+			error = true;
+			return UNDEFINED;
 		}
-		std::cerr << "Transcript '" << id << "' has start_codon outside exons" << std::endl;
-		error = true;
-		return UNDEFINED;
+		return std::pair<size_t, size_t>(start_position, stop_position);
 	}
 };
 /// <summary>
@@ -169,99 +184,191 @@ public:
 const std::pair<size_t, size_t> Transcript::UNDEFINED(-1, -1);
 
 int main(int argc, char* argv[]) {
-	if (argc != 2) {
-		std::cout << "transcripts_startstop_positions <GTF_file>\t Parses annotations file in GTF format and identifies start and stop codon positions for each transcript\n";
+	// Compression of the standard output
+	OutputFile::Compression compression = OutputFile::Compression::NONE;
+	int argi = 1;
+	for (int previous = 0; previous != argi; ) {
+		previous = argi;
+		if (!parse_compression(argi, argc, argv, compression) || !parse_stats(argi, argc, argv) || !parse_cache(argi, argc, argv)) {
+			return 1;
+		}
+	}
+	if (argc != argi + 1) {
+		std::cout << "transcripts_startstop_positions [--compress FORMAT] [--cache DIR] [--stats | --stats-json FILE] <GTF_file>\t Parses annotations file in GTF format and identifies start and stop codon positions for each transcript\n";
 		std::cout << "                                          \t in coordinates relative to the transcript.\n";
-		std::cout << "Created by Jan Jelínek (jan.jelinek@biomed.cas.cz); last update: 2023-03-29; license: Apache License 2.0" << std::endl;
+		std::cout << "                                          \t <GTF_file> can be also an annotation index compiled by compile_annotations.\n";
+		std::cout << "                                          \t --compress FORMAT\t compress the output by 'gzip' (BGZF), 'zstd' or 'none'.\n";
+		print_stats_usage("                                          \t ");
+		print_cache_usage("                                          \t ");
+		std::cout << "Created by Jan Jelínek (jan.jelinek@biomed.cas.cz); last update: 2026-10-14; license: Apache License 2.0" << std::endl;
 		return 0;
 	}
 
-	std::map<std::string, std::pair<size_t, size_t>> coordinates;
+	RunStats& stats = RunStats::global();
+	ResultCache& cache = ResultCache::global();
+	cache.setup("transcripts_startstop_positions", argi, argv);
+	ResultCache::Result result = cache.result({ argv[argi] }, { "-" });
+	if (result.restore()) {
+		stats.add("reused_outputs", 1);
+		return stats.report() ? 0 : 9;
+	}
+	stats.start("annotations load");
+	// Number of annotation lines (or records of an index)
+	uint64_t records = 0;
+	// Coordinates of transcripts in the order of their lines; sorted by transcript_id in the end
+	std::vector<std::pair<std::string, std::pair<size_t, size_t>>> coordinates;
 	{
-		std::ifstream file(argv[1]);
 		Transcript transcript("", false);
-		for (std::string line; std::getline(file, line); ) {
-			if (!line.empty() && line[0] != '#') {
-				std::stringstream parts(line);
-				std::string part("");
-				std::string type("");
-				size_t start = 0;
-				size_t end = 0;
-				bool strand = false;
-				std::string transcript_id;
-				for (size_t i = 0; i < 9; i++) {
-					if (!std::getline(parts, part, '\t')) {
-						std::cerr << "Unexpected line format - not enough columns: " << line << std::endl;
-						part = "";
-						break;
-					}
-					// Well, switch would require an extra variable or goto or needless iterations
-					if (i == 2) {
-						if (part == "exon" || part == "start_codon" || part == "stop_codon") {
-							type = part;
-						} else {
-							break;
-						}
-					} else if (i == 3) {
-						start = std::stoull(part);
-					} else if (i == 4) {
-						end = std::stoull(part);
-					} else if (i == 6) {
-						if (part == "+") {
-							strand = true;
-						} else if (part != "-") {
-							std::cerr << "Unexpected or unsupported strand identifier '" << part << "' within line: " << line << std::endl;
-							type = "";
-							break;
-						}
-					} else if (i == 8) {
-						size_t from = part.find("transcript_id \"");
-						if (from == part.npos) {
-							std::cerr << "Missing transcript_id attribute: " << line << std::endl;
-							type = "";
+		// Adds an exon, start or stop codon line of a transcript
+		auto add = [&](const std::string_view type, const size_t start, const size_t end, const bool strand, const std::string_view transcript_id) {
+			if (transcript.transcript_id() != transcript_id) {
+				coordinates.emplace_back(transcript.transcript_id(), transcript.get_coordinates());
+				transcript.reset(transcript_id, strand);
+			} else if (!transcript.check_strand(strand)) {
+				std::cerr << "Ambiguous strand for transcript '" << transcript.transcript_id() << "'" << std::endl;
+				return;
+			}
+			if (type == "exon") {
+				transcript.add_exon(start, end);
+			} else if (type == "start_codon") {
+				transcript.update_start_codon(start, end);
+			} else if (type == "stop_codon") {
+				transcript.update_stop_codon(start, end);
+			}
+		};
+		if (AnnotationIndex::is_annotation_index(argv[argi])) { // Annotations are already parsed
+			AnnotationIndex index;
+			if (!index.open(argv[argi])) {
+				return 9;
+			}
+			index.read([&](const uint64_t, const GtfRecord& record) {
+				++records;
+				if (record.feature != "exon" && record.feature != "start_codon" && record.feature != "stop_codon") {
+					return 0;
+				}
+				if (record.strand == '.') {
+					std::cerr << "Unexpected or unsupported strand identifier '" << record.strand << "' within line: " << record.to_line() << std::endl;
+				} else if (record.transcript_id.empty()) {
+					std::cerr << "Missing transcript_id attribute: " << record.to_line() << std::endl;
+				} else {
+					add(record.feature, record.start, record.end, record.strand == '+', record.transcript_id);
+				}
+				return 0;
+			}, [](const std::string_view) { return 0; });
+		} else {
+			InputFile file;
+			if (!file.open(argv[argi])) {
+				return 9;
+			}
+			for (std::string line; file.getline(line); ) {
+				++records;
+				if (!line.empty() && line[0] != '#') {
+					std::string_view type;
+					uint64_t start = 0;
+					uint64_t end = 0;
+					bool strand = false;
+					std::string_view transcript_id;
+					// Start of the current column
+					size_t position = 0;
+					for (size_t i = 0; i < 9; i++) {
+						if (position >= line.size()) {
+							std::cerr << "Unexpected line format - not enough columns: " << line << std::endl;
 							break;
 						}
-						from += 15;
-						size_t to = part.find('"', from);
-						if (to == part.npos) {
-							std::cerr << "Unfinished transcript_id attribute: " << line << std::endl;
-							type = "";
-							break;
+						size_t next = line.find('\t', position);
+						if (next == line.npos) {
+							next = line.size();
 						}
-						transcript_id = part.substr(from, to - from);
-						if (transcript_id.empty()) {
-							std::cerr << "Empty transcript_id attribute: " << line << std::endl;
-							type = "";
-							break;
+						std::string_view part(line.data() + position, next - position);
+						position = next + 1;
+						// Well, switch would require an extra variable or goto or needless iterations
+						if (i == 2) {
+							if (part == "exon" || part == "start_codon" || part == "stop_codon") {
+								type = part;
+							} else {
+								break;
+							}
+						} else if (i == 3 || i == 4) {
+							if (!parse_integer(part, i == 3 ? start : end)) {
+								std::cerr << "Unexpected line format - invalid start or end position: " << line << std::endl;
+								return 2;
+							}
+						} else if (i == 6) {
+							if (part == "+") {
+								strand = true;
+							} else if (part != "-") {
+								std::cerr << "Unexpected or unsupported strand identifier '" << part << "' within line: " << line << std::endl;
+								type = std::string_view();
+								break;
+							}
+						} else if (i == 8) {
+							size_t from = part.find("transcript_id \"");
+							if (from == part.npos) {
+								std::cerr << "Missing transcript_id attribute: " << line << std::endl;
+								type = std::string_view();
+								break;
+							}
+							from += 15;
+							size_t to = part.find('"', from);
+							if (to == part.npos) {
+								std::cerr << "Unfinished transcript_id attribute: " << line << std::endl;
+								type = std::string_view();
+								break;
+							}
+							transcript_id = part.substr(from, to - from);
+							if (transcript_id.empty()) {
+								std::cerr << "Empty transcript_id attribute: " << line << std::endl;
+								type = std::string_view();
+								break;
+							}
 						}
 					}
-				}
-				if (!type.empty()) {
-					if (transcript.transcript_id() != transcript_id) {
-						coordinates[transcript.transcript_id()] = transcript.get_coordinates();
-						transcript = Transcript(transcript_id, strand);
-					} else if (!transcript.check_strand(strand)) {
-						std::cerr << "Ambiguous strand for transcript '" << transcript.transcript_id() << "'" << std::endl;
-						continue;
-					}
-					if (type == "exon") {
-						transcript.add_exon(start, end);
-					} else if (type == "start_codon") {
-						transcript.update_start_codon(start, end);
-					} else if (type == "stop_codon") {
-						transcript.update_stop_codon(start, end);
+					if (!type.empty()) {
+						add(type, start, end, strand, transcript_id);
 					}
 				}
 			}
+			if (file.failed()) {
+				std::cerr << "Unable to read file '" << argv[argi] << "'." << std::endl;
+				return 10;
+			}
 		}
 		if (!transcript.transcript_id().empty()) {
-			coordinates[transcript.transcript_id()] = transcript.get_coordinates();
+			coordinates.emplace_back(transcript.transcript_id(), transcript.get_coordinates());
 		}
 	}
+	stats.stop(records);
+
+	stats.start("output");
+	// Numbers of distinct transcripts and transcripts without valid start and stop codons
+	uint64_t transcripts = 0, undefined = 0;
+	OutputFile output;
+	if (!output.open(result.target(0), compression)) {
+		return 9;
+	}
+	// A repeated transcript_id keeps coordinates of its last occurrence
+	std::stable_sort(coordinates.begin(), coordinates.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
 	for (auto coordinates_it = coordinates.begin(); coordinates_it != coordinates.end(); ++coordinates_it) {
-		if (coordinates_it->second != Transcript::UNDEFINED) {
-			std::cout << coordinates_it->first << '\t' << coordinates_it->second.first << '\t' << coordinates_it->second.second << '\n';
+		if (coordinates_it->first.empty() || (coordinates_it + 1 != coordinates.end() && coordinates_it[1].first == coordinates_it->first)) { // The first item is a placeholder without exons
+			continue;
+		}
+		++transcripts;
+		if (coordinates_it->second == Transcript::UNDEFINED) {
+			++undefined;
+		} else {
+			output.write(coordinates_it->first);
+			output.put('\t');
+			output.write(std::to_string(coordinates_it->second.first));
+			output.put('\t');
+			output.write(std::to_string(coordinates_it->second.second));
+			output.put('\n');
 		}
 	}
-	std::cout.flush();
+	if (!output.close() || !result.store()) {
+		return 9;
+	}
+	stats.stop(transcripts - undefined);
+	stats.add("transcripts", transcripts);
+	stats.add("undefined_transcripts", undefined);
+	return stats.report() ? 0 : 9;
 }